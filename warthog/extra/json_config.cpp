@@ -7,7 +7,8 @@ to_json(nlohmann::json& j, const config& c)
         {"hscale", c.hscale}, {"fscale", c.fscale}, {"time", c.time},
         {"itrs", c.itrs}, {"k_moves", c.k_moves}, {"threads", c.threads},
         {"verbose", c.verbose}, {"debug", c.debug},
-        {"thread_alloc", c.thread_alloc}, {"no_cache", c.no_cache}
+        {"thread_alloc", c.thread_alloc}, {"no_cache", c.no_cache},
+        {"batch", c.batch}, {"matrix", c.matrix}
     };
 }
 
@@ -24,6 +25,9 @@ from_json(const nlohmann::json& j, config& c)
     j.at("debug").get_to(c.debug);
     j.at("thread_alloc").get_to(c.thread_alloc);
     j.at("no_cache").get_to(c.no_cache);
+    // optional, for older clients
+    c.batch = j.value("batch", c.batch);
+    c.matrix = j.value("matrix", c.matrix);
 }
 
 // Configuration is passed around as a JSON object, we need to do the
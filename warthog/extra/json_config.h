@@ -34,11 +34,13 @@ typedef struct config
     double time = DBL_MAX;
     uint32_t itrs = warthog::INF32;
     uint32_t k_moves = warthog::INF32;
+    uint32_t batch = 0;                 // Queries extracted in lock-step
     unsigned char threads = 0;
     bool verbose = VERBOSE;
     bool debug = false;
     bool thread_alloc = false;
     bool no_cache = false;
+    bool matrix = false;                // Queries are a cost matrix job
 } config;
 
 void
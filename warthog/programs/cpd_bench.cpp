@@ -0,0 +1,323 @@
+/**
+ * Micro-benchmarks of CPD lookups.
+ *
+ * Rows are either taken from an RLE CPD (--input graph.xy graph.cpd) or
+ * generated at random. Random (row, column) lookups are then timed for each
+ * kernel, grouped by the number of runs in a row, and compared against the
+ * previous implementation: a std::function probe over vectors with bounds
+ * checks.
+ *
+ * With a forward CPD and --queries N, the path costs of N random queries
+ * are also extracted one at a time and in batches of increasing size.
+ */
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <getopt.h>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "binary.h"
+#include "cfg.h"
+#include "cpd_extractions.h"
+#include "graph_oracle.h"
+#include "run_lookup.h"
+#include "timer.h"
+#include "xy_graph.h"
+
+typedef std::vector<std::vector<warthog::cpd::rle_run32>> t_rows;
+typedef std::function<bool(uint32_t&)> t_find_fn;
+
+// The lookup kernel before `run_lookup.h`.
+uint32_t
+legacy_find_row(uint32_t target_index,
+                std::vector<warthog::cpd::rle_run32>& row)
+{
+    uint32_t end = (uint32_t)row.size();
+    t_find_fn find_target = [&target_index, &row](uint32_t mid)
+    {
+        return target_index < row.at(mid).get_index();
+    };
+
+    return warthog::util::binary_find_first<uint32_t, t_find_fn>(
+        0, end, find_target);
+}
+
+void
+random_rows(t_rows& rows, uint32_t num_rows, uint32_t num_cols,
+            std::mt19937& rng)
+{
+    std::vector<uint32_t> lengths = {2, 4, 8, 16, 32, 64, 256, 1024, 4096};
+    std::uniform_int_distribution<uint32_t> col(1, num_cols - 1);
+
+    rows.resize(num_rows);
+    for(uint32_t i = 0; i < num_rows; i++)
+    {
+        uint32_t len = lengths.at(i % lengths.size());
+        std::vector<uint32_t> heads = {0};
+        while(heads.size() < len) { heads.push_back(col(rng)); }
+        std::sort(heads.begin(), heads.end());
+        heads.erase(std::unique(heads.begin(), heads.end()), heads.end());
+
+        for(uint32_t h : heads)
+        {
+            rows.at(i).push_back({(uint32_t)((h << 4) | (rng() % 8))});
+        }
+    }
+}
+
+// copy the rows of a CPD built with symbol S
+template<warthog::cpd::symbol S>
+bool
+load_rows(warthog::graph::xy_graph& g, std::string cpd_filename, t_rows& rows)
+{
+    warthog::cpd::graph_oracle_base<S> oracle(&g);
+    if(!oracle.load(cpd_filename)) { return false; }
+
+    for(size_t i = 0; i < oracle.get_num_rows(); i++)
+    {
+        warthog::cpd::row_handle row = oracle.get_row_at(i);
+        rows.emplace_back(row.begin(), row.end());
+    }
+    return true;
+}
+
+int
+bench_extractions(warthog::graph::xy_graph& g,
+                  warthog::cpd::graph_oracle& oracle, uint32_t num_queries,
+                  std::mt19937& rng)
+{
+    warthog::cpd_extractions extract(&g, &oracle);
+    extract.set_max_k_moves(g.get_num_nodes());
+
+    std::uniform_int_distribution<uint32_t> node(0, g.get_num_nodes() - 1);
+    std::vector<warthog::problem_instance> pis;
+    for(uint32_t i = 0; i < num_queries; i++)
+    {
+        pis.push_back(warthog::problem_instance(node(rng), node(rng)));
+    }
+
+    std::vector<double> costs;
+    uint64_t num_moves = 0;
+    warthog::timer t;
+    t.start();
+    for(warthog::problem_instance& pi : pis)
+    {
+        warthog::solution sol;
+        extract.get_pathcost(pi, sol);
+        costs.push_back(sol.sum_of_edge_costs_);
+        num_moves += sol.nodes_touched_;
+    }
+    t.stop();
+
+    std::cout << "\nbatch\tns/query\tns/move\n" << std::fixed
+              << std::setprecision(2) << "-\t"
+              << t.elapsed_time_nano() / num_queries << "\t"
+              << t.elapsed_time_nano() / num_moves << "\n";
+
+    for(uint32_t batch : {1, 4, 8, 16, 32, 64})
+    {
+        std::vector<warthog::solution> sols;
+        extract.set_batch_size(batch);
+        t.start();
+        extract.get_pathcosts(pis, sols);
+        t.stop();
+
+        for(uint32_t i = 0; i < num_queries; i++)
+        {
+            if(sols.at(i).sum_of_edge_costs_ != costs.at(i))
+            {
+                std::cerr << "err; batched extraction disagrees\n";
+                return EXIT_FAILURE;
+            }
+        }
+
+        std::cout << batch << "\t" << t.elapsed_time_nano() / num_queries
+                  << "\t" << t.elapsed_time_nano() / num_moves << "\n";
+    }
+
+    return EXIT_SUCCESS;
+}
+
+int
+main(int argc, char* argv[])
+{
+    warthog::util::param valid_args[] =
+    {
+        {"input", required_argument, 0, 1},
+        {"lookups", required_argument, 0, 1},
+        {"queries", required_argument, 0, 1},
+        {"seed", required_argument, 0, 1},
+        {0, 0, 0, 0}
+    };
+
+    warthog::util::cfg cfg;
+    cfg.parse_args(argc, argv, valid_args);
+
+    std::string s_lookups = cfg.get_param_value("lookups");
+    std::string s_seed = cfg.get_param_value("seed");
+    uint32_t num_lookups = s_lookups == "" ? 4000000 : std::stoi(s_lookups);
+    std::mt19937 rng(s_seed == "" ? 42 : std::stoi(s_seed));
+
+    std::string s_queries = cfg.get_param_value("queries");
+    uint32_t num_queries = s_queries == "" ? 0 : std::stoi(s_queries);
+
+    t_rows rows;
+    uint32_t num_cols;
+    std::string xy_filename = cfg.get_param_value("input");
+    warthog::graph::xy_graph g;
+    std::string cpd_filename;
+    uint32_t version;
+    uint32_t symbol = warthog::cpd::FORWARD;
+
+    if(xy_filename != "")
+    {
+        cpd_filename = cfg.get_param_value("input");
+        if(cpd_filename == "") { cpd_filename = xy_filename + ".cpd"; }
+
+        std::ifstream ifs(xy_filename);
+        ifs >> g;
+        ifs.close();
+
+        if(!warthog::cpd::get_file_version(cpd_filename, version, symbol))
+        {
+            std::cerr << "Could not find CPD file '" << cpd_filename << "'\n";
+            return EXIT_FAILURE;
+        }
+
+        bool loaded;
+        switch(symbol)
+        {
+            case warthog::cpd::REVERSE:
+                loaded = load_rows<warthog::cpd::REVERSE>(
+                    g, cpd_filename, rows);
+                break;
+            case warthog::cpd::BEARING:
+                loaded = load_rows<warthog::cpd::BEARING>(
+                    g, cpd_filename, rows);
+                break;
+            case warthog::cpd::FWD_BEARING:
+                loaded = load_rows<warthog::cpd::FWD_BEARING>(
+                    g, cpd_filename, rows);
+                break;
+            case warthog::cpd::FORWARD:
+            case UINT32_MAX:
+                loaded = load_rows<warthog::cpd::FORWARD>(
+                    g, cpd_filename, rows);
+                break;
+            default:
+                std::cerr << "err; only run-length encoded CPDs have runs\n";
+                return EXIT_FAILURE;
+        }
+
+        if(!loaded)
+        {
+            std::cerr << "Could not load CPD file '" << cpd_filename << "'\n";
+            return EXIT_FAILURE;
+        }
+        num_cols = g.get_num_nodes();
+    }
+    else
+    {
+        num_cols = 1 << 20;
+        random_rows(rows, 4096, num_cols, rng);
+    }
+
+    // group rows by their number of runs
+    std::vector<uint32_t> bounds = {4, 8, 16, 32, 64, 256, 1024, UINT32_MAX};
+    std::vector<std::vector<uint32_t>> groups(bounds.size());
+    for(uint32_t i = 0; i < rows.size(); i++)
+    {
+        if(rows.at(i).size() == 0) { continue; }
+        uint32_t b = 0;
+        while(rows.at(i).size() > bounds.at(b)) { b++; }
+        groups.at(b).push_back(i);
+    }
+
+    std::cout << "runs\trows\tlegacy\tlinear\tbinary\tfind_run\t(ns/lookup)\n";
+    std::uniform_int_distribution<uint32_t> col(0, num_cols - 1);
+
+    for(uint32_t b = 0; b < bounds.size(); b++)
+    {
+        if(groups.at(b).empty()) { continue; }
+
+        std::vector<std::pair<uint32_t, uint32_t>> lookups(num_lookups);
+        std::uniform_int_distribution<uint32_t> pick(
+            0, groups.at(b).size() - 1);
+        for(auto& l : lookups)
+        {
+            l = {groups.at(b).at(pick(rng)), col(rng)};
+        }
+
+        std::vector<double> nanos;
+        std::vector<uint64_t> sums;
+        for(uint32_t kernel = 0; kernel < 4; kernel++)
+        {
+            warthog::timer t;
+            uint64_t sum = 0;
+            t.start();
+            for(auto& l : lookups)
+            {
+                std::vector<warthog::cpd::rle_run32>& row = rows[l.first];
+                warthog::cpd::rle_row view(row);
+                switch(kernel)
+                {
+                    case 0:
+                        sum += legacy_find_row(l.second, row);
+                        break;
+                    case 1:
+                        sum += warthog::cpd::find_run_linear(
+                            view.begin(), view.size(), l.second);
+                        break;
+                    case 2:
+                        sum += warthog::cpd::find_run_binary(
+                            view.begin(), view.size(), l.second);
+                        break;
+                    default:
+                        sum += warthog::cpd::find_run(view, l.second);
+                        break;
+                }
+            }
+            t.stop();
+            nanos.push_back(t.elapsed_time_nano() / lookups.size());
+            sums.push_back(sum);
+        }
+
+        if(!std::all_of(sums.begin(), sums.end(),
+                        [&sums](uint64_t s) { return s == sums.front(); }))
+        {
+            std::cerr << "err; lookup kernels disagree\n";
+            return EXIT_FAILURE;
+        }
+
+        std::cout << "<=" << (bounds.at(b) == UINT32_MAX ?
+                              std::string("inf") :
+                              std::to_string(bounds.at(b)))
+                  << "\t" << groups.at(b).size() << std::fixed
+                  << std::setprecision(2);
+        for(double n : nanos) { std::cout << "\t" << n; }
+        std::cout << "\n";
+    }
+
+    if(xy_filename != "" && num_queries > 0)
+    {
+        // extractions follow forward moves
+        warthog::cpd::graph_oracle oracle(&g);
+        if(symbol != warthog::cpd::FORWARD && symbol != UINT32_MAX)
+        {
+            std::cerr << "err; --queries needs a forward CPD\n";
+            return EXIT_FAILURE;
+        }
+        if(!oracle.load(cpd_filename))
+        {
+            std::cerr << "Could not load CPD file '" << cpd_filename << "'\n";
+            return EXIT_FAILURE;
+        }
+        return bench_extractions(g, oracle, num_queries, rng);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -19,6 +19,9 @@
 #include <csignal>
 #include <iostream>
 #include <fstream>
+#include <functional>
+#include <memory>
+#include <thread>
 #include <vector>
 #include <omp.h>
 #include <json.hpp>
@@ -30,22 +33,51 @@
 #include "cpd_extractions.h"
 #include "cpd_graph_expansion_policy.h"
 #include "cpd_heuristic.h"
+#include "cpd_matrix.h"
 #include "cpd_search.h"
 #include "graph_oracle.h"
+#include "hub_labels.h"
 #include "json_config.h"
 #include "log.h"
 #include "noop_search.h"
+#include "numa_topology.h"
+#include "published_cpd.h"
 #include "solution.h"
 #include "timer.h"
 #include "xy_graph.h"
 
 typedef std::function<void(warthog::search*, config&)> conf_fn;
+// Extract many queries at once (cf. cpd_extractions_base::get_paths)
+typedef std::function<void(warthog::search*,
+                           std::vector<warthog::problem_instance>&,
+                           std::vector<warthog::solution>&)> batch_fn;
 typedef warthog::sn_id_t t_query;
+// Costs from each source to each target (cf. cpd_matrix_base::get_costs)
+typedef std::function<void(const std::vector<t_query>&,
+                           const std::vector<t_query>&,
+                           std::vector<warthog::cost_t>&,
+                           uint32_t)> matrix_fn;
+// Check for a new build of the CPD between jobs (cf. reload_oracle)
+typedef std::function<void()> reload_fn;
+// Once a job changed the edge costs of the graph
+typedef std::function<void()> perturb_fn;
 
 // Defaults
 std::string fifo = "/tmp/warthog.fifo";
 std::vector<warthog::search*> algos;
 warthog::util::cfg cfg;
+// new id of each node when the graph is renumbered (make_cpd --renumber)
+std::vector<uint32_t> node_ids;
+int reload = 0;
+// cf. load_oracle
+std::string cache_mb;
+std::string shards;
+// with --numa, the NUMA nodes, and the CPU and node (an index of numa_nodes)
+// of each worker thread (cf. place_threads)
+int numa = 0;
+std::vector<warthog::util::numa_node> numa_nodes;
+std::vector<uint32_t> thread_cpus;
+std::vector<uint32_t> thread_nodes;
 
 //
 // - Functions
@@ -102,11 +134,205 @@ read_graph_and_diff(warthog::graph::xy_graph& g)
     return xy_filename;
 }
 
+/**
+ * Renumber the graph like its CPD if it was built with `make_cpd --renumber`,
+ * i.e., if its column order is the identity and a permutation file sits next
+ * to it, or to the manifest of its shards.
+ */
+template<warthog::cpd::symbol S>
+bool
+read_renumbering(std::string cpd_filename, warthog::graph::xy_graph& g,
+                 warthog::cpd::graph_oracle_base<S>& oracle)
+{
+    std::ifstream ifs((shards != "" ? shards : cpd_filename) + ".perm");
+    if (!ifs.good() || !oracle.has_identity_order()) { return true; }
+
+    if (!warthog::cpd::renumber_graph(ifs, &g, node_ids))
+    {
+        std::cerr << "Could not renumber the graph." << std::endl;
+        return false;
+    }
+    oracle.update_bearings();
+
+    user(VERBOSE, "Renumbered the graph into column order.");
+    return true;
+}
+
+/**
+ * Load a CPD file, or with `--cache <MB>`, open it with its rows left on disk
+ * but for a cache of that many megabytes in RAM. With `--shards <manifest>`,
+ * the partial CPDs it lists are mapped instead, as one oracle (cf.
+ * cpd_shards.h). The bound of a lossy CPD is reported.
+ */
+template<warthog::cpd::symbol S>
+bool
+load_oracle(std::string cpd_filename,
+            warthog::cpd::graph_oracle_base<S>& oracle)
+{
+    bool loaded;
+    if (shards != "")
+    {
+        user(VERBOSE, "Mapping the CPD shards of", shards);
+        loaded = oracle.map_shards(shards);
+    }
+    else if (cache_mb == "")
+    {
+        loaded = oracle.load(cpd_filename);
+    }
+    else
+    {
+        size_t cache_bytes = std::stoull(cache_mb) << 20;
+        user(VERBOSE, "Caching", cache_mb, "MB of CPD rows in memory.");
+        loaded = oracle.load_tiered(cpd_filename, cache_bytes);
+    }
+
+    // the paths of a lossy CPD are not all optimal (cf. make_cpd --epsilon)
+    if (loaded && oracle.get_bound() > 0)
+    {
+        std::cerr << "paths within " << oracle.get_bound() * 100
+                  << "% of optimal" << std::endl;
+    }
+    return loaded;
+}
+
+/**
+ * With `--distances <file>`, read the hub labels written by `make_cpd
+ * --distances`, from which path costs are then taken. They hold the costs of
+ * the graph as it is read: once a job applies a diff, they are dropped (cf.
+ * drop_distances) and costs are those of the paths again. Labels give
+ * optimal costs, so they are refused for a CPD of @param bound > 0.
+ *
+ * @return false if the labels are given but cannot be read or used.
+ */
+bool
+read_distances(warthog::graph::xy_graph& g,
+               warthog::cpd::hub_labels& distances, double bound)
+{
+    std::string hl_filename = cfg.get_param_value("distances");
+    if (hl_filename == "") { return true; }
+
+    if (bound > 0)
+    {
+        std::cerr << "err; --distances cannot be used with a lossy CPD"
+                  << std::endl;
+        return false;
+    }
+
+    std::ifstream ifs(hl_filename, std::ios_base::binary);
+    if (!ifs.good() || !distances.read(ifs))
+    {
+        std::cerr << "Could not read the distance file " << hl_filename
+                  << std::endl;
+        return false;
+    }
+    if (distances.get_num_nodes() != g.get_num_nodes())
+    {
+        std::cerr << "err; the distance file is for a graph of "
+                  << distances.get_num_nodes() << " nodes" << std::endl;
+        return false;
+    }
+
+    user(VERBOSE, "Read", distances.get_num_entries(), "hub label entries.");
+    return true;
+}
+
+/**
+ * Stop taking costs from the hub labels, if @param has_distances, once the
+ * edge costs change: the extractions in `algos` and @param matrix walk the
+ * paths again.
+ */
+template<warthog::cpd::symbol S>
+perturb_fn
+drop_distances(bool has_distances, warthog::cpd_matrix_base<S>& matrix)
+{
+    return [&matrix, has_distances] () mutable -> void
+    {
+        if (!has_distances) { return; }
+
+        warning(true, "Edge costs changed, hub labels are no longer used.");
+        for (warthog::search* alg : algos)
+        {
+            static_cast<warthog::cpd_extractions_base<S>*>(alg)
+                ->set_distances(nullptr);
+        }
+        matrix.set_distances(nullptr);
+        has_distances = false;
+    };
+}
+
+/**
+ * With `--reload`, check between jobs whether a new build of the CPD was
+ * published (cf. `make_cpd --publish`), and if so load it in place of the
+ * oracle; jobs which already run keep the build they started with. A build
+ * which cannot be loaded, or does not have the rows of the oracle, is reported
+ * and the oracle is kept. Renumbered CPDs are not reloaded.
+ *
+ * The version is read before the CPD is loaded, so that a build published in
+ * between is loaded at the first job.
+ *
+ * @return the function to call between jobs, which is empty without
+ * `--reload`.
+ */
+template<warthog::cpd::symbol S>
+reload_fn
+reload_oracle(std::string cpd_filename,
+              warthog::cpd::graph_oracle_base<S>& oracle)
+{
+    if (!reload) { return nullptr; }
+    if (numa_nodes.size() > 1)
+    {
+        warning(true, "Replicated CPDs are not reloaded.");
+        return nullptr;
+    }
+    if (shards != "")
+    {
+        warning(true, "Sharded CPDs are not reloaded.");
+        return nullptr;
+    }
+
+    std::shared_ptr<warthog::cpd::published_cpd> published =
+        std::make_shared<warthog::cpd::published_cpd>(cpd_filename);
+    if (!published->open()) { return nullptr; }
+
+    uint64_t version = published->get_version();
+    user(VERBOSE, "Reloading", cpd_filename, "when published, from version",
+         version);
+
+    return [published, version, cpd_filename, &oracle] () mutable -> void
+    {
+        uint64_t latest = published->get_version();
+        if (latest == version) { return; }
+        version = latest;
+
+        if (!node_ids.empty())
+        {
+            warning(true, "Renumbered CPDs are not reloaded.");
+            return;
+        }
+
+        warthog::cpd::graph_oracle_base<S> fresh(oracle.get_graph());
+        if (!load_oracle(cpd_filename, fresh) ||
+            fresh.get_num_rows() != oracle.get_num_rows() ||
+            fresh.has_identity_order() != oracle.has_identity_order())
+        {
+            warning(true, "Could not reload version", version, "of",
+                    cpd_filename, "; keeping the previous build.");
+            return;
+        }
+
+        fresh.set_div(oracle.get_div());
+        fresh.set_mod(oracle.get_mod());
+        fresh.set_offset(oracle.get_offset());
+        oracle = fresh;
+        user(VERBOSE, "Reloaded version", version, "of", cpd_filename);
+    };
+}
+
 template<warthog::cpd::symbol S>
 void
-read_oracle(std::string xy_filename, warthog::cpd::graph_oracle_base<S>& oracle)
+read_oracle(std::string xy_filename, warthog::cpd::graph_oracle_base<S>& oracle,
+            reload_fn* reload_cpd = nullptr)
 {
-    std::ifstream ifs;
     // read the cpd
     std::string cpd_filename = cfg.get_param_value("input");
     if(cpd_filename == "")
@@ -114,23 +340,47 @@ read_oracle(std::string xy_filename, warthog::cpd::graph_oracle_base<S>& oracle)
         cpd_filename = xy_filename + ".cpd";
     }
 
-    ifs.open(cpd_filename);
-    if(ifs.is_open())
+    if (reload_cpd != nullptr)
     {
-        ifs >> oracle;
-        ifs.close();
+        *reload_cpd = reload_oracle(cpd_filename, oracle);
     }
-    else
+
+    if(!load_oracle(cpd_filename, oracle))
     {
         std::cerr << "Could not find the CPD file." << std::endl;
         return;
     }
+
+    read_renumbering(cpd_filename, *oracle.get_graph(), oracle);
+}
+
+/**
+ * With `--lazy <threads>`, compute the rows of the oracle as queries need
+ * them, and with that many threads in the background, instead of loading a
+ * CPD file: a graph can be queried before its CPD is built.
+ *
+ * @return false if the oracle is to be loaded from a file.
+ */
+template<warthog::cpd::symbol S>
+bool
+lazy_oracle(warthog::cpd::graph_oracle_base<S>& oracle)
+{
+    if (cfg.get_num_values("lazy") == 0) { return false; }
+
+    uint32_t threads = std::stoi(cfg.get_param_value("lazy"));
+    user(VERBOSE, "Computing CPD rows on demand, with", threads,
+         "threads in the background.");
+
+    return oracle.make_lazy(warthog::cpd::DFS_ORDER, threads);
 }
 
 template<warthog::cpd::symbol S>
 void
 conf_oracle(warthog::cpd::graph_oracle_base<S>& oracle)
 {
+    // the rows of shards are those of the nodes
+    if (oracle.is_sharded()) { return; }
+
     std::string s_div = cfg.get_param_value("div");
     std::string s_mod = cfg.get_param_value("mod");
     std::string s_offset = cfg.get_param_value("offset");
@@ -149,6 +399,76 @@ conf_oracle(warthog::cpd::graph_oracle_base<S>& oracle)
     }
 }
 
+/**
+ * With `--numa`, pin each worker thread to a core of its own, handing out the
+ * NUMA nodes in turn so that the first threads are spread over the sockets.
+ */
+void
+place_threads()
+{
+    numa_nodes = warthog::util::get_numa_nodes();
+
+    for (size_t t = 0; t < algos.size(); t++)
+    {
+        uint32_t node = t % numa_nodes.size();
+        const std::vector<uint32_t>& cpus = numa_nodes.at(node).cpus_;
+        thread_nodes.push_back(node);
+        thread_cpus.push_back(cpus.at((t / numa_nodes.size()) % cpus.size()));
+    }
+
+    user(VERBOSE, "Pinning", algos.size(), "threads on", numa_nodes.size(),
+         "NUMA nodes.");
+}
+
+/**
+ * With `--numa` on a machine of several NUMA nodes, each worker thread queries
+ * a replica of the rows of @param oracle in the memory of its node, which a
+ * thread pinned there copies. Lazy and tiered oracles are shared, as is the
+ * graph. Replicas are not shared with other processes (cf. published_cpd.h),
+ * and matrix jobs (cf. cpd_matrix_base) read @param oracle itself. The
+ * replicas are kept in @param replicas, which must outlive the workers.
+ *
+ * @return the oracle of each worker thread
+ */
+template<warthog::cpd::symbol S>
+std::vector<warthog::cpd::graph_oracle_base<S>*>
+local_oracles(warthog::cpd::graph_oracle_base<S>& oracle,
+              std::vector<std::unique_ptr<warthog::cpd::graph_oracle_base<S>>>&
+                  replicas)
+{
+    std::vector<warthog::cpd::graph_oracle_base<S>*> oracles(
+        algos.size(), &oracle);
+    if (numa_nodes.size() <= 1) { return oracles; }
+    if (!oracle.is_flat())
+    {
+        warning(true, "Lazy and tiered CPDs are not replicated.");
+        return oracles;
+    }
+
+    replicas.clear();
+    replicas.resize(numa_nodes.size());
+    std::vector<std::thread> copiers;
+    for (size_t n = 0; n < numa_nodes.size(); n++)
+    {
+        copiers.emplace_back([&, n] ()
+        {
+            warthog::util::pin_thread(numa_nodes.at(n).cpus_);
+            replicas.at(n).reset(
+                new warthog::cpd::graph_oracle_base<S>(oracle));
+            replicas.at(n)->localise();
+        });
+    }
+    for (std::thread& copier : copiers) { copier.join(); }
+
+    for (size_t t = 0; t < algos.size(); t++)
+    {
+        oracles.at(t) = replicas.at(thread_nodes.at(t)).get();
+    }
+
+    user(VERBOSE, "Replicated the CPD on", numa_nodes.size(), "NUMA nodes.");
+    return oracles;
+}
+
 /**
  * The search function does a bunch of statistics out of the search. It takes a
  * configration object, an output pipe and a list of queries and processes them.
@@ -156,7 +476,7 @@ conf_oracle(warthog::cpd::graph_oracle_base<S>& oracle)
 void
 run_search(conf_fn& apply_conf, config& conf, const std::string& fifo_out,
            const std::vector<t_query> &reqs, double t_read,
-           warthog::graph::xy_graph* g)
+           warthog::graph::xy_graph* g, batch_fn* get_batch)
 {
     assert(reqs.size() % 2 == 0);
     size_t n_results = reqs.size() / 2;
@@ -180,6 +500,18 @@ run_search(conf_fn& apply_conf, config& conf, const std::string& fifo_out,
     user(conf.verbose, "Preparing to process", n_results, "queries using",
          (int)threads, "threads.");
 
+    // with --numa, the queries and the time of the slowest thread of each
+    // node, from which its throughput is reported
+    std::vector<size_t> node_queries(numa_nodes.size(), 0);
+    std::vector<double> node_us(numa_nodes.size(), 0);
+    // the reader runs as OpenMP thread 0, and gets its CPUs back afterwards:
+    // threads it starts later (e.g., for matrix jobs) inherit them
+    std::vector<uint32_t> reader_cpus;
+    if (!thread_cpus.empty())
+    {
+        reader_cpus = warthog::util::get_thread_cpus();
+    }
+
     t.start();
 
 #pragma omp parallel num_threads(threads)                               \
@@ -193,6 +525,13 @@ run_search(conf_fn& apply_conf, config& conf, const std::string& fifo_out,
         warthog::timer t_thread;
         warthog::solution sol;
         warthog::search* alg = algos.at(thread_id);
+        size_t n_queries = 0;
+
+        // each thread stays on its core, next to its replica of the CPD
+        if (!thread_cpus.empty())
+        {
+            warthog::util::pin_thread({thread_cpus.at(thread_id)});
+        }
 
         apply_conf(alg, conf);
 
@@ -217,6 +556,25 @@ run_search(conf_fn& apply_conf, config& conf, const std::string& fifo_out,
             g->perturb(v);
         }
 
+        auto update_stats = [&](warthog::solution& sol,
+                                warthog::sn_id_t target_id)
+        {
+            t_astar += sol.time_elapsed_nano_;
+            n_expanded += sol.nodes_expanded_;
+            n_touched += sol.nodes_touched_;
+            n_heap_ops += sol.heap_ops_;
+            n_reopen += sol.nodes_reopen_;
+            n_surplus += sol.nodes_surplus_;
+            plen += sol.path_.size();
+            finished += sol.path_.back() == target_id;
+        };
+
+        // Queries are either solved one at a time or, when the algorithm
+        // supports it, collected and extracted together.
+        bool batched = get_batch != nullptr && conf.batch > 0;
+        std::vector<warthog::problem_instance> pis;
+        std::vector<warthog::solution> sols;
+
         t_thread.start();
         // Iterate over the *requests* then convert to ids ({o,d} pair)
         for (auto id = from; id < to; id += 1)
@@ -234,33 +592,60 @@ run_search(conf_fn& apply_conf, config& conf, const std::string& fifo_out,
             if (conf.thread_alloc && target_id % thread_count != thread_id)
             { continue; }
 
-            // Actual search
             warthog::problem_instance pi(start_id, target_id, conf.debug);
+            n_queries++;
+            if (batched)
+            {
+                pis.push_back(pi);
+                continue;
+            }
+
+            // Actual search
             alg->get_path(pi, sol);
+            update_stats(sol, target_id);
+        }
 
-            // Update stasts
-            t_astar += sol.time_elapsed_nano_;
-            n_expanded += sol.nodes_expanded_;
-            n_touched += sol.nodes_touched_;
-            n_heap_ops += sol.heap_ops_;
-            n_reopen += sol.nodes_reopen_;
-            n_surplus += sol.nodes_surplus_;
-            plen += sol.path_.size();
-            finished += sol.path_.back() == target_id;
+        if (batched)
+        {
+            (*get_batch)(alg, pis, sols);
+            for (size_t q = 0; q < pis.size(); q++)
+            {
+                update_stats(sols.at(q), pis.at(q).target_id_);
+            }
         }
 
         t_thread.stop();
 
 #pragma omp critical
-        trace(conf.verbose, "[", thread_id, "] Processed", to - from,
-              "trips in", t_thread.elapsed_time_micro(), "us.");
+        {
+            trace(conf.verbose, "[", thread_id, "] Processed", to - from,
+                  "trips in", t_thread.elapsed_time_micro(), "us.");
+
+            if (!thread_nodes.empty())
+            {
+                uint32_t node = thread_nodes.at(thread_id);
+                node_queries.at(node) += n_queries;
+                node_us.at(node) = std::max(node_us.at(node),
+                                            t_thread.elapsed_time_micro());
+            }
+        }
     }
 
     t.stop();
 
+    if (!reader_cpus.empty()) { warthog::util::pin_thread(reader_cpus); }
+
     user(conf.verbose, "Processed", n_results, "in", t.elapsed_time_micro(),
          "us");
 
+    for (size_t n = 0; n < node_queries.size(); n++)
+    {
+        if (node_queries.at(n) == 0) { continue; }
+        user(conf.verbose, "NUMA node", numa_nodes.at(n).id_, "processed",
+             node_queries.at(n), "queries in", node_us.at(n), "us:",
+             node_queries.at(n) * 1e6 / node_us.at(n), "queries/s");
+    }
+
     std::streambuf* buf;
     std::ofstream of;
     if (fifo_out == "-")
@@ -285,6 +670,60 @@ run_search(conf_fn& apply_conf, config& conf, const std::string& fifo_out,
     if (fifo_out != "-") { of.close(); }
 }
 
+/**
+ * Matrix jobs compute the cost from each source to each target, and write them
+ * to the output pipe: a line of comma-separated costs per source, with -1 where
+ * there is no path.
+ */
+void
+run_matrix(config& conf, const std::string& fifo_out,
+           const std::vector<t_query>& sources,
+           const std::vector<t_query>& targets, matrix_fn& get_matrix)
+{
+#ifdef SINGLE_THREADED
+    unsigned int threads = 1;
+#else
+    unsigned int threads = conf.threads;
+#endif
+
+    warthog::timer t;
+    std::vector<warthog::cost_t> costs;
+
+    t.start();
+    get_matrix(sources, targets, costs, threads);
+    t.stop();
+
+    user(conf.verbose, "Computed a", sources.size(), "x", targets.size(),
+         "matrix in", t.elapsed_time_micro(), "us");
+
+    std::streambuf* buf;
+    std::ofstream of;
+    if (fifo_out == "-")
+    {
+        buf = std::cout.rdbuf();
+    }
+    else
+    {
+        of.open(fifo_out);
+        buf = of.rdbuf();
+    }
+
+    std::ostream out(buf);
+    for (size_t i = 0; i < sources.size(); i++)
+    {
+        for (size_t j = 0; j < targets.size(); j++)
+        {
+            warthog::cost_t cost = costs.at(i * targets.size() + j);
+            out << (j > 0 ? "," : "")
+                << (cost == warthog::COST_MAX ? -1 : cost);
+        }
+        out << "\n";
+    }
+    out.flush();
+
+    if (fifo_out != "-") { of.close(); }
+}
+
 /**
  * The reader thread reads the data passed to the pipe ('FIFO') in the following
  * order:
@@ -296,9 +735,18 @@ run_search(conf_fn& apply_conf, config& conf, const std::string& fifo_out,
  *  3. the queries as (o, d)-pairs.
  *
  * It then passes the data to the search function before calling itself again.
+ *
+ * With `"matrix": true` in the configuration, the queries are instead the
+ * numbers of sources and targets, followed by the sources and then the targets,
+ * and their costs are passed to @param get_matrix.
+ *
+ * Before each job, @param reload_cpd, if any, swaps in a new build of the CPD,
+ * and @param on_perturb, if any, is called once the job's diff is applied.
  */
 void
-reader(conf_fn& apply_conf, warthog::graph::xy_graph* g)
+reader(conf_fn& apply_conf, warthog::graph::xy_graph* g,
+       batch_fn* get_batch = nullptr, matrix_fn* get_matrix = nullptr,
+       reload_fn* reload_cpd = nullptr, perturb_fn* on_perturb = nullptr)
 {
     std::ifstream fd;
     config conf;
@@ -306,6 +754,8 @@ reader(conf_fn& apply_conf, warthog::graph::xy_graph* g)
     std::string queries;
     std::string diff;
     std::vector<t_query> lines;
+    std::vector<t_query> sources;
+    std::vector<t_query> targets;
     warthog::timer t;
     std::vector<std::pair<uint32_t, warthog::graph::edge>> edges;
 
@@ -346,6 +796,32 @@ reader(conf_fn& apply_conf, warthog::graph::xy_graph* g)
         {
             warning("Could not open", queries);
             lines.clear();
+            sources.clear();
+            targets.clear();
+        }
+        else if (conf.matrix)
+        {
+            size_t n_sources = 0;
+            size_t n_targets = 0;
+
+            fd >> n_sources >> n_targets;
+            sources.resize(n_sources);
+            targets.resize(n_targets);
+            for (auto* ids : {&sources, &targets})
+            {
+                for (t_query& id : *ids)
+                {
+                    fd >> id;
+                    if (!node_ids.empty()) { id = node_ids.at(id); }
+                }
+            }
+
+            if (fd.fail())
+            {
+                warning("Could not read the matrix job in", queries);
+                sources.clear();
+                targets.clear();
+            }
         }
         else
         {
@@ -358,6 +834,12 @@ reader(conf_fn& apply_conf, warthog::graph::xy_graph* g)
             debug(conf.verbose, "Preparing to read", s, "queries");
             while (fd >> o >> d)
             {
+                // translate ids once per query rather than at each step
+                if (!node_ids.empty())
+                {
+                    o = node_ids.at(o);
+                    d = node_ids.at(d);
+                }
                 lines.at(i) = o;
                 lines.at(i + 1) = d;
                 i += 2;
@@ -386,6 +868,11 @@ reader(conf_fn& apply_conf, warthog::graph::xy_graph* g)
                 debug(conf.verbose, "Preparing to read", s, "perturbations");
                 while (fd >> h >> t >> w)
                 {
+                    if (!node_ids.empty())
+                    {
+                        h = node_ids.at(h);
+                        t = node_ids.at(t);
+                    }
                     edges.at(i) = {h, warthog::graph::edge(t, w)};
                     i += 1;
                 }
@@ -394,6 +881,10 @@ reader(conf_fn& apply_conf, warthog::graph::xy_graph* g)
             fd.close();
 
             g->perturb(edges);
+            if (!edges.empty() && on_perturb != nullptr && *on_perturb)
+            {
+                (*on_perturb)();
+            }
         }
         t.stop();
 
@@ -409,14 +900,28 @@ reader(conf_fn& apply_conf, warthog::graph::xy_graph* g)
             }
         }
 
-        if (lines.size() > 0)
+        if (reload_cpd != nullptr && *reload_cpd) { (*reload_cpd)(); }
+
+        if (conf.matrix)
+        {
+            if (get_matrix == nullptr)
+            {
+                warning(true, "Matrix jobs need a CPD algorithm.");
+            }
+            else if (sources.size() > 0 && targets.size() > 0)
+            {
+                run_matrix(conf, fifo_out, sources, targets, *get_matrix);
+            }
+        }
+        else if (lines.size() > 0)
         {
             run_search(apply_conf, conf, fifo_out, lines,
-                       t.elapsed_time_nano(), g);
+                       t.elapsed_time_nano(), g, get_batch);
         }
     }
 }
 
+template<warthog::cpd::symbol SYM>
 void
 run_cpd_search(warthog::graph::xy_graph &g)
 {
@@ -425,19 +930,23 @@ run_cpd_search(warthog::graph::xy_graph &g)
     // TODO Have better control flow
     if (xy_filename == "") { return; }
 
-    warthog::cpd::graph_oracle oracle(&g);
-    read_oracle<warthog::cpd::FORWARD>(xy_filename, oracle);
+    warthog::cpd::graph_oracle_base<SYM> oracle(&g);
+    read_oracle<SYM>(xy_filename, oracle);
+    std::vector<std::unique_ptr<warthog::cpd::graph_oracle_base<SYM>>>
+        replicas;
+    std::vector<warthog::cpd::graph_oracle_base<SYM>*> oracles =
+        local_oracles(oracle, replicas);
 
-    for (auto& alg: algos)
+    for (size_t t = 0; t < algos.size(); t++)
     {
         warthog::simple_graph_expansion_policy* expander =
             new warthog::simple_graph_expansion_policy(&g);
-        warthog::cpd_heuristic* h =
-            new warthog::cpd_heuristic(&oracle, 1.0);
+        warthog::cpd_heuristic_base<SYM>* h =
+            new warthog::cpd_heuristic_base<SYM>(oracles.at(t), 1.0);
         warthog::pqueue_min* open = new warthog::pqueue_min();
 
-        alg = new warthog::cpd_search<
-            warthog::cpd_heuristic,
+        algos.at(t) = new warthog::cpd_search<
+            warthog::cpd_heuristic_base<SYM>,
             warthog::simple_graph_expansion_policy,
             warthog::pqueue_min>(h, expander, open);
     }
@@ -447,11 +956,11 @@ run_cpd_search(warthog::graph::xy_graph &g)
     conf_fn apply_conf = [] (warthog::search* base, config &conf) -> void
     {
         warthog::cpd_search<
-            warthog::cpd_heuristic,
+            warthog::cpd_heuristic_base<SYM>,
             warthog::simple_graph_expansion_policy,
             warthog::pqueue_min>* alg = static_cast<
                 warthog::cpd_search<
-                    warthog::cpd_heuristic,
+                    warthog::cpd_heuristic_base<SYM>,
                     warthog::simple_graph_expansion_policy,
                     warthog::pqueue_min>*>(base);
 
@@ -477,16 +986,21 @@ run_table_search(warthog::graph::xy_graph &g)
     warthog::cpd::graph_oracle_base<warthog::cpd::REV_TABLE> oracle(&g);
     read_oracle<warthog::cpd::REV_TABLE>(xy_filename, oracle);
     conf_oracle<warthog::cpd::REV_TABLE>(oracle);
+    std::vector<std::unique_ptr<
+        warthog::cpd::graph_oracle_base<warthog::cpd::REV_TABLE>>> replicas;
+    std::vector<warthog::cpd::graph_oracle_base<warthog::cpd::REV_TABLE>*>
+        oracles = local_oracles(oracle, replicas);
 
-    for (auto& alg: algos)
+    for (size_t t = 0; t < algos.size(); t++)
     {
         warthog::simple_graph_expansion_policy* expander =
             new warthog::simple_graph_expansion_policy(&g);
         warthog::cpd_heuristic_base<warthog::cpd::REV_TABLE>* h =
-            new warthog::cpd_heuristic_base<warthog::cpd::REV_TABLE>(&oracle, 1.0);
+            new warthog::cpd_heuristic_base<warthog::cpd::REV_TABLE>(
+                oracles.at(t), 1.0);
         warthog::pqueue_min* open = new warthog::pqueue_min();
 
-        alg = new warthog::cpd_search<
+        algos.at(t) = new warthog::cpd_search<
             warthog::cpd_heuristic_base<warthog::cpd::REV_TABLE>,
             warthog::simple_graph_expansion_policy,
             warthog::pqueue_min>(h, expander, open);
@@ -531,13 +1045,29 @@ run_table(warthog::graph::xy_graph &g)
     ifs.close();
 
     warthog::cpd::graph_oracle_base<warthog::cpd::REV_TABLE> oracle(&g);
-    read_oracle<warthog::cpd::REV_TABLE>(xy_filename, oracle);
-    conf_oracle<warthog::cpd::REV_TABLE>(oracle);
+    reload_fn reload_cpd;
+    // rows are those of the nodes, in a lazy oracle
+    if (!lazy_oracle(oracle))
+    {
+        read_oracle<warthog::cpd::REV_TABLE>(xy_filename, oracle, &reload_cpd);
+        conf_oracle<warthog::cpd::REV_TABLE>(oracle);
+    }
 
-    for (auto& alg: algos)
+    warthog::cpd::hub_labels distances;
+    if (!read_distances(g, distances, oracle.get_bound())) { return; }
+    bool has_distances = distances.get_num_nodes() > 0;
+    std::vector<std::unique_ptr<
+        warthog::cpd::graph_oracle_base<warthog::cpd::REV_TABLE>>> replicas;
+    std::vector<warthog::cpd::graph_oracle_base<warthog::cpd::REV_TABLE>*>
+        oracles = local_oracles(oracle, replicas);
+
+    for (size_t t = 0; t < algos.size(); t++)
     {
-        alg = new warthog::cpd_extractions_base<warthog::cpd::REV_TABLE>(
-            &g, &oracle);
+        warthog::cpd_extractions_base<warthog::cpd::REV_TABLE>* ext =
+            new warthog::cpd_extractions_base<warthog::cpd::REV_TABLE>(
+            &g, oracles.at(t));
+        if (has_distances) { ext->set_distances(&distances); }
+        algos.at(t) = ext;
     }
 
     user(VERBOSE, "Loaded", algos.size(), "search.");
@@ -549,11 +1079,32 @@ run_table(warthog::graph::xy_graph &g)
                 base);
 
         alg->set_max_k_moves(conf.k_moves);
+        if (conf.batch > 0) { alg->set_batch_size(conf.batch); }
     };
 
-    reader(apply_conf, &g);
+    batch_fn get_batch = [] (warthog::search* base,
+                             std::vector<warthog::problem_instance>& pis,
+                             std::vector<warthog::solution>& sols) -> void
+    {
+        static_cast<warthog::cpd_extractions_base<warthog::cpd::REV_TABLE>*>(
+            base)->get_paths(pis, sols);
+    };
+
+    warthog::cpd_matrix_base<warthog::cpd::REV_TABLE> matrix(&g, &oracle);
+    if (has_distances) { matrix.set_distances(&distances); }
+    matrix_fn get_matrix = [&matrix] (const std::vector<t_query>& sources,
+                                      const std::vector<t_query>& targets,
+                                      std::vector<warthog::cost_t>& costs,
+                                      uint32_t threads) -> void
+    {
+        matrix.get_costs(sources, targets, costs, threads);
+    };
+
+    perturb_fn on_perturb = drop_distances(has_distances, matrix);
+    reader(apply_conf, &g, &get_batch, &get_matrix, &reload_cpd, &on_perturb);
 }
 
+template<warthog::cpd::symbol SYM>
 void
 run_cpd(warthog::graph::xy_graph &g)
 {
@@ -568,41 +1119,73 @@ run_cpd(warthog::graph::xy_graph &g)
     ifs >> g;
     ifs.close();
 
-    warthog::cpd::graph_oracle oracle(&g);
-    std::string cpd_filename = cfg.get_param_value("cpd");
-    if(cpd_filename == "")
+    warthog::cpd::graph_oracle_base<SYM> oracle(&g);
+    reload_fn reload_cpd;
+    if (!lazy_oracle(oracle))
     {
-        cpd_filename = xy_filename + ".cpd";
-    }
+        std::string cpd_filename = cfg.get_param_value("cpd");
+        if(cpd_filename == "")
+        {
+            cpd_filename = xy_filename + ".cpd";
+        }
 
-    ifs.open(cpd_filename);
-    if(ifs.is_open())
-    {
-        ifs >> oracle;
-        ifs.close();
-    }
-    else
-    {
-        std::cerr << "Could not find CPD file." << std::endl;
-        return;
+        reload_cpd = reload_oracle(cpd_filename, oracle);
+        if(!load_oracle(cpd_filename, oracle))
+        {
+            std::cerr << "Could not find CPD file." << std::endl;
+            return;
+        }
+
+        if(!read_renumbering(cpd_filename, g, oracle)) { return; }
     }
 
-    for (auto& alg: algos)
+    warthog::cpd::hub_labels distances;
+    if (!read_distances(g, distances, oracle.get_bound())) { return; }
+    bool has_distances = distances.get_num_nodes() > 0;
+    std::vector<std::unique_ptr<warthog::cpd::graph_oracle_base<SYM>>>
+        replicas;
+    std::vector<warthog::cpd::graph_oracle_base<SYM>*> oracles =
+        local_oracles(oracle, replicas);
+
+    for (size_t t = 0; t < algos.size(); t++)
     {
-        alg = new warthog::cpd_extractions(&g, &oracle);
+        warthog::cpd_extractions_base<SYM>* ext =
+            new warthog::cpd_extractions_base<SYM>(&g, oracles.at(t));
+        if (has_distances) { ext->set_distances(&distances); }
+        algos.at(t) = ext;
     }
 
     user(VERBOSE, "Loaded", algos.size(), "search.");
 
     conf_fn apply_conf = [] (warthog::search* base, config &conf) -> void
     {
-        warthog::cpd_extractions* alg =
-            static_cast<warthog::cpd_extractions*>(base);
+        warthog::cpd_extractions_base<SYM>* alg =
+            static_cast<warthog::cpd_extractions_base<SYM>*>(base);
 
         alg->set_max_k_moves(conf.k_moves);
+        if (conf.batch > 0) { alg->set_batch_size(conf.batch); }
     };
 
-    reader(apply_conf, &g);
+    batch_fn get_batch = [] (warthog::search* base,
+                             std::vector<warthog::problem_instance>& pis,
+                             std::vector<warthog::solution>& sols) -> void
+    {
+        static_cast<warthog::cpd_extractions_base<SYM>*>(base)->get_paths(
+            pis, sols);
+    };
+
+    warthog::cpd_matrix_base<SYM> matrix(&g, &oracle);
+    if (has_distances) { matrix.set_distances(&distances); }
+    matrix_fn get_matrix = [&matrix] (const std::vector<t_query>& sources,
+                                      const std::vector<t_query>& targets,
+                                      std::vector<warthog::cost_t>& costs,
+                                      uint32_t threads) -> void
+    {
+        matrix.get_costs(sources, targets, costs, threads);
+    };
+
+    perturb_fn on_perturb = drop_distances(has_distances, matrix);
+    reader(apply_conf, &g, &get_batch, &get_matrix, &reload_cpd, &on_perturb);
 }
 
 void
@@ -683,7 +1266,13 @@ main(int argc, char *argv[])
             {"div",   required_argument, 0, 1},
             {"mod",   required_argument, 0, 1},
             {"offset", required_argument, 0, 1},
+            {"lazy",  required_argument, 0, 1},
+            {"cache", required_argument, 0, 1},
+            {"shards", required_argument, 0, 1},
+            {"distances", required_argument, 0, 1},
             {"num",   required_argument, 0, 1},
+            {"reload", no_argument, &reload, 1},
+            {"numa", no_argument, &numa, 1},
             // {"problem",  required_argument, 0, 1},
             {0,  0, 0, 0}
         };
@@ -712,6 +1301,12 @@ main(int argc, char *argv[])
     algos.resize(omp_get_max_threads());
 #endif
 
+    if (numa) { place_threads(); }
+
+    // read once, as each CPD which is reloaded is loaded the same way
+    cache_mb = cfg.get_param_value("cache");
+    shards = cfg.get_param_value("shards");
+
     std::string other = cfg.get_param_value("fifo");
     if (other != "")
     {
@@ -735,7 +1330,15 @@ main(int argc, char *argv[])
 
     if (alg_name == "cpd-search")
     {
-        run_cpd_search(g);
+        run_cpd_search<warthog::cpd::FORWARD>(g);
+    }
+    else if (alg_name == "fwd-bearing-search")
+    {
+        run_cpd_search<warthog::cpd::FWD_BEARING>(g);
+    }
+    else if (alg_name == "hybrid-search")
+    {
+        run_cpd_search<warthog::cpd::HYBRID>(g);
     }
     else if (alg_name == "table-search")
     {
@@ -744,12 +1347,27 @@ main(int argc, char *argv[])
     }
     else if (alg_name == "cpd")
     {
-        run_cpd(g);
+        run_cpd<warthog::cpd::FORWARD>(g);
+    }
+    else if (alg_name == "fwd-bearing")
+    {
+        run_cpd<warthog::cpd::FWD_BEARING>(g);
+    }
+    else if (alg_name == "hybrid")
+    {
+        run_cpd<warthog::cpd::HYBRID>(g);
     }
     else if (alg_name == "table")
     {
         run_table(g);
     }
+    else if (alg_name == "rev")
+    {
+        // e.g., lossy CPDs (cf. make_cpd --epsilon); lazy reverse rows are
+        // searched along the incoming edges
+        warthog::graph::xy_graph rg(0, "", true);
+        run_cpd<warthog::cpd::REVERSE>(rg);
+    }
     else if (alg_name == "bch")
     {
         run_bch();
@@ -1,20 +1,34 @@
 /**
  * This file is used to create CPDs in an independent fashion.
  */
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <cstdlib>
+#include <iomanip>
 #include <iostream>
 #include <fstream>
 #include <getopt.h>
+#include <memory>
+#include <mutex>
 #include <numeric>
 #include <omp.h>
+#include <type_traits>
 #include <vector>
 
 #include "bidirectional_graph_expansion_policy.h"
+#include "bounded_rows.h"
 #include "cfg.h"
 #include "constants.h"
+#include "cpd_repair.h"
+#include "cpd_shards.h"
+#include "cpd_writer.h"
 #include "graph_oracle.h"
+#include "grid_first_move_dijkstra.h"
+#include "hub_labels.h"
 #include "oracle_listener.h"
 #include "log.h"
+#include "published_cpd.h"
 #include "xy_graph.h"
 
 std::vector<warthog::sn_id_t>
@@ -47,51 +61,392 @@ range(size_t from, size_t to, size_t node_count)
     return nodes;
 }
 
+/**
+ * Report the number of runs per row of a CPD, to compare column orders.
+ */
+void
+report_runs(std::vector<uint32_t> runs, std::string order)
+{
+    uint64_t total = std::accumulate(runs.begin(), runs.end(), (uint64_t)0);
+
+    if (runs.empty()) { return; }
+    std::sort(runs.begin(), runs.end());
+
+    auto pct = [&runs](double p)
+    {
+        return runs.at((size_t)(p * (runs.size() - 1)));
+    };
+
+    std::cerr << "order: " << order << "; rows: " << runs.size()
+              << "; runs: " << total << "; runs per row: mean "
+              << std::fixed << std::setprecision(2)
+              << (double)total / runs.size() << ", median " << pct(0.5)
+              << ", p90 " << pct(0.9) << ", p99 " << pct(0.99) << ", max "
+              << runs.back() << std::endl;
+}
+
+template<warthog::cpd::symbol S>
+void
+report_runs(warthog::cpd::graph_oracle_base<S> &cpd, std::string order)
+{
+    std::vector<uint32_t> runs;
+
+    for (size_t i = 0; i < cpd.get_num_rows(); i++)
+    {
+        runs.push_back(cpd.get_row_at(i).size());
+    }
+
+    report_runs(runs, order);
+}
+
+/**
+ * Encode the rows of a built CPD as delta rows, then as block rows, as asked.
+ */
+template<warthog::cpd::symbol S>
+bool
+encode_rows(warthog::cpd::graph_oracle_base<S> &cpd, std::string order,
+            bool delta, bool blocks, bool verbose)
+{
+    if (delta)
+    {
+        info(verbose, "Encoding delta rows.");
+        if (!cpd.encode_deltas()) { return false; }
+        report_runs(cpd, order);
+    }
+
+    if (blocks)
+    {
+        info(verbose, "Encoding block rows.");
+        if (!cpd.encode_blocks()) { return false; }
+        report_runs(cpd, order);
+    }
+
+    return true;
+}
+
+/**
+ * Rewrite the CPD file `cpd_filename` with delta or block rows. Rows were
+ * streamed to disk as they were built, so they are read back from the file.
+ */
+template<warthog::cpd::symbol S>
+int
+rewrite_rows(warthog::cpd::graph_oracle_base<S> &cpd,
+             std::string cpd_filename, bool binary, std::string order,
+             bool delta, bool blocks, bool verbose)
+{
+    cpd.clear();
+
+    if (!cpd.load(cpd_filename))
+    {
+        std::cerr << "Cannot open file " << cpd_filename << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (!encode_rows(cpd, order, delta, blocks, verbose))
+    {
+        return EXIT_FAILURE;
+    }
+
+    // the rows are now in memory and the file can be written over
+    std::ofstream ofs(cpd_filename, std::ios_base::binary);
+
+    if (!ofs.good())
+    {
+        std::cerr << "Could not open CPD file " << cpd_filename << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    info(verbose, "Writing results to", cpd_filename);
+    if (binary)
+    {
+        cpd.write_binary(ofs);
+    }
+    else
+    {
+        ofs << cpd;
+    }
+
+    return ofs.good() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * Repair the CPD `old_filename` of `g` once the edge costs become those of
+ * the diff graph `diff_filename` (cf. xy_graph::perturb), and write it to
+ * `cpd_filename`. Only the rows which may change are computed again (cf.
+ * cpd_repair.h); the others are copied as they are.
+ */
+template<warthog::cpd::symbol S>
+int
+repair_cpd(warthog::graph::xy_graph &g,
+           warthog::cpd::graph_oracle_base<S> &cpd, std::string old_filename,
+           std::string diff_filename, std::string cpd_filename, bool reverse,
+           bool binary, double table_ratio, std::string order, bool delta,
+           bool blocks, bool verbose)
+{
+    warthog::timer t;
+    t.start();
+
+    if (!cpd.load(old_filename))
+    {
+        std::cerr << "Cannot open file " << old_filename << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // their moves were only checked against the old costs
+    if (cpd.get_bound() > 0)
+    {
+        std::cerr << "err; lossy CPDs (--epsilon) cannot be repaired"
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::ifstream ifs(diff_filename);
+    if (!ifs.good())
+    {
+        std::cerr << "Could not open diff-graph: " << diff_filename
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    uint32_t num_nodes = 0;
+    uint32_t num_edges = 0;
+    std::vector<std::pair<uint32_t, warthog::graph::edge>> edges;
+    std::vector<std::pair<int32_t, int32_t>> xy;
+    std::vector<warthog::graph::ECAP_T> in_degree;
+    std::vector<warthog::graph::ECAP_T> out_degree;
+    warthog::graph::parse_xy(
+        ifs, num_nodes, num_edges, edges, xy, in_degree, out_degree);
+    ifs.close();
+
+    if (num_nodes != g.get_num_nodes())
+    {
+        std::cerr << "err; the diff-graph has " << num_nodes
+                  << " nodes, but the graph has " << g.get_num_nodes()
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // a CPD built with --renumber goes with the renumbered graph, and the
+    // diff with it
+    std::vector<uint32_t> ids;
+    std::ifstream pfs(old_filename + ".perm");
+    if (pfs.good() && cpd.has_identity_order())
+    {
+        info(verbose, "Renumbering the graph into column order.");
+        if (!warthog::cpd::renumber_graph(pfs, &g, ids))
+        {
+            std::cerr << "Could not renumber the graph." << std::endl;
+            return EXIT_FAILURE;
+        }
+        for (auto& e : edges)
+        {
+            e.first = ids.at(e.first);
+            e.second.node_id_ = ids.at(e.second.node_id_);
+        }
+    }
+    pfs.close();
+
+    std::vector<warthog::cpd::edge_change> changes;
+    warthog::cpd::changed_edges(&g, edges, changes);
+    info(verbose, "Edges with new costs:", changes.size());
+
+    // the rows which may change are found with the old costs, searching
+    // against the direction of the rows
+    std::vector<bool> affected(g.get_num_nodes(), false);
+    {
+        warthog::cpd::first_move_graph fm_graph(&g, !reverse);
+
+        #ifndef SINGLE_THREADED
+        #pragma omp parallel
+        #endif
+        {
+            warthog::cpd::row_repair repair(&fm_graph);
+            std::vector<bool> marked(g.get_num_nodes(), false);
+
+            #ifndef SINGLE_THREADED
+            #pragma omp for schedule(dynamic)
+            #endif
+            for (size_t i = 0; i < changes.size(); i++)
+            {
+                repair.mark_rows(changes.at(i), marked);
+            }
+
+            #ifndef SINGLE_THREADED
+            #pragma omp critical
+            #endif
+            for (size_t r = 0; r < marked.size(); r++)
+            {
+                if (marked.at(r)) { affected.at(r) = true; }
+            }
+        }
+    }
+    if (!cpd.mark_delta_rows(affected)) { return EXIT_FAILURE; }
+
+    std::vector<uint32_t> row_ids;
+    for (uint32_t r = 0; r < affected.size(); r++)
+    {
+        if (affected.at(r)) { row_ids.push_back(r); }
+    }
+    std::cerr << "rows to repair: " << row_ids.size() << " of "
+              << cpd.get_num_rows() << std::endl;
+
+    // then computed again with the new ones, in the same column order
+    g.perturb(edges);
+    warthog::cpd::first_move_graph fm_graph(&g, reverse);
+    warthog::cpd::graph_oracle_base<S> builder(&g);
+    builder.set_table_ratio(table_ratio);
+    builder.copy_column_order(cpd);
+    std::vector<std::vector<warthog::cpd::rle_run32>> rows(row_ids.size());
+
+    #ifndef SINGLE_THREADED
+    #pragma omp parallel
+    #endif
+    {
+        warthog::cpd::first_move_dijkstra dijk(&fm_graph);
+        std::vector<warthog::cpd::fm_coll> s_row(g.get_num_nodes());
+
+        #ifndef SINGLE_THREADED
+        #pragma omp for schedule(dynamic, 16)
+        #endif
+        for (size_t i = 0; i < row_ids.size(); i++)
+        {
+            dijk.compute_row(row_ids.at(i), s_row);
+            builder.compress_row(row_ids.at(i), s_row, rows.at(i));
+        }
+    }
+
+    // the rows are now in memory and the old file can be written over
+    cpd.replace_rows(row_ids, rows);
+    std::vector<std::vector<warthog::cpd::rle_run32>>().swap(rows);
+    report_runs(cpd, order);
+
+    if (!encode_rows(cpd, order, delta, blocks, verbose))
+    {
+        return EXIT_FAILURE;
+    }
+
+    std::ofstream ofs(cpd_filename, std::ios_base::binary);
+
+    if (!ofs.good())
+    {
+        std::cerr << "Could not open CPD file " << cpd_filename << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    info(verbose, "Writing results to", cpd_filename);
+    if (binary)
+    {
+        cpd.write_binary(ofs);
+    }
+    else
+    {
+        ofs << cpd;
+    }
+    ofs.close();
+
+    if (!ids.empty() && cpd_filename != old_filename)
+    {
+        std::string perm_filename = cpd_filename + ".perm";
+        std::vector<uint32_t> column_order(ids.size());
+        for (uint32_t i = 0; i < ids.size(); i++)
+        {
+            column_order.at(ids.at(i)) = i;
+        }
+
+        std::ofstream perm(perm_filename);
+        if (!perm.good())
+        {
+            std::cerr << "Could not open permutation file " << perm_filename
+                      << std::endl;
+            return EXIT_FAILURE;
+        }
+        info(verbose, "Writing permutation to", perm_filename);
+        warthog::cpd::write_permutation(perm, column_order);
+    }
+
+    t.stop();
+    info(verbose, "total repair time (seconds):", t.elapsed_time_sec());
+
+    return EXIT_SUCCESS;
+}
+
 /**
  * Rebuild a CPD given a list of file containing its parts.
  *
- * The partial CPDs must be given in the order of the nodes.
+ * The partial CPDs must be given in the order of the nodes, and all be of
+ * symbol S and in the same column order, which the CPD keeps.
  */
+template<warthog::cpd::symbol S>
 int
 join_cpds(warthog::graph::xy_graph &g, std::string cpd_filename,
-          std::vector<std::string> file_list, uint32_t seed, bool verbose,
-          uint32_t mod)
+          std::vector<std::string> file_list, uint32_t seed,
+          std::string order, bool verbose, uint32_t mod, bool binary,
+          bool delta, bool blocks)
 {
     uint32_t step = 0;
     std::vector<warthog::sn_id_t> nodes;
 
+    // without --type, S is read from the parts, after the checks of main
+    if ((delta || blocks) &&
+        !warthog::cpd::graph_oracle_base<S>::has_tagged_rows())
+    {
+        std::cerr << "err; --delta and --blocks need a run-length encoded "
+                  << "CPD type" << std::endl;
+        return EXIT_FAILURE;
+    }
+
     if (mod > 1)
     {
         nodes = modulo(0, mod, g.get_num_nodes());
     }
 
-    // Here, the type of the oracle does not matter.
-    warthog::cpd::graph_oracle cpd(&g);
+    warthog::cpd::graph_oracle_base<S> cpd(&g);
     cpd.clear();                // Need to reset fm_
-    cpd.compute_dfs_preorder(seed);
-    // convert the column order into a map: from vertex id to its ordered index
-    cpd.value_index_swap_array();
 
     for (auto name: file_list)
     {
-        warthog::cpd::graph_oracle part(&g);
-        std::ifstream ifs(name);
+        warthog::cpd::graph_oracle_base<S> part(&g);
 
-        if (!ifs.good())
+        if (!part.load(name))
         {
             std::cerr << "Cannot open file " << name << std::endl;
             return EXIT_FAILURE;
         }
 
-        ifs >> part;
-        ifs.close();
+        // the runs of a part are over its own column order
+        if (step == 0)
+        {
+            cpd.copy_column_order(part);
+            cpd.value_index_swap_array();
+        }
+
+        bool same_order = part.get_num_cols() == cpd.get_num_cols();
+        for (uint32_t n = 0; same_order && n < cpd.get_num_cols(); n++)
+        {
+            same_order = part.get_col(n) == cpd.get_col(n);
+        }
+
+        if (!same_order)
+        {
+            std::cerr << "err; " << name << " has another column order than "
+                      << file_list.front() << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        // delta rows refer to rows of their own part
+        if (part.has_delta_rows())
+        {
+            std::cerr << "err; cannot join " << name
+                      << ", which has delta rows" << std::endl;
+            return EXIT_FAILURE;
+        }
+        cpd.set_bound(std::max(cpd.get_bound(), part.get_bound()));
 
         // Need to do it by hand as the rows are not consecutive
         if (mod > 1)
         {
             for (auto n : nodes)
             {
-                cpd.set_row(step + n, part.get_row(n));
+                cpd.set_row(step + n, part.get_row(n).view());
             }
         }
         else
@@ -102,7 +457,23 @@ join_cpds(warthog::graph::xy_graph &g, std::string cpd_filename,
         step++;
     }
 
-    std::ofstream ofs(cpd_filename);
+    cpd.compact();
+    report_runs(cpd, order);
+
+    // only the binary header records the bound of lossy parts
+    if (cpd.get_bound() > 0 && !binary)
+    {
+        std::cerr << "err; lossy CPDs (--epsilon) can only be joined with "
+                  << "--binary" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (!encode_rows(cpd, order, delta, blocks, verbose))
+    {
+        return EXIT_FAILURE;
+    }
+
+    std::ofstream ofs(cpd_filename, std::ios_base::binary);
 
     if (!ofs.good())
     {
@@ -111,33 +482,256 @@ join_cpds(warthog::graph::xy_graph &g, std::string cpd_filename,
     }
 
     info(verbose, "Writing results to", cpd_filename);
-    ofs << cpd;
+    if (binary)
+    {
+        cpd.write_binary(ofs);
+    }
+    else
+    {
+        ofs << cpd;
+    }
     ofs.close();
 
     return EXIT_SUCCESS;
 }
 
+/**
+ * Fill the first-move tables of a batch of sources with any of the searches.
+ */
+void
+fill_rows(warthog::cpd::first_move_dijkstra* dijk, const uint32_t* sources,
+          uint32_t count, std::vector<std::vector<warthog::cpd::fm_coll>> &rows)
+{
+    for (uint32_t i = 0; i < count; i++)
+    {
+        dijk->compute_row(sources[i], rows.at(i));
+    }
+}
+
+void
+fill_rows(warthog::cpd::grid_first_move_dijkstra* dijk,
+          const uint32_t* sources, uint32_t count,
+          std::vector<std::vector<warthog::cpd::fm_coll>> &rows)
+{
+    dijk->compute_rows(sources, count, rows);
+}
+
+void
+fill_rows(warthog::search* dijk, const uint32_t* sources, uint32_t count,
+          std::vector<std::vector<warthog::cpd::fm_coll>> &rows)
+{
+    for (uint32_t i = 0; i < count; i++)
+    {
+        warthog::problem_instance problem(sources[i]);
+        warthog::solution sol;
+
+        std::fill(rows.at(i).begin(), rows.at(i).end(),
+                  warthog::cpd::CPD_FM_NONE);
+        dijk->get_path(problem, sol);
+    }
+}
+
+/**
+ * Add the moves within the bound to the row of the target just searched (cf.
+ * bounded_rows.h), compress it and @return the bound its paths achieve.
+ */
+template<warthog::cpd::symbol S>
+double
+compress_bounded(warthog::cpd::first_move_dijkstra* dijk,
+                 warthog::cpd::bounded_rows& bounded,
+                 const warthog::cpd::graph_oracle_base<S>& cpd,
+                 uint32_t target_id,
+                 std::vector<warthog::cpd::fm_coll>& row,
+                 std::vector<warthog::cpd::rle_run32>& runs)
+{
+    bounded.widen(target_id, *dijk, row);
+    cpd.compress_row(target_id, row, runs);
+    return bounded.get_bound(target_id, *dijk, cpd.get_order(), runs);
+}
+
+/**
+ * Build the hub labels of the graph (cf. hub_labels.h), which answer path
+ * costs without walking the CPD, and write them to @param hl_filename.
+ */
+int
+write_distances(warthog::graph::xy_graph &g, std::string hl_filename,
+                bool verbose)
+{
+    warthog::timer t;
+    t.start();
+
+    info(verbose, "Building hub labels.");
+    warthog::cpd::hub_labels labels;
+    labels.build(&g);
+
+    std::ofstream ofs(hl_filename, std::ios_base::binary);
+    if (!ofs.good())
+    {
+        std::cerr << "Could not open distance file " << hl_filename
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+    labels.write(ofs);
+    ofs.close();
+    t.stop();
+
+    std::cerr << "wrote " << labels.get_num_entries() << " hub label entries ("
+              << (double)labels.get_num_entries() / g.get_num_nodes()
+              << " per node) to " << hl_filename << " in "
+              << t.elapsed_time_sec() << " s" << std::endl;
+
+    return ofs.good() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * Write the manifest line of the partial CPD `cpd_filename` of the rows of
+ * `nodes`, a range or every `mod`-th node, to `cpd_filename.shard` (cf.
+ * cpd_shards.h). The manifest of a directory of shards is the concatenation of
+ * their lines.
+ */
+int
+write_shard(std::string cpd_filename,
+            const std::vector<warthog::sn_id_t>& nodes)
+{
+    if (nodes.empty()) { return EXIT_SUCCESS; }
+
+    size_t slash = cpd_filename.find_last_of('/');
+    warthog::cpd::cpd_shard shard;
+    shard.filename_ = cpd_filename.substr(
+        slash == std::string::npos ? 0 : slash + 1);
+    shard.first_ = nodes.at(0);
+    shard.step_ = nodes.size() > 1 ? nodes.at(1) - nodes.at(0) : 1;
+
+    std::ofstream ofs(cpd_filename + ".shard");
+    warthog::cpd::write_shard_line(ofs, shard);
+    if (!ofs.good())
+    {
+        std::cerr << "Could not write " << cpd_filename << ".shard"
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Build the rows of the sources and stream them to disk in order.
+ *
+ * Rows are finished out of order by the threads and held in a window of
+ * `window` rows until all the rows before them are written, so memory is
+ * bounded by the window rather than the whole CPD. A checkpoint is saved
+ * every `ckpt_secs` seconds, from which an interrupted build can `resume`.
+ */
 template<warthog::cpd::symbol S>
 int
 make_cpd(warthog::graph::xy_graph &g, warthog::cpd::graph_oracle_base<S> &cpd,
          std::vector<warthog::cpd::oracle_listener*> &listeners,
          std::string cpd_filename, std::vector<warthog::sn_id_t> &nodes,
-         bool reverse, uint32_t seed, bool verbose=false)
+         bool reverse, uint32_t seed, std::string order,
+         warthog::cpd::order_strategy strategy, bool binary, bool resume,
+         size_t window, double ckpt_secs, uint32_t lanes, bool delta,
+         bool blocks, double epsilon, bool verbose=false)
 {
-    unsigned char pct_done = 0;
-    uint32_t nprocessed = 0;
     size_t node_count = nodes.size();
 
+    // per-thread statistics
+    std::vector<size_t> thread_rows(omp_get_max_threads(), 0);
+    std::vector<double> thread_secs(omp_get_max_threads(), 0);
+
     warthog::timer t;
     t.start();
 
-    info(verbose, "Computing node ordering.");
-    cpd.compute_dfs_preorder(seed);
+    info(verbose, "Computing node ordering:", order);
+    cpd.compute_column_order(strategy);
+
+    // a checkpoint only resumes the same sources in the same column order
+    const std::vector<uint32_t>& column_order = cpd.get_order();
+    uint64_t build_hash = warthog::cpd::hash_bytes(
+        nodes.data(), sizeof(warthog::sn_id_t) * nodes.size());
+    build_hash = warthog::cpd::hash_bytes(
+        column_order.data(), sizeof(uint32_t) * column_order.size(),
+        build_hash);
+    if (S == warthog::cpd::HYBRID || S == warthog::cpd::REV_HYBRID)
+    {
+        // and a hybrid one with the same choice of row encodings
+        double ratio = cpd.get_table_ratio();
+        build_hash = warthog::cpd::hash_bytes(
+            &ratio, sizeof(ratio), build_hash);
+    }
+    if (epsilon > 0)
+    {
+        // and a lossy one with the same bound
+        build_hash = warthog::cpd::hash_bytes(
+            &epsilon, sizeof(epsilon), build_hash);
+    }
+
+    warthog::cpd::cpd_writer writer(
+        cpd_filename, binary, S, column_order, node_count, build_hash);
+    std::ifstream ckpt(writer.get_checkpoint_filename());
+    bool has_ckpt = ckpt.good();
+    ckpt.close();
+
+    if (resume && has_ckpt)
+    {
+        if (!writer.resume())
+        {
+            std::cerr << "Cannot resume " << cpd_filename << std::endl;
+            return EXIT_FAILURE;
+        }
+        std::cerr << "Resuming " << cpd_filename << " from row "
+                  << writer.get_rows_done() << " of " << node_count
+                  << std::endl;
+    }
+    else
+    {
+        if (resume)
+        {
+            std::cerr << "No checkpoint for " << cpd_filename
+                      << ", starting a new build" << std::endl;
+        }
+        if (!writer.create()) { return EXIT_FAILURE; }
+    }
+
+    // Rows are computed by the specialised search unless we are given
+    // listeners, which only reverse bearing CPDs need.
+    std::unique_ptr<warthog::cpd::first_move_graph> fm_graph;
+    if (listeners.empty())
+    {
+        fm_graph.reset(new warthog::cpd::first_move_graph(&g, reverse));
+    }
+
+    // Grid maps are searched from a batch of sources at once, but lossy rows
+    // need the costs of each search.
+    bool grid = fm_graph && lanes > 0 && epsilon == 0 &&
+        warthog::cpd::grid_first_move_dijkstra::supports(fm_graph.get());
+    uint32_t batch = grid ? lanes : 1;
+    // a batch must fit in the window
+    window = std::max<size_t>(window, batch);
+    if (grid)
+    {
+        info(verbose, "Grid map: searching from", lanes, "sources at once.");
+    }
+
+    // sources are handed out in small chunks from a shared cursor, so that
+    // threads which draw cheap rows go on to take more of them
+    size_t rows_done = writer.get_rows_done();
+    std::atomic<size_t> next_id(rows_done);
+    std::atomic<size_t> nprocessed(rows_done);
+    std::atomic<uint32_t> pct_done((uint32_t)(rows_done * 100 / node_count));
+    std::atomic<bool> failed(false);
+
+    // the reorder buffer: row i waits in slot i % window until the rows
+    // before it are written
+    std::mutex window_mutex;
+    std::condition_variable window_cv;
+    std::vector<std::vector<warthog::cpd::rle_run32>> slots(window);
+    std::vector<bool> ready(window, false);
+    size_t next_write = rows_done;
+    double last_ckpt = t.get_time_sec();
 
     info(verbose, "Computing Dijkstra labels.");
     std::cerr << "progress: [";
     for(uint32_t i = 0; i < 100; i++) { std::cerr <<" "; }
-    std::cerr << "]\rprogress: [";
+    std::cerr << "]\rprogress: [" << std::string(pct_done.load(), '=');
 
     #ifndef SINGLE_THREADED
     #pragma omp parallel
@@ -145,69 +739,224 @@ make_cpd(warthog::graph::xy_graph &g, warthog::cpd::graph_oracle_base<S> &cpd,
     {
         int thread_count = omp_get_num_threads();
         int thread_id = omp_get_thread_num();
-        size_t start_id = thread_id;
         warthog::sn_id_t source_id;
+        // at least 32 chunks per thread, to even out the finishing times,
+        // in whole batches
+        size_t chunk = std::max<size_t>(
+            1, std::min<size_t>(64, node_count / (thread_count * 32)));
+        chunk = (chunk + batch - 1) / batch * batch;
+
+        std::vector<std::vector<warthog::cpd::fm_coll>> rows(
+            batch, std::vector<warthog::cpd::fm_coll>(g.get_num_nodes()));
+        std::vector<std::vector<warthog::cpd::rle_run32>> runs(batch);
+        std::vector<uint32_t> sources(batch);
+        std::unique_ptr<warthog::cpd::bounded_rows> bounded;
+        if (epsilon > 0)
+        {
+            bounded.reset(new warthog::cpd::bounded_rows(&g, epsilon));
+        }
+
+        auto compute_rows = [&](auto* dijk)
+        {
+            warthog::timer thread_timer;
+            thread_timer.start();
+
+            while (!failed)
+            {
+                size_t start_id = next_id.fetch_add(chunk);
+                if (start_id >= node_count) { break; }
+                size_t end_id = std::min(start_id + chunk, node_count);
+
+                for (size_t i = start_id; i < end_id; i += batch)
+                {
+                    uint32_t count = std::min<size_t>(batch, end_id - i);
+
+                    // the row before the window is always being computed, so
+                    // this wait cannot block every thread
+                    {
+                        std::unique_lock<std::mutex> lock(window_mutex);
+                        window_cv.wait(lock, [&]() {
+                            return i + count <= next_write + window ||
+                                failed; });
+                    }
+                    if (failed) { break; }
+
+                    for (uint32_t j = 0; j < count; j++)
+                    {
+                        sources.at(j) = (uint32_t)nodes.at(i + j);
+                    }
+                    // read by the listeners, which only search one source
+                    source_id = sources.at(0);
+                    fill_rows(dijk, sources.data(), count, rows);
+
+                    double bound = 0;
+                    for (uint32_t j = 0; j < count; j++)
+                    {
+                        runs.at(j).clear();
+                        // the other searches do not keep their costs, and
+                        // are not used for lossy rows
+                        if constexpr (std::is_same<
+                                decltype(dijk),
+                                warthog::cpd::first_move_dijkstra*>::value)
+                        {
+                            if (bounded)
+                            {
+                                bound = std::max(bound, compress_bounded(
+                                    dijk, *bounded, cpd, sources.at(j),
+                                    rows.at(j), runs.at(j)));
+                                continue;
+                            }
+                        }
+                        cpd.compress_row(
+                            sources.at(j), rows.at(j), runs.at(j));
+                    }
+
+                    std::lock_guard<std::mutex> lock(window_mutex);
+                    writer.add_bound(bound);
+                    for (uint32_t j = 0; j < count; j++)
+                    {
+                        slots.at((i + j) % window).swap(runs.at(j));
+                        ready.at((i + j) % window) = true;
+                    }
+
+                    while (next_write < node_count &&
+                           ready.at(next_write % window))
+                    {
+                        size_t slot = next_write % window;
+                        if (!writer.append(slots.at(slot))) { failed = true; }
+                        slots.at(slot).clear();
+                        ready.at(slot) = false;
+                        next_write++;
+                    }
+
+                    if (ckpt_secs > 0 && next_write < node_count &&
+                        t.get_time_sec() - last_ckpt >= ckpt_secs)
+                    {
+                        if (!writer.checkpoint()) { failed = true; }
+                        last_ckpt = t.get_time_sec();
+                    }
+                    window_cv.notify_all();
+                }
+                thread_rows.at(thread_id) += end_id - start_id;
+
+                // whichever thread moves the progress bar prints it
+                size_t done = nprocessed.fetch_add(end_id - start_id) +
+                              end_id - start_id;
+                uint32_t pct = (uint32_t)(done * 100 / node_count);
+                uint32_t prev = pct_done.load();
+                while (pct > prev &&
+                       !pct_done.compare_exchange_weak(prev, pct)) { }
+                if (pct > prev) { std::cerr << std::string(pct - prev, '='); }
+            }
+
+            thread_timer.stop();
+            thread_secs.at(thread_id) = thread_timer.elapsed_time_sec();
+        };
+
+        // each thread has its own copy of Dijkstra and each
+        // copy has a separate memory pool
+        if (grid)
+        {
+            warthog::cpd::grid_first_move_dijkstra dijk(fm_graph.get(), lanes);
+            compute_rows(&dijk);
+        }
+        else if (listeners.empty())
+        {
+            warthog::cpd::first_move_dijkstra dijk(fm_graph.get());
+            compute_rows(&dijk);
+        }
+        else
+        {
+            warthog::bidirectional_graph_expansion_policy expander(
+                &g, reverse);
+            warthog::zero_heuristic h;
+            warthog::pqueue_min queue;
+            warthog::flexible_astar<
+                warthog::zero_heuristic,
+                warthog::bidirectional_graph_expansion_policy,
+                warthog::pqueue_min,
+                warthog::cpd::oracle_listener>
+                dijk(&h, &expander, &queue);
+
+            listeners.at(thread_id)->set_run(&source_id, &rows.at(0));
+            dijk.set_listener(listeners.at(thread_id));
+            compute_rows((warthog::search*)&dijk);
+        }
+    }
+
+    std::cerr << std::endl;
+
+    for (auto l : listeners)
+    {
+        delete l;
+    }
+
+    if (failed)
+    {
+        std::cerr << "Could not write CPD file " << cpd_filename << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (verbose)
+    {
+        double max_secs = 0;
+        double sum_secs = 0;
+        size_t num_threads = 0;
 
-        std::vector<warthog::cpd::fm_coll> s_row(g.get_num_nodes());
-        // each thread has its own copy of Dijkstra and each
-        // copy has a separate memory pool
-        warthog::bidirectional_graph_expansion_policy expander(&g, reverse);
-        warthog::zero_heuristic h;
-        warthog::pqueue_min queue;
-        warthog::flexible_astar<
-            warthog::zero_heuristic,
-            warthog::bidirectional_graph_expansion_policy,
-            warthog::pqueue_min,
-            warthog::cpd::oracle_listener>
-            dijk(&h, &expander, &queue);
-
-        listeners.at(thread_id)->set_run(&source_id, &s_row);
-        dijk.set_listener(listeners.at(thread_id));
-
-        while (start_id < node_count)
-        {
-            source_id = nodes.at(start_id);
-            cpd.compute_row(source_id, &dijk, s_row);
-            // We increment the start_id by the number of threads to *jump* to
-            // that id in the vector.
-            start_id += thread_count;
-            #pragma omp critical
-            {
-                nprocessed++;
+        std::cerr << "thread\trows\tseconds\trows/s" << std::endl;
+        for (size_t i = 0; i < thread_rows.size(); i++)
+        {
+            if (thread_rows.at(i) == 0) { continue; }
+            std::cerr << i << "\t" << thread_rows.at(i) << "\t"
+                      << thread_secs.at(i) << "\t"
+                      << thread_rows.at(i) / thread_secs.at(i) << std::endl;
+            max_secs = std::max(max_secs, thread_secs.at(i));
+            sum_secs += thread_secs.at(i);
+            num_threads++;
+        }
 
-                if ((nprocessed * 100 / node_count) > pct_done)
-                {
-                    std::cerr << "=";
-                    pct_done++;
-                }
-            }
+        // 1 when all threads finish at the same time
+        if (num_threads > 0)
+        {
+            std::cerr << "load imbalance (max / mean thread time): "
+                      << max_secs * num_threads / sum_secs << std::endl;
         }
     }
 
-    std::cerr << std::endl;
-    // convert the column order into a map: from vertex id to its ordered index
-    cpd.value_index_swap_array();
-
-    t.stop();
-    info(verbose, "total preproc time (seconds):", t.elapsed_time_sec());
+    info(verbose, "Writing results to", cpd_filename);
+    if (!writer.finish()) { return EXIT_FAILURE; }
 
-    std::ofstream ofs(cpd_filename);
+    const std::vector<uint64_t>& offsets = writer.get_offsets();
+    std::vector<uint32_t> runs;
+    for (size_t i = 1; i < offsets.size(); i++)
+    {
+        runs.push_back(offsets.at(i) - offsets.at(i - 1));
+    }
+    report_runs(runs, order);
+    if (epsilon > 0)
+    {
+        std::cerr << "paths within " << writer.get_bound() * 100
+                  << "% of optimal (epsilon " << epsilon * 100 << "%)"
+                  << std::endl;
+    }
 
-    if (!ofs.good())
+    if ((delta || blocks) &&
+        rewrite_rows(cpd, cpd_filename, binary, order, delta, blocks,
+                     verbose) != EXIT_SUCCESS)
     {
-        std::cerr << "Could not open CPD file " << cpd_filename << std::endl;
         return EXIT_FAILURE;
     }
 
-    info(verbose, "Writing results to", cpd_filename);
-    ofs << cpd;
-    ofs.close();
-
-    for (auto l : listeners)
+    // the manifest line of a partial CPD, for fifo --shards
+    if (binary && node_count < g.get_num_nodes() &&
+        write_shard(cpd_filename, nodes) != EXIT_SUCCESS)
     {
-        delete l;
+        return EXIT_FAILURE;
     }
 
+    t.stop();
+    info(verbose, "total preproc time (seconds):", t.elapsed_time_sec());
+
     return EXIT_SUCCESS;
 }
 
@@ -215,6 +964,12 @@ int
 main(int argc, char *argv[])
 {
     int verbose = 0;
+    int binary = 0;
+    int renumber = 0;
+    int resume = 0;
+    int delta = 0;
+    int blocks = 0;
+    int distances = 0;
     warthog::util::param valid_args[] =
     {
         {"from", required_argument, 0, 1},
@@ -226,7 +981,22 @@ main(int argc, char *argv[])
         {"output", required_argument, 0, 1},
         {"join", required_argument, 0, 1},
         {"seed", required_argument, 0, 1},
+        {"order", required_argument, 0, 1},
         {"type", required_argument, 0, 1},
+        {"window", required_argument, 0, 1},
+        {"checkpoint", required_argument, 0, 1},
+        {"lanes", required_argument, 0, 1},
+        {"table-ratio", required_argument, 0, 1},
+        {"epsilon", required_argument, 0, 1},
+        {"repair", required_argument, 0, 1},
+        {"diff", required_argument, 0, 1},
+        {"publish", required_argument, 0, 1},
+        {"binary", no_argument, &binary, 1},
+        {"resume", no_argument, &resume, 1},
+        {"delta", no_argument, &delta, 1},
+        {"blocks", no_argument, &blocks, 1},
+        {"distances", no_argument, &distances, 1},
+        {"renumber", no_argument, &renumber, 1},
         {"verbose", no_argument, &verbose, 1},
         {0, 0, 0, 0}
     };
@@ -253,7 +1023,11 @@ main(int argc, char *argv[])
     {
         cpd_type = warthog::cpd::BEARING;
         reverse = true;
-        // TODO Implement forward azimuth compression
+    }
+    else if (type == "fwd-bearing")
+    {
+        cpd_type = warthog::cpd::FWD_BEARING;
+        reverse = false;
     }
     else if (type == "table")
     {
@@ -265,14 +1039,83 @@ main(int argc, char *argv[])
         cpd_type = warthog::cpd::REV_TABLE;
         reverse = true;
     }
+    else if (type == "hybrid")
+    {
+        cpd_type = warthog::cpd::HYBRID;
+        reverse = false;
+    }
+    else if (type == "rev-hybrid")
+    {
+        cpd_type = warthog::cpd::REV_HYBRID;
+        reverse = true;
+    }
     else
     {
         std::cerr << "Unknown CPD type '" << type << "'\n";
         return EXIT_FAILURE;
     }
 
+    if ((delta || blocks) && (cpd_type == warthog::cpd::TABLE ||
+                              cpd_type == warthog::cpd::REV_TABLE ||
+                              cpd_type == warthog::cpd::HYBRID ||
+                              cpd_type == warthog::cpd::REV_HYBRID))
+    {
+        std::cerr << "err; --delta and --blocks need a run-length encoded "
+                  << "CPD type" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::string order = cfg.get_param_value("order");
+    warthog::cpd::order_strategy strategy;
+
+    if (order == "" || order == "dfs")
+    {
+        order = "dfs";
+        strategy = warthog::cpd::DFS_ORDER;
+    }
+    else if (order == "cut")
+    {
+        strategy = warthog::cpd::CUT_ORDER;
+    }
+    else
+    {
+        std::cerr << "Unknown column order '" << order << "'\n";
+        return EXIT_FAILURE;
+    }
+
     std::string xy_filename = cfg.get_param_value("input");
     std::string cpd_filename = cfg.get_param_value("output");
+    std::string publish_filename = cfg.get_param_value("publish");
+
+    // Serve a binary CPD which was built already in place of --output, for
+    // the processes which reload it (cf. fifo --reload); nothing is built.
+    if (publish_filename != "")
+    {
+        if (cpd_filename == "")
+        {
+            std::cerr << "err; --publish needs the served file as --output"
+                      << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        // the graph of the processes would not match the new build
+        if (std::ifstream(publish_filename + ".perm").good())
+        {
+            std::cerr << "err; renumbered CPDs cannot be published"
+                      << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        warthog::cpd::published_cpd published(cpd_filename);
+        if (!published.publish(publish_filename))
+        {
+            return EXIT_FAILURE;
+        }
+
+        info(verbose, "Published version", published.get_version(), "of",
+             cpd_filename);
+        return EXIT_SUCCESS;
+    }
 
     if (xy_filename == "")
     {
@@ -281,8 +1124,18 @@ main(int argc, char *argv[])
         return EXIT_FAILURE;
     }
 
-    // We save the incoming edges in case we are building a reverse CPD
-    warthog::graph::xy_graph g(0, "", reverse);
+    std::string repair_filename = cfg.get_param_value("repair");
+
+    if (repair_filename != "" && cpd_type == warthog::cpd::BEARING)
+    {
+        std::cerr << "err; reverse bearing CPDs cannot be repaired"
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // We save the incoming edges in case we are building a reverse CPD, or
+    // repairing any CPD
+    warthog::graph::xy_graph g(0, "", reverse || repair_filename != "");
     std::ifstream ifs(xy_filename);
 
     if (!ifs.good())
@@ -306,12 +1159,21 @@ main(int argc, char *argv[])
             case warthog::cpd::BEARING:
                 cpd_filename += "-bearing";
                 break;
+            case warthog::cpd::FWD_BEARING:
+                cpd_filename += "-fwd-bearing";
+                break;
             case warthog::cpd::TABLE:
                 cpd_filename += "-table";
                 break;
             case warthog::cpd::REV_TABLE:
                 cpd_filename += "-rev-table";
                 break;
+            case warthog::cpd::HYBRID:
+                cpd_filename += "-hybrid";
+                break;
+            case warthog::cpd::REV_HYBRID:
+                cpd_filename += "-rev-hybrid";
+                break;
             default: // noop
                 break;
         }
@@ -434,6 +1296,176 @@ main(int argc, char *argv[])
         seed = ((uint32_t)rand() % (uint32_t)g.get_num_nodes());
     }
 
+    // words a hybrid row may take as a table, per word of its runs
+    double table_ratio = 1.0;
+    std::string s_ratio = cfg.get_param_value("table-ratio");
+
+    if (s_ratio != "")
+    {
+        table_ratio = std::stod(s_ratio);
+
+        if (table_ratio < 0)
+        {
+            std::cerr << "The table ratio must be >= 0, got: " << s_ratio
+                      << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    // paths may cost up to (1 + epsilon) times the optimum, for fewer runs
+    double epsilon = 0;
+    std::string s_epsilon = cfg.get_param_value("epsilon");
+
+    if (s_epsilon != "")
+    {
+        epsilon = std::stod(s_epsilon);
+
+        if (!(epsilon >= 0))
+        {
+            std::cerr << "The epsilon must be >= 0, got: " << s_epsilon
+                      << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    // only the rows of reverse CPDs hold whole paths, which are checked as
+    // the rows are built (cf. bounded_rows.h)
+    if (epsilon > 0 && cpd_type != warthog::cpd::REVERSE)
+    {
+        std::cerr << "err; --epsilon needs a reverse CPD (--type rev)"
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (epsilon > 0 && !binary)
+    {
+        std::cerr << "err; --epsilon needs --binary, whose header records "
+                  << "the bound" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // the labels give optimal costs, not those of the paths of the CPD
+    if (epsilon > 0 && distances)
+    {
+        std::cerr << "err; --distances cannot be used with --epsilon"
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (repair_filename != "")
+    {
+        // the column order, and any renumbering, are those of the old CPD
+        if (renumber || distances || epsilon > 0 ||
+            cfg.get_num_values("join") > 0)
+        {
+            std::cerr << "err; --repair cannot be used with --renumber, "
+                      << "--distances, --epsilon or --join" << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        std::string diff_filename = cfg.get_param_value("diff");
+        if (diff_filename == "")
+        {
+            diff_filename = xy_filename + ".diff";
+        }
+
+        switch (cpd_type)
+        {
+            case warthog::cpd::REVERSE:
+            {
+                warthog::cpd::graph_oracle_base<warthog::cpd::REVERSE> cpd(&g);
+                return repair_cpd(g, cpd, repair_filename, diff_filename,
+                                  cpd_filename, reverse, binary, table_ratio,
+                                  order, delta, blocks, verbose);
+            }
+
+            case warthog::cpd::FWD_BEARING:
+            {
+                warthog::cpd::graph_oracle_base<warthog::cpd::FWD_BEARING>
+                    cpd(&g);
+                return repair_cpd(g, cpd, repair_filename, diff_filename,
+                                  cpd_filename, reverse, binary, table_ratio,
+                                  order, delta, blocks, verbose);
+            }
+
+            case warthog::cpd::TABLE:
+            {
+                warthog::cpd::graph_oracle_base<warthog::cpd::TABLE> cpd(&g);
+                return repair_cpd(g, cpd, repair_filename, diff_filename,
+                                  cpd_filename, reverse, binary, table_ratio,
+                                  order, delta, blocks, verbose);
+            }
+
+            case warthog::cpd::REV_TABLE:
+            {
+                warthog::cpd::graph_oracle_base<warthog::cpd::REV_TABLE> cpd(&g);
+                return repair_cpd(g, cpd, repair_filename, diff_filename,
+                                  cpd_filename, reverse, binary, table_ratio,
+                                  order, delta, blocks, verbose);
+            }
+
+            case warthog::cpd::HYBRID:
+            {
+                warthog::cpd::graph_oracle_base<warthog::cpd::HYBRID> cpd(&g);
+                return repair_cpd(g, cpd, repair_filename, diff_filename,
+                                  cpd_filename, reverse, binary, table_ratio,
+                                  order, delta, blocks, verbose);
+            }
+
+            case warthog::cpd::REV_HYBRID:
+            {
+                warthog::cpd::graph_oracle_base<warthog::cpd::REV_HYBRID>
+                    cpd(&g);
+                return repair_cpd(g, cpd, repair_filename, diff_filename,
+                                  cpd_filename, reverse, binary, table_ratio,
+                                  order, delta, blocks, verbose);
+            }
+
+            // case warthog::cpd::FORWARD:
+            default:
+            {
+                warthog::cpd::graph_oracle cpd(&g);
+                return repair_cpd(g, cpd, repair_filename, diff_filename,
+                                  cpd_filename, reverse, binary, table_ratio,
+                                  order, delta, blocks, verbose);
+            }
+        }
+    }
+
+    // Renumber the graph into column order so that the CPD's order is the
+    // identity, and save the permutation for the query side.
+    if (renumber)
+    {
+        std::vector<uint32_t> column_order;
+        std::string perm_filename = cpd_filename + ".perm";
+
+        info(verbose, "Renumbering the graph into column order.");
+        warthog::cpd::compute_column_order(&g, &column_order, strategy);
+        g.permute(column_order);
+
+        std::ofstream pfs(perm_filename);
+        if (!pfs.good())
+        {
+            std::cerr << "Could not open permutation file " << perm_filename
+                      << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        info(verbose, "Writing permutation to", perm_filename);
+        warthog::cpd::write_permutation(pfs, column_order);
+        pfs.close();
+
+        // the graph is now in column order
+        strategy = warthog::cpd::IDENTITY_ORDER;
+    }
+
+    // the distance layer only depends on the (renumbered) graph
+    if (distances &&
+        write_distances(g, cpd_filename + ".hl", verbose) != EXIT_SUCCESS)
+    {
+        return EXIT_FAILURE;
+    }
+
     if (cfg.get_num_values("join") > 0)
     {
         std::vector<std::string> names;
@@ -447,7 +1479,95 @@ main(int argc, char *argv[])
             names.push_back(part);
         }
 
-        return join_cpds(g, cpd_filename, names, seed, verbose, mod);
+        // without --type, join the parts with the symbol they were built
+        // with; stream files of version 1 do not record it
+        for (auto name : names)
+        {
+            uint32_t version;
+            uint32_t symbol;
+            if (!warthog::cpd::get_file_version(name, version, symbol))
+            {
+                std::cerr << "Cannot open file " << name << std::endl;
+                return EXIT_FAILURE;
+            }
+
+            if (symbol == UINT32_MAX && type == "")
+            {
+                std::cerr << "err; " << name << " does not record its "
+                          << "symbol, give it with --type" << std::endl;
+                return EXIT_FAILURE;
+            }
+            else if (symbol == UINT32_MAX)
+            {
+                symbol = cpd_type;
+            }
+            else if (type == "" && name == names.front())
+            {
+                if (symbol > warthog::cpd::REV_HYBRID)
+                {
+                    std::cerr << "err; " << name << " has unknown symbol "
+                              << symbol << std::endl;
+                    return EXIT_FAILURE;
+                }
+                cpd_type = (warthog::cpd::symbol)symbol;
+            }
+
+            if (symbol != (uint32_t)cpd_type)
+            {
+                std::cerr << "err; " << name << " was built with symbol "
+                          << symbol << ", not " << cpd_type << std::endl;
+                return EXIT_FAILURE;
+            }
+
+            if (!warthog::cpd::check_file_version(version, symbol))
+            {
+                return EXIT_FAILURE;
+            }
+        }
+
+        switch (cpd_type)
+        {
+            case warthog::cpd::REVERSE:
+                return join_cpds<warthog::cpd::REVERSE>(
+                    g, cpd_filename, names, seed, order, verbose, mod,
+                    binary, delta, blocks);
+
+            case warthog::cpd::BEARING:
+                return join_cpds<warthog::cpd::BEARING>(
+                    g, cpd_filename, names, seed, order, verbose, mod,
+                    binary, delta, blocks);
+
+            case warthog::cpd::FWD_BEARING:
+                return join_cpds<warthog::cpd::FWD_BEARING>(
+                    g, cpd_filename, names, seed, order, verbose, mod,
+                    binary, delta, blocks);
+
+            case warthog::cpd::TABLE:
+                return join_cpds<warthog::cpd::TABLE>(
+                    g, cpd_filename, names, seed, order, verbose, mod,
+                    binary, delta, blocks);
+
+            case warthog::cpd::REV_TABLE:
+                return join_cpds<warthog::cpd::REV_TABLE>(
+                    g, cpd_filename, names, seed, order, verbose, mod,
+                    binary, delta, blocks);
+
+            case warthog::cpd::HYBRID:
+                return join_cpds<warthog::cpd::HYBRID>(
+                    g, cpd_filename, names, seed, order, verbose, mod,
+                    binary, delta, blocks);
+
+            case warthog::cpd::REV_HYBRID:
+                return join_cpds<warthog::cpd::REV_HYBRID>(
+                    g, cpd_filename, names, seed, order, verbose, mod,
+                    binary, delta, blocks);
+
+            // case warthog::cpd::FORWARD:
+            default:
+                return join_cpds<warthog::cpd::FORWARD>(
+                    g, cpd_filename, names, seed, order, verbose, mod,
+                    binary, delta, blocks);
+        }
     }
     else
     {
@@ -456,7 +1576,53 @@ main(int argc, char *argv[])
         #else
         size_t nthreads = omp_get_max_threads();
         #endif
-        std::vector<warthog::cpd::oracle_listener*> listeners(nthreads);
+        // rows held in memory before they are written, enough for every
+        // thread to be a few chunks ahead of the slowest
+        size_t window = std::max<size_t>(256, 4 * 64 * nthreads);
+        double ckpt_secs = 60;
+        std::string s_window = cfg.get_param_value("window");
+        std::string s_ckpt = cfg.get_param_value("checkpoint");
+
+        if (s_window != "")
+        {
+            int w = std::stoi(s_window);
+
+            if (w < 1)
+            {
+                std::cerr << "The window must be >= 1, got: " << s_window
+                          << std::endl;
+                return EXIT_FAILURE;
+            }
+            window = w;
+        }
+
+        // 0 to disable checkpoints
+        if (s_ckpt != "")
+        {
+            ckpt_secs = std::stod(s_ckpt);
+        }
+
+        // sources searched at once on grid maps, 0 to search one at a time
+        uint32_t lanes = 16;
+        std::string s_lanes = cfg.get_param_value("lanes");
+
+        if (s_lanes != "")
+        {
+            int l = std::stoi(s_lanes);
+
+            if (l < 0 ||
+                l > (int)warthog::cpd::grid_first_move_dijkstra::MAX_LANES)
+            {
+                std::cerr << "The number of lanes must be in [0, "
+                          << warthog::cpd::grid_first_move_dijkstra::MAX_LANES
+                          << "], got: " << s_lanes << std::endl;
+                return EXIT_FAILURE;
+            }
+            lanes = l;
+        }
+
+        // only reverse bearing CPDs are built with listeners
+        std::vector<warthog::cpd::oracle_listener*> listeners;
         std::vector<warthog::sn_id_t> nodes;
 
         if (mod > 1)
@@ -476,21 +1642,17 @@ main(int argc, char *argv[])
             {
                 warthog::cpd::graph_oracle_base<warthog::cpd::REVERSE> cpd(&g);
 
-                for (size_t t = 0; t < nthreads; t++)
-                {
-                    listeners.at(t) = new warthog::cpd::reverse_oracle_listener<
-                            warthog::cpd::REVERSE>(&cpd);
-                }
-
                 return make_cpd<warthog::cpd::REVERSE>(
                     g, cpd, listeners, cpd_filename, nodes, reverse, seed,
-                    verbose);
+                    order, strategy, binary, resume, window, ckpt_secs, lanes,
+                    delta, blocks, epsilon, verbose);
             }
 
             case warthog::cpd::BEARING:
             {
                 warthog::cpd::graph_oracle_base<warthog::cpd::BEARING> cpd(&g);
 
+                listeners.resize(nthreads);
                 for (size_t t = 0; t < nthreads; t++)
                 {
                     listeners.at(t) =
@@ -499,37 +1661,78 @@ main(int argc, char *argv[])
 
                 return make_cpd<warthog::cpd::BEARING>(
                     g, cpd, listeners, cpd_filename, nodes, reverse, seed,
-                    verbose);
+                    order, strategy, binary, resume, window, ckpt_secs, lanes,
+                    delta, blocks, epsilon, verbose);
             }
 
-            case warthog::cpd::TABLE:
+            // the wildcards are added to plain first moves when rows are
+            // compressed, so there is no need for a listener
+            case warthog::cpd::FWD_BEARING:
             {
-                warthog::cpd::graph_oracle_base<warthog::cpd::TABLE> cpd(&g);
+                warthog::cpd::graph_oracle_base<warthog::cpd::FWD_BEARING>
+                    cpd(&g);
 
-                for (size_t t = 0; t < nthreads; t++)
+                // two symbols are taken by the wildcards
+                for (uint32_t i = 0; i < g.get_num_nodes(); i++)
                 {
-                    listeners.at(t) = new warthog::cpd::graph_oracle_listener<
-                        warthog::cpd::TABLE>(&cpd);
+                    if (g.get_node(i)->out_degree() >
+                        warthog::cpd::CPD_FM_MAX - 2)
+                    {
+                        std::cerr << "err; node " << i << " has more than "
+                                  << warthog::cpd::CPD_FM_MAX - 2
+                                  << " out-edges, too many for a bearing CPD"
+                                  << std::endl;
+                        return EXIT_FAILURE;
+                    }
                 }
 
+                return make_cpd<warthog::cpd::FWD_BEARING>(
+                    g, cpd, listeners, cpd_filename, nodes, reverse, seed,
+                    order, strategy, binary, resume, window, ckpt_secs, lanes,
+                    delta, blocks, epsilon, verbose);
+            }
+
+            case warthog::cpd::TABLE:
+            {
+                warthog::cpd::graph_oracle_base<warthog::cpd::TABLE> cpd(&g);
+
                 return make_cpd<warthog::cpd::TABLE>(
                     g, cpd, listeners, cpd_filename, nodes, reverse, seed,
-                    verbose);
+                    order, strategy, binary, resume, window, ckpt_secs, lanes,
+                    delta, blocks, epsilon, verbose);
             }
 
             case warthog::cpd::REV_TABLE:
             {
                 warthog::cpd::graph_oracle_base<warthog::cpd::REV_TABLE> cpd(&g);
 
-                for (size_t t = 0; t < nthreads; t++)
-                {
-                    listeners.at(t) = new warthog::cpd::reverse_oracle_listener<
-                        warthog::cpd::REV_TABLE>(&cpd);
-                }
-
                 return make_cpd<warthog::cpd::REV_TABLE>(
                     g, cpd, listeners, cpd_filename, nodes, reverse, seed,
-                    verbose);
+                    order, strategy, binary, resume, window, ckpt_secs, lanes,
+                    delta, blocks, epsilon, verbose);
+            }
+
+            case warthog::cpd::HYBRID:
+            {
+                warthog::cpd::graph_oracle_base<warthog::cpd::HYBRID> cpd(&g);
+                cpd.set_table_ratio(table_ratio);
+
+                return make_cpd<warthog::cpd::HYBRID>(
+                    g, cpd, listeners, cpd_filename, nodes, reverse, seed,
+                    order, strategy, binary, resume, window, ckpt_secs, lanes,
+                    delta, blocks, epsilon, verbose);
+            }
+
+            case warthog::cpd::REV_HYBRID:
+            {
+                warthog::cpd::graph_oracle_base<warthog::cpd::REV_HYBRID>
+                    cpd(&g);
+                cpd.set_table_ratio(table_ratio);
+
+                return make_cpd<warthog::cpd::REV_HYBRID>(
+                    g, cpd, listeners, cpd_filename, nodes, reverse, seed,
+                    order, strategy, binary, resume, window, ckpt_secs, lanes,
+                    delta, blocks, epsilon, verbose);
             }
 
             // case warthog::cpd::FORWARD:
@@ -537,15 +1740,10 @@ main(int argc, char *argv[])
             {
                 warthog::cpd::graph_oracle cpd(&g);
 
-                for (size_t t = 0; t < nthreads; t++)
-                {
-                    listeners.at(t) = new warthog::cpd::graph_oracle_listener<
-                        warthog::cpd::FORWARD>(&cpd);
-                }
-
                 return make_cpd<warthog::cpd::FORWARD>(
                     g, cpd, listeners, cpd_filename, nodes, reverse, seed,
-                    verbose);
+                    order, strategy, binary, resume, window, ckpt_secs, lanes,
+                    delta, blocks, epsilon, verbose);
             }
         }
     }
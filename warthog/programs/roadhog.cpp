@@ -59,6 +59,9 @@ int suppress_header = 0;
 
 long nruns = 1;
 
+// new id of each node when the graph is renumbered (make_cpd --renumber)
+std::vector<uint32_t> node_ids;
+
 void
 help()
 {
@@ -82,7 +85,9 @@ help()
     << "\nRecognised values for --alg:\n"
     << "\tastar, astar-bb, dijkstra, bi-astar, bi-dijkstra\n"
     << "\tbch, bch-astar, bch-bb, fch, fch-bb\n"
-    << "\tdfs, cpd, cpd-search\n";
+    << "\tdfs, cpd, cpd-search\n"
+    << "\tbearing, bearing-search, fwd-bearing, fwd-bearing-search\n"
+    << "\thybrid, rev-hybrid, hybrid-search\n";
 }
 
 void
@@ -107,6 +112,12 @@ run_experiments( warthog::search* algo, std::string alg_name,
         warthog::solution sol;
         warthog::sn_id_t start_id = exp.source;
         warthog::sn_id_t target_id = exp.p2p ? exp.target : warthog::SN_ID_MAX;
+        // translate ids once per query rather than at each step
+        if(!node_ids.empty())
+        {
+            start_id = node_ids.at(start_id);
+            if(exp.p2p) { target_id = node_ids.at(target_id); }
+        }
         warthog::problem_instance pi(start_id, target_id, verbose);
         uint32_t expanded=0, reopen=0, heap_ops=0, touched=0, surplus=0;
         double nano_time = DBL_MAX;
@@ -755,6 +766,28 @@ load_diff(std::string diff_file, warthog::graph::xy_graph& g)
   return edges;
 }
 
+// renumber the graph like its CPD if it was built with `make_cpd --renumber`,
+// i.e., if its column order is the identity and a permutation file sits next
+// to it.
+template<warthog::cpd::symbol SYM>
+bool
+read_renumbering(std::string cpd_filename, warthog::graph::xy_graph& g,
+                 warthog::cpd::graph_oracle_base<SYM>& oracle)
+{
+    std::ifstream ifs(cpd_filename + ".perm");
+    if(!ifs.good() || !oracle.has_identity_order()) { return true; }
+
+    if(!warthog::cpd::renumber_graph(ifs, &g, node_ids))
+    {
+        std::cerr << "Could not renumber the graph.\n";
+        return false;
+    }
+    oracle.update_bearings();
+
+    std::cerr << "renumbered the graph into column order\n";
+    return true;
+}
+
 template<warthog::cpd::symbol SYM>
 void
 run_cpd_search(warthog::util::cfg& cfg,
@@ -808,18 +841,14 @@ run_cpd_search(warthog::util::cfg& cfg,
         cpd_filename = xy_filename + ".cpd";
     }
 
-    ifs.open(cpd_filename);
-    if(ifs.is_open())
-    {
-        ifs >> oracle;
-        ifs.close();
-    }
-    else
+    if(!oracle.load(cpd_filename))
     {
         std::cerr << "Could not find CPD file '" << cpd_filename << "'\n";
         return;
     }
 
+    if(!read_renumbering(cpd_filename, g, oracle)) { return; }
+
     warthog::simple_graph_expansion_policy expander(&g);
     warthog::cpd_heuristic_base<SYM> h(&oracle, 1.0);
     warthog::pqueue_min open;
@@ -900,18 +929,14 @@ run_cpd(warthog::util::cfg& cfg,
         cpd_filename = xy_filename + ".cpd";
     }
 
-    ifs.open(cpd_filename);
-    if(ifs.is_open())
-    {
-        ifs >> oracle;
-        ifs.close();
-    }
-    else
+    if(!oracle.load(cpd_filename))
     {
         std::cerr << "Could not find CPD file '" << cpd_filename << "'\n";
         return;
     }
 
+    if(!read_renumbering(cpd_filename, g, oracle)) { return; }
+
     warthog::cpd_extractions_base<SYM> cpd_extract(&g, &oracle);
 
     run_experiments(&cpd_extract, alg_name, parser, std::cout);
@@ -971,17 +996,14 @@ run_cpd_dfs(warthog::util::cfg& cfg,
         cpd_filename = xy_filename + ".cpd";
     }
 
-    ifs.open(cpd_filename);
-    if(ifs.is_open())
-    {
-        ifs >> oracle;
-    }
-    else
+    if(!oracle.load(cpd_filename))
     {
         std::cerr << "Could not find CPD file '" << cpd_filename << "'\n";
         return;
     }
 
+    if(!read_renumbering(cpd_filename, g, oracle)) { return; }
+
     warthog::cpd_graph_expansion_policy expander(&oracle);
     warthog::zero_heuristic h;
     warthog::pqueue_min open;
@@ -1084,10 +1106,30 @@ run_dimacs(warthog::util::cfg& cfg)
     {
         run_cpd_search<warthog::cpd::REV_TABLE>(cfg, parser, alg_name);
     }
+    else if(alg_name == "bearing-search")
+    {
+        run_cpd_search<warthog::cpd::BEARING>(cfg, parser, alg_name);
+    }
+    else if(alg_name == "fwd-bearing-search")
+    {
+        run_cpd_search<warthog::cpd::FWD_BEARING>(cfg, parser, alg_name);
+    }
+    else if(alg_name == "hybrid-search")
+    {
+        run_cpd_search<warthog::cpd::HYBRID>(cfg, parser, alg_name);
+    }
     else if(alg_name == "cpd")
     {
         run_cpd<warthog::cpd::FORWARD>(cfg, parser, alg_name);
     }
+    else if(alg_name == "bearing")
+    {
+        run_cpd<warthog::cpd::BEARING>(cfg, parser, alg_name);
+    }
+    else if(alg_name == "fwd-bearing")
+    {
+        run_cpd<warthog::cpd::FWD_BEARING>(cfg, parser, alg_name);
+    }
     else if(alg_name == "rev-cpd")
     {
         run_cpd<warthog::cpd::REVERSE>(cfg, parser, alg_name);
@@ -1100,6 +1142,14 @@ run_dimacs(warthog::util::cfg& cfg)
     {
         run_cpd<warthog::cpd::REV_TABLE>(cfg, parser, alg_name);
     }
+    else if(alg_name == "hybrid")
+    {
+        run_cpd<warthog::cpd::HYBRID>(cfg, parser, alg_name);
+    }
+    else if(alg_name == "rev-hybrid")
+    {
+        run_cpd<warthog::cpd::REV_HYBRID>(cfg, parser, alg_name);
+    }
     else if(alg_name == "dfs")
     {
         run_dfs(cfg, parser, alg_name);
@@ -0,0 +1,50 @@
+#include "bearing_table.h"
+#include "cpd.h"
+
+#include <algorithm>
+#include <cassert>
+
+warthog::cpd::bearing_table::bearing_table(warthog::graph::xy_graph* g)
+    : g_(g)
+{
+    uint32_t num_nodes = g->get_num_nodes();
+    first_.resize(num_nodes + 1);
+    first_.at(0) = 0;
+
+    std::vector<std::pair<uint16_t, uint8_t>> sorted;
+    for(uint32_t i = 0; i < num_nodes; i++)
+    {
+        warthog::graph::node* n = g->get_node(i);
+        assert(n->out_degree() <= warthog::cpd::CPD_FM_MAX);
+        int32_t xs, ys, x, y;
+        g->get_xy(i, xs, ys);
+
+        // an edge to a node at the same place gets bearing 0
+        sorted.clear();
+        for(uint32_t e = 0; e < n->out_degree(); e++)
+        {
+            g->get_xy((n->outgoing_begin() + e)->node_id_, x, y);
+            int64_t dx = (int64_t)x - xs;
+            int64_t dy = (int64_t)y - ys;
+            uint16_t b = (dx == 0 && dy == 0) ? 0 : bearing(dx, dy);
+            sorted.push_back({b, (uint8_t)e});
+        }
+        // equal bearings are sorted by edge index
+        std::sort(sorted.begin(), sorted.end());
+
+        for(auto& p : sorted)
+        {
+            bearings_.push_back(p.first);
+            edges_.push_back(p.second);
+        }
+        first_.at(i + 1) = (uint32_t)bearings_.size();
+    }
+}
+
+size_t
+warthog::cpd::bearing_table::mem() const
+{
+    return sizeof(*this) + first_.capacity() * sizeof(uint32_t) +
+        bearings_.capacity() * sizeof(uint16_t) +
+        edges_.capacity() * sizeof(uint8_t);
+}
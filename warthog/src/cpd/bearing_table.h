@@ -0,0 +1,132 @@
+#ifndef WARTHOG_CPD_BEARING_TABLE_H
+#define WARTHOG_CPD_BEARING_TABLE_H
+
+// cpd/bearing_table.h
+//
+// The out-edges of each node sorted by bearing, to resolve the clockwise and
+// counter-clockwise wildcards of BEARING and FWD_BEARING CPDs.
+//
+// A bearing is a pseudo-angle (the "diamond angle", which grows with the
+// angle but needs a single division) quantised to 16 bits. The wildcards of
+// a target are then found by counting the out-edges whose bearing is at most
+// the target's, in a short branch-free loop over a few contiguous values,
+// rather than by reading the coordinates of every neighbour. CPDs are built
+// and queried with the same table, so their symbols agree.
+//
+// @created: 2026-10-16
+//
+
+#include "xy_graph.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace warthog
+{
+
+namespace cpd
+{
+
+class bearing_table
+{
+    public:
+        bearing_table() : g_(nullptr) { }
+
+        // sort the out-edges of every node of @param g
+        bearing_table(warthog::graph::xy_graph* g);
+
+        // the quantised bearing of direction (@param dx, @param dy), which
+        // must not be (0, 0): a pseudo-angle in [0, 4), counter-clockwise
+        // from the positive x axis, over 16 bits
+        static inline uint16_t
+        bearing(int64_t dx, int64_t dy)
+        {
+            double x = (double)dx;
+            double y = (double)dy;
+            double a;
+            if(y >= 0)
+            {
+                a = x >= 0 ? y / (x + y) : 1 - x / (y - x);
+            }
+            else
+            {
+                a = x < 0 ? 2 - y / (-x - y) : 3 + x / (x - y);
+            }
+
+            // a may round up to 4 just below the positive x axis
+            uint32_t q = (uint32_t)(a * (1 << 14));
+            return (uint16_t)(q < UINT16_MAX ? q : UINT16_MAX);
+        }
+
+        // the bearing of @param target_id from @param node_id, in @param b
+        //
+        // @return false if both nodes are at the same place
+        inline bool
+        target_bearing(uint32_t node_id, uint32_t target_id,
+                       uint16_t& b) const
+        {
+            int32_t xn, yn, xt, yt;
+            g_->get_xy(node_id, xn, yn);
+            g_->get_xy(target_id, xt, yt);
+            int64_t dx = (int64_t)xt - xn;
+            int64_t dy = (int64_t)yt - yn;
+            if(dx == 0 && dy == 0) { return false; }
+            b = bearing(dx, dy);
+            return true;
+        }
+
+        // The out-edges of @param node_id on either side of the bearing
+        // @param b of a target: @param cw is the first edge met when turning
+        // clockwise from the target (an edge with the same bearing included)
+        // and @param ccw the first met when turning counter-clockwise. These
+        // are the moves of the wildcards of a bearing CPD.
+        //
+        // @return false if the node has no out-edge
+        inline bool
+        bearing_sector(uint32_t node_id, uint16_t b,
+                       uint32_t& cw, uint32_t& ccw) const
+        {
+            uint32_t begin = first_[node_id];
+            uint32_t degree = first_[node_id + 1] - begin;
+            if(degree == 0) { return false; }
+
+            const uint16_t* bearings = bearings_.data() + begin;
+            uint32_t at_most = 0;
+            for(uint32_t i = 0; i < degree; i++)
+            {
+                at_most += bearings[i] <= b;
+            }
+
+            ccw = edges_[begin + (at_most < degree ? at_most : 0)];
+            cw = edges_[begin + (at_most > 0 ? at_most : degree) - 1];
+            return true;
+        }
+
+        // the wildcards of @param target_id from @param node_id
+        //
+        // @return false if there are none
+        inline bool
+        sector(uint32_t node_id, uint32_t target_id,
+               uint32_t& cw, uint32_t& ccw) const
+        {
+            uint16_t b;
+            return target_bearing(node_id, target_id, b) &&
+                bearing_sector(node_id, b, cw, ccw);
+        }
+
+        size_t
+        mem() const;
+
+    private:
+        const warthog::graph::xy_graph* g_;
+        // edges of node i: [first_[i], first_[i+1]), sorted by bearing
+        std::vector<uint32_t> first_;
+        std::vector<uint16_t> bearings_;
+        std::vector<uint8_t> edges_;    // index of the edge in the node
+};
+
+}
+
+}
+
+#endif
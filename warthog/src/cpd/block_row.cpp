@@ -0,0 +1,209 @@
+#include "block_row.h"
+
+#include <functional>
+
+namespace
+{
+
+// the number of bits of @param gap >= 1 with the Exp-Golomb code of order
+// @param order
+inline uint32_t
+gap_bits(uint32_t gap, uint32_t order)
+{
+    uint64_t value = (uint64_t)gap - 1 + (UINT64_C(1) << order);
+    uint32_t zeros = 63 - __builtin_clzll(value) - order;
+    return 2 * zeros + order + 1;
+}
+
+// the lengths of the Huffman codes of moves with counts @param freq, of at
+// most CPD_BLOCK_CODE_BITS bits
+void
+code_lengths(const uint64_t* freq, uint32_t* lengths)
+{
+    const uint32_t max_bits = warthog::cpd::CPD_BLOCK_CODE_BITS;
+
+    // a subtree is a weight and the set of moves below it
+    std::vector<std::pair<uint64_t, uint32_t>> trees;
+    for(uint32_t m = 0; m < warthog::cpd::CPD_FM_MAX; m++)
+    {
+        lengths[m] = 0;
+        if(freq[m] > 0) { trees.push_back({freq[m], 1u << m}); }
+    }
+
+    if(trees.size() == 1) { lengths[__builtin_ctz(trees[0].second)] = 1; }
+
+    // few moves, so the two lightest trees are found by sorting
+    while(trees.size() > 1)
+    {
+        std::sort(trees.begin(), trees.end(), std::greater<>());
+        std::pair<uint64_t, uint32_t> a = trees.back();
+        trees.pop_back();
+        std::pair<uint64_t, uint32_t> b = trees.back();
+        trees.pop_back();
+
+        uint32_t below = a.second | b.second;
+        for(uint32_t m = 0; m < warthog::cpd::CPD_FM_MAX; m++)
+        {
+            lengths[m] += (below >> m) & 1;
+        }
+        trees.push_back({a.first + b.first, below});
+    }
+
+    // cut the longest codes, then lengthen the longest codes which are
+    // still short until there is a prefix code (the Kraft sum is at most 1)
+    uint32_t kraft = 0;
+    for(uint32_t m = 0; m < warthog::cpd::CPD_FM_MAX; m++)
+    {
+        if(lengths[m] == 0) { continue; }
+        lengths[m] = std::min(lengths[m], max_bits);
+        kraft += 1u << (max_bits - lengths[m]);
+    }
+    while(kraft > (1u << max_bits))
+    {
+        uint32_t longest = warthog::cpd::CPD_FM_MAX;
+        for(uint32_t m = 0; m < warthog::cpd::CPD_FM_MAX; m++)
+        {
+            if(lengths[m] > 0 && lengths[m] < max_bits &&
+               (longest == warthog::cpd::CPD_FM_MAX ||
+                lengths[m] > lengths[longest]))
+            {
+                longest = m;
+            }
+        }
+        kraft -= 1u << (max_bits - lengths[longest] - 1);
+        lengths[longest]++;
+    }
+}
+
+// writes codes from the least significant bit of each word
+struct block_writer
+{
+    std::vector<uint32_t> words_;
+    uint64_t pos_ = 0;
+
+    void
+    put(uint64_t value, uint32_t bits)
+    {
+        for(uint32_t i = 0; i < bits; i++, pos_++)
+        {
+            if((pos_ >> 5) == words_.size()) { words_.push_back(0); }
+            words_.back() |= (uint32_t)((value >> i) & 1) << (pos_ & 31);
+        }
+    }
+
+    void
+    put_gap(uint32_t gap, uint32_t order)
+    {
+        uint64_t value = (uint64_t)gap - 1 + (UINT64_C(1) << order);
+        uint32_t bits = 63 - __builtin_clzll(value);
+        put(UINT64_C(1) << (bits - order), bits - order + 1);
+        put(value, bits);
+    }
+};
+
+}
+
+bool
+warthog::cpd::encode_block_row(
+    warthog::cpd::rle_row row, std::vector<warthog::cpd::rle_run32>& out)
+{
+    // a row of one block would only grow
+    uint32_t size = row.size();
+    if(size <= CPD_BLOCK_RUNS) { return false; }
+
+    // gaps[i] leads to run i. The runs of the skip index are not coded.
+    std::vector<uint32_t> gaps(size, 0);
+    uint64_t freq[CPD_FM_MAX] = {};
+    for(uint32_t i = 1; i < size; i++)
+    {
+        gaps[i] = row.at(i).get_index() - row.at(i - 1).get_index();
+        if(i % CPD_BLOCK_RUNS != 0) { freq[row.at(i).get_move()]++; }
+    }
+
+    // the order with the fewest bits
+    uint32_t order = 0;
+    uint64_t best = UINT64_MAX;
+    for(uint32_t k = 0; k < 24; k++)
+    {
+        uint64_t bits = 0;
+        for(uint32_t i = 1; i < size; i++)
+        {
+            if(i % CPD_BLOCK_RUNS != 0) { bits += gap_bits(gaps[i], k); }
+        }
+        if(bits < best) { best = bits; order = k; }
+    }
+
+    // canonical codes, by length then move, and the decoding table. A code
+    // is read from its first bit, which is the lowest bit of a table index.
+    uint32_t lengths[CPD_FM_MAX];
+    code_lengths(freq, lengths);
+    std::vector<uint32_t> moves;
+    uint32_t code_bits = 0;
+    for(uint32_t m = 0; m < CPD_FM_MAX; m++)
+    {
+        if(lengths[m] == 0) { continue; }
+        moves.push_back(m);
+        code_bits = std::max(code_bits, lengths[m]);
+    }
+    std::sort(moves.begin(), moves.end(), [&](uint32_t a, uint32_t b)
+        { return lengths[a] != lengths[b] ? lengths[a] < lengths[b] : a < b; });
+
+    uint32_t table_words = ((1u << code_bits) + 3) / 4;
+    std::vector<uint8_t> table(4 * table_words, 0);
+    uint32_t codes[CPD_FM_MAX] = {};
+    uint32_t code = 0;
+    for(uint32_t i = 0; i < moves.size(); i++)
+    {
+        uint32_t m = moves[i];
+        if(i > 0) { code = (code + 1) << (lengths[m] - lengths[moves[i - 1]]); }
+
+        // the bits of the code, in the order they are written
+        uint32_t first = 0;
+        for(uint32_t b = 0; b < lengths[m]; b++)
+        {
+            first |= ((code >> (lengths[m] - 1 - b)) & 1) << b;
+        }
+        codes[m] = first;
+        for(uint32_t rest = 0; rest < (1u << (code_bits - lengths[m])); rest++)
+        {
+            table.at(first | (rest << lengths[m])) =
+                (uint8_t)(m | (lengths[m] << 4));
+        }
+    }
+
+    // the first run of each block goes to the skip index
+    uint32_t num_blocks = (size + CPD_BLOCK_RUNS - 1) / CPD_BLOCK_RUNS;
+    std::vector<warthog::cpd::rle_run32> skip;
+    std::vector<uint32_t> pos;
+    block_writer w;
+    for(uint32_t i = 0; i < size; i++)
+    {
+        if(i % CPD_BLOCK_RUNS == 0)
+        {
+            skip.push_back(row.at(i));
+            pos.push_back((uint32_t)w.pos_);
+            continue;
+        }
+
+        uint32_t move = row.at(i).get_move();
+        w.put_gap(gaps[i], order);
+        w.put(codes[move], lengths[move]);
+    }
+    w.words_.resize(w.words_.size() + 2, 0);
+
+    if(w.pos_ > UINT32_MAX ||
+       3 + table_words + 2 * num_blocks + w.words_.size() >= size)
+    {
+        return false;
+    }
+
+    uint32_t header[3] = {CPD_BLOCK_ROW, size, order | code_bits << 8};
+    size_t begin = out.size();
+    out.resize(begin + 3 + table_words);
+    std::memcpy(out.data() + begin, header, sizeof(header));
+    std::memcpy(out.data() + begin + 3, table.data(), table.size());
+    out.insert(out.end(), skip.begin(), skip.end());
+    for(uint32_t p : pos) { out.push_back({p}); }
+    for(uint32_t word : w.words_) { out.push_back({word}); }
+    return true;
+}
@@ -0,0 +1,155 @@
+#ifndef WARTHOG_CPD_BLOCK_ROW_H
+#define WARTHOG_CPD_BLOCK_ROW_H
+
+// cpd/block_row.h
+//
+// Entropy-coded CPD rows, for CPDs which are shipped to machines with little
+// memory and where lookups may take a little longer.
+//
+// A run of a plain row spends 28 of its 32 bits on an absolute column index,
+// although the runs of a row are sorted and the gaps between them are small.
+// A block row codes each run as the gap from the previous run, with an
+// Exp-Golomb code whose order suits the row, followed by its move, with a
+// Huffman code built from the moves of the row. Codes are at most
+// CPD_BLOCK_CODE_BITS long, so that a move is decoded with a single lookup
+// in a table of the row.
+//
+// Runs are cut into blocks of CPD_BLOCK_RUNS runs. The first run of each
+// block is stored apart, as a plain run: these runs are a skip index which is
+// searched with find_run, and a lookup then decodes the rest of a single
+// block, whose codes start at a bit position kept next to the skip index.
+//
+// A block row is laid out in words as
+//
+//  [CPD_BLOCK_ROW][num runs][order | code bits << 8][table][skip][pos][codes]
+//
+// where the table has a byte for each value of the next (code bits) bits of
+// the codes: the move of the code they start with and, in the high 4 bits,
+// its length. Bits are stored from the least significant bit of each word,
+// little-endian, and the codes end with two words of zeros so that 64-bit
+// reads never go past the row.
+//
+// @created: 2026-10-16
+//
+
+#include "cpd.h"
+#include "run_lookup.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace warthog
+{
+
+namespace cpd
+{
+
+// the first word of a block row (cf. CPD_TABLE_ROW and CPD_DELTA_ROW)
+static const uint32_t CPD_BLOCK_ROW = UINT32_MAX - 2;
+
+// the runs of a block, that of the skip index included. Lookups decode half
+// as many runs on average.
+static const uint32_t CPD_BLOCK_RUNS = 16;
+
+// the longest code of a move, for tables of at most 64 bytes
+static const uint32_t CPD_BLOCK_CODE_BITS = 6;
+
+// Encode the plain row @param row as a block row at the end of @param out,
+// unless that takes as many words.
+//
+// @return false if the row is better left as it is; @param out is then
+// unchanged.
+bool
+encode_block_row(warthog::cpd::rle_row row,
+                 std::vector<warthog::cpd::rle_run32>& out);
+
+// Reads codes from bit @param pos of @param words
+class block_reader
+{
+    public:
+        block_reader(const warthog::cpd::rle_run32* words, uint64_t pos)
+            : bytes_((const uint8_t*)words), pos_(pos) { }
+
+        // a gap of at least 1, coded with Exp-Golomb of order @param order:
+        // as many zeros as there are high bits, a one, then the low bits
+        inline uint32_t
+        read_gap(uint32_t order)
+        {
+            uint64_t bits = peek();
+            uint32_t zeros = __builtin_ctzll(bits);
+            uint32_t low = zeros + order;
+            uint64_t value = (bits >> (zeros + 1)) &
+                ((UINT64_C(1) << low) - 1);
+            used_ = zeros + 1 + low;
+            rest_ = bits >> used_;
+            pos_ += used_;
+            return (uint32_t)(((UINT64_C(1) << low) | value) -
+                              (UINT64_C(1) << order) + 1);
+        }
+
+        // a move coded with the decoding @param table of @param code_bits,
+        // after a gap. Unless the gap is long, its code was read with it.
+        inline uint32_t
+        read_move(const uint8_t* table, uint32_t code_bits)
+        {
+            uint64_t bits = used_ + code_bits <= 57 ? rest_ : peek();
+            uint8_t entry = table[bits & ((1u << code_bits) - 1)];
+            pos_ += entry >> 4;
+            return entry & 0xF;
+        }
+
+    private:
+        const uint8_t* bytes_;
+        uint64_t pos_;
+        uint64_t rest_ = 0;
+        uint32_t used_ = 0;
+
+        // at least the next 57 bits
+        inline uint64_t
+        peek() const
+        {
+            uint64_t bits;
+            std::memcpy(&bits, bytes_ + (pos_ >> 3), sizeof(bits));
+            return bits >> (pos_ & 7);
+        }
+};
+
+// the move of column @param index in the block row @param row
+inline uint32_t
+get_block_move(warthog::cpd::rle_row row, uint32_t index)
+{
+    const warthog::cpd::rle_run32* words = row.begin();
+    uint32_t num_runs = words[1].data_;
+    uint32_t num_blocks = (num_runs + CPD_BLOCK_RUNS - 1) / CPD_BLOCK_RUNS;
+    uint32_t order = words[2].data_ & 0xFF;
+    uint32_t code_bits = words[2].data_ >> 8;
+    const uint8_t* table = (const uint8_t*)(words + 3);
+
+    warthog::cpd::rle_row skip(
+        words + 3 + ((1u << code_bits) + 3) / 4, num_blocks);
+    const warthog::cpd::rle_run32* pos = skip.end();
+    const warthog::cpd::rle_run32* codes = pos + num_blocks;
+
+    uint32_t block = find_run(skip, index);
+    uint32_t col = skip.at(block).get_index();
+    uint32_t move = skip.at(block).get_move();
+    uint32_t count = std::min(CPD_BLOCK_RUNS,
+                              num_runs - block * CPD_BLOCK_RUNS);
+
+    block_reader in(codes, pos[block].data_);
+    for(uint32_t i = 1; i < count; i++)
+    {
+        col += in.read_gap(order);
+        if(col > index) { break; }
+        move = in.read_move(table, code_bits);
+    }
+    return move;
+}
+
+}
+
+}
+
+#endif
@@ -0,0 +1,98 @@
+#include "bounded_rows.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+
+warthog::cpd::bounded_rows::bounded_rows(
+        warthog::graph::xy_graph* g, double epsilon)
+    : g_(g), epsilon_(epsilon)
+{ }
+
+void
+warthog::cpd::bounded_rows::widen(
+        uint32_t target_id, const warthog::cpd::first_move_dijkstra& dijk,
+        std::vector<warthog::cpd::fm_coll>& row) const
+{
+    for(uint32_t id = 0; id < g_->get_num_nodes(); id++)
+    {
+        double d = dijk.get_cost(id);
+        // unreachable nodes have wildcard moves
+        if(id == target_id || d == DBL_MAX) { continue; }
+
+        warthog::graph::node* n = g_->get_node(id);
+        uint32_t move = 0;
+        for(auto e = n->outgoing_begin();
+            e != n->outgoing_end() && move < warthog::cpd::CPD_FM_MAX;
+            e++, move++)
+        {
+            double d_next = dijk.get_cost(e->node_id_);
+            if(d_next < d && e->wt_ <= (1 + epsilon_) * (d - d_next))
+            {
+                row.at(id) |= (warthog::cpd::fm_coll)(1 << move);
+            }
+        }
+    }
+}
+
+double
+warthog::cpd::bounded_rows::get_bound(
+        uint32_t target_id, const warthog::cpd::first_move_dijkstra& dijk,
+        const std::vector<uint32_t>& order,
+        const std::vector<warthog::cpd::rle_run32>& runs)
+{
+    uint32_t num_nodes = g_->get_num_nodes();
+    move_.resize(num_nodes);
+    cost_.assign(num_nodes, -1);
+
+    for(size_t i = 0; i < runs.size(); i++)
+    {
+        uint32_t end = i + 1 < runs.size() ?
+            runs.at(i + 1).get_index() : num_nodes;
+        for(uint32_t index = runs.at(i).get_index(); index < end; index++)
+        {
+            move_.at(order.at(index)) = runs.at(i).get_move();
+        }
+    }
+
+    double bound = 0;
+    cost_.at(target_id) = 0;
+    for(uint32_t id = 0; id < num_nodes; id++)
+    {
+        double d = dijk.get_cost(id);
+        if(d == DBL_MAX) { continue; }
+
+        // follow the moves until a node whose cost is known
+        stack_.clear();
+        uint32_t next_id = id;
+        while(cost_.at(next_id) < 0)
+        {
+            warthog::graph::node* n = g_->get_node(next_id);
+            // the moves of reachable nodes are edges, and only a path of
+            // zero-cost edges can have a cycle
+            assert(move_.at(next_id) < n->out_degree());
+            if(stack_.size() >= num_nodes) { return DBL_MAX; }
+
+            stack_.push_back(next_id);
+            next_id = (n->outgoing_begin() + move_.at(next_id))->node_id_;
+        }
+
+        double cost = cost_.at(next_id);
+        while(!stack_.empty())
+        {
+            uint32_t prev_id = stack_.back();
+            stack_.pop_back();
+            warthog::graph::node* n = g_->get_node(prev_id);
+            cost += (n->outgoing_begin() + move_.at(prev_id))->wt_;
+            cost_.at(prev_id) = cost;
+
+            double optimum = dijk.get_cost(prev_id);
+            if(cost > optimum)
+            {
+                bound = std::max(
+                    bound, optimum > 0 ? cost / optimum - 1 : DBL_MAX);
+            }
+        }
+    }
+    return bound;
+}
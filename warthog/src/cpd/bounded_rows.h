@@ -0,0 +1,80 @@
+#ifndef WARTHOG_CPD_BOUNDED_ROWS_H
+#define WARTHOG_CPD_BOUNDED_ROWS_H
+
+// cpd/bounded_rows.h
+//
+// Lossy rows for reverse CPDs, which trade optimal paths for memory: a row
+// may give a move which is not optimal when this lets two runs merge, as long
+// as every path costs at most (1 + epsilon) times the optimum.
+//
+// A row of a reverse CPD holds the moves of every node towards one target,
+// so the paths to that target only follow moves of that row, and they are
+// checked with the costs d of the search which built it. A move from s to v
+// along an edge of cost w is allowed when v is closer to the target and
+//
+//      w <= (1 + epsilon) * (d(s) - d(v)),
+//
+// which holds for optimal moves. Then, by induction on d, a path which only
+// takes allowed moves costs at most (1 + epsilon) * d(s), and has no cycle.
+// The allowed moves are added to the sets of optimal moves of the row, among
+// which the greedy compression picks (cf. graph_oracle_base::compress_runs).
+//
+// The rest of a path from a row of a forward CPD is in the rows of other
+// nodes, so these rows cannot be checked alone.
+//
+// @created: 2026-10-16
+//
+
+#include "cpd.h"
+#include "first_move_dijkstra.h"
+#include "xy_graph.h"
+
+#include <vector>
+
+namespace warthog
+{
+
+namespace cpd
+{
+
+class bounded_rows
+{
+    public:
+        // paths within (1 + @param epsilon) times the optimum on @param g
+        bounded_rows(warthog::graph::xy_graph* g, double epsilon);
+
+        // add the allowed moves to @param row, the row of @param target_id,
+        // once @param dijk has searched from it
+        void
+        widen(uint32_t target_id,
+              const warthog::cpd::first_move_dijkstra& dijk,
+              std::vector<warthog::cpd::fm_coll>& row) const;
+
+        // the largest ratio, less one, of the cost of a path to the optimum,
+        // over the paths of @param runs, the row of @param target_id
+        // compressed in the column order @param order
+        double
+        get_bound(uint32_t target_id,
+                  const warthog::cpd::first_move_dijkstra& dijk,
+                  const std::vector<uint32_t>& order,
+                  const std::vector<warthog::cpd::rle_run32>& runs);
+
+        inline double
+        get_epsilon() const { return epsilon_; }
+
+    private:
+        warthog::graph::xy_graph* g_;
+        double epsilon_;
+
+        // the move of each node in the row, and the cost of its path, or
+        // -1 until it is known
+        std::vector<uint32_t> move_;
+        std::vector<double> cost_;
+        std::vector<uint32_t> stack_;
+};
+
+}
+
+}
+
+#endif
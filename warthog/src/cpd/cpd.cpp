@@ -1,6 +1,8 @@
 #include "cpd.h"
 #include "xy_graph.h"
 
+#include <numeric>
+
 
 void
 warthog::cpd::compute_dfs_preorder(
@@ -72,6 +74,28 @@ warthog::cpd::compute_dfs_preorder(
     }
 }
 
+void
+warthog::cpd::compute_column_order(
+        warthog::graph::xy_graph* g,
+        std::vector<uint32_t>* column_order,
+        warthog::cpd::order_strategy strategy,
+        uint32_t seed)
+{
+    switch(strategy)
+    {
+        case warthog::cpd::CUT_ORDER:
+            warthog::cpd::compute_cut_order(g, column_order);
+            break;
+        case warthog::cpd::IDENTITY_ORDER:
+            column_order->resize(g->get_num_nodes());
+            std::iota(column_order->begin(), column_order->end(), 0);
+            break;
+        default:
+            warthog::cpd::compute_dfs_preorder(g, column_order, seed);
+            break;
+    }
+}
+
 std::istream&
 warthog::cpd::operator>>(std::istream& in, warthog::cpd::rle_run32& the_run)
 {
@@ -80,10 +104,65 @@ warthog::cpd::operator>>(std::istream& in, warthog::cpd::rle_run32& the_run)
 }
 
 std::ostream&
-warthog::cpd::operator<<(std::ostream& out, warthog::cpd::rle_run32& the_run)
+warthog::cpd::operator<<(std::ostream& out, const warthog::cpd::rle_run32& the_run)
 {
     out.write((char*)(&the_run.data_), sizeof(the_run.data_));
     return out;
 }
 
 
+
+std::ostream&
+warthog::cpd::write_permutation(
+        std::ostream& out, const std::vector<uint32_t>& order)
+{
+    out << order.size() << "\n";
+    for(uint32_t n_id : order)
+    {
+        out << n_id << "\n";
+    }
+    return out;
+}
+
+bool
+warthog::cpd::read_permutation(std::istream& in, std::vector<uint32_t>& order)
+{
+    size_t num_nodes = 0;
+    if(!(in >> num_nodes)) { return false; }
+
+    order.resize(num_nodes);
+    std::vector<bool> seen(num_nodes, false);
+    for(uint32_t i = 0; i < num_nodes; i++)
+    {
+        if(!(in >> order.at(i)) || order.at(i) >= num_nodes ||
+           seen.at(order.at(i)))
+        {
+            return false;
+        }
+        seen.at(order.at(i)) = true;
+    }
+    return true;
+}
+
+bool
+warthog::cpd::renumber_graph(std::istream& in, warthog::graph::xy_graph* g,
+                             std::vector<uint32_t>& ids)
+{
+    if(!warthog::cpd::read_permutation(in, ids))
+    {
+        std::cerr << "err; malformed node permutation\n";
+        return false;
+    }
+
+    if(ids.size() != g->get_num_nodes())
+    {
+        std::cerr
+            << "err; " << "input mismatch. permutation has " << ids.size()
+            << " nodes, but graph contains " << g->get_num_nodes() << "\n";
+        return false;
+    }
+
+    g->permute(ids);
+    warthog::helpers::value_index_swap_array(ids);
+    return true;
+}
@@ -12,6 +12,7 @@
 #include <cassert>
 #include <functional>
 #include <iostream>
+#include <memory>
 #include <vector>
 
 #include "flexible_astar.h"
@@ -33,14 +34,14 @@ enum clock_direction {CW, CCW};
 struct rle_run32
 {
     uint8_t 
-    get_move() { return data_ & 0xF; } 
+    get_move() const { return data_ & 0xF; } 
 
     uint32_t 
-    get_index() { return data_ >> 4; } 
+    get_index() const { return data_ >> 4; } 
 
 
     void
-    print(std::ostream& out)
+    print(std::ostream& out) const
     {
         out << " [" << get_index() << ", " << get_move() << "]";
     }
@@ -48,11 +49,76 @@ struct rle_run32
     uint32_t data_;
 };
 
+// a read-only view of the runs that make up one row of a CPD. the runs
+// are owned elsewhere: by a per-row vector, or by a flat array that may
+// be memory-mapped from disk.
+struct rle_row
+{
+    rle_row() : runs_(nullptr), size_(0) { }
+
+    rle_row(const rle_run32* runs, size_t size)
+        : runs_(runs), size_((uint32_t)size) { }
+
+    rle_row(const std::vector<rle_run32>& row)
+        : runs_(row.data()), size_((uint32_t)row.size()) { }
+
+    inline uint32_t
+    size() const { return size_; }
+
+    inline const rle_run32&
+    at(uint32_t index) const
+    {
+        assert(index < size_);
+        return runs_[index];
+    }
+
+    inline const rle_run32*
+    begin() const { return runs_; }
+
+    inline const rle_run32*
+    end() const { return runs_ + size_; }
+
+    const rle_run32* runs_;
+    uint32_t size_;
+};
+
+// a row of a CPD which stays valid as long as the handle, and its oracle:
+// the runs of a tiered oracle, which its cache may free, are owned by the
+// handle (cf. row_cache)
+class row_handle
+{
+    public:
+        row_handle(rle_row row) : row_(row) { }
+
+        row_handle(std::shared_ptr<const std::vector<rle_run32>> runs)
+            : row_(*runs), owner_(std::move(runs)) { }
+
+        inline uint32_t
+        size() const { return row_.size(); }
+
+        inline const rle_run32&
+        at(uint32_t index) const { return row_.at(index); }
+
+        inline const rle_run32*
+        begin() const { return row_.begin(); }
+
+        inline const rle_run32*
+        end() const { return row_.end(); }
+
+        // the runs, valid as long as this handle
+        inline const rle_row&
+        view() const { return row_; }
+
+    private:
+        rle_row row_;
+        std::shared_ptr<const std::vector<rle_run32>> owner_;
+};
+
 std::istream&
 operator>>(std::istream& in, warthog::cpd::rle_run32& the_run);
 
 std::ostream&
-operator<<(std::ostream& out, warthog::cpd::rle_run32& the_run);
+operator<<(std::ostream& out, const warthog::cpd::rle_run32& the_run);
 
 //  limits on the number of nodes in a graph 
 //  for which we compute a CPD
@@ -71,6 +137,52 @@ static const uint32_t CPD_FM_NONE=0xF;
 // degree of any node is determined by CPD_FM_MAX
 typedef uint16_t fm_coll;
 
+// the binary CPD file format. unlike the stream format, which needs to be
+// parsed run by run, a binary CPD is laid out so that it can be memory-mapped
+// and queried in place:
+//
+//  [header][order array][run array][padding][row offsets]
+//
+// the order array has num_nodes_ uint32_t entries (from vertex id to column
+// index), the run array has num_runs_ rle_run32 entries and the row offsets
+// table has num_rows_ + 1 uint64_t entries; row i spans the runs
+// [offsets[i], offsets[i+1]). the position of each section is given in
+// bytes from the start of the file. all values are little-endian.
+static const uint32_t CPD_FILE_MAGIC = 0x44504357; // "WCPD"
+// version 2 changed the wildcards of BEARING rows to the exact sectors of
+// bearing_table; other rows are the same as in version 1
+static const uint32_t CPD_FILE_VERSION = 2;
+// files of the stream format start with this magic number, the version and
+// the symbol, or with their number of nodes for version 1
+static const uint32_t CPD_STREAM_MAGIC = 0x53504357; // "WCPS"
+
+// cpd_header::flags_
+// the order array is the identity: the graph was renumbered into column order
+static const uint32_t CPD_FLAG_IDENTITY_ORDER = 0x1;
+// some rows are stored as a patch of another row (cf. CPD_DELTA_ROW)
+static const uint32_t CPD_FLAG_DELTA_ROWS = 0x2;
+// some rows are entropy-coded (cf. CPD_BLOCK_ROW)
+static const uint32_t CPD_FLAG_BLOCK_ROWS = 0x4;
+// some moves are not optimal, but the paths cost at most (1 + bound_) times
+// the optimum (cf. bounded_rows.h)
+static const uint32_t CPD_FLAG_BOUNDED = 0x8;
+
+struct cpd_header
+{
+    uint32_t magic_;
+    uint32_t version_;
+    uint32_t symbol_;       // the warthog::cpd::symbol of the oracle
+    uint32_t num_nodes_;
+    uint32_t num_rows_;     // smaller than num_nodes_ for partial CPDs
+    uint32_t flags_;        // CPD_FLAG_* values, unknown bits are ignored
+    uint64_t num_runs_;
+    uint64_t order_pos_;
+    uint64_t runs_pos_;
+    uint64_t rows_pos_;
+    double bound_;          // cf. CPD_FLAG_BOUNDED, 0 for exact CPDs
+};
+static_assert(sizeof(cpd_header) == 64, "CPD header must be 64 bytes");
+
 // a DFS pre-order traversal of the input graph is known to produce an 
 // effective node order for the purposes of compression
 // @param g: the input graph
@@ -82,6 +194,48 @@ compute_dfs_preorder(
         std::vector<uint32_t>* column_order,
         uint32_t seed=0);
 
+// a nested dissection order: the graph is recursively bisected along small
+// cuts and each side is numbered contiguously (cf. cut_order.cpp). it tends
+// to give fewer runs per row than a DFS pre-order.
+// @param g: the input graph
+// @param column_order: a list of node ids in column order
+void
+compute_cut_order(
+        warthog::graph::xy_graph* g,
+        std::vector<uint32_t>* column_order);
+
+// the strategies available to order the columns of a CPD. IDENTITY_ORDER is
+// for graphs which are already numbered in column order.
+enum order_strategy {DFS_ORDER, CUT_ORDER, IDENTITY_ORDER};
+
+void
+compute_column_order(
+        warthog::graph::xy_graph* g,
+        std::vector<uint32_t>* column_order,
+        warthog::cpd::order_strategy strategy,
+        uint32_t seed=0);
+
+// Renumbering a graph into the column order of its CPD (cf. xy_graph::permute)
+// makes the order array the identity, so queries no longer look it up. The
+// permutation is saved next to the CPD, as its number of nodes followed by
+// the original id of each node, so that the same graph can be renumbered
+// at query time.
+std::ostream&
+write_permutation(std::ostream& out, const std::vector<uint32_t>& order);
+
+// @return false if the file is malformed or @param order is not a
+// permutation.
+bool
+read_permutation(std::istream& in, std::vector<uint32_t>& order);
+
+// Renumber @param g with the permutation read from @param in and set
+// @param ids to the new id of each original node, to translate queries.
+//
+// @return false if the permutation cannot be read or does not match @param g.
+bool
+renumber_graph(std::istream& in, warthog::graph::xy_graph* g,
+               std::vector<uint32_t>& ids);
+
 }
 
 }
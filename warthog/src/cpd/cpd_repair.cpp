@@ -0,0 +1,67 @@
+#include "cpd_repair.h"
+
+#include <algorithm>
+#include <cfloat>
+
+void
+warthog::cpd::changed_edges(
+    warthog::graph::xy_graph* g,
+    const std::vector<std::pair<uint32_t, warthog::graph::edge>>& edges,
+    std::vector<warthog::cpd::edge_change>& changes)
+{
+    std::vector<std::pair<uint32_t, warthog::graph::edge>> merged = edges;
+    warthog::graph::merge_parallel_edges(merged);
+
+    for(auto& e : merged)
+    {
+        if(e.first >= g->get_num_nodes()) { continue; }
+
+        warthog::graph::node* from = g->get_node(e.first);
+        warthog::graph::edge_iter eit = from->find_edge(
+            e.second.node_id_, from->outgoing_begin(), from->outgoing_end());
+
+        if(eit != from->outgoing_end() && eit->wt_ != e.second.wt_)
+        {
+            changes.push_back(
+                {e.first, e.second.node_id_, eit->wt_, e.second.wt_});
+        }
+    }
+}
+
+warthog::cpd::row_repair::row_repair(
+        const warthog::cpd::first_move_graph* g)
+    : g_(g), from_a_(g), from_b_(g)
+{ }
+
+void
+warthog::cpd::row_repair::mark_rows(
+        const warthog::cpd::edge_change& change, std::vector<bool>& affected)
+{
+    // the arc (a, b) of the rows' graph
+    bool forward_rows = g_->is_reverse();
+    uint32_t a = forward_rows ? change.tail_ : change.head_;
+    uint32_t b = forward_rows ? change.head_ : change.tail_;
+    double wt = std::min(change.old_wt_, change.new_wt_);
+
+    from_a_.compute_costs(a);
+    from_b_.compute_costs(b);
+
+    // costs are summed in another order than in the rows' searches, so
+    // unless they are exact, ties are found up to rounding
+    double tolerance = g_->is_integral() ? 0 : 1e-9;
+
+    for(uint32_t r = 0; r < g_->get_num_nodes(); r++)
+    {
+        double d_a = from_a_.get_cost(r);
+        if(d_a == DBL_MAX) { continue; }
+
+        double d_b = from_b_.get_cost(r);
+        if(d_a + wt <= d_b + tolerance * d_b) { affected.at(r) = true; }
+    }
+}
+
+size_t
+warthog::cpd::row_repair::mem()
+{
+    return sizeof(*this) + from_a_.mem() + from_b_.mem();
+}
@@ -0,0 +1,83 @@
+#ifndef WARTHOG_CPD_CPD_REPAIR_H
+#define WARTHOG_CPD_CPD_REPAIR_H
+
+// cpd/cpd_repair.h
+//
+// Repair a CPD after the costs of some edges of its graph change for good
+// (e.g., a road closes), by recomputing only the rows which may change
+// rather than building the CPD again.
+//
+// Rows are the one-to-all searches of a graph: the graph itself for forward
+// CPDs, its reverse for reverse CPDs. An arc (a, b) of this graph whose cost
+// goes from w to w' can only change the row of r if
+//
+//      d(r, a) + min(w, w') <= d(r, b)
+//
+// with the old costs: for w' > w, the arc is on a shortest path from r;
+// for w' < w, it gives a path to b at least as short. When no arc passes
+// this test, the shortest paths from r and their costs stay the same (the
+// first changed arc of a path which got shorter would pass it), and so do
+// its first moves. The costs d(., a) and d(., b) of all rows are found with
+// two searches of the other direction, from a and from b.
+//
+// @created: 2026-10-16
+//
+
+#include "first_move_dijkstra.h"
+#include "xy_graph.h"
+
+#include <utility>
+#include <vector>
+
+namespace warthog
+{
+
+namespace cpd
+{
+
+// an edge of a graph and its old and new costs
+struct edge_change
+{
+    uint32_t tail_;
+    uint32_t head_;
+    double old_wt_;
+    double new_wt_;
+};
+
+// The edges of @param g whose costs differ in @param edges (cf.
+// xy_graph::perturb), into @param changes. Edges which are not in @param g
+// are skipped, and those listed more than once are merged as by
+// merge_parallel_edges.
+void
+changed_edges(warthog::graph::xy_graph* g,
+              const std::vector<std::pair<uint32_t, warthog::graph::edge>>&
+                  edges,
+              std::vector<warthog::cpd::edge_change>& changes);
+
+// Finds the rows which an edge change may affect. One per thread.
+class row_repair
+{
+    public:
+        // @param g: the graph with the old costs, against the direction of
+        // the rows (i.e., the reverse graph for a forward CPD)
+        row_repair(const warthog::cpd::first_move_graph* g);
+
+        // mark in @param affected the rows which @param change may affect
+        void
+        mark_rows(const warthog::cpd::edge_change& change,
+                  std::vector<bool>& affected);
+
+        size_t
+        mem();
+
+    private:
+        const warthog::cpd::first_move_graph* g_;
+        warthog::cpd::first_move_dijkstra from_a_;
+        warthog::cpd::first_move_dijkstra from_b_;
+};
+
+}
+
+}
+
+#endif
@@ -0,0 +1,256 @@
+#include "cpd_shards.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool
+warthog::cpd::read_shard_manifest(const std::string& filename,
+                                  std::vector<warthog::cpd::cpd_shard>& shards)
+{
+    std::string manifest = filename;
+    struct stat st;
+    if(stat(filename.c_str(), &st) == 0 && S_ISDIR(st.st_mode))
+    {
+        manifest = filename + "/manifest";
+    }
+
+    std::ifstream ifs(manifest);
+    if(!ifs.good())
+    {
+        std::cerr << "err; cannot open shard manifest " << manifest << "\n";
+        return false;
+    }
+
+    size_t slash = manifest.find_last_of('/');
+    std::string dir = slash == std::string::npos ?
+        "" : manifest.substr(0, slash + 1);
+
+    std::string line;
+    uint32_t line_no = 0;
+    while(std::getline(ifs, line))
+    {
+        line_no++;
+        std::istringstream ls(line);
+        std::string kind;
+        if(!(ls >> kind) || kind.at(0) == '#') { continue; }
+
+        warthog::cpd::cpd_shard shard;
+        bool valid;
+        if(kind == "range")
+        {
+            shard.step_ = 1;
+            valid = (bool)(ls >> shard.first_ >> shard.filename_);
+        }
+        else if(kind == "mod")
+        {
+            valid = (bool)(ls >> shard.step_ >> shard.first_ >>
+                           shard.filename_) &&
+                shard.step_ > 0 && shard.first_ < shard.step_;
+        }
+        else
+        {
+            valid = false;
+        }
+
+        if(!valid)
+        {
+            std::cerr << "err; invalid shard at line " << line_no << " of "
+                      << manifest << "\n";
+            return false;
+        }
+
+        if(shard.filename_.at(0) != '/')
+        {
+            shard.filename_ = dir + shard.filename_;
+        }
+        shards.push_back(shard);
+    }
+
+    if(shards.empty())
+    {
+        std::cerr << "err; no shards in " << manifest << "\n";
+        return false;
+    }
+    return true;
+}
+
+std::ostream&
+warthog::cpd::write_shard_line(std::ostream& out,
+                               const warthog::cpd::cpd_shard& shard)
+{
+    if(shard.step_ > 1)
+    {
+        out << "mod " << shard.step_ << " " << shard.first_;
+    }
+    else
+    {
+        out << "range " << shard.first_;
+    }
+    return out << " " << shard.filename_ << "\n";
+}
+
+warthog::cpd::cpd_shards::cpd_shards()
+    : base_(nullptr), reserved_(0), flags_(0), bound_(0), num_runs_(0)
+{ }
+
+warthog::cpd::cpd_shards::~cpd_shards()
+{
+    close();
+}
+
+void
+warthog::cpd::cpd_shards::close()
+{
+    // the files are unmapped with the range they sit in
+    if(base_ != nullptr) { munmap(base_, reserved_); }
+    base_ = nullptr;
+    reserved_ = 0;
+    pos_.clear();
+    sizes_.clear();
+}
+
+bool
+warthog::cpd::cpd_shards::open(const std::string& manifest)
+{
+    close();
+    shards_.clear();
+    if(!warthog::cpd::read_shard_manifest(manifest, shards_))
+    {
+        return false;
+    }
+
+    // each file starts on a page of its own
+    size_t page = sysconf(_SC_PAGESIZE);
+    std::vector<int> fds;
+    bool failed = false;
+    for(const warthog::cpd::cpd_shard& shard : shards_)
+    {
+        int fd = ::open(shard.filename_.c_str(), O_RDONLY);
+        struct stat st;
+        if(fd < 0 || fstat(fd, &st) != 0 ||
+           (size_t)st.st_size < sizeof(warthog::cpd::cpd_header))
+        {
+            std::cerr << "err; cannot map shard " << shard.filename_ << "\n";
+            if(fd >= 0) { ::close(fd); }
+            failed = true;
+            break;
+        }
+
+        fds.push_back(fd);
+        pos_.push_back(reserved_);
+        sizes_.push_back(st.st_size);
+        reserved_ += (st.st_size + page - 1) / page * page;
+    }
+
+    if(!failed)
+    {
+        void* addr = mmap(nullptr, reserved_, PROT_NONE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        base_ = addr == MAP_FAILED ? nullptr : (char*)addr;
+        failed = base_ == nullptr;
+    }
+
+    for(size_t i = 0; !failed && i < fds.size(); i++)
+    {
+        void* addr = mmap(base_ + pos_.at(i), sizes_.at(i), PROT_READ,
+                          MAP_SHARED | MAP_FIXED, fds.at(i), 0);
+        if(addr == MAP_FAILED)
+        {
+            std::cerr << "err; cannot map shard " << shards_.at(i).filename_
+                      << ": " << strerror(errno) << "\n";
+            failed = true;
+        }
+    }
+
+    // the mappings keep their own references to the files
+    for(int fd : fds) { ::close(fd); }
+
+    if(failed)
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool
+warthog::cpd::cpd_shards::index_rows(uint32_t num_nodes)
+{
+    const warthog::cpd::cpd_header& first = get_header(0);
+    std::vector<bool> covered(num_nodes, false);
+    begins_.assign(num_nodes, 0);
+    ends_.assign(num_nodes, 0);
+    flags_ = 0;
+    bound_ = 0;
+    num_runs_ = 0;
+
+    for(size_t i = 0; i < shards_.size(); i++)
+    {
+        const warthog::cpd::cpd_shard& shard = shards_.at(i);
+        const warthog::cpd::cpd_header& header = get_header(i);
+        const char* data = base_ + pos_.at(i);
+
+        if(header.symbol_ != first.symbol_ ||
+           header.num_nodes_ != num_nodes ||
+           std::memcmp(data + header.order_pos_, get_order(),
+                       sizeof(uint32_t) * (size_t)num_nodes) != 0)
+        {
+            std::cerr << "err; shard " << shard.filename_ << " is not built "
+                      << "with the symbol, graph and column order of "
+                      << shards_.at(0).filename_ << "\n";
+            return false;
+        }
+        if(header.flags_ & warthog::cpd::CPD_FLAG_DELTA_ROWS)
+        {
+            std::cerr << "err; shard " << shard.filename_
+                      << " has delta rows\n";
+            return false;
+        }
+
+        // runs are 4-byte words from the base
+        uint64_t runs = pos_.at(i) + header.runs_pos_;
+        assert(runs % sizeof(warthog::cpd::rle_run32) == 0);
+        runs /= sizeof(warthog::cpd::rle_run32);
+        const uint64_t* offsets = (const uint64_t*)(data + header.rows_pos_);
+
+        for(uint32_t row_id = 0; row_id < header.num_rows_; row_id++)
+        {
+            uint64_t node = shard.first_ + (uint64_t)row_id * shard.step_;
+            if(node >= num_nodes || covered.at(node))
+            {
+                std::cerr << "err; shard " << shard.filename_ << " has "
+                          << (node >= num_nodes ?
+                              "rows past the last node" :
+                              "the row of a node of another shard")
+                          << "\n";
+                return false;
+            }
+            covered.at(node) = true;
+            begins_.at(node) = runs + offsets[row_id];
+            ends_.at(node) = runs + offsets[row_id + 1];
+        }
+
+        flags_ |= header.flags_;
+        if(header.flags_ & warthog::cpd::CPD_FLAG_BOUNDED)
+        {
+            bound_ = std::max(bound_, header.bound_);
+        }
+        num_runs_ += header.num_runs_;
+    }
+
+    size_t missing = std::count(covered.begin(), covered.end(), false);
+    if(missing > 0)
+    {
+        std::cerr << "warn; " << missing << " nodes have no row in any "
+                  << "shard\n";
+    }
+    return true;
+}
@@ -0,0 +1,153 @@
+#ifndef WARTHOG_CPD_CPD_SHARDS_H
+#define WARTHOG_CPD_CPD_SHARDS_H
+
+// cpd/cpd_shards.h
+//
+// Several partial binary CPDs of the same graph, mapped into one process and
+// queried as a single oracle (cf. graph_oracle_base::map_shards). The parts
+// may come from different machines: each is built by make_cpd with --from
+// and --to, --div or --mod, and a manifest lists them, one per line:
+//
+//      range <from> <file>         rows of nodes from, from + 1, ...
+//      mod <mod> <num> <file>      rows of nodes num, num + mod, ...
+//
+// Blank lines and lines starting with '#' are skipped, and relative paths are
+// taken from the directory of the manifest. A binary partial CPD is written
+// with its line in <file>.shard, so a manifest is the concatenation of these.
+//
+// The files are mapped read-only, side by side in one range of addresses, so
+// the runs of every shard are at a known offset from a single base. A row
+// table then gives the runs of each node's row, wherever it is: a lookup
+// costs no more than in a single mapped CPD, and has no branch on the shard.
+// The row table takes 16 bytes per node in RAM; the runs and column order
+// are shared with the page cache.
+//
+// @created: 2026-10-16
+//
+
+#include "cpd.h"
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace warthog
+{
+
+namespace cpd
+{
+
+// a partial CPD whose row r is that of node first_ + r * step_
+struct cpd_shard
+{
+    std::string filename_;
+    uint32_t first_;
+    uint32_t step_;
+};
+
+// read the shards listed in the manifest @param filename, or in the file
+// "manifest" if it is a directory, into @param shards
+// @return false if the manifest cannot be read or has an invalid line
+bool
+read_shard_manifest(const std::string& filename,
+                    std::vector<warthog::cpd::cpd_shard>& shards);
+
+// the manifest line of @param shard
+std::ostream&
+write_shard_line(std::ostream& out, const warthog::cpd::cpd_shard& shard);
+
+class cpd_shards
+{
+    public:
+        cpd_shards();
+
+        ~cpd_shards();
+
+        cpd_shards(const cpd_shards&) = delete;
+        cpd_shards& operator=(const cpd_shards&) = delete;
+
+        // map the files of the shards listed in @param manifest
+        // @return false if a file cannot be mapped or is too small for a CPD
+        bool
+        open(const std::string& manifest);
+
+        // index the rows of the shards by node, for a graph of
+        // @param num_nodes nodes, once their headers are checked. Shards
+        // must have the same symbol and column order, and no delta rows
+        // (they refer to rows of their own shard).
+        // @return false if the shards do not make a CPD of the graph, e.g.
+        // if two of them hold the row of the same node
+        bool
+        index_rows(uint32_t num_nodes);
+
+        inline size_t
+        get_num_shards() const { return shards_.size(); }
+
+        inline const warthog::cpd::cpd_shard&
+        get_shard(size_t i) const { return shards_.at(i); }
+
+        inline const warthog::cpd::cpd_header&
+        get_header(size_t i) const
+        { return *(const warthog::cpd::cpd_header*)(base_ + pos_.at(i)); }
+
+        inline uint64_t
+        get_file_size(size_t i) const { return sizes_.at(i); }
+
+        // the column order, shared by all shards
+        inline const uint32_t*
+        get_order() const
+        { return (const uint32_t*)(base_ + pos_.at(0) +
+                                   get_header(0).order_pos_); }
+
+        // the runs of all shards, from which the row table counts
+        inline const warthog::cpd::rle_run32*
+        get_runs() const { return (const warthog::cpd::rle_run32*)base_; }
+
+        // row n spans [get_begins()[n], get_ends()[n]) of ::get_runs, and is
+        // empty if no shard holds it
+        inline const uint64_t*
+        get_begins() const { return begins_.data(); }
+
+        inline const uint64_t*
+        get_ends() const { return ends_.data(); }
+
+        // the flags of all shards, and the largest bound of lossy ones
+        inline uint32_t
+        get_flags() const { return flags_; }
+
+        inline double
+        get_bound() const { return bound_; }
+
+        // the runs of all shards
+        inline uint64_t
+        get_num_runs() const { return num_runs_; }
+
+        inline size_t
+        mem() const
+        { return sizeof(uint64_t) * (begins_.size() + ends_.size()); }
+
+    private:
+        std::vector<warthog::cpd::cpd_shard> shards_;
+        // the files are mapped at base_ + pos_[i], of sizes_[i] bytes, in a
+        // range of reserved_ bytes
+        char* base_;
+        size_t reserved_;
+        std::vector<uint64_t> pos_;
+        std::vector<uint64_t> sizes_;
+
+        std::vector<uint64_t> begins_;
+        std::vector<uint64_t> ends_;
+        uint32_t flags_;
+        double bound_;
+        uint64_t num_runs_;
+
+        void
+        close();
+};
+
+}
+
+}
+
+#endif
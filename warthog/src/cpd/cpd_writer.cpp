@@ -0,0 +1,262 @@
+#include "cpd_writer.h"
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+
+warthog::cpd::cpd_writer::cpd_writer(
+        const std::string& filename, bool binary, uint32_t symbol,
+        const std::vector<uint32_t>& column_order, uint64_t num_rows,
+        uint64_t build_hash)
+    : filename_(filename), ckpt_filename_(filename + ".ckpt"),
+      binary_(binary), symbol_(symbol), flags_(0), num_rows_(num_rows),
+      build_hash_(build_hash), rows_done_(0), bound_(0)
+{
+    cols_.resize(column_order.size());
+    bool identity = true;
+    for(uint32_t i = 0; i < column_order.size(); i++)
+    {
+        cols_.at(column_order.at(i)) = i;
+        identity = identity && column_order.at(i) == i;
+    }
+    flags_ = identity ? warthog::cpd::CPD_FLAG_IDENTITY_ORDER : 0;
+}
+
+uint64_t
+warthog::cpd::cpd_writer::runs_pos() const
+{
+    uint64_t header = binary_ ?
+        sizeof(warthog::cpd::cpd_header) : 4 * sizeof(uint32_t);
+    return header + sizeof(uint32_t) * cols_.size();
+}
+
+bool
+warthog::cpd::cpd_writer::create()
+{
+    std::remove(ckpt_filename_.c_str());
+
+    out_.open(filename_,
+              std::ios_base::out | std::ios_base::trunc | std::ios_base::binary);
+    if(!out_.good())
+    {
+        std::cerr << "err; cannot open CPD file " << filename_ << "\n";
+        return false;
+    }
+
+    // the binary header is written again by finish()
+    if(binary_)
+    {
+        warthog::cpd::cpd_header header;
+        std::memset(&header, 0, sizeof(header));
+        out_.write((char*)&header, sizeof(header));
+    }
+    else
+    {
+        uint32_t stream[4] = {warthog::cpd::CPD_STREAM_MAGIC,
+                              warthog::cpd::CPD_FILE_VERSION, symbol_,
+                              (uint32_t)cols_.size()};
+        out_.write((char*)stream, sizeof(stream));
+    }
+    out_.write((char*)cols_.data(), sizeof(uint32_t) * cols_.size());
+
+    rows_done_ = 0;
+    offsets_.assign(1, 0);
+    bound_ = 0;
+    return out_.good();
+}
+
+bool
+warthog::cpd::cpd_writer::resume()
+{
+    std::ifstream ckpt(ckpt_filename_, std::ios_base::binary);
+    if(!ckpt.good()) { return false; }
+
+    warthog::cpd::cpd_checkpoint c;
+    ckpt.read((char*)&c, sizeof(c));
+    if(!ckpt.good() || c.magic_ != warthog::cpd::CPD_CHECKPOINT_MAGIC ||
+       c.version_ != warthog::cpd::CPD_CHECKPOINT_VERSION)
+    {
+        std::cerr << "err; corrupt checkpoint " << ckpt_filename_ << "\n";
+        return false;
+    }
+
+    if(c.symbol_ != symbol_ || c.num_nodes_ != cols_.size() ||
+       c.binary_ != (uint32_t)binary_ || c.flags_ != flags_ ||
+       c.num_rows_ != num_rows_ || c.build_hash_ != build_hash_ ||
+       c.rows_done_ > num_rows_ || c.num_offsets_ == 0 ||
+       c.num_offsets_ > c.rows_done_ + 1)
+    {
+        std::cerr << "err; checkpoint " << ckpt_filename_
+                  << " is for a different build\n";
+        return false;
+    }
+
+    offsets_.resize(c.num_offsets_);
+    ckpt.read((char*)offsets_.data(), sizeof(uint64_t) * offsets_.size());
+    if(!ckpt.good())
+    {
+        std::cerr << "err; corrupt checkpoint " << ckpt_filename_ << "\n";
+        return false;
+    }
+    ckpt.close();
+
+    // rows written after the checkpoint are dropped
+    if(::truncate(filename_.c_str(), (off_t)c.file_size_) != 0)
+    {
+        std::cerr << "err; cannot truncate CPD file " << filename_ << "\n";
+        return false;
+    }
+
+    out_.open(filename_,
+              std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+    out_.seekg(0, std::ios_base::end);
+    if(!out_.good() || (uint64_t)out_.tellg() != c.file_size_ ||
+       c.file_size_ < runs_pos())
+    {
+        std::cerr << "err; CPD file " << filename_
+                  << " is shorter than its checkpoint\n";
+        return false;
+    }
+
+    // the file must have been started with the same column order
+    std::vector<uint32_t> cols(cols_.size());
+    out_.seekg(runs_pos() - sizeof(uint32_t) * cols_.size());
+    out_.read((char*)cols.data(), sizeof(uint32_t) * cols.size());
+    if(!out_.good() || cols != cols_)
+    {
+        std::cerr << "err; CPD file " << filename_
+                  << " has a different column order\n";
+        return false;
+    }
+
+    out_.seekp(c.file_size_);
+    rows_done_ = c.rows_done_;
+    bound_ = c.bound_;
+    return out_.good();
+}
+
+bool
+warthog::cpd::cpd_writer::append(
+        const std::vector<warthog::cpd::rle_run32>& row)
+{
+    assert(rows_done_ < num_rows_);
+    rows_done_++;
+    if(row.size() == 0) { return true; }
+
+    if(!binary_)
+    {
+        uint32_t num_runs = (uint32_t)row.size();
+        out_.write((char*)&num_runs, sizeof(num_runs));
+    }
+    out_.write((char*)row.data(),
+               sizeof(warthog::cpd::rle_run32) * row.size());
+    offsets_.push_back(offsets_.back() + row.size());
+
+    if(!out_.good())
+    {
+        std::cerr << "err; while writing CPD file " << filename_ << "\n";
+        return false;
+    }
+    return true;
+}
+
+bool
+warthog::cpd::cpd_writer::checkpoint()
+{
+    out_.flush();
+
+    warthog::cpd::cpd_checkpoint c;
+    std::memset(&c, 0, sizeof(c));
+    c.magic_ = warthog::cpd::CPD_CHECKPOINT_MAGIC;
+    c.version_ = warthog::cpd::CPD_CHECKPOINT_VERSION;
+    c.symbol_ = symbol_;
+    c.num_nodes_ = (uint32_t)cols_.size();
+    c.binary_ = binary_;
+    c.flags_ = flags_;
+    c.num_rows_ = num_rows_;
+    c.rows_done_ = rows_done_;
+    c.file_size_ = (uint64_t)out_.tellp();
+    c.build_hash_ = build_hash_;
+    c.num_offsets_ = offsets_.size();
+    c.bound_ = bound_;
+
+    // replace the previous checkpoint only once the new one is complete
+    std::string tmp_filename = ckpt_filename_ + ".tmp";
+    std::ofstream ckpt(tmp_filename, std::ios_base::binary);
+    ckpt.write((char*)&c, sizeof(c));
+    ckpt.write((char*)offsets_.data(), sizeof(uint64_t) * offsets_.size());
+    ckpt.close();
+
+    if(!out_.good() || !ckpt.good() ||
+       std::rename(tmp_filename.c_str(), ckpt_filename_.c_str()) != 0)
+    {
+        std::cerr << "err; cannot write checkpoint " << ckpt_filename_ << "\n";
+        return false;
+    }
+    return true;
+}
+
+bool
+warthog::cpd::cpd_writer::finish()
+{
+    assert(rows_done_ == num_rows_);
+    uint64_t num_runs = offsets_.back();
+
+    if(binary_)
+    {
+        warthog::cpd::cpd_header header;
+        std::memset(&header, 0, sizeof(header));
+        header.magic_ = warthog::cpd::CPD_FILE_MAGIC;
+        header.version_ = warthog::cpd::CPD_FILE_VERSION;
+        header.symbol_ = symbol_;
+        header.num_nodes_ = (uint32_t)cols_.size();
+        header.num_rows_ = (uint32_t)(offsets_.size() - 1);
+        header.flags_ = flags_;
+        if(bound_ > 0)
+        {
+            header.flags_ |= warthog::cpd::CPD_FLAG_BOUNDED;
+            header.bound_ = bound_;
+        }
+        header.num_runs_ = num_runs;
+        header.order_pos_ = sizeof(warthog::cpd::cpd_header);
+        header.runs_pos_ = runs_pos();
+        // align the offsets table on 8 bytes
+        header.rows_pos_ = header.runs_pos_ +
+            sizeof(warthog::cpd::rle_run32) * header.num_runs_;
+        uint32_t padding = (8 - (header.rows_pos_ % 8)) % 8;
+        header.rows_pos_ += padding;
+
+        uint64_t zero = 0;
+        out_.write((char*)&zero, padding);
+        out_.write((char*)offsets_.data(), sizeof(uint64_t) * offsets_.size());
+        out_.seekp(0);
+        out_.write((char*)&header, sizeof(header));
+    }
+
+    out_.close();
+    if(!out_.good())
+    {
+        std::cerr << "err; while writing CPD file " << filename_ << "\n";
+        return false;
+    }
+    std::remove(ckpt_filename_.c_str());
+
+    std::cerr << "wrote to disk " << offsets_.size() - 1 << " rows and "
+              << num_runs << " runs" << (binary_ ? " (binary)." : ".")
+              << std::endl;
+    return true;
+}
+
+uint64_t
+warthog::cpd::hash_bytes(const void* data, size_t size, uint64_t seed)
+{
+    const unsigned char* bytes = (const unsigned char*)data;
+    uint64_t hash = seed;
+    for(size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
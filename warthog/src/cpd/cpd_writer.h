@@ -0,0 +1,133 @@
+#ifndef WARTHOG_CPD_CPD_WRITER_H
+#define WARTHOG_CPD_CPD_WRITER_H
+
+// cpd/cpd_writer.h
+//
+// Write a CPD file row by row, as rows are built, instead of holding the
+// whole oracle in memory. Both the stream and the binary formats put the
+// column order before the runs, so rows are appended in order; the header
+// and the row offsets of a binary file are completed once all rows are in.
+//
+// The writer can save a checkpoint next to the file (<filename>.ckpt): the
+// number of rows and bytes written so far and the row offsets. A build which
+// stops can then resume from its last checkpoint, after the file is cut back
+// to the checkpointed size.
+//
+// @created: 2026-10-16
+//
+
+#include "cpd.h"
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace warthog
+{
+
+namespace cpd
+{
+
+static const uint32_t CPD_CHECKPOINT_MAGIC = 0x504b4357; // "WCKP"
+static const uint32_t CPD_CHECKPOINT_VERSION = 4;
+
+// followed by num_offsets_ uint64_t row offsets
+struct cpd_checkpoint
+{
+    uint32_t magic_;
+    uint32_t version_;
+    uint32_t symbol_;
+    uint32_t num_nodes_;
+    uint32_t binary_;
+    uint32_t flags_;
+    uint64_t num_rows_;     // rows in the complete file
+    uint64_t rows_done_;
+    uint64_t file_size_;    // bytes of the CPD file which hold these rows
+    uint64_t build_hash_;   // identifies the sources and column order
+    uint64_t num_offsets_;
+    double bound_;          // cf. cpd_writer::add_bound
+};
+
+class cpd_writer
+{
+    public:
+        // @param column_order: the node of each column
+        // @param num_rows: the number of rows the complete file will have
+        // @param build_hash: a hash of anything else which must be the same
+        // for a build to resume (e.g., the source nodes)
+        cpd_writer(const std::string& filename, bool binary, uint32_t symbol,
+                   const std::vector<uint32_t>& column_order,
+                   uint64_t num_rows, uint64_t build_hash);
+
+        // start a new file, removing any previous checkpoint
+        bool
+        create();
+
+        // continue the file of an interrupted build from its checkpoint.
+        //
+        // @return false if there is no checkpoint or if it does not match
+        // this build
+        bool
+        resume();
+
+        // append the next row; empty rows are skipped, as in the stream and
+        // binary writers of graph_oracle
+        bool
+        append(const std::vector<warthog::cpd::rle_run32>& row);
+
+        // the paths of the rows appended, or about to be, cost at most
+        // (1 + @param bound) times the optimum (cf. CPD_FLAG_BOUNDED)
+        inline void
+        add_bound(double bound) { bound_ = std::max(bound_, bound); }
+
+        inline double
+        get_bound() const { return bound_; }
+
+        // flush the file and save a checkpoint of the rows written so far
+        bool
+        checkpoint();
+
+        // complete the file and remove the checkpoint
+        bool
+        finish();
+
+        inline uint64_t
+        get_rows_done() const { return rows_done_; }
+
+        // offsets of the (non-empty) rows written so far
+        inline const std::vector<uint64_t>&
+        get_offsets() const { return offsets_; }
+
+        inline const std::string&
+        get_checkpoint_filename() const { return ckpt_filename_; }
+
+    private:
+        std::string filename_;
+        std::string ckpt_filename_;
+        bool binary_;
+        uint32_t symbol_;
+        uint32_t flags_;
+        std::vector<uint32_t> cols_;    // the column of each node
+        uint64_t num_rows_;
+        uint64_t build_hash_;
+
+        std::fstream out_;
+        uint64_t rows_done_;
+        std::vector<uint64_t> offsets_;
+        double bound_;
+
+        uint64_t
+        runs_pos() const;
+};
+
+// FNV-1a of @param size bytes, to fill cpd_checkpoint::build_hash_
+uint64_t
+hash_bytes(const void* data, size_t size,
+           uint64_t seed=14695981039346656037ull);
+
+}
+
+}
+
+#endif
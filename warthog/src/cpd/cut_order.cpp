@@ -0,0 +1,329 @@
+// cpd/cut_order.cpp
+//
+// A nested dissection column order for CPDs, after `compute_cut_order` from
+// the FirstMoveCompression entry to GPPC 2014 (other/gppc-2014). The graph is
+// recursively bisected and each side is given a contiguous range of column
+// indices, so that the targets reached with the same first move from a
+// source tend to be adjacent columns.
+//
+// The original splits subgraphs with METIS; we instead cut each connected
+// subgraph at the median of its nodes' coordinates, along whichever of four
+// directions (x, y and both diagonals) crosses the fewest edges. Subgraphs
+// which are not connected are instead split between their components (the
+// "prefer zero cut" strategy).
+//
+// @created: 2026-10-15
+//
+
+#include "cpd.h"
+#include "xy_graph.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace
+{
+
+typedef std::pair<uint32_t, uint32_t> cut_arc;
+
+// a node-induced subgraph whose nodes are numbered [0, to_top_.size()) and
+// whose columns start at id_begin_.
+struct cut_subgraph
+{
+    uint32_t id_begin_;
+    std::vector<cut_arc> arcs_;
+    std::vector<uint32_t> to_top_;  // from local to top-level node id
+};
+
+// @return a cut of @param sg which crosses no arcs, if it is not connected:
+// its components, in order of their smallest node, are split into two sides
+// of roughly equal size. otherwise an empty vector.
+std::vector<bool>
+zero_cut(const cut_subgraph& sg)
+{
+    uint32_t num_nodes = (uint32_t)sg.to_top_.size();
+    std::vector<uint32_t> first(num_nodes + 1, 0);
+    std::vector<uint32_t> heads(sg.arcs_.size());
+
+    for(const cut_arc& a : sg.arcs_) { first.at(a.first + 1)++; }
+    std::partial_sum(first.begin(), first.end(), first.begin());
+    std::vector<uint32_t> next(first.begin(), first.end() - 1);
+    for(const cut_arc& a : sg.arcs_)
+    {
+        heads.at(next.at(a.first)++) = a.second;
+    }
+
+    std::vector<uint32_t> component(num_nodes, UINT32_MAX);
+    std::vector<uint32_t> sizes;
+    std::vector<uint32_t> stack;
+    for(uint32_t s = 0; s < num_nodes; s++)
+    {
+        if(component.at(s) != UINT32_MAX) { continue; }
+
+        uint32_t c = (uint32_t)sizes.size();
+        sizes.push_back(1);
+        component.at(s) = c;
+        stack.push_back(s);
+        while(stack.size())
+        {
+            uint32_t u = stack.back();
+            stack.pop_back();
+            for(uint32_t i = first.at(u); i < first.at(u + 1); i++)
+            {
+                if(component.at(heads.at(i)) == UINT32_MAX)
+                {
+                    component.at(heads.at(i)) = c;
+                    stack.push_back(heads.at(i));
+                    sizes.at(c)++;
+                }
+            }
+        }
+    }
+
+    if(sizes.size() == 1) { return std::vector<bool>(); }
+
+    // the first component is always on the lower side and the last one on
+    // the higher side
+    std::vector<bool> lower_component(sizes.size(), false);
+    uint32_t lower_size = 0;
+    for(uint32_t c = 0; c + 1 < sizes.size(); c++)
+    {
+        if(c > 0 && lower_size >= num_nodes / 2) { break; }
+        lower_component.at(c) = true;
+        lower_size += sizes.at(c);
+    }
+
+    std::vector<bool> is_lower(num_nodes);
+    for(uint32_t i = 0; i < num_nodes; i++)
+    {
+        is_lower.at(i) = lower_component.at(component.at(i));
+    }
+    return is_lower;
+}
+
+// @return a balanced bisection of the nodes of @param sg: a median split of
+// their coordinates along the direction which cuts the fewest arcs.
+std::vector<bool>
+coordinate_cut(const cut_subgraph& sg, warthog::graph::xy_graph* g)
+{
+    uint32_t num_nodes = (uint32_t)sg.to_top_.size();
+    std::vector<int64_t> xs(num_nodes), ys(num_nodes);
+    for(uint32_t i = 0; i < num_nodes; i++)
+    {
+        int32_t x, y;
+        g->get_xy(sg.to_top_.at(i), x, y);
+        xs.at(i) = x;
+        ys.at(i) = y;
+    }
+
+    std::vector<bool> best;
+    size_t best_cut = SIZE_MAX;
+    std::vector<uint32_t> ids(num_nodes);
+    std::vector<int64_t> key(num_nodes);
+    const int64_t dirs[4][2] = { {1, 0}, {0, 1}, {1, 1}, {1, -1} };
+
+    for(const int64_t* d : dirs)
+    {
+        for(uint32_t i = 0; i < num_nodes; i++)
+        {
+            key.at(i) = d[0] * xs.at(i) + d[1] * ys.at(i);
+        }
+        std::iota(ids.begin(), ids.end(), 0);
+        std::sort(ids.begin(), ids.end(),
+            [&key](uint32_t a, uint32_t b)
+            {
+                return key.at(a) < key.at(b) ||
+                       (key.at(a) == key.at(b) && a < b);
+            });
+
+        std::vector<bool> is_lower(num_nodes, false);
+        for(uint32_t i = 0; i < num_nodes / 2; i++)
+        {
+            is_lower.at(ids.at(i)) = true;
+        }
+
+        size_t cut = 0;
+        for(const cut_arc& a : sg.arcs_)
+        {
+            cut += is_lower.at(a.first) != is_lower.at(a.second);
+        }
+        if(cut < best_cut)
+        {
+            best_cut = cut;
+            best.swap(is_lower);
+        }
+    }
+    return best;
+}
+
+// move nodes without a neighbour on their own side of the cut to the other
+// side (cf. remove_isolated_nodes_from_cut)
+void
+remove_isolated_nodes(const cut_subgraph& sg, std::vector<bool>& is_lower)
+{
+    std::vector<bool> is_isolated(sg.to_top_.size());
+    auto update_isolated = [&sg, &is_lower, &is_isolated]()
+    {
+        std::fill(is_isolated.begin(), is_isolated.end(), true);
+        for(const cut_arc& a : sg.arcs_)
+        {
+            if(is_lower.at(a.first) == is_lower.at(a.second))
+            {
+                is_isolated.at(a.first) = false;
+                is_isolated.at(a.second) = false;
+            }
+        }
+    };
+
+    update_isolated();
+    for(uint32_t i = 0; i < is_lower.size(); i++)
+    {
+        if(is_isolated.at(i) && is_lower.at(i)) { is_lower.at(i) = false; }
+    }
+
+    update_isolated();
+    for(uint32_t i = 0; i < is_lower.size(); i++)
+    {
+        if(is_isolated.at(i) && !is_lower.at(i)) { is_lower.at(i) = true; }
+    }
+}
+
+cut_subgraph
+extract_subgraph(const cut_subgraph& sg, const std::vector<bool>& is_lower,
+                 bool side, uint32_t id_begin)
+{
+    cut_subgraph sub;
+    std::vector<uint32_t> to_sub(sg.to_top_.size(), UINT32_MAX);
+
+    sub.id_begin_ = id_begin;
+    for(uint32_t i = 0; i < sg.to_top_.size(); i++)
+    {
+        if(is_lower.at(i) == side)
+        {
+            to_sub.at(i) = (uint32_t)sub.to_top_.size();
+            sub.to_top_.push_back(sg.to_top_.at(i));
+        }
+    }
+    for(const cut_arc& a : sg.arcs_)
+    {
+        if(is_lower.at(a.first) == side && is_lower.at(a.second) == side)
+        {
+            sub.arcs_.push_back({to_sub.at(a.first), to_sub.at(a.second)});
+        }
+    }
+    return sub;
+}
+
+}
+
+void
+warthog::cpd::compute_cut_order(
+        warthog::graph::xy_graph* g,
+        std::vector<uint32_t>* column_order)
+{
+    uint32_t num_nodes = g->get_num_nodes();
+    assert(num_nodes < UINT32_MAX);
+    column_order->resize(num_nodes);
+    if(num_nodes == 0) { return; }
+
+    // the cut is computed on the undirected graph
+    cut_subgraph top;
+    top.id_begin_ = 0;
+    top.to_top_.resize(num_nodes);
+    std::iota(top.to_top_.begin(), top.to_top_.end(), 0);
+    for(uint32_t u = 0; u < num_nodes; u++)
+    {
+        warthog::graph::node* n = g->get_node(u);
+        for(warthog::graph::edge_iter it = n->outgoing_begin();
+                it != n->outgoing_end(); it++)
+        {
+            if(it->node_id_ == u) { continue; }
+            top.arcs_.push_back(
+                {std::min(u, it->node_id_), std::max(u, it->node_id_)});
+        }
+    }
+    std::sort(top.arcs_.begin(), top.arcs_.end());
+    top.arcs_.erase(std::unique(top.arcs_.begin(), top.arcs_.end()),
+                    top.arcs_.end());
+    size_t num_edges = top.arcs_.size();
+    for(size_t i = 0; i < num_edges; i++)
+    {
+        top.arcs_.push_back({top.arcs_.at(i).second, top.arcs_.at(i).first});
+    }
+
+    // the number of cut edges to each node from the lower and higher side of
+    // the cuts it was on; they decide which side of a cut goes first.
+    std::vector<int64_t> lower_deg(num_nodes, 0), higher_deg(num_nodes, 0);
+
+    // recurse on the higher side of each cut first. the stack keeps deep
+    // recursions (e.g., one per component) off the call stack.
+    std::vector<cut_subgraph> stack;
+    stack.push_back(std::move(top));
+    while(stack.size())
+    {
+        cut_subgraph sg = std::move(stack.back());
+        stack.pop_back();
+        uint32_t sg_nodes = (uint32_t)sg.to_top_.size();
+
+        std::vector<bool> is_lower = zero_cut(sg);
+        if(is_lower.empty())
+        {
+            is_lower = coordinate_cut(sg, g);
+            remove_isolated_nodes(sg, is_lower);
+        }
+
+        if(std::find(is_lower.begin(), is_lower.end(), !is_lower.at(0)) ==
+                is_lower.end())
+        {
+            // no cut: order the nodes by their connections to the lower side
+            std::vector<uint32_t>& inner = sg.to_top_;
+            std::stable_sort(inner.begin(), inner.end(),
+                [&lower_deg, &higher_deg](uint32_t u, uint32_t v)
+                {
+                    return higher_deg.at(u) - lower_deg.at(u) <
+                           higher_deg.at(v) - lower_deg.at(v);
+                });
+            for(uint32_t i = 0; i < sg_nodes; i++)
+            {
+                column_order->at(sg.id_begin_ + i) = inner.at(i);
+            }
+            continue;
+        }
+
+        // the side with more edges to previously ordered lower columns is
+        // placed first
+        int64_t order_value = 0;
+        for(uint32_t i = 0; i < sg_nodes; i++)
+        {
+            int64_t diff = lower_deg.at(sg.to_top_.at(i)) -
+                           higher_deg.at(sg.to_top_.at(i));
+            order_value += is_lower.at(i) ? diff : -diff;
+        }
+        if(order_value < 0) { is_lower.flip(); }
+
+        for(const cut_arc& a : sg.arcs_)
+        {
+            if(is_lower.at(a.first) && !is_lower.at(a.second))
+            {
+                higher_deg.at(sg.to_top_.at(a.first))++;
+                lower_deg.at(sg.to_top_.at(a.second))++;
+            }
+            else if(!is_lower.at(a.first) && is_lower.at(a.second))
+            {
+                higher_deg.at(sg.to_top_.at(a.second))++;
+                lower_deg.at(sg.to_top_.at(a.first))++;
+            }
+        }
+
+        uint32_t lower_nodes =
+            (uint32_t)std::count(is_lower.begin(), is_lower.end(), true);
+        cut_subgraph lower =
+            extract_subgraph(sg, is_lower, true, sg.id_begin_);
+        cut_subgraph higher =
+            extract_subgraph(sg, is_lower, false, sg.id_begin_ + lower_nodes);
+        sg = cut_subgraph();
+
+        stack.push_back(std::move(lower));
+        stack.push_back(std::move(higher));
+    }
+}
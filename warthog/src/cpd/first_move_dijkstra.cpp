@@ -0,0 +1,172 @@
+#include "first_move_dijkstra.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+
+// non-negative doubles compare in the same order as their bits. integral
+// costs are used as they are, which keeps the keys of a search close
+// together and spares most of the radix heap's redistribution.
+inline uint64_t
+cost_key(double cost, bool integral)
+{
+    if(integral) { return (uint64_t)cost; }
+
+    uint64_t key;
+    std::memcpy(&key, &cost, sizeof(key));
+    return key;
+}
+
+}
+
+warthog::cpd::first_move_graph::first_move_graph(
+        warthog::graph::xy_graph* g, bool reverse) : reverse_(reverse)
+{
+    // path costs are exact integers if the sum of all edge costs is
+    double total = 0;
+    integral_ = true;
+    min_wt_ = DBL_MAX;
+    max_wt_ = 0;
+    // the distinct edge costs, up to three
+    std::vector<double> weights;
+
+    uint32_t num_nodes = g->get_num_nodes();
+    first_.resize(num_nodes + 1);
+    first_.at(0) = 0;
+
+    for(uint32_t i = 0; i < num_nodes; i++)
+    {
+        warthog::graph::node* n = g->get_node(i);
+        warthog::graph::edge_iter begin =
+            reverse ? n->incoming_begin() : n->outgoing_begin();
+        warthog::graph::edge_iter end =
+            reverse ? n->incoming_end() : n->outgoing_end();
+
+        for(warthog::graph::edge_iter it = begin; it != end; it++)
+        {
+            arc a;
+            a.wt_ = it->wt_;
+            a.head_ = it->node_id_;
+            total += a.wt_;
+            integral_ = integral_ && a.wt_ >= 0 && a.wt_ == std::floor(a.wt_);
+            min_wt_ = std::min(min_wt_, a.wt_);
+            max_wt_ = std::max(max_wt_, a.wt_);
+            if(weights.size() < 3 &&
+               std::find(weights.begin(), weights.end(), a.wt_) ==
+               weights.end())
+            {
+                weights.push_back(a.wt_);
+            }
+            if(reverse)
+            {
+                // cf. reverse_oracle_listener
+                warthog::graph::node* pred = g->get_node(it->node_id_);
+                warthog::graph::edge_iter eit = pred->find_edge(
+                    i, pred->outgoing_begin(), pred->outgoing_end());
+                assert(eit != pred->outgoing_end());
+                a.fm_ = (warthog::cpd::fm_coll)
+                    (1 << (eit - pred->outgoing_begin()));
+            }
+            else
+            {
+                a.fm_ = (warthog::cpd::fm_coll)(1 << (it - begin));
+            }
+            arcs_.push_back(a);
+        }
+        first_.at(i + 1) = (uint32_t)arcs_.size();
+    }
+    integral_ = integral_ && total < (double)(1ull << 53);
+    if(arcs_.empty()) { min_wt_ = max_wt_ = 0; }
+    grid_ = integral_ && weights.size() <= 2 && min_wt_ > 0 &&
+        max_wt_ <= 2 * min_wt_;
+}
+
+size_t
+warthog::cpd::first_move_graph::mem()
+{
+    return sizeof(*this) + first_.capacity() * sizeof(uint32_t) +
+        arcs_.capacity() * sizeof(arc);
+}
+
+warthog::cpd::first_move_dijkstra::first_move_dijkstra(
+        const warthog::cpd::first_move_graph* g)
+    : g_(g), dist_(g->get_num_nodes())
+{ }
+
+void
+warthog::cpd::first_move_dijkstra::compute_row(
+        uint32_t source_id, std::vector<warthog::cpd::fm_coll>& s_row)
+{
+    assert(s_row.size() == dist_.size());
+    std::fill(s_row.begin(), s_row.end(), warthog::cpd::CPD_FM_NONE);
+    search<true>(source_id, s_row.data());
+}
+
+void
+warthog::cpd::first_move_dijkstra::compute_costs(uint32_t source_id)
+{
+    search<false>(source_id, nullptr);
+}
+
+template<bool ROW>
+void
+warthog::cpd::first_move_dijkstra::search(
+        uint32_t source_id, warthog::cpd::fm_coll* row)
+{
+    const uint32_t* first = g_->first_.data();
+    const warthog::cpd::first_move_graph::arc* arcs = g_->arcs_.data();
+    double* dist = dist_.data();
+    bool reverse = g_->is_reverse();
+    bool integral = g_->is_integral();
+
+    std::fill(dist_.begin(), dist_.end(), DBL_MAX);
+    queue_.clear();
+
+    dist[source_id] = 0;
+    queue_.push(cost_key(0, integral), source_id);
+
+    while(!queue_.empty())
+    {
+        uint64_t key;
+        uint32_t from;
+        queue_.pop(key, from);
+        if(key != cost_key(dist[from], integral)) { continue; } // stale
+
+        double g_from = dist[from];
+        for(uint32_t i = first[from]; i < first[from + 1]; i++)
+        {
+            const warthog::cpd::first_move_graph::arc& a = arcs[i];
+            double alt_g = g_from + a.wt_;
+            double g_val = dist[a.head_];
+
+            if(ROW && !reverse && from == source_id)
+            {
+                // the successors of the source take the move to them
+                row[a.head_] = a.fm_;
+            }
+            else if(ROW)
+            {
+                warthog::cpd::fm_coll fm = reverse ? a.fm_ : row[from];
+                if(alt_g < g_val) { row[a.head_] = fm; }
+                // add to the set of optimal first moves
+                if(alt_g == g_val) { row[a.head_] |= fm; }
+            }
+
+            if(alt_g < g_val)
+            {
+                dist[a.head_] = alt_g;
+                queue_.push(cost_key(alt_g, integral), a.head_);
+            }
+        }
+    }
+}
+
+size_t
+warthog::cpd::first_move_dijkstra::mem()
+{
+    return sizeof(*this) + dist_.capacity() * sizeof(double) + queue_.mem();
+}
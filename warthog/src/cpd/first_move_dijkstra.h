@@ -0,0 +1,124 @@
+#ifndef WARTHOG_CPD_FIRST_MOVE_DIJKSTRA_H
+#define WARTHOG_CPD_FIRST_MOVE_DIJKSTRA_H
+
+// cpd/first_move_dijkstra.h
+//
+// A one-to-all Dijkstra search specialised to compute the rows of a CPD.
+// It replaces `flexible_astar` and an `oracle_listener` when building
+// FORWARD, REVERSE, TABLE and REV_TABLE CPDs: the graph is flattened into
+// an array of arcs, costs live in a plain array and the queue is a radix
+// heap over the (non-negative) costs: their integer values when all edge
+// costs are integers, else their bits. The sets of optimal first moves are
+// propagated as each arc is relaxed.
+//
+// Costs are summed in the same order as the generic search and first moves
+// follow the same rules as the listeners, so rows are identical to theirs.
+// (With zero-cost edges, ties can be popped in a different order, and rows
+// may then differ where either search depends on that order.)
+//
+// @created: 2026-10-16
+//
+
+#include "cpd.h"
+#include "radix_heap.h"
+#include "xy_graph.h"
+
+#include <vector>
+
+namespace warthog
+{
+
+namespace cpd
+{
+
+// The graph in the direction of the search, shared by all searches.
+class first_move_graph
+{
+    public:
+        // @param reverse: follow incoming edges, for reverse CPDs. The first
+        // move of each arc is then the index of the edge which it reverses
+        // in the outgoing edges of its head.
+        first_move_graph(warthog::graph::xy_graph* g, bool reverse);
+
+        inline uint32_t
+        get_num_nodes() const { return (uint32_t)first_.size() - 1; }
+
+        inline bool
+        is_reverse() const { return reverse_; }
+
+        // true if all path costs are integers which a double holds exactly
+        inline bool
+        is_integral() const { return integral_; }
+
+        // true if the edge costs are those of a grid map: positive integers
+        // which take at most two values, within a factor of two (e.g., the
+        // straight and diagonal moves of gridmap_to_xy_graph)
+        inline bool
+        is_grid() const { return grid_; }
+
+        inline double
+        get_min_weight() const { return min_wt_; }
+
+        inline double
+        get_max_weight() const { return max_wt_; }
+
+        size_t
+        mem();
+
+        struct arc
+        {
+            double wt_;
+            uint32_t head_;
+            warthog::cpd::fm_coll fm_;
+        };
+
+        std::vector<uint32_t> first_;   // arcs of node i: [first_[i], first_[i+1])
+        std::vector<arc> arcs_;
+
+    private:
+        bool reverse_;
+        bool integral_;
+        bool grid_;
+        double min_wt_;
+        double max_wt_;
+};
+
+// One search per thread; each keeps its own costs and queue.
+class first_move_dijkstra
+{
+    public:
+        first_move_dijkstra(const warthog::cpd::first_move_graph* g);
+
+        // fill @param s_row with the optimal first moves from (or, for a
+        // reverse graph, towards) @param source_id to every node.
+        void
+        compute_row(uint32_t source_id,
+                    std::vector<warthog::cpd::fm_coll>& s_row);
+
+        // the costs only, of the paths from (or towards) @param source_id
+        void
+        compute_costs(uint32_t source_id);
+
+        // the cost of the path to @param node_id in the last search, or
+        // DBL_MAX if there is none
+        inline double
+        get_cost(uint32_t node_id) const { return dist_[node_id]; }
+
+        size_t
+        mem();
+
+    private:
+        const warthog::cpd::first_move_graph* g_;
+        std::vector<double> dist_;
+        warthog::radix_heap queue_;
+
+        template<bool ROW>
+        void
+        search(uint32_t source_id, warthog::cpd::fm_coll* row);
+};
+
+}
+
+}
+
+#endif
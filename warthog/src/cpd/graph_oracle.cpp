@@ -1,52 +1,348 @@
 #include "cpd.h"
+#include "cpd_writer.h"
 #include "graph_oracle.h"
 #include "helpers.h"
 
-// When we store a first move table we compress 8 (4 bit) firstmoves into one
-// `rle_run32`.
+#include <unordered_map>
+
+// When we store a first move table we pack 16, 10 or 8 first moves of 2, 3 or
+// 4 bits into one `rle_run32` (cf. warthog::cpd::table_words).
 //
 // TODO Replace with an actual datatype?
 void
 pack_row(std::vector<warthog::cpd::fm_coll>& row,
-         std::vector<uint32_t>& order,
+         const std::vector<uint32_t>& order, uint32_t bits,
          std::vector<warthog::cpd::rle_run32>& fm)
 {
-    // We pack 8 first moves in the 32 bits field.
-    for(uint32_t index = 0; index < row.size(); index += 8)
+    uint32_t per_word = 32 / bits;
+    for(uint32_t index = 0; index < row.size(); index += per_word)
     {
         uint32_t moveset = 0x0;
-        uint32_t entry_size = std::min<uint32_t>(row.size() - index, 8);
+        uint32_t entry_size = std::min<uint32_t>(row.size() - index, per_word);
 
-        for(uint8_t entry = 0; entry < entry_size; entry++)
+        for(uint32_t entry = 0; entry < entry_size; entry++)
         {
-            uint8_t firstmove = __builtin_ffsl(
+            uint32_t firstmove = __builtin_ffsl(
                 row.at(order.at(index + entry))) - 1;
-            assert(firstmove < warthog::cpd::CPD_FM_MAX);
-            moveset |= firstmove << (entry * 4);
+            assert(firstmove < (1u << bits));
+            moveset |= firstmove << (entry * bits);
         }
 
         fm.push_back({ moveset });
     }
 }
 
+// the fewest bits which hold every first move of a table @param row, if the
+// length of the row tells them apart
+uint32_t
+table_row_bits(const std::vector<warthog::cpd::fm_coll>& row)
+{
+    if(!warthog::cpd::table_widths_distinct(row.size())) { return 4; }
+
+    uint32_t max_move = 0;
+    for(warthog::cpd::fm_coll moves : row)
+    {
+        max_move = std::max<uint32_t>(max_move, __builtin_ffsl(moves) - 1);
+    }
+    return max_move < 4 ? 2 : (max_move < 8 ? 3 : 4);
+}
+
 template<>
 void
-warthog::cpd::graph_oracle_base<warthog::cpd::REV_TABLE>::add_row(
-    uint32_t target_id, std::vector<warthog::cpd::fm_coll>& row)
+warthog::cpd::graph_oracle_base<warthog::cpd::REV_TABLE>::compress_row(
+    uint32_t target_id, std::vector<warthog::cpd::fm_coll>& row,
+    std::vector<warthog::cpd::rle_run32>& runs) const
 {
     // target gets a wildcard move
     row.at(target_id) = warthog::cpd::CPD_FM_NONE;
 
-    pack_row(row, order_, fm_.at(target_id));
+    pack_row(row, order_, table_row_bits(row), runs);
+}
+
+template<>
+void
+warthog::cpd::graph_oracle_base<warthog::cpd::TABLE>::compress_row(
+    uint32_t source_id, std::vector<warthog::cpd::fm_coll>& row,
+    std::vector<warthog::cpd::rle_run32>& runs) const
+{
+    // source gets a wildcard move
+    row.at(source_id) = warthog::cpd::CPD_FM_NONE;
+
+    pack_row(row, order_, table_row_bits(row), runs);
+}
+
+// The rows are built as in a forward CPD, then each set of optimal first moves
+// gets the symbols of a bearing CPD: move i becomes symbol i + 2, and the
+// target also gets a clockwise (resp. counter-clockwise) wildcard when the
+// first edge clockwise (resp. counter-clockwise) of its direction is optimal.
+// Many targets share a wildcard, e.g., all those reached by the edge on their
+// right, which lengthens runs.
+template<>
+void
+warthog::cpd::graph_oracle_base<warthog::cpd::FWD_BEARING>::compress_row(
+    uint32_t source_id, std::vector<warthog::cpd::fm_coll>& row,
+    std::vector<warthog::cpd::rle_run32>& runs) const
+{
+    uint32_t degree = g_->get_node(source_id)->out_degree();
+    assert(degree <= warthog::cpd::CPD_FM_MAX - 2);
+    // unreachable targets (CPD_FM_NONE) get the first moves it stands for
+    warthog::cpd::fm_coll edges = (1 << degree) - 1;
+
+    for(uint32_t target_id = 0; target_id < row.size(); target_id++)
+    {
+        warthog::cpd::fm_coll moves = row.at(target_id) & edges;
+        warthog::cpd::fm_coll fm = moves << 2;
+
+        uint32_t cw, ccw;
+        if(moves != 0 && bearings_.sector(source_id, target_id, cw, ccw))
+        {
+            if(moves & (1 << cw)) { fm |= 1 << warthog::cpd::CW; }
+            if(moves & (1 << ccw)) { fm |= 1 << warthog::cpd::CCW; }
+        }
+
+        row.at(target_id) = fm != 0 ? fm : warthog::cpd::CPD_FM_NONE;
+    }
+
+    // source gets a wildcard move
+    row.at(source_id) = warthog::cpd::CPD_FM_NONE;
+    compress_runs(row, runs);
+}
+
+// A row of a hybrid CPD is compressed into runs, which are then replaced by a
+// table (after a CPD_TABLE_ROW tag) if that takes at most `ratio` times as
+// many words. Rows with many runs become tables, which are also queried with
+// a single load instead of a search. Rows are streamed to disk as they are
+// built, so the memory budget is per row.
+void
+hybrid_row(std::vector<warthog::cpd::fm_coll>& row,
+           const std::vector<uint32_t>& order, double ratio, size_t begin,
+           std::vector<warthog::cpd::rle_run32>& runs)
+{
+    size_t num_runs = runs.size() - begin;
+    size_t num_words = 1 + (row.size() + 7) / 8;
+
+    if(num_words <= ratio * num_runs)
+    {
+        runs.resize(begin);
+        runs.push_back({ warthog::cpd::CPD_TABLE_ROW });
+        pack_row(row, order, 4, runs);
+    }
 }
 
 template<>
 void
-warthog::cpd::graph_oracle_base<warthog::cpd::TABLE>::add_row(
-    uint32_t source_id, std::vector<warthog::cpd::fm_coll>& row)
+warthog::cpd::graph_oracle_base<warthog::cpd::HYBRID>::compress_row(
+    uint32_t source_id, std::vector<warthog::cpd::fm_coll>& row,
+    std::vector<warthog::cpd::rle_run32>& runs) const
 {
     // source gets a wildcard move
     row.at(source_id) = warthog::cpd::CPD_FM_NONE;
 
-    pack_row(row, order_, fm_.at(source_id));
+    size_t begin = runs.size();
+    compress_runs(row, runs);
+    hybrid_row(row, order_, table_ratio_, begin, runs);
+}
+
+template<>
+void
+warthog::cpd::graph_oracle_base<warthog::cpd::REV_HYBRID>::compress_row(
+    uint32_t target_id, std::vector<warthog::cpd::fm_coll>& row,
+    std::vector<warthog::cpd::rle_run32>& runs) const
+{
+    // target gets a wildcard move
+    row.at(target_id) = warthog::cpd::CPD_FM_NONE;
+
+    size_t begin = runs.size();
+    compress_runs(row, runs);
+    hybrid_row(row, order_, table_ratio_, begin, runs);
+}
+
+// The runs of row @param own, for the columns where its move differs from
+// that of row @param ref, and holes for the columns where they agree. Runs
+// which follow each other with the same move, or holes, are merged.
+void
+delta_runs(warthog::cpd::rle_row own, warthog::cpd::rle_row ref,
+           std::vector<warthog::cpd::rle_run32>& patch)
+{
+    patch.clear();
+    uint32_t i = 0;
+    uint32_t j = 0;
+    uint32_t col = 0;
+
+    while(true)
+    {
+        uint32_t move = own.at(i).get_move();
+        bool hole = move == ref.at(j).get_move();
+        bool last_hole =
+            !patch.empty() && warthog::cpd::is_delta_hole(patch.back());
+
+        if(patch.empty() || (hole ? !last_hole :
+           last_hole || patch.back().get_move() != move))
+        {
+            patch.push_back(
+                { warthog::cpd::delta_run(col, hole, hole ? 0 : move) });
+        }
+
+        // the next column where either row changes
+        uint32_t next_own = i + 1 < own.size() ?
+            own.at(i + 1).get_index() : UINT32_MAX;
+        uint32_t next_ref = j + 1 < ref.size() ?
+            ref.at(j + 1).get_index() : UINT32_MAX;
+        col = std::min(next_own, next_ref);
+        if(col == UINT32_MAX) { break; }
+
+        if(next_own == col) { i++; }
+        if(next_ref == col) { j++; }
+    }
+}
+
+bool
+warthog::cpd::check_file_version(uint32_t version, uint32_t symbol)
+{
+    if(version < 1 || version > warthog::cpd::CPD_FILE_VERSION)
+    {
+        std::cerr << "err; unsupported CPD file version " << version << "\n";
+        return false;
+    }
+    if(version < 2 && symbol == warthog::cpd::BEARING)
+    {
+        std::cerr << "err; bearing CPDs of version " << version << " have "
+                  << "other wildcards, rebuild the CPD with make_cpd\n";
+        return false;
+    }
+    return true;
+}
+
+bool
+warthog::cpd::get_file_version(const std::string& filename,
+                               uint32_t& version, uint32_t& symbol)
+{
+    std::ifstream ifs(filename, std::ios_base::binary);
+    warthog::cpd::cpd_header header;
+    ifs.read((char*)&header.magic_, sizeof(header.magic_));
+    if(!ifs.good()) { return false; }
+
+    version = 1;
+    symbol = UINT32_MAX;
+    if(header.magic_ == warthog::cpd::CPD_FILE_MAGIC)
+    {
+        ifs.read((char*)&header + sizeof(header.magic_),
+                 sizeof(header) - sizeof(header.magic_));
+        version = header.version_;
+        symbol = header.symbol_;
+    }
+    else if(header.magic_ == warthog::cpd::CPD_STREAM_MAGIC)
+    {
+        ifs.read((char*)&version, sizeof(version));
+        ifs.read((char*)&symbol, sizeof(symbol));
+    }
+    return ifs.good();
+}
+
+bool
+warthog::cpd::encode_delta_rows(
+    warthog::graph::xy_graph* g, const uint64_t* offsets,
+    const warthog::cpd::rle_run32* runs, uint32_t num_rows,
+    std::vector<warthog::cpd::rle_run32>& out_runs,
+    std::vector<uint64_t>& out_offsets)
+{
+    enum { FREE, REFERENCE, DELTA };
+    std::vector<uint8_t> state(num_rows, FREE);
+    // a hash of each row content, to the first plain row with it
+    std::unordered_multimap<uint64_t, uint32_t> plain;
+    std::vector<warthog::cpd::rle_run32> patch;
+    std::vector<warthog::cpd::rle_run32> best;
+    std::vector<uint32_t> candidates;
+    bool by_node = g != nullptr && g->get_num_nodes() == num_rows;
+
+    auto get_row = [offsets, runs](uint32_t row_id)
+    {
+        return warthog::cpd::rle_row(
+            runs + offsets[row_id], offsets[row_id + 1] - offsets[row_id]);
+    };
+    auto same_row = [](warthog::cpd::rle_row a, warthog::cpd::rle_row b)
+    {
+        return a.size() == b.size() && std::equal(
+            a.begin(), a.end(), b.begin(),
+            [](const warthog::cpd::rle_run32& x,
+               const warthog::cpd::rle_run32& y)
+            { return x.data_ == y.data_; });
+    };
+
+    out_runs.clear();
+    out_offsets.assign(1, 0);
+
+    for(uint32_t row_id = 0; row_id < num_rows; row_id++)
+    {
+        warthog::cpd::rle_row own = get_row(row_id);
+        if(own.size() == 0)
+        {
+            std::cerr << "err; cannot delta-encode a CPD with empty rows\n";
+            return false;
+        }
+
+        uint64_t hash = warthog::cpd::hash_bytes(
+            own.begin(), sizeof(warthog::cpd::rle_run32) * own.size());
+        uint32_t best_ref = UINT32_MAX;
+
+        // rows referred to stay plain, so a lookup takes at most one hop
+        if(state.at(row_id) == FREE)
+        {
+            // the same row, anywhere, and the rows of the node's neighbours
+            candidates.clear();
+            auto same = plain.equal_range(hash);
+            for(auto it = same.first; it != same.second; ++it)
+            {
+                if(same_row(own, get_row(it->second)))
+                {
+                    candidates.push_back(it->second);
+                    break;
+                }
+            }
+            if(by_node)
+            {
+                warthog::graph::node* n = g->get_node(row_id);
+                for(uint32_t e = 0; e < n->out_degree(); e++)
+                {
+                    candidates.push_back((n->outgoing_begin() + e)->node_id_);
+                }
+                for(uint32_t e = 0; e < n->in_degree(); e++)
+                {
+                    candidates.push_back((n->incoming_begin() + e)->node_id_);
+                }
+            }
+
+            // a delta row takes a tag and its reference before the patch
+            size_t best_size = own.size();
+            for(uint32_t ref : candidates)
+            {
+                if(ref == row_id || state.at(ref) == DELTA) { continue; }
+
+                delta_runs(own, get_row(ref), patch);
+                if(2 + patch.size() < best_size)
+                {
+                    best_size = 2 + patch.size();
+                    best_ref = ref;
+                    best.swap(patch);
+                }
+            }
+        }
+
+        if(best_ref != UINT32_MAX)
+        {
+            state.at(row_id) = DELTA;
+            state.at(best_ref) = REFERENCE;
+            out_runs.push_back({ warthog::cpd::CPD_DELTA_ROW });
+            out_runs.push_back({ best_ref });
+            out_runs.insert(out_runs.end(), best.begin(), best.end());
+        }
+        else
+        {
+            plain.emplace(hash, row_id);
+            out_runs.insert(out_runs.end(), own.begin(), own.end());
+        }
+        out_offsets.push_back(out_runs.size());
+    }
+
+    return true;
 }
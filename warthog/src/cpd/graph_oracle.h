@@ -18,21 +18,155 @@
 #ifndef WARTHOG_CPD_GRAPH_ORACLE_H
 #define WARTHOG_CPD_GRAPH_ORACLE_H
 
+#include "bearing_table.h"
 #include "binary.h"
+#include "block_row.h"
 #include "constants.h"
 #include "cpd.h"
+#include "cpd_shards.h"
+#include "first_move_dijkstra.h"
 #include "geography.h"
 #include "graph.h"
 #include "graph_expansion_policy.h"
+#include "lazy_rows.h"
+#include "row_cache.h"
+#include "mapped_file.h"
+#include "run_lookup.h"
 #include "xy_graph.h"
 
+#include <fstream>
+#include <memory>
+
+#if defined(__BMI__)
+#include <immintrin.h>
+#endif
+
 namespace warthog
 {
 
 namespace cpd
 {
 
-enum symbol {FORWARD, REVERSE, BEARING, TABLE, REV_TABLE};
+// BEARING is a reverse CPD and FWD_BEARING a forward one; both add clockwise
+// and counter-clockwise wildcards to the moves. Symbols are stored in binary
+// CPD files, so new ones go at the end.
+//
+// HYBRID and REV_HYBRID CPDs store each row either as runs or as a table,
+// whichever suits the row (cf. graph_oracle_base<HYBRID>::compress_row).
+enum symbol {FORWARD, REVERSE, BEARING, TABLE, REV_TABLE, FWD_BEARING,
+             HYBRID, REV_HYBRID};
+
+// @return false if a CPD file of @param version, whose rows are of
+// @param symbol, cannot be read, e.g. a BEARING CPD which must be rebuilt
+// (cf. CPD_FILE_VERSION)
+bool
+check_file_version(uint32_t version, uint32_t symbol);
+
+// read the version and symbol of the CPD file @param filename; @param symbol
+// is UINT32_MAX for stream files of version 1, which do not record it
+// @return false if the file cannot be read
+bool
+get_file_version(const std::string& filename, uint32_t& version,
+                 uint32_t& symbol);
+
+// the first word of a table row in a hybrid CPD. The first run of a row
+// starts at column 0, so the data of a run row's first word is at most 0xF.
+static const uint32_t CPD_TABLE_ROW = UINT32_MAX;
+
+// the first word of a delta row, followed by the id of its reference row and
+// a patch (cf. graph_oracle_base::encode_deltas)
+static const uint32_t CPD_DELTA_ROW = UINT32_MAX - 1;
+
+// A run of a patch starts at column @param index with @param move, or with
+// a hole where the move is that of the reference row. Its index is doubled,
+// plus one for a hole, so patches are still sorted runs which are searched
+// with find_run(patch, 2 * index + 1). Columns must be fewer than 2^27.
+inline uint32_t
+delta_run(uint32_t index, bool hole, uint32_t move)
+{ return ((2 * index + (hole ? 1 : 0)) << 4) | move; }
+
+inline bool
+is_delta_hole(const warthog::cpd::rle_run32& run)
+{ return (run.data_ >> 4) & 1; }
+
+// Replace rows of the CSR storage @param offsets, @param runs with a delta
+// against a similar row when that takes fewer words, into @param out_runs,
+// @param out_offsets. Rows are compared with identical rows and, when there
+// is one row per node of @param g, with the rows of the node's neighbours.
+// A row which is referred to stays plain.
+//
+// @return false if a row is empty.
+bool
+encode_delta_rows(
+    warthog::graph::xy_graph* g, const uint64_t* offsets,
+    const warthog::cpd::rle_run32* runs, uint32_t num_rows,
+    std::vector<warthog::cpd::rle_run32>& out_runs,
+    std::vector<uint64_t>& out_offsets);
+
+// Table rows pack their moves into 32-bit words: 16 moves of 2 bits, 10 of 3
+// bits or 8 of 4 bits per word. Each row takes the smallest width which holds
+// its largest move, which is often 2 or 3 bits on road networks. The width is
+// told by the number of words in the row, so CPD files need no extra field
+// and tables of 4 bits, as written before, still load. When two widths give
+// rows of the same length (on very small graphs), all rows take 4 bits.
+inline uint32_t
+table_words(uint32_t num_cols, uint32_t bits)
+{
+    uint32_t per_word = 32 / bits;
+    return (num_cols + per_word - 1) / per_word;
+}
+
+// @return true if rows of 2, 3 and 4 bits over @param num_cols columns have
+// different lengths
+inline bool
+table_widths_distinct(uint32_t num_cols)
+{
+    return table_words(num_cols, 2) != table_words(num_cols, 3) &&
+        table_words(num_cols, 3) != table_words(num_cols, 4);
+}
+
+// the word @param entry and the bit @param shift of column @param index in
+// a table row of @param bits bits per move. Divisors are constants for each
+// width.
+inline void
+table_position(uint32_t index, uint32_t bits,
+               uint32_t& entry, uint32_t& shift)
+{
+    uint32_t slot;
+    switch(bits)
+    {
+        case 2: entry = index / 16; slot = index % 16; break;
+        case 3: entry = index / 10; slot = index % 10; break;
+        default: entry = index / 8; slot = index % 8; break;
+    }
+    shift = slot * bits;
+}
+
+// the @param bits bits of @param word from bit @param shift
+inline uint32_t
+table_field(uint32_t word, uint32_t shift, uint32_t bits)
+{
+#if defined(__BMI__)
+    return _bextr_u32(word, shift, bits);
+#else
+    return (word >> shift) & ((1u << bits) - 1);
+#endif
+}
+
+// Finding a first move is a lookup, a shift and a mask
+inline uint32_t
+get_table_move(warthog::cpd::rle_row row, uint32_t index, uint32_t bits)
+{
+    if(row.size() == 0) { return warthog::cpd::CPD_FM_NONE; }
+
+    uint32_t entry, shift;
+    table_position(index, bits, entry, shift);
+    assert(entry < row.size());
+    return table_field(row.begin()[entry].data_, shift, bits);
+}
+
+// number of queries whose loads are in flight at once in batched lookups
+static const uint32_t CPD_PREFETCH_GROUP = 16;
 
 template<symbol T>
 class graph_oracle_base
@@ -43,31 +177,75 @@ class graph_oracle_base
         {
             order_.resize(g_->get_num_nodes());
             fm_.resize(g_->get_num_nodes());
+            update_bearings();
+            update_table_words();
         }
 
-        graph_oracle_base() : g_(nullptr) { }
+        graph_oracle_base() : g_(nullptr), div_(1), mod_(0), offset_(0) { }
 
         virtual ~graph_oracle_base() { }
 
-        graph_oracle_base(const graph_oracle_base&) = default;
+        graph_oracle_base(const graph_oracle_base& other)
+        { *this = other; }
+
+        graph_oracle_base&
+        operator=(const graph_oracle_base& other)
+        {
+            fm_ = other.fm_;
+            order_ = other.order_;
+            g_ = other.g_;
+            bearings_ = other.bearings_;
+            div_ = other.div_;
+            mod_ = other.mod_;
+            offset_ = other.offset_;
+            map_ = other.map_;
+            shards_ = other.shards_;
+            runs_ = other.runs_;
+            offsets_ = other.offsets_;
+            flat_order_ = other.flat_order_;
+            flat_offsets_ = other.flat_offsets_;
+            flat_ends_ = other.flat_ends_;
+            flat_runs_ = other.flat_runs_;
+            flat_cols_ = other.flat_cols_;
+            flat_rows_ = other.flat_rows_;
+            flat_runs_count_ = other.flat_runs_count_;
+            identity_order_ = other.identity_order_;
+            table_ratio_ = other.table_ratio_;
+            table_words2_ = other.table_words2_;
+            table_words3_ = other.table_words3_;
+            has_deltas_ = other.has_deltas_;
+            has_blocks_ = other.has_blocks_;
+            bound_ = other.bound_;
+            lazy_ = other.lazy_;
+            tiered_ = other.tiered_;
+
+            // a compacted oracle points into its own arrays
+            if(other.is_flat() && !other.is_mapped()) { set_flat_view(); }
+
+            return *this;
+        }
 
         bool
-        operator==(const graph_oracle_base& other)
+        operator==(const graph_oracle_base& other) const
         {
-            if (order_ != other.order_)
+            if (get_num_rows() != other.get_num_rows())
             {
                 return false;
             }
 
-            if (fm_.size() != other.fm_.size())
+            size_t num_cols = std::max(get_num_cols(), other.get_num_cols());
+            for (size_t i = 0; i < num_cols; i++)
             {
-                return false;
+                if (get_col(i) != other.get_col(i))
+                {
+                    return false;
+                }
             }
 
-            for (size_t i = 0; i < fm_.size(); i++)
+            for (size_t i = 0; i < get_num_rows(); i++)
             {
-                std::vector<warthog::cpd::rle_run32> row1 = fm_.at(i);
-                std::vector<warthog::cpd::rle_run32> row2 = other.fm_.at(i);
+                warthog::cpd::rle_row row1 = row_at(i);
+                warthog::cpd::rle_row row2 = other.row_at(i);
 
                 if (row1.size() != row2.size())
                 {
@@ -97,31 +275,199 @@ class graph_oracle_base
         {
             order_.clear();
             fm_.clear();
+            lazy_.reset();
+            tiered_.reset();
+            clear_flat();
+            bound_ = 0;
         }
 
         inline void
         compute_dfs_preorder(uint32_t seed=0)
         {
+            assert(!is_flat());
             warthog::cpd::compute_dfs_preorder(g_, &order_);
         }
 
+        inline void
+        compute_column_order(warthog::cpd::order_strategy strategy)
+        {
+            assert(!is_flat());
+            warthog::cpd::compute_column_order(g_, &order_, strategy);
+        }
+
         // convert the column order into a map: from vertex id to its ordered
         // index
         inline void
         value_index_swap_array()
         {
+            assert(!is_flat());
             warthog::helpers::value_index_swap_array(order_);
+            update_identity_order();
+        }
+
+        // Compute rows on demand instead of building them all first (cf.
+        // lazy_rows): a row is computed the first time it is looked up, with
+        // the current edge costs, and kept. @param num_threads threads
+        // compute the other rows in the background. The oracle can be
+        // queried at once, by any number of threads, and becomes a complete
+        // one when compacted. Not for BEARING CPDs, whose rows are built with
+        // listeners.
+        //
+        // @return false if the oracle cannot be lazy
+        bool
+        make_lazy(warthog::cpd::order_strategy strategy, uint32_t num_threads)
+        {
+            assert(!is_flat());
+            if(T == BEARING)
+            {
+                std::cerr << "err; reverse bearing CPDs cannot be lazy\n";
+                return false;
+            }
+
+            // rows are compressed in the column order of a copy, as they are
+            // by make_cpd
+            compute_column_order(strategy);
+            std::shared_ptr<graph_oracle_base> builder =
+                std::make_shared<graph_oracle_base>(g_);
+            builder->order_ = order_;
+            builder->table_ratio_ = table_ratio_;
+            builder->fm_.clear();
+            value_index_swap_array();
+
+            bool reverse = T == REVERSE || T == REV_TABLE || T == REV_HYBRID;
+            lazy_ = std::make_shared<warthog::cpd::lazy_rows>(
+                g_, reverse,
+                [builder](uint32_t source_id,
+                          std::vector<warthog::cpd::fm_coll>& row,
+                          std::vector<warthog::cpd::rle_run32>& runs)
+                { builder->compress_row(source_id, row, runs); });
+            lazy_->fill(num_threads);
+            return true;
+        }
+
+        // @return true if rows are computed on demand (cf. ::make_lazy)
+        inline bool
+        is_lazy() const
+        { return lazy_ != nullptr; }
+
+        // the rows which are computed, of a lazy oracle
+        inline uint32_t
+        get_num_lazy_rows_done() const
+        { return lazy_ ? lazy_->get_num_done() : 0; }
+
+        // move all rows into a single run array indexed by a table of row
+        // offsets (i.e., CSR storage). This removes the vector header and
+        // heap allocation of each row and keeps consecutive rows adjacent in
+        // memory. Call once all rows are built; a compacted oracle cannot
+        // be modified.
+        void
+        compact()
+        {
+            if(is_flat()) { return; }
+
+            // a lazy oracle is completed first
+            if(lazy_)
+            {
+                lazy_->wait();
+                for(uint32_t row_id = 0; row_id < fm_.size(); row_id++)
+                {
+                    warthog::cpd::rle_row row = lazy_->get(row_id);
+                    fm_.at(row_id).assign(row.begin(), row.end());
+                }
+                lazy_.reset();
+            }
+
+            // and a tiered one is read in memory
+            if(tiered_)
+            {
+                fm_.resize(tiered_->get_num_rows());
+                for(uint32_t row_id = 0; row_id < fm_.size(); row_id++)
+                {
+                    warthog::cpd::rle_row row = tiered_->get(row_id);
+                    fm_.at(row_id).assign(row.begin(), row.end());
+                }
+                tiered_.reset();
+            }
+
+            uint64_t num_runs = 0;
+            for(auto& row : fm_) { num_runs += row.size(); }
+
+            offsets_.clear();
+            offsets_.reserve(fm_.size() + 1);
+            offsets_.push_back(0);
+            runs_.clear();
+            runs_.reserve(num_runs);
+
+            for(auto& row : fm_)
+            {
+                runs_.insert(runs_.end(), row.begin(), row.end());
+                offsets_.push_back(runs_.size());
+                // release rows as we go to keep the peak memory down
+                std::vector<warthog::cpd::rle_run32>().swap(row);
+            }
+            std::vector<std::vector<warthog::cpd::rle_run32>>().swap(fm_);
+
+            set_flat_view();
+        }
+
+        // copy the column order and rows of a flat oracle, mapped or not,
+        // into arrays of its own, in CSR form. Pages are placed on the NUMA
+        // node of the thread which first writes them, so a copy made by a
+        // thread pinned on a node is a replica in its local memory (cf.
+        // numa_topology.h); it is no longer shared with other processes.
+        void
+        localise()
+        {
+            assert(is_flat());
+            std::vector<uint32_t> order(flat_order_, flat_order_ + flat_cols_);
+            std::vector<warthog::cpd::rle_run32> runs;
+            std::vector<uint64_t> offsets(1, 0);
+            runs.reserve(flat_runs_count_);
+            offsets.reserve(flat_rows_ + 1);
+
+            for(uint32_t row_id = 0; row_id < flat_rows_; row_id++)
+            {
+                warthog::cpd::rle_row row = row_at(row_id);
+                runs.insert(runs.end(), row.begin(), row.end());
+                offsets.push_back(runs.size());
+            }
+
+            clear_flat();
+            order_.swap(order);
+            runs_.swap(runs);
+            offsets_.swap(offsets);
+            set_flat_view();
         }
 
         // compress a given first-move table @param row and associate
         // the compressed result with source node @param source_id
         void
         add_row(uint32_t source_id, std::vector<warthog::cpd::fm_coll>& row)
+        {
+            assert(!is_flat() && !is_lazy() && !is_tiered());
+            compress_row(source_id, row, fm_.at(source_id));
+        }
+
+        // compress a given first-move table @param row of source node
+        // @param source_id and append the runs to @param runs, without
+        // storing them (e.g., to stream them to disk). Must be called before
+        // value_index_swap_array.
+        void
+        compress_row(uint32_t source_id,
+                     std::vector<warthog::cpd::fm_coll>& row,
+                     std::vector<warthog::cpd::rle_run32>& runs) const
         {
             // source gets a wildcard move
             row.at(source_id) = warthog::cpd::CPD_FM_NONE;
+            compress_runs(row, runs);
+        }
 
-            // greedily compress the row w.r.t. the current column order
+        // greedily compress @param row w.r.t. the current column order and
+        // append the runs to @param runs
+        void
+        compress_runs(const std::vector<warthog::cpd::fm_coll>& row,
+                      std::vector<warthog::cpd::rle_run32>& runs) const
+        {
             warthog::cpd::fm_coll moveset = row.at(order_.at(0));
             uint32_t head = 0;
             for(uint32_t index = 0; index < row.size(); index++)
@@ -131,7 +477,7 @@ class graph_oracle_base
                 {
                     uint32_t firstmove = __builtin_ffsl(moveset) - 1;
                     assert(firstmove < warthog::cpd::CPD_FM_MAX);
-                    fm_.at(source_id).push_back(
+                    runs.push_back(
                             warthog::cpd::rle_run32{ (head << 4) | firstmove} );
                     moveset = row.at(order_.at(index));
                     head = index;
@@ -142,11 +488,297 @@ class graph_oracle_base
             // add the last run
             uint32_t firstmove = __builtin_ffsl(moveset) - 1;
             assert(firstmove < warthog::cpd::CPD_FM_MAX);
-            fm_.at(source_id).push_back(
+            runs.push_back(
                     warthog::cpd::rle_run32{ (head << 4) | firstmove} );
+        }
+
+        // A row of a hybrid CPD is stored as a table when that takes at most
+        // @param ratio times as many words as its runs. 1 keeps the smaller
+        // encoding, a larger ratio spends memory on faster lookups and 0
+        // keeps runs only.
+        inline void
+        set_table_ratio(double ratio)
+        { table_ratio_ = ratio; }
+
+        inline double
+        get_table_ratio() const
+        { return table_ratio_; }
+
+        // the bits per move of a table row of @param size words
+        inline uint32_t
+        table_bits(uint32_t size) const
+        {
+            return size == table_words2_ ? 2 :
+                (size == table_words3_ ? 3 : 4);
+        }
+
+        // Store rows which are close to another row (the same row, or that of
+        // a neighbouring node) as a patch of that row, when this takes fewer
+        // words (cf. encode_delta_rows). A lookup in a delta row then takes
+        // at most one more row lookup. Only for run-length encoded CPDs, once
+        // all rows are built; the oracle is compacted first.
+        //
+        // @return false if the CPD cannot be delta-encoded
+        bool
+        encode_deltas()
+        {
+            if(T == TABLE || T == REV_TABLE || T == HYBRID ||
+               T == REV_HYBRID)
+            {
+                std::cerr << "err; only run-length encoded CPDs have delta "
+                          << "rows\n";
+                return false;
+            }
+            if(has_deltas_) { return true; }
+            if(is_sharded())
+            {
+                std::cerr << "err; sharded CPDs have no delta rows\n";
+                return false;
+            }
+            if(has_blocks_)
+            {
+                std::cerr << "err; delta rows must be encoded before block "
+                          << "rows\n";
+                return false;
+            }
+            if(get_num_cols() >= (1 << 27))
+            {
+                std::cerr << "err; too many columns for delta rows\n";
+                return false;
+            }
+
+            compact();
+            std::vector<uint32_t> order(flat_order_, flat_order_ + flat_cols_);
+            std::vector<warthog::cpd::rle_run32> runs;
+            std::vector<uint64_t> offsets;
+            // rows are those of the nodes unless the CPD is partial
+            bool by_node = div_ <= 1 && mod_ == 0 && offset_ == 0;
+
+            if(!warthog::cpd::encode_delta_rows(
+                   by_node ? g_ : nullptr, flat_offsets_, flat_runs_,
+                   flat_rows_, runs, offsets))
+            {
+                return false;
+            }
+
+            clear_flat();
+            order_.swap(order);
+            runs_.swap(runs);
+            offsets_.swap(offsets);
+            set_flat_view();
+            return true;
+        }
+
+        // only rows of runs can be tagged: the words of a table row are
+        // moves, and may hold any value
+        static constexpr bool
+        has_tagged_rows()
+        {
+            return T == FORWARD || T == REVERSE || T == BEARING ||
+                   T == FWD_BEARING;
+        }
+
+        // @return true if some rows are patches of another row
+        inline bool
+        has_delta_rows() const
+        { return has_deltas_; }
+
+        // Store rows as entropy-coded blocks (cf. block_row.h) when this
+        // takes fewer words. Lookups then decode part of a block, which
+        // makes them slower; this is meant for CPDs which are too large for
+        // the memory of the machines they are shipped to. Only for
+        // run-length encoded CPDs, once all rows are built, and after delta
+        // rows if any: these stay as they are, while the rows they refer to
+        // may be coded. So do block rows, and plain rows which replaced some
+        // of them (cf. replace_rows) are coded in turn.
+        //
+        // @return false if the CPD cannot have block rows
+        bool
+        encode_blocks()
+        {
+            if(T == TABLE || T == REV_TABLE || T == HYBRID ||
+               T == REV_HYBRID)
+            {
+                std::cerr << "err; only run-length encoded CPDs have block "
+                          << "rows\n";
+                return false;
+            }
+
+            compact();
+            std::vector<uint32_t> order(flat_order_, flat_order_ + flat_cols_);
+            std::vector<warthog::cpd::rle_run32> runs;
+            std::vector<uint64_t> offsets(1, 0);
+            runs.reserve(flat_runs_count_);
+            offsets.reserve(flat_rows_ + 1);
+
+            for(uint32_t row_id = 0; row_id < flat_rows_; row_id++)
+            {
+                warthog::cpd::rle_row row = row_at(row_id);
+                bool tagged = row.size() > 0 &&
+                    (row.at(0).data_ == warthog::cpd::CPD_DELTA_ROW ||
+                     row.at(0).data_ == warthog::cpd::CPD_BLOCK_ROW);
+                if(tagged || !warthog::cpd::encode_block_row(row, runs))
+                {
+                    runs.insert(runs.end(), row.begin(), row.end());
+                }
+                offsets.push_back(runs.size());
+            }
 
-        //    std::cerr << "compressed source row " << source_id << " with "
-        //        << fm_.at(source_id).size() << std::endl;
+            clear_flat();
+            order_.swap(order);
+            runs_.swap(runs);
+            offsets_.swap(offsets);
+            set_flat_view();
+            return true;
+        }
+
+        // @return true if some rows are entropy-coded
+        inline bool
+        has_block_rows() const
+        { return has_blocks_; }
+
+        // the paths of a lossy CPD cost at most (1 + bound) times the
+        // optimum (cf. bounded_rows.h); 0 if all moves are optimal
+        inline double
+        get_bound() const
+        { return bound_; }
+
+        inline void
+        set_bound(double bound)
+        { bound_ = bound; }
+
+        // Once some rows are marked in @param affected to be repaired (cf.
+        // cpd_repair.h), mark the delta rows which refer to them as well:
+        // their patches no longer hold.
+        //
+        // @return false if the oracle does not have a row per node
+        bool
+        mark_delta_rows(std::vector<bool>& affected) const
+        {
+            if(g_ == nullptr || get_num_rows() != g_->get_num_nodes())
+            {
+                std::cerr << "err; only CPDs with a row per node can be "
+                          << "repaired\n";
+                return false;
+            }
+            if(!has_tagged_rows() || !has_deltas_) { return true; }
+
+            for(size_t row_id = 0; row_id < get_num_rows(); row_id++)
+            {
+                warthog::cpd::rle_row row = row_at(row_id);
+                if(row.size() > 0 &&
+                   row.at(0).data_ == warthog::cpd::CPD_DELTA_ROW &&
+                   affected.at(row.at(1).data_))
+                {
+                    affected.at(row_id) = true;
+                }
+            }
+            return true;
+        }
+
+        // the column order of the built oracle @param other, to compress
+        // rows with compress_row which replace some of its rows
+        void
+        copy_column_order(const graph_oracle_base& other)
+        {
+            assert(!is_flat());
+            order_.resize(other.get_num_cols());
+            for(uint32_t node_id = 0; node_id < order_.size(); node_id++)
+            {
+                order_.at(other.get_col(node_id)) = node_id;
+            }
+        }
+
+        // Replace the rows @param row_ids, in increasing order, with
+        // @param rows, and keep the others (delta and block rows included).
+        // The oracle is compacted first and then no longer refers to its
+        // file, which can be written over.
+        void
+        replace_rows(const std::vector<uint32_t>& row_ids,
+                     const std::vector<std::vector<warthog::cpd::rle_run32>>&
+                         rows)
+        {
+            assert(row_ids.size() == rows.size());
+            compact();
+            std::vector<uint32_t> order(flat_order_, flat_order_ + flat_cols_);
+            std::vector<warthog::cpd::rle_run32> runs;
+            std::vector<uint64_t> offsets(1, 0);
+            runs.reserve(flat_runs_count_);
+            offsets.reserve(flat_rows_ + 1);
+
+            size_t next = 0;
+            for(uint32_t row_id = 0; row_id < flat_rows_; row_id++)
+            {
+                if(next < row_ids.size() && row_ids.at(next) == row_id)
+                {
+                    const std::vector<warthog::cpd::rle_run32>& row =
+                        rows.at(next++);
+                    runs.insert(runs.end(), row.begin(), row.end());
+                }
+                else
+                {
+                    warthog::cpd::rle_row row = row_at(row_id);
+                    runs.insert(runs.end(), row.begin(), row.end());
+                }
+                offsets.push_back(runs.size());
+            }
+
+            clear_flat();
+            order_.swap(order);
+            runs_.swap(runs);
+            offsets_.swap(offsets);
+            set_flat_view();
+        }
+
+        // the move of column @param index in @param row of a run-length
+        // encoded CPD, through the reference row of a delta row and the
+        // blocks of a block row
+        inline uint32_t
+        get_run_move(warthog::cpd::rle_row row, uint32_t index) const
+        {
+            if(has_deltas_ &&
+               row.begin()[0].data_ == warthog::cpd::CPD_DELTA_ROW)
+            {
+                return get_delta_move(row, index);
+            }
+            return get_plain_move(row, index);
+        }
+
+        // the node of each column, until value_index_swap_array turns it
+        // into the column of each node
+        inline const std::vector<uint32_t>&
+        get_order() const { return order_; }
+
+        // the move of the symbol @param fm of a bearing CPD from
+        // @param source_id to @param target_id
+        inline uint32_t
+        bearing_move(uint32_t fm, warthog::sn_id_t source_id,
+                     warthog::sn_id_t target_id) const
+        {
+            if(fm >= 2) { return fm - 2; }
+
+            // counter-/clock-wise wildcard
+            uint32_t cw, ccw;
+            bool found = bearings_.sector(source_id, target_id, cw, ccw);
+            assert(found);
+            if(!found) { return warthog::cpd::CPD_FM_NONE; }
+
+            return fm == warthog::cpd::CW ? cw : ccw;
+        }
+
+        // the out-edges of each node sorted by bearing, for bearing CPDs
+        inline const warthog::cpd::bearing_table&
+        get_bearings() const { return bearings_; }
+
+        // sort the out-edges of the graph again, once its nodes or their
+        // coordinates have changed (e.g., when it is renumbered)
+        void
+        update_bearings()
+        {
+            if(T == BEARING || T == FWD_BEARING)
+            {
+                bearings_ = warthog::cpd::bearing_table(g_);
+            }
         }
 
         inline warthog::graph::xy_graph* 
@@ -154,15 +786,31 @@ class graph_oracle_base
 
         inline void
         set_graph(warthog::graph::xy_graph* g)
-        { g_ = g; }
+        {
+            g_ = g;
+            update_bearings();
+        }
 
         inline size_t
         mem()
         {
-            size_t retval = 
-                g_->mem() + 
+            size_t retval = g_->mem() + bearings_.mem();
+
+            if(is_flat())
+            {
+                // for mapped files, we only count the sections we query
+                if(shards_) { retval += shards_->mem(); }
+                return retval +
+                    sizeof(uint32_t) * flat_cols_ +
+                    sizeof(uint64_t) * (flat_rows_ + 1) +
+                    sizeof(warthog::cpd::rle_run32) * flat_runs_count_;
+            }
+
+            retval +=
                 sizeof(uint32_t) * order_.size() + 
                 sizeof(std::vector<warthog::cpd::rle_run32>) * fm_.size();
+            if(lazy_) { retval += lazy_->mem(); }
+            if(tiered_) { retval += tiered_->mem(); }
 
             for(uint32_t i = 0; i < fm_.size(); i++)
             {
@@ -172,31 +820,99 @@ class graph_oracle_base
             return retval; 
         }
 
+        // @return true if the rows and column order are read in place from a
+        // memory-mapped binary CPD file, or from several (cf. ::map_shards)
+        inline bool
+        is_mapped() const
+        { return map_ != nullptr || shards_ != nullptr; }
+
+        // @return true if the rows are those of several partial CPDs (cf.
+        // ::map_shards)
+        inline bool
+        is_sharded() const
+        { return shards_ != nullptr; }
+
+        // @return true if the rows are stored in CSR form, either because the
+        // oracle was compacted or loaded, or because it is memory-mapped
+        inline bool
+        is_flat() const
+        { return flat_offsets_ != nullptr; }
+
+        inline size_t
+        get_num_rows() const
+        {
+            if(is_flat()) { return flat_rows_; }
+            return tiered_ ? tiered_->get_num_rows() : fm_.size();
+        }
+
+        inline size_t
+        get_num_cols() const
+        { return is_flat() ? flat_cols_ : order_.size(); }
+
+        // @return true if every node is its own column, i.e. the graph was
+        // renumbered into column order (cf. make_cpd --renumber)
+        inline bool
+        has_identity_order() const
+        { return identity_order_; }
+
+        // the column index of node @param node_id
+        inline uint32_t
+        get_col(warthog::sn_id_t node_id) const
+        {
+            if(identity_order_)
+            {
+                assert(node_id < get_num_cols());
+                return (uint32_t)node_id;
+            }
+            if(is_flat())
+            {
+                assert(node_id < flat_cols_);
+                return flat_order_[node_id];
+            }
+            return order_.at(node_id);
+        }
+
+        // the runs of row @param row_id, without any div/mod/offset
+        // translation (cf. ::get_row)
+        inline warthog::cpd::row_handle
+        get_row_at(size_t row_id) const
+        {
+            if(tiered_) { return tiered_->get_shared((uint32_t)row_id); }
+            return row_at(row_id);
+        }
+
         friend std::ostream&
         operator<<(std::ostream& out, graph_oracle_base& lab)
         {
             warthog::timer mytimer;
             mytimer.start();
 
-            // write graph size
+            // write the version, symbol and graph size
+            uint32_t magic = warthog::cpd::CPD_STREAM_MAGIC;
+            uint32_t version = warthog::cpd::CPD_FILE_VERSION;
+            uint32_t symbol = T;
             uint32_t num_nodes = lab.g_->get_num_nodes();
+            out.write((char*)(&magic), 4);
+            out.write((char*)(&version), 4);
+            out.write((char*)(&symbol), 4);
             out.write((char*)(&num_nodes), 4);
 
             // write node ordering
-            assert(lab.order_.size() == num_nodes);
+            assert(lab.get_num_cols() == num_nodes);
             for(uint32_t i = 0; i < num_nodes; i++)
             {
-                uint32_t n_id = lab.order_.at(i);
+                uint32_t n_id = lab.get_col(i);
                 out.write((char*)(&n_id), 4);
             }
 
             // write the runs for each row
             uint32_t row_count = 0;
             uint32_t run_count = 0;
-            for(uint32_t row_id = 0; row_id < lab.g_->get_num_nodes(); row_id++)
+            for(uint32_t row_id = 0; row_id < lab.get_num_rows(); row_id++)
             {
+                warthog::cpd::rle_row row = lab.row_at(row_id);
                 // write the number of runs
-                uint32_t num_runs = (uint32_t)lab.fm_.at(row_id).size();
+                uint32_t num_runs = row.size();
                 // Skip empty runs
                 if (num_runs == 0) { continue; }
 
@@ -205,7 +921,7 @@ class graph_oracle_base
 
                 for(uint32_t run = 0; run < num_runs; run++)
                 {
-                    out << lab.fm_.at(row_id).at(run);
+                    out << row.at(run);
                     run_count++;
                     if(!out.good())
                     {
@@ -213,7 +929,7 @@ class graph_oracle_base
                         std::cerr
                             << "[debug info] "
                             << " row_id " << row_id
-                            << " run# " << lab.fm_.at(row_id).size()
+                            << " run# " << row.size()
                             << ". aborting.\n";
                         return out;
                     }
@@ -240,6 +956,35 @@ class graph_oracle_base
 
             uint32_t num_nodes;
             in.read((char*)(&num_nodes), 4);
+
+            if(num_nodes == warthog::cpd::CPD_FILE_MAGIC)
+            {
+                return lab.read_binary(in);
+            }
+
+            // files of version 1 start with the graph size; they have no
+            // symbol, so they are taken to be of that of the oracle
+            uint32_t version = 1;
+            uint32_t symbol = T;
+            if(num_nodes == warthog::cpd::CPD_STREAM_MAGIC)
+            {
+                in.read((char*)(&version), 4);
+                in.read((char*)(&symbol), 4);
+                in.read((char*)(&num_nodes), 4);
+            }
+            if(in.good() && symbol != T)
+            {
+                std::cerr << "err; CPD was built with symbol " << symbol
+                          << " but is loaded as " << T << "\n";
+                in.setstate(std::ios_base::failbit);
+            }
+            if(!in.good() || !warthog::cpd::check_file_version(version, T))
+            {
+                lab.clear();
+                in.setstate(std::ios_base::failbit);
+                return in;
+            }
+
             // Need to check whether we have initialized the graph as
             // serialising removes the internal pointer.
             if(lab.g_ != nullptr && num_nodes != lab.g_->get_num_nodes())
@@ -251,8 +996,10 @@ class graph_oracle_base
                 return in;
             }
 
-            lab.fm_.clear();
+            // rows are read straight into CSR storage
+            lab.clear();
             lab.order_.resize(num_nodes);
+            lab.offsets_.push_back(0);
 
             // read the vertex-to-column-order mapping
             for(uint32_t i = 0; i < num_nodes; i++)
@@ -264,13 +1011,11 @@ class graph_oracle_base
 
             // read the RLE data
             uint32_t run_count = 0;
-            lab.fm_.resize(num_nodes);
             for(uint32_t row_id = 0; row_id < num_nodes; row_id++)
             {
                 // Check if we have a partial CPD file
                 if (in.peek() == EOF)
                 {
-                    lab.fm_.resize(row_id);
                     std::cerr << "early stop; ";
                     break;
                 }
@@ -283,7 +1028,7 @@ class graph_oracle_base
                 {
                     warthog::cpd::rle_run32 tmp;
                     in >> tmp;
-                    lab.fm_.at(row_id).push_back(tmp);
+                    lab.runs_.push_back(tmp);
                     run_count++;
 
                     if(!in.good())
@@ -292,16 +1037,19 @@ class graph_oracle_base
                         std::cerr
                             << "[debug info] "
                             << " row_id " << row_id
-                            << " run# " << i << " of " << lab.fm_.size()
+                            << " run# " << i << " of " << num_runs
                             << ". aborting.\n";
+                        lab.clear();
                         return in;
                     }
                 }
+                lab.offsets_.push_back(lab.runs_.size());
             }
+            lab.set_flat_view();
             mytimer.stop();
 
             std::cerr
-                << "read from disk " << lab.fm_.size()
+                << "read from disk " << lab.get_num_rows()
                 << " rows and "
                 << run_count << " runs. "
                 << " time: " << (double)mytimer.elapsed_time_nano() / 1e9
@@ -309,60 +1057,456 @@ class graph_oracle_base
             return in;
         }
 
-        /**
-         * Append operator for CPDs. Used when building partial CPDs so we can
-         * join them into a single one.
-         */
-        void
-        append_fm(const graph_oracle_base &cpd)
-        {
-            fm_.insert(fm_.end(), cpd.fm_.begin(), cpd.fm_.end());
-        }
-
-        void
-        compute_row(uint32_t source_id, warthog::search* dijk,
-                    std::vector<warthog::cpd::fm_coll> &s_row)
+        // write the oracle in the binary CPD format (cf. cpd_header). As for
+        // the stream format, empty rows are skipped.
+        std::ostream&
+        write_binary(std::ostream& out)
         {
-            warthog::problem_instance problem(source_id);
-            warthog::solution sol;
-
-            std::fill(s_row.begin(), s_row.end(), warthog::cpd::CPD_FM_NONE);
-            dijk->get_path(problem, sol);
-            add_row(source_id, s_row);
-        }
+            warthog::timer mytimer;
+            mytimer.start();
 
-        // TODO should only be used with reverse schemes
-        std::vector<warthog::cpd::rle_run32>&
-        get_row(warthog::sn_id_t target_id)
-        {
-            size_t row_id;
-            if(div_ > 1)
+            warthog::cpd::cpd_header header = {};
+            header.magic_ = warthog::cpd::CPD_FILE_MAGIC;
+            header.version_ = warthog::cpd::CPD_FILE_VERSION;
+            header.symbol_ = T;
+            header.num_nodes_ = g_->get_num_nodes();
+            header.flags_ = identity_order_ ?
+                warthog::cpd::CPD_FLAG_IDENTITY_ORDER : 0;
+            if(has_deltas_)
             {
-                row_id = target_id / div_;
+                header.flags_ |= warthog::cpd::CPD_FLAG_DELTA_ROWS;
             }
-            else if(mod_ > 0)
+            if(has_blocks_)
             {
-                row_id = target_id % mod_;
+                header.flags_ |= warthog::cpd::CPD_FLAG_BLOCK_ROWS;
             }
-            else if(offset_ > 0)
+            if(bound_ > 0)
             {
-                row_id = target_id - offset_;
+                header.flags_ |= warthog::cpd::CPD_FLAG_BOUNDED;
+                header.bound_ = bound_;
             }
-            else
+
+            std::vector<uint64_t> offsets(1, 0);
+            for(size_t row_id = 0; row_id < get_num_rows(); row_id++)
             {
-                row_id = target_id;
+                uint32_t num_runs = row_at(row_id).size();
+                if(num_runs == 0) { continue; }
+                offsets.push_back(offsets.back() + num_runs);
             }
 
-            assert(row_id >= 0);
-            assert(row_id < fm_.size());
+            header.num_rows_ = (uint32_t)(offsets.size() - 1);
+            header.num_runs_ = offsets.back();
+            header.order_pos_ = sizeof(warthog::cpd::cpd_header);
+            header.runs_pos_ =
+                header.order_pos_ + sizeof(uint32_t) * header.num_nodes_;
+            // align the offsets table on 8 bytes
+            header.rows_pos_ = header.runs_pos_ +
+                sizeof(warthog::cpd::rle_run32) * header.num_runs_;
+            uint32_t padding = (8 - (header.rows_pos_ % 8)) % 8;
+            header.rows_pos_ += padding;
+
+            out.write((char*)&header, sizeof(header));
+
+            assert(get_num_cols() == header.num_nodes_);
+            for(uint32_t i = 0; i < header.num_nodes_; i++)
+            {
+                uint32_t n_id = get_col(i);
+                out.write((char*)(&n_id), 4);
+            }
 
-            return fm_.at(row_id);
-        }
+            for(size_t row_id = 0; row_id < get_num_rows(); row_id++)
+            {
+                warthog::cpd::rle_row row = row_at(row_id);
+                out.write((char*)row.begin(),
+                          sizeof(warthog::cpd::rle_run32) * row.size());
+            }
 
+            uint64_t zero = 0;
+            out.write((char*)&zero, padding);
+            out.write((char*)offsets.data(), sizeof(uint64_t) * offsets.size());
+
+            mytimer.stop();
+
+            if(!out.good())
+            {
+                std::cerr << "err; while writing binary CPD\n";
+                return out;
+            }
+
+            std::cerr
+                << "wrote to disk " << header.num_rows_
+                << " rows and "
+                << header.num_runs_ << " runs (binary). "
+                << " time: " << (double)mytimer.elapsed_time_nano() / 1e9
+                << " s \n";
+            return out;
+        }
+
+        // load the oracle from @param filename. Binary CPD files are
+        // memory-mapped and queried in place; files in the stream format
+        // are read in memory.
+        //
+        // @return false if the file could not be read.
+        bool
+        load(const std::string& filename)
+        {
+            std::ifstream ifs(filename, std::ios_base::binary);
+            if(!ifs.good()) { return false; }
+
+            uint32_t magic = 0;
+            ifs.read((char*)&magic, sizeof(magic));
+
+            if(magic == warthog::cpd::CPD_FILE_MAGIC)
+            {
+                ifs.close();
+                return map(filename);
+            }
+
+            ifs.seekg(0);
+            ifs >> *this;
+
+            return !ifs.fail();
+        }
+
+        // memory-map a binary CPD file. The column order and rows are not
+        // copied: lookups read the file's pages directly, which are shared
+        // with every other process that maps the same file.
+        //
+        // @return false if the file is not a valid binary CPD.
+        bool
+        map(const std::string& filename)
+        {
+            warthog::timer mytimer;
+            mytimer.start();
+
+            std::shared_ptr<warthog::util::mapped_file> mf =
+                std::make_shared<warthog::util::mapped_file>();
+
+            if(!mf->open(filename)) { return false; }
+
+            const warthog::cpd::cpd_header* header =
+                (const warthog::cpd::cpd_header*)mf->data();
+
+            if(!check_header(*header, mf->size())) { return false; }
+
+            clear();
+            map_ = mf;
+            flat_cols_ = header->num_nodes_;
+            flat_rows_ = header->num_rows_;
+            flat_runs_count_ = header->num_runs_;
+            flat_order_ = (const uint32_t*)(mf->data() + header->order_pos_);
+            flat_runs_ = (const warthog::cpd::rle_run32*)(
+                mf->data() + header->runs_pos_);
+            flat_offsets_ = (const uint64_t*)(mf->data() + header->rows_pos_);
+            flat_ends_ = flat_offsets_ + 1;
+            // trust the header rather than read the whole order array
+            identity_order_ =
+                header->flags_ & warthog::cpd::CPD_FLAG_IDENTITY_ORDER;
+            // a table CPD written with tag flags has no tagged rows
+            has_deltas_ = has_tagged_rows() &&
+                (header->flags_ & warthog::cpd::CPD_FLAG_DELTA_ROWS);
+            has_blocks_ = has_tagged_rows() &&
+                (header->flags_ & warthog::cpd::CPD_FLAG_BLOCK_ROWS);
+            bound_ = (header->flags_ & warthog::cpd::CPD_FLAG_BOUNDED) ?
+                header->bound_ : 0;
+            update_table_words();
+
+            mytimer.stop();
+
+            std::cerr
+                << "mapped from disk " << flat_rows_
+                << " rows and "
+                << flat_runs_count_ << " runs. "
+                << " time: " << (double)mytimer.elapsed_time_nano() / 1e9
+                << " s\n";
+            return true;
+        }
+
+        // map the partial binary CPDs listed in the manifest @param manifest
+        // (cf. cpd_shards) as one oracle, whose rows are those of the nodes:
+        // the div/mod/offset of each part is in the manifest, so none is
+        // set. Rows which no part holds are empty.
+        //
+        // @return false if the parts are not valid binary CPDs of the graph,
+        // or do not fit together.
+        bool
+        map_shards(const std::string& manifest)
+        {
+            warthog::timer mytimer;
+            mytimer.start();
+
+            std::shared_ptr<warthog::cpd::cpd_shards> shards =
+                std::make_shared<warthog::cpd::cpd_shards>();
+
+            if(!shards->open(manifest)) { return false; }
+
+            for(size_t i = 0; i < shards->get_num_shards(); i++)
+            {
+                if(!check_header(shards->get_header(i),
+                                 shards->get_file_size(i)))
+                {
+                    std::cerr << "err; in shard "
+                              << shards->get_shard(i).filename_ << "\n";
+                    return false;
+                }
+            }
+
+            uint32_t num_nodes = shards->get_header(0).num_nodes_;
+            if(!shards->index_rows(num_nodes)) { return false; }
+
+            clear();
+            shards_ = shards;
+            flat_cols_ = num_nodes;
+            flat_rows_ = num_nodes;
+            flat_runs_count_ = shards->get_num_runs();
+            flat_order_ = shards->get_order();
+            flat_runs_ = shards->get_runs();
+            flat_offsets_ = shards->get_begins();
+            flat_ends_ = shards->get_ends();
+            identity_order_ =
+                shards->get_flags() & warthog::cpd::CPD_FLAG_IDENTITY_ORDER;
+            has_blocks_ = has_tagged_rows() &&
+                (shards->get_flags() & warthog::cpd::CPD_FLAG_BLOCK_ROWS);
+            bound_ = shards->get_bound();
+            update_table_words();
+
+            mytimer.stop();
+
+            std::cerr
+                << "mapped from disk " << shards->get_num_shards()
+                << " shards of " << flat_rows_ << " rows and "
+                << flat_runs_count_ << " runs. "
+                << " time: " << (double)mytimer.elapsed_time_nano() / 1e9
+                << " s\n";
+            return true;
+        }
+
+        // load a binary CPD file for lookups, with the rows left on disk but
+        // for a cache of at most @param cache_bytes of them in RAM (cf.
+        // row_cache). For CPDs which do not fit in RAM: only the column
+        // order and the row offsets are read in memory.
+        //
+        // @return false if the file is not a valid binary CPD.
+        bool
+        load_tiered(const std::string& filename, size_t cache_bytes)
+        {
+            std::shared_ptr<warthog::cpd::row_cache> cache =
+                std::make_shared<warthog::cpd::row_cache>(cache_bytes);
+
+            if(!cache->open(filename)) { return false; }
+
+            const warthog::cpd::cpd_header& header = cache->get_header();
+            if(!check_header(header, cache->get_file_size()) ||
+               !cache->read_offsets())
+            {
+                return false;
+            }
+
+            clear();
+            order_.resize(header.num_nodes_);
+            if(!cache->read(header.order_pos_, order_.data(),
+                            sizeof(uint32_t) * order_.size()))
+            {
+                std::cerr << "err; while reading binary CPD\n";
+                clear();
+                return false;
+            }
+
+            tiered_ = cache;
+            identity_order_ =
+                header.flags_ & warthog::cpd::CPD_FLAG_IDENTITY_ORDER;
+            // a table CPD written with tag flags has no tagged rows
+            has_deltas_ = has_tagged_rows() &&
+                (header.flags_ & warthog::cpd::CPD_FLAG_DELTA_ROWS);
+            has_blocks_ = has_tagged_rows() &&
+                (header.flags_ & warthog::cpd::CPD_FLAG_BLOCK_ROWS);
+            bound_ = (header.flags_ & warthog::cpd::CPD_FLAG_BOUNDED) ?
+                header.bound_ : 0;
+            update_table_words();
+
+            std::cerr
+                << "opened " << get_num_rows() << " rows and "
+                << header.num_runs_ << " runs on disk, with a cache of "
+                << cache_bytes << " bytes.\n";
+            return true;
+        }
+
+        // @return true if the rows are read from disk through a cache (cf.
+        // ::load_tiered)
+        inline bool
+        is_tiered() const
+        { return tiered_ != nullptr; }
+
+        // the cache of a tiered oracle, e.g. for its hit and miss counts
+        inline const warthog::cpd::row_cache*
+        get_row_cache() const
+        { return tiered_.get(); }
+
+        /**
+         * Append operator for CPDs. Used when building partial CPDs so we can
+         * join them into a single one.
+         */
         void
-        set_row(size_t row_id, std::vector<warthog::cpd::rle_run32>& row)
+        append_fm(const graph_oracle_base &cpd)
         {
-            fm_.at(row_id) = row;
+            assert(!is_flat());
+
+            for(size_t row_id = 0; row_id < cpd.get_num_rows(); row_id++)
+            {
+                warthog::cpd::rle_row row = cpd.row_at(row_id);
+                fm_.emplace_back(row.begin(), row.end());
+            }
+        }
+
+        void
+        compute_row(uint32_t source_id, warthog::search* dijk,
+                    std::vector<warthog::cpd::fm_coll> &s_row)
+        {
+            warthog::problem_instance problem(source_id);
+            warthog::solution sol;
+
+            std::fill(s_row.begin(), s_row.end(), warthog::cpd::CPD_FM_NONE);
+            dijk->get_path(problem, sol);
+            add_row(source_id, s_row);
+        }
+
+        void
+        compute_row(uint32_t source_id,
+                    warthog::cpd::first_move_dijkstra* dijk,
+                    std::vector<warthog::cpd::fm_coll> &s_row)
+        {
+            dijk->compute_row(source_id, s_row);
+            add_row(source_id, s_row);
+        }
+
+        // TODO should only be used with reverse schemes
+        warthog::cpd::row_handle
+        get_row(warthog::sn_id_t target_id)
+        {
+            return get_row_at(get_row_id(target_id));
+        }
+
+        // the row of node @param target_id, given the div/mod/offset of a
+        // partial CPD
+        inline size_t
+        get_row_id(warthog::sn_id_t target_id) const
+        {
+            size_t row_id;
+            if(div_ > 1)
+            {
+                row_id = target_id / div_;
+            }
+            else if(mod_ > 0)
+            {
+                row_id = target_id % mod_;
+            }
+            else if(offset_ > 0)
+            {
+                row_id = target_id - offset_;
+            }
+            else
+            {
+                row_id = target_id;
+            }
+
+            assert(row_id < get_num_rows());
+            return row_id;
+        }
+
+        // Batched lookups. A move is found through a chain of dependent
+        // loads (column, row offsets, runs) which mostly miss the cache on
+        // large graphs. To overlap the misses of independent queries, issue
+        // ::prefetch_move for a group of queries, then ::prefetch_runs for
+        // the same group, and only then ::get_move. Only flat oracles are
+        // prefetched.
+        inline void
+        prefetch_move(warthog::sn_id_t source_id,
+                      warthog::sn_id_t target_id) const
+        {
+            if(!is_flat()) { return; }
+
+            size_t row_id = move_row(source_id, target_id);
+            __builtin_prefetch(flat_offsets_ + row_id);
+            // a separate table in sharded oracles, or else the same line
+            __builtin_prefetch(flat_ends_ + row_id);
+            if(!identity_order_)
+            {
+                __builtin_prefetch(
+                    flat_order_ + move_col_node(source_id, target_id));
+            }
+        }
+
+        // second stage: read the (prefetched) row offsets and column, then
+        // prefetch the runs which ::get_move will probe first.
+        inline void
+        prefetch_runs(warthog::sn_id_t source_id,
+                      warthog::sn_id_t target_id) const
+        {
+            if(!is_flat()) { return; }
+
+            size_t row_id = move_row(source_id, target_id);
+            uint64_t begin = flat_offsets_[row_id];
+            const warthog::cpd::rle_run32* runs = flat_runs_ + begin;
+
+            if(T == TABLE || T == REV_TABLE)
+            {
+                uint32_t size = (uint32_t)(flat_ends_[row_id] - begin);
+                uint32_t entry, shift;
+                table_position(get_col(move_col_node(source_id, target_id)),
+                               table_bits(size), entry, shift);
+                __builtin_prefetch(runs + entry);
+            }
+            else
+            {
+                uint64_t size = flat_ends_[row_id] - begin;
+                __builtin_prefetch(runs);
+                // the entry of the target, should this be a table row
+                if(T == HYBRID || T == REV_HYBRID)
+                {
+                    uint64_t entry =
+                        1 + get_col(move_col_node(source_id, target_id)) / 8;
+                    if(entry < size) { __builtin_prefetch(runs + entry); }
+                }
+                // first probes of the binary search
+                if(size > RUN_LOOKUP_LINEAR_MAX)
+                {
+                    __builtin_prefetch(runs + size / 4);
+                    __builtin_prefetch(runs + size / 2);
+                    __builtin_prefetch(runs + size / 2 + size / 4);
+                }
+            }
+        }
+
+        // the first moves of @param num (source, target) pairs, looked up
+        // CPD_PREFETCH_GROUP at a time with prefetching
+        void
+        get_moves(const warthog::sn_id_t* sources,
+                  const warthog::sn_id_t* targets,
+                  uint32_t* moves, size_t num)
+        {
+            for(size_t from = 0; from < num; from += CPD_PREFETCH_GROUP)
+            {
+                size_t to = std::min(num, from + CPD_PREFETCH_GROUP);
+                for(size_t i = from; i < to; i++)
+                {
+                    prefetch_move(sources[i], targets[i]);
+                }
+                for(size_t i = from; i < to; i++)
+                {
+                    prefetch_runs(sources[i], targets[i]);
+                }
+                for(size_t i = from; i < to; i++)
+                {
+                    moves[i] = get_move(sources[i], targets[i]);
+                }
+            }
+        }
+
+        void
+        set_row(size_t row_id, warthog::cpd::rle_row row)
+        {
+            assert(!is_flat());
+            fm_.at(row_id).assign(row.begin(), row.end());
         }
 
         void
@@ -377,13 +1521,343 @@ class graph_oracle_base
         set_offset(uint32_t offset)
         { offset_ = offset; }
 
+        uint32_t
+        get_div() const
+        { return div_; }
+
+        uint32_t
+        get_mod() const
+        { return mod_; }
+
+        uint32_t
+        get_offset() const
+        { return offset_; }
+
     private:
+        // the runs of row @param row_id, as ::get_row_at. The runs of a
+        // tiered oracle are only valid until this thread looks up two other
+        // rows (cf. row_cache).
+        inline warthog::cpd::rle_row
+        row_at(size_t row_id) const
+        {
+            if(is_flat())
+            {
+                assert(row_id < flat_rows_);
+                uint64_t begin = flat_offsets_[row_id];
+                return warthog::cpd::rle_row(
+                    flat_runs_ + begin, flat_ends_[row_id] - begin);
+            }
+            if(lazy_) { return lazy_->get((uint32_t)row_id); }
+            if(tiered_) { return tiered_->get((uint32_t)row_id); }
+            return warthog::cpd::rle_row(fm_.at(row_id));
+        }
+
+        // the runs of the row of node @param target_id, as ::get_row
+        inline warthog::cpd::rle_row
+        row_of(warthog::sn_id_t target_id) const
+        {
+            return row_at(get_row_id(target_id));
+        }
+
+        // the row, and the node of the column, which hold the first move from
+        // @param source_id to @param target_id (cf. the ::get_move
+        // specialisations)
+        inline size_t
+        move_row(warthog::sn_id_t source_id, warthog::sn_id_t target_id) const
+        {
+            switch(T)
+            {
+                case FORWARD:
+                case FWD_BEARING:
+                    return source_id;
+                case BEARING:
+                    return target_id;
+                case TABLE:
+                case HYBRID:
+                    return get_row_id(source_id);
+                default:
+                    return get_row_id(target_id);
+            }
+        }
+
+        inline warthog::sn_id_t
+        move_col_node(warthog::sn_id_t source_id,
+                      warthog::sn_id_t target_id) const
+        {
+            return (T == FORWARD || T == TABLE || T == FWD_BEARING ||
+                    T == HYBRID) ? target_id : source_id;
+        }
+
+        // the move of column @param index in the delta row @param row
+        uint32_t
+        get_delta_move(warthog::cpd::rle_row row, uint32_t index) const
+        {
+            warthog::cpd::rle_row patch(row.begin() + 2, row.size() - 2);
+            const warthog::cpd::rle_run32& run =
+                patch.at(find_run(patch, 2 * index + 1));
+            if(!warthog::cpd::is_delta_hole(run)) { return run.get_move(); }
+
+            // references are never delta rows
+            return get_plain_move(row_at(row.at(1).data_), index);
+        }
+
+        // the move of column @param index in @param row, which is not a
+        // delta row
+        inline uint32_t
+        get_plain_move(warthog::cpd::rle_row row, uint32_t index) const
+        {
+            if(has_blocks_ &&
+               row.begin()[0].data_ == warthog::cpd::CPD_BLOCK_ROW)
+            {
+                return warthog::cpd::get_block_move(row, index);
+            }
+            return row.at(find_run(row, index)).get_move();
+        }
+
+        // check whether any row is a delta row or a block row
+        void
+        update_tagged_rows()
+        {
+            has_deltas_ = false;
+            has_blocks_ = false;
+            if(!has_tagged_rows()) { return; }
+
+            for(size_t row_id = 0; row_id < get_num_rows(); row_id++)
+            {
+                warthog::cpd::rle_row row = row_at(row_id);
+                if(row.size() == 0) { continue; }
+
+                has_deltas_ = has_deltas_ ||
+                    row.at(0).data_ == warthog::cpd::CPD_DELTA_ROW;
+                has_blocks_ = has_blocks_ ||
+                    row.at(0).data_ == warthog::cpd::CPD_BLOCK_ROW;
+            }
+        }
+
+        // the lengths of table rows of 2 and 3 bits (cf. table_words), or
+        // UINT32_MAX if the widths cannot be told apart
+        void
+        update_table_words()
+        {
+            uint32_t num_cols = (uint32_t)get_num_cols();
+            bool distinct = table_widths_distinct(num_cols);
+            table_words2_ = distinct ? table_words(num_cols, 2) : UINT32_MAX;
+            table_words3_ = distinct ? table_words(num_cols, 3) : UINT32_MAX;
+        }
+
+        // the remainder of a binary CPD, after its magic number, read from a
+        // stream into memory
+        std::istream&
+        read_binary(std::istream& in)
+        {
+            warthog::timer mytimer;
+            mytimer.start();
+
+            warthog::cpd::cpd_header header;
+            header.magic_ = warthog::cpd::CPD_FILE_MAGIC;
+            in.read((char*)&header + sizeof(header.magic_),
+                    sizeof(header) - sizeof(header.magic_));
+
+            if(!in.good() || !check_header(header, SIZE_MAX))
+            {
+                in.setstate(std::ios_base::failbit);
+                return in;
+            }
+
+            clear();
+            order_.resize(header.num_nodes_);
+            in.read((char*)order_.data(), sizeof(uint32_t) * order_.size());
+
+            runs_.resize(header.num_runs_);
+            in.read((char*)runs_.data(),
+                    sizeof(warthog::cpd::rle_run32) * runs_.size());
+
+            uint64_t pos = header.runs_pos_ +
+                sizeof(warthog::cpd::rle_run32) * header.num_runs_;
+            in.ignore(header.rows_pos_ - pos);
+
+            offsets_.resize(header.num_rows_ + 1);
+            in.read((char*)offsets_.data(), sizeof(uint64_t) * offsets_.size());
+
+            if(!in.good())
+            {
+                std::cerr << "err; while reading binary CPD\n";
+                clear();
+                return in;
+            }
+
+            set_flat_view();
+            bound_ = (header.flags_ & warthog::cpd::CPD_FLAG_BOUNDED) ?
+                header.bound_ : 0;
+            mytimer.stop();
+
+            std::cerr
+                << "read from disk " << get_num_rows()
+                << " rows and "
+                << header.num_runs_ << " runs (binary). "
+                << " time: " << (double)mytimer.elapsed_time_nano() / 1e9
+                << " s\n";
+            return in;
+        }
+
+        // point the CSR view at ::order_, ::runs_ and ::offsets_
+        void
+        set_flat_view()
+        {
+            assert(offsets_.size() > 0);
+            flat_order_ = order_.data();
+            flat_offsets_ = offsets_.data();
+            flat_ends_ = flat_offsets_ + 1;
+            flat_runs_ = runs_.data();
+            flat_cols_ = (uint32_t)order_.size();
+            flat_rows_ = (uint32_t)(offsets_.size() - 1);
+            flat_runs_count_ = runs_.size();
+            update_identity_order();
+            update_table_words();
+            update_tagged_rows();
+        }
+
+        // check whether ::order_ is the identity
+        void
+        update_identity_order()
+        {
+            identity_order_ = false;
+            for(uint32_t i = 0; i < order_.size(); i++)
+            {
+                if(order_.at(i) != i) { return; }
+            }
+            identity_order_ = order_.size() > 0;
+        }
+
+        // drop the CSR storage and the memory mapping, if any
+        void
+        clear_flat()
+        {
+            map_.reset();
+            shards_.reset();
+            runs_.clear();
+            offsets_.clear();
+            flat_order_ = nullptr;
+            flat_offsets_ = nullptr;
+            flat_ends_ = nullptr;
+            flat_runs_ = nullptr;
+            flat_cols_ = 0;
+            flat_rows_ = 0;
+            flat_runs_count_ = 0;
+            identity_order_ = false;
+            has_deltas_ = false;
+            has_blocks_ = false;
+        }
+
+        // sanity checks on a binary CPD header; @param file_size is the size
+        // of the file the header was read from, if known.
+        bool
+        check_header(const warthog::cpd::cpd_header& header, size_t file_size)
+        {
+            if(file_size < sizeof(header) ||
+               header.magic_ != warthog::cpd::CPD_FILE_MAGIC)
+            {
+                std::cerr << "err; not a binary CPD file\n";
+                return false;
+            }
+
+            if(!warthog::cpd::check_file_version(
+                   header.version_, header.symbol_))
+            {
+                return false;
+            }
+
+            if(g_ != nullptr && header.num_nodes_ != g_->get_num_nodes())
+            {
+                std::cerr
+                    << "err; " << "input mismatch. cpd file says "
+                    << header.num_nodes_ << " nodes, but graph contains "
+                    << g_->get_num_nodes() << "\n";
+                return false;
+            }
+
+            uint64_t end = header.rows_pos_ +
+                sizeof(uint64_t) * ((uint64_t)header.num_rows_ + 1);
+            if(header.order_pos_ < sizeof(header) ||
+               header.runs_pos_ < header.order_pos_ +
+                   sizeof(uint32_t) * (uint64_t)header.num_nodes_ ||
+               header.rows_pos_ < header.runs_pos_ +
+                   sizeof(warthog::cpd::rle_run32) * header.num_runs_ ||
+               header.rows_pos_ % sizeof(uint64_t) != 0 ||
+               (file_size != SIZE_MAX && end > file_size))
+            {
+                std::cerr << "err; corrupt or truncated binary CPD file\n";
+                return false;
+            }
+
+            // rows of another symbol would give wrong moves
+            if(header.symbol_ != T)
+            {
+                std::cerr << "err; binary CPD was built with symbol "
+                          << header.symbol_ << " but is loaded as " << T
+                          << "\n";
+                return false;
+            }
+
+            return true;
+        }
+
         std::vector<std::vector<warthog::cpd::rle_run32>> fm_;
         std::vector<uint32_t> order_;
         warthog::graph::xy_graph* g_;
         uint32_t div_;
         uint32_t mod_;
         uint32_t offset_;
+        warthog::cpd::bearing_table bearings_;
+
+        // CSR storage: the runs of all rows in one array, row i spanning
+        // [offsets_[i], offsets_[i+1]). Replaces ::fm_ once compacted.
+        std::vector<warthog::cpd::rle_run32> runs_;
+        std::vector<uint64_t> offsets_;
+
+        // when loaded from a binary CPD file, the column order and rows are
+        // read in place from the mapping
+        std::shared_ptr<warthog::util::mapped_file> map_;
+
+        // cf. ::map_shards
+        std::shared_ptr<warthog::cpd::cpd_shards> shards_;
+
+        // lookups go through this view, which points either into the CSR
+        // arrays above, into the mapping or into the row table of shards;
+        // null while the oracle is built. Row i spans [flat_offsets_[i],
+        // flat_ends_[i]), and flat_ends_ is flat_offsets_ + 1 but in shards.
+        const uint32_t* flat_order_ = nullptr;
+        const uint64_t* flat_offsets_ = nullptr;
+        const uint64_t* flat_ends_ = nullptr;
+        const warthog::cpd::rle_run32* flat_runs_ = nullptr;
+        uint32_t flat_cols_ = 0;
+        uint32_t flat_rows_ = 0;
+        uint64_t flat_runs_count_ = 0;
+
+        // skip the column order lookups in ::get_col
+        bool identity_order_ = false;
+
+        // cf. ::set_table_ratio
+        double table_ratio_ = 1.0;
+
+        // cf. ::table_bits
+        uint32_t table_words2_ = UINT32_MAX;
+        uint32_t table_words3_ = UINT32_MAX;
+
+        // cf. ::encode_deltas
+        bool has_deltas_ = false;
+
+        // cf. ::encode_blocks
+        bool has_blocks_ = false;
+
+        // cf. ::get_bound
+        double bound_ = 0;
+
+        // cf. ::make_lazy
+        std::shared_ptr<warthog::cpd::lazy_rows> lazy_;
+
+        // cf. ::load_tiered
+        std::shared_ptr<warthog::cpd::row_cache> tiered_;
 };
 
 typedef warthog::cpd::graph_oracle_base<FORWARD> graph_oracle;
@@ -398,33 +1872,15 @@ void
 compute_row(uint32_t source_id, warthog::cpd::graph_oracle* cpd,
             warthog::search* dijk, std::vector<warthog::cpd::fm_coll> &s_row);
 
-typedef std::function<bool(uint32_t&)> t_find_fn;
-
-inline uint32_t
-binary_find_row(uint32_t target_index,
-                std::vector<warthog::cpd::rle_run32>& row)
-{
-    uint32_t end = (uint32_t)row.size();
-    t_find_fn find_target = [&target_index, &row](uint32_t mid)
-    {
-        return target_index < row.at(mid).get_index();
-    };
-
-    return util::binary_find_first<uint32_t, t_find_fn>(0, end, find_target);
-}
-
 template<>
 inline uint32_t
 graph_oracle_base<warthog::cpd::FORWARD>::get_move(
     warthog::sn_id_t source_id, warthog::sn_id_t target_id)
 {
-    if(fm_.at(source_id).size() == 0) { return warthog::cpd::CPD_FM_NONE; }
-
-    std::vector<warthog::cpd::rle_run32>& row = fm_.at(source_id);
-    uint32_t target_index = order_.at(target_id);
-    uint32_t begin = binary_find_row(target_index, row);
+    warthog::cpd::rle_row row = row_at(source_id);
+    if(row.size() == 0) { return warthog::cpd::CPD_FM_NONE; }
 
-    return row.at(begin).get_move();
+    return get_run_move(row, get_col(target_id));
 }
 
 // In a reverse CPD we get the row with the target's id, and then try to find
@@ -434,13 +1890,10 @@ inline uint32_t
 graph_oracle_base<warthog::cpd::REVERSE>::get_move(
     warthog::sn_id_t source_id, warthog::sn_id_t target_id)
 {
-    std::vector<warthog::cpd::rle_run32>& row = get_row(target_id);
+    warthog::cpd::rle_row row = row_of(target_id);
     if(row.size() == 0) { return warthog::cpd::CPD_FM_NONE; }
 
-    uint32_t target_index = order_.at(source_id);
-    uint32_t begin = binary_find_row(target_index, row);
-
-    return row.at(begin).get_move();
+    return get_run_move(row, get_col(source_id));
 }
 
 template<>
@@ -449,81 +1902,56 @@ graph_oracle_base<warthog::cpd::BEARING>::get_move(
     warthog::sn_id_t source_id, warthog::sn_id_t target_id)
 {
 
-    if(fm_.at(target_id).size() == 0) { return warthog::cpd::CPD_FM_NONE; }
-
-    std::vector<warthog::cpd::rle_run32>& row = fm_.at(target_id);
-    uint32_t target_index = order_.at(source_id);
-    uint32_t begin = binary_find_row(target_index, row);
-    uint8_t fm = row.at(begin).get_move();
-
-    // Check if we have a counter-/clock-wise wildcard
-    if(fm < 2)
-    {
-        // safeguard
-        fm = warthog::cpd::CPD_FM_NONE;
-
-        int32_t xa, ya, xb, yb, xt, yt, xs, ys;
-        warthog::graph::node* node = g_->get_node(source_id);
-        warthog::graph::edge_iter from = node->outgoing_begin();
-        g_->get_xy(target_id, xt, yt);
-        g_->get_xy(source_id, xs, ys);
+    warthog::cpd::rle_row row = row_at(target_id);
+    if(row.size() == 0) { return warthog::cpd::CPD_FM_NONE; }
 
-        for(warthog::graph::ECAP_T edge_id = 0;
-            edge_id < node->out_degree();
-            edge_id++)
-        {
-            warthog::graph::edge_iter to = from + 1;
+    return bearing_move(
+        get_run_move(row, get_col(source_id)), source_id, target_id);
+}
 
-            // Wrap around
-            if (to == node->outgoing_end())
-            {
-                to = node->outgoing_begin();
-            }
+// A forward bearing CPD has the rows of a forward CPD, with the symbols of a
+// BEARING one.
+template<>
+inline uint32_t
+graph_oracle_base<warthog::cpd::FWD_BEARING>::get_move(
+    warthog::sn_id_t source_id, warthog::sn_id_t target_id)
+{
+    warthog::cpd::rle_row row = row_at(source_id);
+    if(row.size() == 0) { return warthog::cpd::CPD_FM_NONE; }
 
-            g_->get_xy(from->node_id_, xa, ya);
-            g_->get_xy(to->node_id_, xb, yb);
+    return bearing_move(
+        get_run_move(row, get_col(target_id)), source_id, target_id);
+}
 
-            if(warthog::geo::between_xy(xs, ys, xa, ya, xt, yt, xb, yb))
-            {
-                if(fm == warthog::cpd::CW)
-                {
-                    fm = edge_id + 1;
+// A row of a hybrid CPD is a table after a CPD_TABLE_ROW tag, or else runs.
+// The tag is checked on the first word, which is loaded in either case.
+inline uint32_t
+get_hybrid_move(warthog::cpd::rle_row row, uint32_t index)
+{
+    if(row.size() == 0) { return warthog::cpd::CPD_FM_NONE; }
 
-                    if(fm >= node->out_degree())
-                    {
-                        fm = 0;
-                    }
-                }
-                else // if(fm == warthog::cpd::CCW)
-                {
-                    fm = edge_id;
-                }
-                break;
-            }
-            from = to;
-        }
-        assert(fm != warthog::cpd::CPD_FM_NONE);
-    }
-    else
+    if(row.at(0).data_ == warthog::cpd::CPD_TABLE_ROW)
     {
-            fm -= 2;
+        return table_field(row.at(1 + index / 8).data_, (index % 8) * 4, 4);
     }
 
-    return fm;
+    return row.at(find_run(row, index)).get_move();
 }
 
-// Finding a first move is a lookup, a mask and a shift
+template<>
 inline uint32_t
-get_table_move(std::vector<warthog::cpd::rle_run32>& row, uint32_t index)
+warthog::cpd::graph_oracle_base<warthog::cpd::HYBRID>::get_move(
+    warthog::sn_id_t source_id, warthog::sn_id_t target_id)
 {
-    if(row.size() == 0) { return warthog::cpd::CPD_FM_NONE; }
-
-    uint32_t entry = index / 8; // Which 32bit int contains the information
-    uint8_t shift = (index % 8) * 4; // Where in the 32bit int is the fm
-    uint32_t mask = 0xF << shift;
+    return get_hybrid_move(row_of(source_id), get_col(target_id));
+}
 
-    // TODO look into `bextr`
-    return (row.at(entry).data_ & mask) >> shift;
+template<>
+inline uint32_t
+warthog::cpd::graph_oracle_base<warthog::cpd::REV_HYBRID>::get_move(
+    warthog::sn_id_t source_id, warthog::sn_id_t target_id)
+{
+    return get_hybrid_move(row_of(target_id), get_col(source_id));
 }
 
 template<>
@@ -531,7 +1959,8 @@ inline uint32_t
 warthog::cpd::graph_oracle_base<warthog::cpd::REV_TABLE>::get_move(
     warthog::sn_id_t source_id, warthog::sn_id_t target_id)
 {
-    return get_table_move(get_row(target_id), order_.at(source_id));
+    warthog::cpd::rle_row row = row_of(target_id);
+    return get_table_move(row, get_col(source_id), table_bits(row.size()));
 }
 
 template<>
@@ -539,7 +1968,8 @@ inline uint32_t
 warthog::cpd::graph_oracle_base<warthog::cpd::TABLE>::get_move(
     warthog::sn_id_t source_id, warthog::sn_id_t target_id)
 {
-    return get_table_move(get_row(source_id), order_.at(target_id));
+    warthog::cpd::rle_row row = row_of(source_id);
+    return get_table_move(row, get_col(target_id), table_bits(row.size()));
 }
 
 // For some reason, this needs to be defined in the .cpp. But we cannot do the
@@ -549,13 +1979,33 @@ warthog::cpd::graph_oracle_base<warthog::cpd::TABLE>::get_move(
 //      always use the default.
 template<>
 void
-warthog::cpd::graph_oracle_base<warthog::cpd::TABLE>::add_row(
-    uint32_t target_id, std::vector<warthog::cpd::fm_coll>& row);
+warthog::cpd::graph_oracle_base<warthog::cpd::TABLE>::compress_row(
+    uint32_t source_id, std::vector<warthog::cpd::fm_coll>& row,
+    std::vector<warthog::cpd::rle_run32>& runs) const;
+
+template<>
+void
+warthog::cpd::graph_oracle_base<warthog::cpd::REV_TABLE>::compress_row(
+    uint32_t target_id, std::vector<warthog::cpd::fm_coll>& row,
+    std::vector<warthog::cpd::rle_run32>& runs) const;
+
+template<>
+void
+warthog::cpd::graph_oracle_base<warthog::cpd::FWD_BEARING>::compress_row(
+    uint32_t source_id, std::vector<warthog::cpd::fm_coll>& row,
+    std::vector<warthog::cpd::rle_run32>& runs) const;
+
+template<>
+void
+warthog::cpd::graph_oracle_base<warthog::cpd::HYBRID>::compress_row(
+    uint32_t source_id, std::vector<warthog::cpd::fm_coll>& row,
+    std::vector<warthog::cpd::rle_run32>& runs) const;
 
 template<>
 void
-warthog::cpd::graph_oracle_base<warthog::cpd::REV_TABLE>::add_row(
-    uint32_t target_id, std::vector<warthog::cpd::fm_coll>& row);
+warthog::cpd::graph_oracle_base<warthog::cpd::REV_HYBRID>::compress_row(
+    uint32_t target_id, std::vector<warthog::cpd::fm_coll>& row,
+    std::vector<warthog::cpd::rle_run32>& runs) const;
 }
 
 }
@@ -0,0 +1,167 @@
+#include "grid_first_move_dijkstra.h"
+
+#include <algorithm>
+
+warthog::cpd::grid_first_move_dijkstra::grid_first_move_dijkstra(
+        const warthog::cpd::first_move_graph* g, uint32_t lanes)
+    : g_(g), lanes_(lanes), overflow_(false), fallback_(g)
+{
+    assert(supports(g));
+    assert(lanes > 0 && lanes <= MAX_LANES);
+    min_wt_ = (int32_t)g->get_min_weight();
+    max_wt_ = (int32_t)g->get_max_weight();
+
+    dist_.resize((size_t)g->get_num_nodes() * lanes_);
+    fm_.resize((size_t)g->get_num_nodes() * lanes_);
+    key_.resize(g->get_num_nodes());
+}
+
+bool
+warthog::cpd::grid_first_move_dijkstra::supports(
+        const warthog::cpd::first_move_graph* g)
+{
+    // leave room for a few thousand moves under INF
+    return g->is_grid() && g->get_max_weight() < (double)(1 << 18);
+}
+
+void
+warthog::cpd::grid_first_move_dijkstra::push(uint32_t node_id, int32_t key)
+{
+    if(key >= key_[node_id]) { return; }
+
+    // the node is already in the bucket of its new key
+    bool queued = key_[node_id] != INF &&
+        key_[node_id] / min_wt_ == key / min_wt_;
+    key_[node_id] = key;
+    if(queued) { return; }
+
+    uint32_t b = key / min_wt_;
+    if(b >= buckets_.size()) { buckets_.resize(b + 1); }
+    buckets_[b].push_back(node_id);
+}
+
+void
+warthog::cpd::grid_first_move_dijkstra::compute_rows(
+        const uint32_t* sources, uint32_t count,
+        std::vector<std::vector<warthog::cpd::fm_coll>>& rows)
+{
+    assert(count <= lanes_ && rows.size() >= count);
+    overflow_ = overflow_ || !search(sources, count);
+
+    if(overflow_)
+    {
+        for(uint32_t l = 0; l < count; l++)
+        {
+            fallback_.compute_row(sources[l], rows.at(l));
+        }
+        return;
+    }
+
+    // one row per lane
+    uint32_t num_nodes = g_->get_num_nodes();
+    for(uint32_t l = 0; l < count; l++)
+    {
+        std::vector<warthog::cpd::fm_coll>& row = rows.at(l);
+        assert(row.size() == num_nodes);
+        for(uint32_t n = 0; n < num_nodes; n++)
+        {
+            uint32_t moves = fm_[(size_t)n * lanes_ + l];
+            row[n] = moves ? (warthog::cpd::fm_coll)moves :
+                warthog::cpd::CPD_FM_NONE;
+        }
+    }
+}
+
+bool
+warthog::cpd::grid_first_move_dijkstra::search(
+        const uint32_t* sources, uint32_t count)
+{
+    const uint32_t* first = g_->first_.data();
+    const warthog::cpd::first_move_graph::arc* arcs = g_->arcs_.data();
+    int32_t* dist = dist_.data();
+    uint32_t* fm = fm_.data();
+    bool reverse = g_->is_reverse();
+    uint32_t stride = lanes_;
+
+    // unused lanes have no source and stay put
+    std::fill(dist_.begin(), dist_.end(), INF);
+    std::fill(fm_.begin(), fm_.end(), 0);
+    std::fill(key_.begin(), key_.end(), INF);
+    for(std::vector<uint32_t>& b : buckets_) { b.clear(); }
+
+    for(uint32_t l = 0; l < count; l++)
+    {
+        dist[(size_t)sources[l] * stride + l] = 0;
+        push(sources[l], 0);
+    }
+
+    for(uint32_t cur = 0; cur < buckets_.size(); cur++)
+    {
+        // pushes go to later buckets, which may grow the array
+        for(size_t e = 0; e < buckets_[cur].size(); e++)
+        {
+            uint32_t from = buckets_[cur][e];
+            if(key_[from] == INF || (uint32_t)(key_[from] / min_wt_) != cur)
+            { continue; } // stale
+            key_[from] = INF;
+
+            const int32_t* d_from = dist + (size_t)from * stride;
+            const uint32_t* fm_from = fm + (size_t)from * stride;
+
+            for(uint32_t i = first[from]; i < first[from + 1]; i++)
+            {
+                const warthog::cpd::first_move_graph::arc& a = arcs[i];
+                int32_t wt = (int32_t)a.wt_;
+                uint32_t arc_fm = a.fm_;
+                int32_t* d_head = dist + (size_t)a.head_ * stride;
+                uint32_t* fm_head = fm + (size_t)a.head_ * stride;
+                int32_t key = INF;
+
+                // same rules as first_move_dijkstra, without branches. a
+                // source has no first move, so its successors take the
+                // move of the arc.
+                for(uint32_t l = 0; l < stride; l++)
+                {
+                    int32_t alt_g = d_from[l] + wt;
+                    int32_t g_val = d_head[l];
+                    uint32_t move = reverse ? arc_fm :
+                        (fm_from[l] ? fm_from[l] : arc_fm);
+
+                    uint32_t lt = -(uint32_t)(alt_g < g_val);
+                    uint32_t eq = -(uint32_t)(alt_g == g_val);
+                    uint32_t fm_val = fm_head[l];
+                    uint32_t new_fm =
+                        (lt & move) | (~lt & (fm_val | (eq & move)));
+                    int32_t new_g = alt_g < g_val ? alt_g : g_val;
+
+                    bool changed = lt | (new_fm ^ fm_val);
+                    key = std::min(key, changed ? new_g : INF);
+                    d_head[l] = new_g;
+                    fm_head[l] = new_fm;
+                }
+
+                if(key != INF) { push(a.head_, key); }
+            }
+        }
+    }
+
+    // a cost close to INF may stand for a path which costs more
+    for(size_t i = 0; i < dist_.size(); i++)
+    {
+        if(dist[i] != INF && dist[i] >= INF - max_wt_) { return false; }
+    }
+    return true;
+}
+
+size_t
+warthog::cpd::grid_first_move_dijkstra::mem()
+{
+    size_t bytes = sizeof(*this) + dist_.capacity() * sizeof(int32_t) +
+        fm_.capacity() * sizeof(uint32_t) + key_.capacity() * sizeof(int32_t) +
+        fallback_.mem();
+    for(std::vector<uint32_t>& b : buckets_)
+    {
+        bytes += b.capacity() * sizeof(uint32_t);
+    }
+    return bytes;
+}
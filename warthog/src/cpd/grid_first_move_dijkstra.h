@@ -0,0 +1,100 @@
+#ifndef WARTHOG_CPD_GRID_FIRST_MOVE_DIJKSTRA_H
+#define WARTHOG_CPD_GRID_FIRST_MOVE_DIJKSTRA_H
+
+// cpd/grid_first_move_dijkstra.h
+//
+// Computes the CPD rows of a batch of up to 64 sources in one search, for
+// graphs with the edge costs of a grid map (cf. first_move_graph::is_grid).
+//
+// Each source is a lane: a node keeps a cost and a set of first moves per
+// lane, side by side, and an expansion relaxes every lane of an arc at once
+// in a loop which the compiler vectorises. Nodes are queued when any of
+// their lanes changes, in buckets of the smallest edge cost (as in Dial's
+// algorithm) by the smallest cost which changed. Lanes which are further
+// ahead may be relaxed before their cost is final, and their node is then
+// expanded again, so this is a label-correcting search; but the sources of
+// a batch are close together (consecutive ids of a grid map), their search
+// fronts move together and a node is expanded a few times per batch rather
+// than once per source.
+//
+// Costs are exact integers and the search stops at a fixed point, so rows
+// are the same as first_move_dijkstra's. Costs are kept on 32 bits: once a
+// batch has a path which costs too much for that, rows are computed by
+// first_move_dijkstra instead, one source at a time.
+//
+// @created: 2026-10-16
+//
+
+#include "first_move_dijkstra.h"
+
+#include <vector>
+
+namespace warthog
+{
+
+namespace cpd
+{
+
+class grid_first_move_dijkstra
+{
+    public:
+        static constexpr uint32_t MAX_LANES = 64;
+
+        // @param g: a graph for which supports() holds
+        // @param lanes: the number of sources of each batch
+        grid_first_move_dijkstra(
+                const warthog::cpd::first_move_graph* g, uint32_t lanes);
+
+        // true if the graph has the edge costs of a grid map
+        static bool
+        supports(const warthog::cpd::first_move_graph* g);
+
+        inline uint32_t
+        get_lanes() const { return lanes_; }
+
+        // fill @param rows[i] with the optimal first moves from (or, for a
+        // reverse graph, towards) @param sources[i] to every node, for
+        // each of the @param count <= get_lanes() sources.
+        void
+        compute_rows(const uint32_t* sources, uint32_t count,
+                     std::vector<std::vector<warthog::cpd::fm_coll>>& rows);
+
+        // true if the costs overflowed and first_move_dijkstra took over
+        inline bool
+        has_overflowed() const { return overflow_; }
+
+        size_t
+        mem();
+
+    private:
+        static constexpr int32_t INF = 1 << 30;
+
+        const warthog::cpd::first_move_graph* g_;
+        uint32_t lanes_;
+        int32_t min_wt_;
+        int32_t max_wt_;
+        bool overflow_;
+        warthog::cpd::first_move_dijkstra fallback_;
+
+        // per node and lane. first moves are on 32 bits, as the costs, so
+        // that both are relaxed by the same vector instructions.
+        std::vector<int32_t> dist_;
+        std::vector<uint32_t> fm_;
+        // per node, the smallest cost which changed since it was expanded
+        std::vector<int32_t> key_;
+        // by cost / min_wt_; nodes whose key has since dropped are skipped
+        std::vector<std::vector<uint32_t>> buckets_;
+
+        inline void
+        push(uint32_t node_id, int32_t key);
+
+        // @return false if some path cost does not fit in 32 bits
+        bool
+        search(const uint32_t* sources, uint32_t count);
+};
+
+}
+
+}
+
+#endif
@@ -0,0 +1,336 @@
+#include "hub_labels.h"
+
+#include <algorithm>
+#include <functional>
+#include <numeric>
+#include <queue>
+#include <random>
+
+namespace
+{
+
+typedef std::pair<warthog::cost_t, uint32_t> queue_entry;
+typedef std::priority_queue<queue_entry, std::vector<queue_entry>,
+                            std::greater<queue_entry>> min_queue;
+
+// the arcs of a graph, or of its reverse, in CSR form
+struct adjacency
+{
+    std::vector<uint32_t> begin_;
+    std::vector<uint32_t> heads_;
+    std::vector<warthog::cost_t> wts_;
+};
+
+// a label while it is built
+struct build_label
+{
+    std::vector<uint32_t> hubs_;
+    std::vector<warthog::cost_t> costs_;
+};
+
+// from the outgoing edges only, so that the graph needs no incoming ones
+adjacency
+make_adjacency(warthog::graph::xy_graph* g, bool reverse)
+{
+    uint32_t num_nodes = g->get_num_nodes();
+    adjacency adj;
+    adj.begin_.assign(num_nodes + 1, 0);
+
+    for(uint32_t id = 0; id < num_nodes; id++)
+    {
+        warthog::graph::node* n = g->get_node(id);
+        for(auto e = n->outgoing_begin(); e != n->outgoing_end(); e++)
+        {
+            adj.begin_.at((reverse ? e->node_id_ : id) + 1)++;
+        }
+    }
+    std::partial_sum(adj.begin_.begin(), adj.begin_.end(),
+                     adj.begin_.begin());
+
+    std::vector<uint32_t> next(adj.begin_.begin(), adj.begin_.end() - 1);
+    adj.heads_.resize(adj.begin_.back());
+    adj.wts_.resize(adj.begin_.back());
+    for(uint32_t id = 0; id < num_nodes; id++)
+    {
+        warthog::graph::node* n = g->get_node(id);
+        for(auto e = n->outgoing_begin(); e != n->outgoing_end(); e++)
+        {
+            uint32_t tail = reverse ? (uint32_t)e->node_id_ : id;
+            uint32_t head = reverse ? id : (uint32_t)e->node_id_;
+            uint32_t pos = next.at(tail)++;
+            adj.heads_.at(pos) = head;
+            adj.wts_.at(pos) = e->wt_;
+        }
+    }
+    return adj;
+}
+
+// the nodes, most important first: by the number of nodes below them in
+// shortest-path trees from @param num_samples random roots, then by degree
+std::vector<uint32_t>
+rank_nodes(const adjacency& fwd, const adjacency& bwd, uint32_t num_samples,
+           uint32_t seed)
+{
+    uint32_t num_nodes = fwd.begin_.size() - 1;
+    std::vector<uint64_t> score(num_nodes, 0);
+    std::vector<warthog::cost_t> dist(num_nodes);
+    std::vector<uint32_t> parent(num_nodes);
+    std::vector<uint64_t> below(num_nodes);
+    std::vector<uint32_t> settled;
+    std::mt19937 rng(seed);
+
+    for(uint32_t s = 0; s < num_samples && num_nodes > 0; s++)
+    {
+        uint32_t root = rng() % num_nodes;
+        std::fill(dist.begin(), dist.end(), warthog::COST_MAX);
+        settled.clear();
+
+        min_queue queue;
+        dist.at(root) = 0;
+        parent.at(root) = root;
+        queue.push({0, root});
+        while(!queue.empty())
+        {
+            queue_entry top = queue.top();
+            queue.pop();
+            if(top.first > dist.at(top.second)) { continue; }
+
+            uint32_t u = top.second;
+            settled.push_back(u);
+            below.at(u) = 1;
+            for(uint32_t a = fwd.begin_.at(u); a < fwd.begin_.at(u + 1); a++)
+            {
+                warthog::cost_t d = top.first + fwd.wts_.at(a);
+                uint32_t v = fwd.heads_.at(a);
+                if(d < dist.at(v))
+                {
+                    dist.at(v) = d;
+                    parent.at(v) = u;
+                    queue.push({d, v});
+                }
+            }
+        }
+
+        // nodes are settled after their parent
+        for(auto it = settled.rbegin(); it != settled.rend(); it++)
+        {
+            score.at(*it) += below.at(*it);
+            if(*it != root) { below.at(parent.at(*it)) += below.at(*it); }
+        }
+    }
+
+    auto degree = [&](uint32_t id)
+    {
+        return fwd.begin_.at(id + 1) - fwd.begin_.at(id) +
+            bwd.begin_.at(id + 1) - bwd.begin_.at(id);
+    };
+
+    std::vector<uint32_t> order(num_nodes);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+        [&](uint32_t a, uint32_t b)
+        {
+            if(score.at(a) != score.at(b)) { return score.at(a) > score.at(b); }
+            return degree(a) > degree(b);
+        });
+    return order;
+}
+
+// A search from @param root, the node of rank @param rank, along @param adj.
+// A node is labelled with its cost unless the labels built so far, the
+// label of the root @param root_label on one side and @param labels on the
+// other, already give a path which costs no more; its arcs are then pruned.
+void
+pruned_search(const adjacency& adj, uint32_t root, uint32_t rank,
+              const build_label& root_label, std::vector<build_label>& labels,
+              std::vector<warthog::cost_t>& dist,
+              std::vector<warthog::cost_t>& root_costs)
+{
+    for(size_t i = 0; i < root_label.hubs_.size(); i++)
+    {
+        root_costs.at(root_label.hubs_.at(i)) = root_label.costs_.at(i);
+    }
+
+    std::vector<uint32_t> touched;
+    min_queue queue;
+    dist.at(root) = 0;
+    touched.push_back(root);
+    queue.push({0, root});
+
+    while(!queue.empty())
+    {
+        queue_entry top = queue.top();
+        queue.pop();
+        uint32_t u = top.second;
+        if(top.first > dist.at(u)) { continue; }
+
+        build_label& label = labels.at(u);
+        bool covered = false;
+        for(size_t i = 0; i < label.hubs_.size() && !covered; i++)
+        {
+            warthog::cost_t c = root_costs.at(label.hubs_.at(i));
+            covered = c != warthog::COST_MAX &&
+                c + label.costs_.at(i) <= top.first;
+        }
+        if(covered) { continue; }
+
+        label.hubs_.push_back(rank);
+        label.costs_.push_back(top.first);
+
+        for(uint32_t a = adj.begin_.at(u); a < adj.begin_.at(u + 1); a++)
+        {
+            warthog::cost_t d = top.first + adj.wts_.at(a);
+            uint32_t v = adj.heads_.at(a);
+            if(d < dist.at(v))
+            {
+                if(dist.at(v) == warthog::COST_MAX) { touched.push_back(v); }
+                dist.at(v) = d;
+                queue.push({d, v});
+            }
+        }
+    }
+
+    for(uint32_t id : touched) { dist.at(id) = warthog::COST_MAX; }
+    for(uint32_t hub : root_label.hubs_)
+    {
+        root_costs.at(hub) = warthog::COST_MAX;
+    }
+}
+
+template<typename T>
+void
+write_vector(std::ostream& out, const std::vector<T>& v)
+{
+    out.write((const char*)v.data(), sizeof(T) * v.size());
+}
+
+template<typename T>
+void
+read_vector(std::istream& in, std::vector<T>& v, uint64_t size)
+{
+    v.resize(size);
+    in.read((char*)v.data(), sizeof(T) * size);
+}
+
+}
+
+void
+warthog::cpd::hub_labels::build(
+        warthog::graph::xy_graph* g, uint32_t num_samples, uint32_t seed)
+{
+    num_nodes_ = g->get_num_nodes();
+    adjacency fwd = make_adjacency(g, false);
+    adjacency bwd = make_adjacency(g, true);
+    std::vector<uint32_t> order = rank_nodes(fwd, bwd, num_samples, seed);
+
+    std::vector<build_label> fwd_labels(num_nodes_);
+    std::vector<build_label> bwd_labels(num_nodes_);
+    std::vector<warthog::cost_t> dist(num_nodes_, warthog::COST_MAX);
+    std::vector<warthog::cost_t> root_costs(num_nodes_, warthog::COST_MAX);
+
+    for(uint32_t rank = 0; rank < num_nodes_; rank++)
+    {
+        uint32_t root = order.at(rank);
+        // costs from the root, then to it
+        pruned_search(fwd, root, rank, fwd_labels.at(root), bwd_labels,
+                      dist, root_costs);
+        pruned_search(bwd, root, rank, bwd_labels.at(root), fwd_labels,
+                      dist, root_costs);
+    }
+
+    // labels are sorted by rank, the order in which hubs were added
+    for(auto set : {std::make_pair(&fwd_, &fwd_labels),
+                    std::make_pair(&bwd_, &bwd_labels)})
+    {
+        label_set& flat = *set.first;
+        flat.offsets_.assign(1, 0);
+        flat.hubs_.clear();
+        flat.costs_.clear();
+        for(build_label& label : *set.second)
+        {
+            flat.hubs_.insert(
+                flat.hubs_.end(), label.hubs_.begin(), label.hubs_.end());
+            flat.costs_.insert(
+                flat.costs_.end(), label.costs_.begin(), label.costs_.end());
+            flat.offsets_.push_back(flat.hubs_.size());
+            build_label().hubs_.swap(label.hubs_);
+            build_label().costs_.swap(label.costs_);
+        }
+    }
+}
+
+size_t
+warthog::cpd::hub_labels::mem() const
+{
+    size_t retval = sizeof(*this);
+    for(const label_set* set : {&fwd_, &bwd_})
+    {
+        retval += sizeof(uint64_t) * set->offsets_.capacity() +
+            sizeof(uint32_t) * set->hubs_.capacity() +
+            sizeof(warthog::cost_t) * set->costs_.capacity();
+    }
+    return retval;
+}
+
+void
+warthog::cpd::hub_labels::write(std::ostream& out) const
+{
+    uint32_t header[4] =
+        {HUB_LABELS_MAGIC, HUB_LABELS_VERSION, num_nodes_, 0};
+    uint64_t sizes[2] = {fwd_.hubs_.size(), bwd_.hubs_.size()};
+    out.write((const char*)header, sizeof(header));
+    out.write((const char*)sizes, sizeof(sizes));
+
+    for(const label_set* set : {&fwd_, &bwd_})
+    {
+        write_vector(out, set->offsets_);
+        write_vector(out, set->hubs_);
+        write_vector(out, set->costs_);
+    }
+}
+
+bool
+warthog::cpd::hub_labels::read(std::istream& in)
+{
+    uint32_t header[4] = {0, 0, 0, 0};
+    uint64_t sizes[2] = {0, 0};
+    in.read((char*)header, sizeof(header));
+    in.read((char*)sizes, sizeof(sizes));
+
+    if(!in.good() || header[0] != HUB_LABELS_MAGIC)
+    {
+        std::cerr << "err; not a hub labels file\n";
+        return false;
+    }
+    if(header[1] != HUB_LABELS_VERSION)
+    {
+        std::cerr << "err; unsupported hub labels version " << header[1]
+                  << "\n";
+        return false;
+    }
+
+    num_nodes_ = header[2];
+    label_set* sets[2] = {&fwd_, &bwd_};
+    for(uint32_t s = 0; s < 2; s++)
+    {
+        read_vector(in, sets[s]->offsets_, (uint64_t)num_nodes_ + 1);
+        read_vector(in, sets[s]->hubs_, sizes[s]);
+        read_vector(in, sets[s]->costs_, sizes[s]);
+
+        bool valid = in.good() && sets[s]->offsets_.front() == 0 &&
+            sets[s]->offsets_.back() == sizes[s] &&
+            std::is_sorted(sets[s]->offsets_.begin(),
+                           sets[s]->offsets_.end());
+        for(uint64_t i = 0; valid && i < sizes[s]; i++)
+        {
+            valid = sets[s]->hubs_.at(i) < num_nodes_;
+        }
+        if(!valid)
+        {
+            std::cerr << "err; corrupt or truncated hub labels file\n";
+            num_nodes_ = 0;
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,123 @@
+#ifndef WARTHOG_CPD_HUB_LABELS_H
+#define WARTHOG_CPD_HUB_LABELS_H
+
+// cpd/hub_labels.h
+//
+// A distance layer for CPDs: exact path costs without walking the path, for
+// queries which only need the cost (e.g., arrival times).
+//
+// Each node has a forward label, the costs from the node to some hubs, and a
+// backward label, the costs from some hubs to the node, such that a shortest
+// path from s to t passes through a hub of both the forward label of s and
+// the backward label of t (2-hop cover). The cost from s to t is then the
+// least sum over their common hubs, found by merging two short sorted lists.
+//
+// Labels are built with pruned Dijkstra searches (pruned landmark labelling,
+// Akiba et al. 2013), from each node in turn, most important first: a search
+// stops at nodes whose cost the labels built so far already give. Nodes are
+// ranked by the number of shortest paths they lie on, in a sample of
+// shortest-path trees, which keeps labels small on road networks.
+//
+// The costs are those of the graph when the labels are built; first moves
+// still come from the CPD.
+//
+// @created: 2026-10-16
+//
+
+#include "constants.h"
+#include "xy_graph.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <vector>
+
+namespace warthog
+{
+
+namespace cpd
+{
+
+static const uint32_t HUB_LABELS_MAGIC = 0x424c4857; // "WHLB"
+static const uint32_t HUB_LABELS_VERSION = 1;
+
+class hub_labels
+{
+    public:
+        hub_labels() : num_nodes_(0) { }
+
+        // label the nodes of @param g, ranked with shortest-path trees from
+        // @param num_samples random nodes
+        void
+        build(warthog::graph::xy_graph* g, uint32_t num_samples = 32,
+              uint32_t seed = 0);
+
+        // the cost of a shortest path from @param source_id to
+        // @param target_id, or warthog::COST_MAX if there is none
+        inline warthog::cost_t
+        get_cost(warthog::sn_id_t source_id, warthog::sn_id_t target_id) const
+        {
+            assert(source_id < num_nodes_ && target_id < num_nodes_);
+            uint64_t i = fwd_.offsets_[source_id];
+            uint64_t i_end = fwd_.offsets_[source_id + 1];
+            uint64_t j = bwd_.offsets_[target_id];
+            uint64_t j_end = bwd_.offsets_[target_id + 1];
+            warthog::cost_t cost = warthog::COST_MAX;
+
+            while(i < i_end && j < j_end)
+            {
+                uint32_t a = fwd_.hubs_[i];
+                uint32_t b = bwd_.hubs_[j];
+                if(a == b)
+                {
+                    cost = std::min(cost, fwd_.costs_[i] + bwd_.costs_[j]);
+                    i++;
+                    j++;
+                }
+                else if(a < b) { i++; }
+                else { j++; }
+            }
+            return cost;
+        }
+
+        inline uint32_t
+        get_num_nodes() const
+        { return num_nodes_; }
+
+        // the hubs of all labels
+        inline uint64_t
+        get_num_entries() const
+        { return fwd_.hubs_.size() + bwd_.hubs_.size(); }
+
+        size_t
+        mem() const;
+
+        // binary format: a header, then the forward and the backward labels
+        // as row offsets, hubs and costs.
+        void
+        write(std::ostream& out) const;
+
+        // @return false if @param in is not a valid labels file
+        bool
+        read(std::istream& in);
+
+    private:
+        // labels in CSR form: the hubs of node n (by rank) and their costs
+        // span [offsets_[n], offsets_[n+1])
+        struct label_set
+        {
+            std::vector<uint64_t> offsets_;
+            std::vector<uint32_t> hubs_;
+            std::vector<warthog::cost_t> costs_;
+        };
+
+        uint32_t num_nodes_;
+        label_set fwd_;
+        label_set bwd_;
+};
+
+}
+
+}
+
+#endif
@@ -0,0 +1,123 @@
+#include "lazy_rows.h"
+
+#include <cstring>
+
+warthog::cpd::lazy_rows::lazy_rows(
+        warthog::graph::xy_graph* g, bool reverse, compress_fn compress)
+    : graph_(g, reverse), compress_(compress), done_(0), words_(0),
+      next_(0), stop_(false)
+{
+    uint32_t num_rows = graph_.get_num_nodes();
+    rows_.reset(new std::atomic<const warthog::cpd::rle_run32*>[num_rows]);
+    for(uint32_t i = 0; i < num_rows; i++)
+    {
+        rows_[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+warthog::cpd::lazy_rows::~lazy_rows()
+{
+    stop_ = true;
+    for(std::thread& t : fillers_)
+    {
+        if(t.joinable()) { t.join(); }
+    }
+
+    for(uint32_t i = 0; i < get_num_rows(); i++)
+    {
+        delete[] rows_[i].load();
+    }
+}
+
+const warthog::cpd::rle_run32*
+warthog::cpd::lazy_rows::compute(uint32_t source_id)
+{
+    std::unique_ptr<worker> w;
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex_);
+        if(!pool_.empty())
+        {
+            w = std::move(pool_.back());
+            pool_.pop_back();
+        }
+    }
+    if(!w) { w.reset(new worker(&graph_)); }
+
+    // the first word is left for the number of runs
+    std::vector<warthog::cpd::rle_run32> runs(1);
+    w->dijk_.compute_row(source_id, w->row_);
+    compress_(source_id, w->row_, runs);
+    runs.at(0).data_ = (uint32_t)(runs.size() - 1);
+
+    warthog::cpd::rle_run32* row = new warthog::cpd::rle_run32[runs.size()];
+    std::memcpy(row, runs.data(), sizeof(warthog::cpd::rle_run32) * runs.size());
+
+    const warthog::cpd::rle_run32* published = nullptr;
+    if(rows_[source_id].compare_exchange_strong(
+           published, row, std::memory_order_acq_rel))
+    {
+        published = row;
+        done_++;
+        words_ += runs.size();
+    }
+    else
+    {
+        // another thread was first
+        delete[] row;
+    }
+
+    std::lock_guard<std::mutex> lock(pool_mutex_);
+    pool_.push_back(std::move(w));
+    return published;
+}
+
+void
+warthog::cpd::lazy_rows::fill_rows()
+{
+    while(!stop_)
+    {
+        uint32_t source_id = next_++;
+        if(source_id >= get_num_rows()) { break; }
+
+        if(rows_[source_id].load(std::memory_order_acquire) == nullptr)
+        {
+            compute(source_id);
+        }
+    }
+}
+
+void
+warthog::cpd::lazy_rows::fill(uint32_t num_threads)
+{
+    for(uint32_t i = 0; i < num_threads; i++)
+    {
+        fillers_.emplace_back(&warthog::cpd::lazy_rows::fill_rows, this);
+    }
+}
+
+void
+warthog::cpd::lazy_rows::wait()
+{
+    if(fillers_.empty()) { fill_rows(); }
+
+    for(std::thread& t : fillers_)
+    {
+        if(t.joinable()) { t.join(); }
+    }
+}
+
+size_t
+warthog::cpd::lazy_rows::mem()
+{
+    size_t retval = sizeof(*this) + graph_.mem() +
+        sizeof(warthog::cpd::rle_run32) * words_.load() +
+        sizeof(std::atomic<const warthog::cpd::rle_run32*>) * get_num_rows();
+
+    std::lock_guard<std::mutex> lock(pool_mutex_);
+    for(auto& w : pool_)
+    {
+        retval += sizeof(worker) + w->dijk_.mem() +
+            sizeof(warthog::cpd::fm_coll) * w->row_.capacity();
+    }
+    return retval;
+}
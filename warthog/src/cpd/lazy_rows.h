@@ -0,0 +1,125 @@
+#ifndef WARTHOG_CPD_LAZY_ROWS_H
+#define WARTHOG_CPD_LAZY_ROWS_H
+
+// cpd/lazy_rows.h
+//
+// The rows of a CPD computed as they are needed rather than all in advance,
+// so that a graph can be queried as soon as it is loaded (cf.
+// graph_oracle_base::make_lazy).
+//
+// A row is computed by the first lookup which needs it, with the specialised
+// search, and then kept. Meanwhile, background threads compute the rows
+// which are still missing, until all rows are there. Rows are published
+// with an atomic pointer, so that any number of threads look them up without
+// a lock; two threads which need the same missing row may both compute it,
+// and the first to publish it wins.
+//
+// @created: 2026-10-16
+//
+
+#include "cpd.h"
+#include "first_move_dijkstra.h"
+#include "xy_graph.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace warthog
+{
+
+namespace cpd
+{
+
+class lazy_rows
+{
+    public:
+        // append the runs of the first-move table of a source to a row
+        typedef std::function<void(uint32_t source_id,
+                                   std::vector<warthog::cpd::fm_coll>& row,
+                                   std::vector<warthog::cpd::rle_run32>& runs)>
+            compress_fn;
+
+        // the rows of @param g, from (or, when @param reverse, towards) each
+        // node, compressed with @param compress. Edge costs are those of
+        // the graph at this time.
+        lazy_rows(warthog::graph::xy_graph* g, bool reverse,
+                  compress_fn compress);
+
+        // stops the background threads
+        ~lazy_rows();
+
+        lazy_rows(const lazy_rows&) = delete;
+        lazy_rows& operator=(const lazy_rows&) = delete;
+
+        // the row of @param source_id, computed now unless it is there
+        inline warthog::cpd::rle_row
+        get(uint32_t source_id)
+        {
+            const warthog::cpd::rle_run32* row =
+                rows_[source_id].load(std::memory_order_acquire);
+            if(row == nullptr) { row = compute(source_id); }
+            // the first word is the number of runs
+            return warthog::cpd::rle_row(row + 1, row[0].data_);
+        }
+
+        // compute the missing rows with @param num_threads threads in the
+        // background
+        void
+        fill(uint32_t num_threads);
+
+        // wait until all rows are there, computing them on this thread if
+        // there is no background thread
+        void
+        wait();
+
+        inline uint32_t
+        get_num_rows() const { return graph_.get_num_nodes(); }
+
+        // the rows which are there
+        inline uint32_t
+        get_num_done() const { return done_.load(); }
+
+        size_t
+        mem();
+
+    private:
+        warthog::cpd::first_move_graph graph_;
+        compress_fn compress_;
+        std::unique_ptr<std::atomic<const warthog::cpd::rle_run32*>[]> rows_;
+        std::atomic<uint32_t> done_;
+        std::atomic<uint64_t> words_;
+
+        // a search and its first-move table
+        struct worker
+        {
+            worker(const warthog::cpd::first_move_graph* g)
+                : dijk_(g), row_(g->get_num_nodes()) { }
+
+            warthog::cpd::first_move_dijkstra dijk_;
+            std::vector<warthog::cpd::fm_coll> row_;
+        };
+
+        // idle workers, which threads take and give back
+        std::mutex pool_mutex_;
+        std::vector<std::unique_ptr<worker>> pool_;
+
+        std::vector<std::thread> fillers_;
+        std::atomic<uint32_t> next_;
+        std::atomic<bool> stop_;
+
+        const warthog::cpd::rle_run32*
+        compute(uint32_t source_id);
+
+        void
+        fill_rows();
+};
+
+}
+
+}
+
+#endif
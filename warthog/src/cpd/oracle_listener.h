@@ -139,10 +139,14 @@ class reverse_oracle_listener final : public oracle_listener
     warthog::cpd::graph_oracle_base<SYM>* oracle_;
 };
 
-// helps to precompute first-move data, this one does bearing compression on
-// road networks. This may not work on classic gridmaps.
-//
-// TODO add a forward listener with orientation
+// helps to precompute first-move data of forward bearing CPDs. The rows hold
+// plain first moves, as for FORWARD: the orientation of a target depends on
+// the whole set of moves from the source, so the wildcards are only added
+// when the row is compressed (cf. graph_oracle_base::compress_row).
+typedef graph_oracle_listener<warthog::cpd::FWD_BEARING>
+    bearing_oracle_listener;
+
+// helps to precompute first-move data, this one does bearing compression.
 class reverse_bearing_oracle_listener final : public oracle_listener
 {
   public:
@@ -170,38 +174,15 @@ class reverse_bearing_oracle_listener final : public oracle_listener
         // Offset the first move symbol by two we can fit the clockwise symbols.
         warthog::cpd::fm_coll fm = 1 << ((eit - pred->outgoing_begin()) + 2);
 
-        // Circle back around on both sides
-        warthog::graph::edge_iter prev = eit - 1;
-        warthog::graph::edge_iter next = eit + 1;
-        if(eit == pred->outgoing_begin())
+        // Next, find whether it is the first edge (counter-) clockwise from
+        // the target, in which case it also gets that wildcard.
+        uint32_t cw, ccw;
+        if(oracle_->get_bearings().sector(
+                succ->get_id(), *source_id_, cw, ccw))
         {
-            prev = pred->outgoing_end() - 1;
-        }
-
-        if(next == pred->outgoing_end())
-        {
-            next = pred->outgoing_begin();
-        }
-
-        // Next, find whether it is (counter-) clockwise from the target
-        warthog::graph::xy_graph* g = oracle_->get_graph();
-        int32_t xf, yf, xs, ys, xt, yt, xp, yp, xn, yn;
-        g->get_xy(from->get_id(), xf, yf);
-        g->get_xy(succ->get_id(), xs, ys);
-        g->get_xy(*source_id_, xt, yt);
-        g->get_xy(prev->node_id_, xp, yp);
-        g->get_xy(next->node_id_, xn, yn);
-
-        // To add a wildcard, we need the target's bearing to lie between the
-        // first move and one of its neighbours. We record which direction to
-        // rotate from that bearing to find the first move.
-        if(warthog::geo::between_xy(xs, ys, xp, yp, xt, yt, xf, yf))
-        {
-            fm |= 1 << warthog::cpd::CW;
-        }
-        if(warthog::geo::between_xy(xs, ys, xf, yf, xt, yt, xn, yn))
-        {
-            fm |= 1 << warthog::cpd::CCW;
+            uint32_t edge_idx = eit - pred->outgoing_begin();
+            if(edge_idx == cw) { fm |= 1 << warthog::cpd::CW; }
+            if(edge_idx == ccw) { fm |= 1 << warthog::cpd::CCW; }
         }
 
         //  update first move
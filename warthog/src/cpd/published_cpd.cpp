@@ -0,0 +1,208 @@
+#include "published_cpd.h"
+#include "cpd.h"
+#include "cpd_writer.h"
+#include "graph_oracle.h"
+
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+
+// @param filename with its directory resolved, so that all processes agree
+std::string
+absolute_path(const std::string& filename)
+{
+    size_t slash = filename.find_last_of('/');
+    std::string dir = slash == std::string::npos ?
+        "." : (slash == 0 ? "/" : filename.substr(0, slash));
+    std::string base = slash == std::string::npos ?
+        filename : filename.substr(slash + 1);
+
+    char resolved[PATH_MAX];
+    if(realpath(dir.c_str(), resolved) == nullptr) { return filename; }
+    return std::string(resolved) + "/" + base;
+}
+
+// read the header of the binary CPD @param filename into @param header
+// @return false unless the file holds a complete binary CPD
+bool
+read_build(const std::string& filename, warthog::cpd::cpd_header& header)
+{
+    std::ifstream ifs(filename, std::ios_base::binary | std::ios_base::ate);
+    uint64_t file_size = ifs.good() ? (uint64_t)ifs.tellg() : 0;
+    ifs.seekg(0);
+    ifs.read((char*)&header, sizeof(header));
+
+    if(!ifs.good() || header.magic_ != warthog::cpd::CPD_FILE_MAGIC)
+    {
+        std::cerr << "err; " << filename << " is not a binary CPD file\n";
+        return false;
+    }
+    if(!warthog::cpd::check_file_version(header.version_, header.symbol_))
+    {
+        return false;
+    }
+    if(header.rows_pos_ + sizeof(uint64_t) * (header.num_rows_ + 1) >
+       file_size)
+    {
+        std::cerr << "err; " << filename << " is truncated\n";
+        return false;
+    }
+    return true;
+}
+
+}
+
+warthog::cpd::published_cpd::published_cpd(const std::string& filename)
+    : filename_(filename), header_(nullptr), opened_(false), writable_(false)
+{
+    std::string path = absolute_path(filename);
+    std::stringstream ss;
+    ss << "/warthog-cpd-" << std::hex << std::setw(16) << std::setfill('0')
+       << warthog::cpd::hash_bytes(path.data(), path.size());
+    shm_name_ = ss.str();
+}
+
+warthog::cpd::published_cpd::~published_cpd()
+{
+    if(header_ != nullptr) { munmap(header_, sizeof(published_header)); }
+}
+
+bool
+warthog::cpd::published_cpd::open(bool writable)
+{
+    if(header_ != nullptr && (writable_ || !writable)) { return true; }
+    if(header_ != nullptr)
+    {
+        munmap(header_, sizeof(published_header));
+        header_ = nullptr;
+    }
+    opened_ = true;
+    writable_ = writable;
+
+    int fd = writable ?
+        shm_open(shm_name_.c_str(), O_RDWR | O_CREAT, 0644) :
+        shm_open(shm_name_.c_str(), O_RDONLY, 0);
+    // nothing is published yet
+    if(fd < 0 && !writable && errno == ENOENT) { return true; }
+    if(fd < 0)
+    {
+        std::cerr << "err; cannot open shared memory " << shm_name_ << ": "
+                  << strerror(errno) << "\n";
+        return false;
+    }
+
+    // a new segment is filled with zeros, which is version 0; a reader may
+    // see it before the publisher sized it
+    struct stat st;
+    if(fstat(fd, &st) != 0 ||
+       (writable && (size_t)st.st_size < sizeof(published_header) &&
+        ftruncate(fd, sizeof(published_header)) != 0))
+    {
+        std::cerr << "err; cannot size shared memory " << shm_name_ << ": "
+                  << strerror(errno) << "\n";
+        ::close(fd);
+        return false;
+    }
+    if(!writable && (size_t)st.st_size < sizeof(published_header))
+    {
+        ::close(fd);
+        return true;
+    }
+
+    void* addr = mmap(nullptr, sizeof(published_header),
+                      writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                      MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(addr == MAP_FAILED)
+    {
+        std::cerr << "err; cannot map shared memory " << shm_name_ << ": "
+                  << strerror(errno) << "\n";
+        return false;
+    }
+
+    published_header* header = (published_header*)addr;
+    if(writable && header->magic_ == 0)
+    {
+        // processes which create it at once write the same values
+        header->format_ = CPD_PUBLISHED_VERSION;
+        header->magic_ = CPD_PUBLISHED_MAGIC;
+    }
+    // readers see a zero magic, and version, until the publisher writes it
+    if((header->magic_ != 0 || writable) &&
+       (header->magic_ != CPD_PUBLISHED_MAGIC ||
+        header->format_ != CPD_PUBLISHED_VERSION))
+    {
+        std::cerr << "err; shared memory " << shm_name_
+                  << " is not the version of a published CPD\n";
+        munmap(addr, sizeof(published_header));
+        return false;
+    }
+
+    header_ = header;
+    return true;
+}
+
+uint64_t
+warthog::cpd::published_cpd::get_version()
+{
+    // a reader maps the header once the publisher created it
+    if(header_ == nullptr && opened_ && !open(writable_)) { opened_ = false; }
+    if(header_ == nullptr) { return 0; }
+    return header_->version_.load(std::memory_order_acquire);
+}
+
+bool
+warthog::cpd::published_cpd::publish(const std::string& new_filename)
+{
+    warthog::cpd::cpd_header header;
+    if(!open(true) || !read_build(new_filename, header)) { return false; }
+
+    // the processes which serve the file keep their graph and partition
+    warthog::cpd::cpd_header served;
+    if(!std::ifstream(filename_).good()) { served = header; }
+    else if(!read_build(filename_, served)) { return false; }
+
+    if(header.symbol_ != served.symbol_ ||
+       header.num_nodes_ != served.num_nodes_ ||
+       header.num_rows_ != served.num_rows_)
+    {
+        std::cerr << "err; " << new_filename << " is not a build of the "
+                  << "same kind of CPD as " << filename_ << "\n";
+        return false;
+    }
+
+    if(std::rename(new_filename.c_str(), filename_.c_str()) != 0)
+    {
+        std::cerr << "err; cannot rename " << new_filename << " to "
+                  << filename_ << ": " << strerror(errno) << "\n";
+        return false;
+    }
+
+    header_->version_.fetch_add(1, std::memory_order_release);
+    return true;
+}
+
+bool
+warthog::cpd::published_cpd::unlink()
+{
+    if(header_ != nullptr)
+    {
+        munmap(header_, sizeof(published_header));
+        header_ = nullptr;
+    }
+    opened_ = false;
+    return shm_unlink(shm_name_.c_str()) == 0;
+}
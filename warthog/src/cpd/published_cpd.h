@@ -0,0 +1,98 @@
+#ifndef WARTHOG_CPD_PUBLISHED_CPD_H
+#define WARTHOG_CPD_PUBLISHED_CPD_H
+
+// cpd/published_cpd.h
+//
+// A binary CPD served by several processes at once, which a new build can
+// replace while they run (cf. make_cpd --publish and fifo --reload).
+//
+// The processes map the file (cf. graph_oracle_base::map), so they share a
+// single copy of the order array, runs and row offsets in the page cache; to
+// keep that copy in RAM, the file can sit in a tmpfs such as /dev/shm. A new
+// build is published by renaming it over the file, which is atomic: a process
+// maps either the old build or the new one, whole, and its mapping of the old
+// one stays valid until it maps the file again.
+//
+// The version of the file, the number of builds published so far, is kept in
+// a header in POSIX shared memory named after the file. The publisher bumps
+// it once the rename is done, so that a process checks for a new build with
+// a single load from memory, e.g. between jobs. Only the publisher can write
+// the header; the processes which serve the file map it read-only.
+//
+// @created: 2026-10-16
+//
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace warthog
+{
+
+namespace cpd
+{
+
+static const uint32_t CPD_PUBLISHED_MAGIC = 0x42505357; // "WSPB"
+static const uint32_t CPD_PUBLISHED_VERSION = 1;
+
+// the shared memory header of a published CPD
+struct published_header
+{
+    uint32_t magic_;
+    uint32_t format_;                   // CPD_PUBLISHED_VERSION
+    std::atomic<uint64_t> version_;     // builds published so far
+};
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "the version of a published CPD is shared between processes");
+
+class published_cpd
+{
+    public:
+        // the CPD served at @param filename; processes must name it with
+        // the same directory, up to symbolic links and relative paths
+        published_cpd(const std::string& filename);
+
+        ~published_cpd();
+
+        published_cpd(const published_cpd&) = delete;
+        published_cpd& operator=(const published_cpd&) = delete;
+
+        // map the version header, read-only unless @param writable. Only the
+        // publisher creates it, so a reader maps it once the first build is
+        // published, at ::get_version.
+        // @return false if the shared memory cannot be mapped.
+        bool
+        open(bool writable=false);
+
+        // the number of builds published, 0 until ::open
+        uint64_t
+        get_version();
+
+        // replace the file by the binary CPD @param new_filename, on the
+        // same file system, and bump the version.
+        // @return false if the new build is not a complete binary CPD, has
+        // not the symbol, nodes and rows of the file already served, or
+        // cannot be renamed; the file is then left as it was.
+        bool
+        publish(const std::string& new_filename);
+
+        // remove the version header, once the file is no longer served
+        bool
+        unlink();
+
+        inline const std::string&
+        get_shm_name() const { return shm_name_; }
+
+    private:
+        std::string filename_;
+        std::string shm_name_;
+        published_header* header_;
+        bool opened_;
+        bool writable_;
+};
+
+}
+
+}
+
+#endif
@@ -0,0 +1,292 @@
+#include "row_cache.h"
+
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+
+// a row this thread looked up, of the cache of id cache_id_ (cf.
+// row_cache::lookup)
+struct l1_row
+{
+    uint64_t cache_id_ = 0;
+    uint32_t row_id_ = 0;
+    std::shared_ptr<const std::vector<warthog::cpd::rle_run32>> row_;
+};
+
+// two rows, of which the one at lru_ is replaced first
+struct l1_set
+{
+    l1_row rows_[2];
+    uint32_t lru_ = 0;
+};
+
+thread_local l1_set l1[warthog::cpd::CPD_CACHE_L1_SETS];
+
+// ids start at 1, so that no cache has the id of an empty row
+std::atomic<uint64_t> next_cache_id(1);
+std::atomic<uint32_t> next_stripe(0);
+thread_local uint32_t stripe_id = UINT32_MAX;
+
+}
+
+warthog::cpd::row_cache::row_cache(size_t capacity)
+    : id_(next_cache_id.fetch_add(1)), fd_(-1), file_size_(0),
+      capacity_(capacity)
+{
+    std::memset(&header_, 0, sizeof(header_));
+}
+
+warthog::cpd::row_cache::~row_cache()
+{
+    if(fd_ >= 0) { ::close(fd_); }
+}
+
+bool
+warthog::cpd::row_cache::open(const std::string& filename)
+{
+    fd_ = ::open(filename.c_str(), O_RDONLY);
+    if(fd_ < 0)
+    {
+        std::cerr << "err; cannot open " << filename << ": "
+                  << strerror(errno) << "\n";
+        return false;
+    }
+
+    struct stat st;
+    if(fstat(fd_, &st) != 0 || !read(0, &header_, sizeof(header_)))
+    {
+        std::cerr << "err; cannot read the header of " << filename << "\n";
+        return false;
+    }
+    file_size_ = st.st_size;
+
+    return true;
+}
+
+bool
+warthog::cpd::row_cache::read_offsets()
+{
+    offsets_.resize((size_t)header_.num_rows_ + 1);
+    if(!read(header_.rows_pos_, offsets_.data(),
+             sizeof(uint64_t) * offsets_.size()))
+    {
+        std::cerr << "err; cannot read the row offsets\n";
+        return false;
+    }
+
+    for(uint32_t row_id = 0; row_id < header_.num_rows_; row_id++)
+    {
+        if(offsets_.at(row_id) > offsets_.at(row_id + 1))
+        {
+            std::cerr << "err; corrupt or truncated binary CPD file\n";
+            return false;
+        }
+    }
+    if(offsets_.back() > header_.num_runs_)
+    {
+        std::cerr << "err; corrupt or truncated binary CPD file\n";
+        return false;
+    }
+
+    slot_of_.assign(header_.num_rows_, UINT32_MAX);
+    return true;
+}
+
+bool
+warthog::cpd::row_cache::read(uint64_t pos, void* data, size_t size) const
+{
+    char* dest = (char*)data;
+    while(size > 0)
+    {
+        ssize_t n = pread(fd_, dest, size, pos);
+        if(n < 0 && errno == EINTR) { continue; }
+        if(n <= 0) { return false; }
+
+        dest += n;
+        pos += n;
+        size -= n;
+    }
+    return true;
+}
+
+warthog::cpd::row_cache::row_ptr
+warthog::cpd::row_cache::read_row(uint32_t row_id) const
+{
+    uint64_t begin = offsets_.at(row_id);
+    std::shared_ptr<std::vector<warthog::cpd::rle_run32>> row =
+        std::make_shared<std::vector<warthog::cpd::rle_run32>>(
+            offsets_.at(row_id + 1) - begin);
+
+    if(!read(header_.runs_pos_ + sizeof(warthog::cpd::rle_run32) * begin,
+             row->data(), sizeof(warthog::cpd::rle_run32) * row->size()))
+    {
+        std::cerr << "err; cannot read row " << row_id << " of the CPD\n";
+        row->clear();
+    }
+    return row;
+}
+
+warthog::cpd::rle_row
+warthog::cpd::row_cache::get(uint32_t row_id)
+{
+    return warthog::cpd::rle_row(*lookup(row_id));
+}
+
+std::shared_ptr<const std::vector<warthog::cpd::rle_run32>>
+warthog::cpd::row_cache::get_shared(uint32_t row_id)
+{
+    return lookup(row_id);
+}
+
+const warthog::cpd::row_cache::row_ptr&
+warthog::cpd::row_cache::lookup(uint32_t row_id)
+{
+    assert(row_id < get_num_rows());
+    l1_set& set = l1[row_id % CPD_CACHE_L1_SETS];
+
+    for(uint32_t w = 0; w < 2; w++)
+    {
+        l1_row& r = set.rows_[w];
+        if(r.cache_id_ == id_ && r.row_id_ == row_id)
+        {
+            if(stripe_id == UINT32_MAX)
+            {
+                stripe_id = next_stripe.fetch_add(1) % CPD_CACHE_STRIPES;
+            }
+            stripes_[stripe_id].hits_.fetch_add(1, std::memory_order_relaxed);
+            set.lru_ = 1 - w;
+            return r.row_;
+        }
+    }
+
+    // the row replaced is freed here unless other threads, or the shards,
+    // hold it
+    l1_row& r = set.rows_[set.lru_];
+    r.row_ = fetch(row_id);
+    r.cache_id_ = id_;
+    r.row_id_ = row_id;
+    set.lru_ = 1 - set.lru_;
+    return r.row_;
+}
+
+warthog::cpd::row_cache::row_ptr
+warthog::cpd::row_cache::fetch(uint32_t row_id)
+{
+    shard& s = shards_[row_id % CPD_CACHE_SHARDS];
+
+    {
+        std::lock_guard<std::mutex> lock(s.mutex_);
+        uint32_t index = slot_of_[row_id];
+        if(index != UINT32_MAX)
+        {
+            s.hits_++;
+            s.slots_[index].referenced_ = true;
+            return s.slots_[index].row_;
+        }
+        s.misses_++;
+    }
+
+    // other rows of the shard can be looked up during the read
+    row_ptr row = read_row(row_id);
+
+    std::lock_guard<std::mutex> lock(s.mutex_);
+    uint32_t index = slot_of_[row_id];
+    if(index != UINT32_MAX)
+    {
+        // another thread read it first
+        return s.slots_[index].row_;
+    }
+    insert(s, row_id, row);
+    return row;
+}
+
+void
+warthog::cpd::row_cache::insert(
+        shard& s, uint32_t row_id, const row_ptr& row)
+{
+    size_t bytes = row_bytes(row);
+    size_t capacity = capacity_ / CPD_CACHE_SHARDS;
+
+    while(!s.slots_.empty() && s.bytes_ + bytes > capacity)
+    {
+        slot& victim = s.slots_[s.hand_];
+        if(victim.referenced_)
+        {
+            // second chance
+            victim.referenced_ = false;
+            s.hand_ = (s.hand_ + 1) % s.slots_.size();
+            continue;
+        }
+
+        s.bytes_ -= row_bytes(victim.row_);
+        slot_of_[victim.row_id_] = UINT32_MAX;
+
+        // fill the hole with the last slot
+        if(s.hand_ + 1 != s.slots_.size())
+        {
+            victim = std::move(s.slots_.back());
+            slot_of_[victim.row_id_] = s.hand_;
+        }
+        s.slots_.pop_back();
+        if(s.hand_ >= s.slots_.size()) { s.hand_ = 0; }
+    }
+
+    // a row larger than the shard is cached until the next miss
+    slot_of_[row_id] = (uint32_t)s.slots_.size();
+    s.slots_.push_back(slot{row_id, false, row});
+    s.bytes_ += bytes;
+}
+
+uint64_t
+warthog::cpd::row_cache::get_hits() const
+{
+    uint64_t hits = 0;
+    for(const stripe& st : stripes_)
+    {
+        hits += st.hits_.load(std::memory_order_relaxed);
+    }
+    for(const shard& s : shards_)
+    {
+        std::lock_guard<std::mutex> lock(s.mutex_);
+        hits += s.hits_;
+    }
+    return hits;
+}
+
+uint64_t
+warthog::cpd::row_cache::get_misses() const
+{
+    uint64_t misses = 0;
+    for(const shard& s : shards_)
+    {
+        std::lock_guard<std::mutex> lock(s.mutex_);
+        misses += s.misses_;
+    }
+    return misses;
+}
+
+size_t
+warthog::cpd::row_cache::get_cached_bytes() const
+{
+    size_t bytes = 0;
+    for(const shard& s : shards_)
+    {
+        std::lock_guard<std::mutex> lock(s.mutex_);
+        bytes += s.bytes_;
+    }
+    return bytes;
+}
+
+size_t
+warthog::cpd::row_cache::mem() const
+{
+    return sizeof(*this) + sizeof(uint64_t) * offsets_.capacity() +
+        sizeof(uint32_t) * slot_of_.capacity() + get_cached_bytes();
+}
@@ -0,0 +1,185 @@
+#ifndef WARTHOG_CPD_ROW_CACHE_H
+#define WARTHOG_CPD_ROW_CACHE_H
+
+// cpd/row_cache.h
+//
+// The rows of a binary CPD file read from disk as they are needed, with a
+// cache of a fixed number of bytes in RAM (cf.
+// graph_oracle_base::load_tiered). It is for CPDs larger than the RAM:
+// only the row offsets stay in memory, and the runs of a row are read with
+// pread(2) on a miss.
+//
+// Lookups are skewed (e.g., to the targets of a reverse CPD), so the cache
+// keeps the rows which are looked up again: it evicts with the clock
+// algorithm, which gives a row a second chance if it was looked up since the
+// hand last passed it. The cache is split in shards, by row, each with its
+// own lock, hand and share of the bytes, so that threads which look up
+// different rows seldom wait for each other.
+//
+// Each thread keeps the rows it looked up last in a small cache of its own,
+// in front of the shared one, so that looking up these rows again takes no
+// lock; only the misses of this cache go to the shards. It is set
+// associative, with two rows per set: a row returned by ::get stays valid
+// until the same thread has looked up two other rows. ::get_shared returns
+// a row which the caller owns instead. An evicted row is freed once no
+// thread holds it, so each thread may keep up to 2 * CPD_CACHE_L1_SETS rows
+// in memory besides the shared cache.
+//
+// @created: 2026-10-16
+//
+
+#include "cpd.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace warthog
+{
+
+namespace cpd
+{
+
+// sets of the rows each thread keeps (cf. row_cache::get), of two rows each:
+// a delta row and its reference are used together
+static const uint32_t CPD_CACHE_L1_SETS = 64;
+
+// shards of a row cache
+static const uint32_t CPD_CACHE_SHARDS = 16;
+
+// counters of the lookups which the threads serve from their own rows
+static const uint32_t CPD_CACHE_STRIPES = 16;
+
+class row_cache
+{
+    public:
+        // a cache of at most @param capacity bytes of rows
+        row_cache(size_t capacity);
+
+        ~row_cache();
+
+        row_cache(const row_cache&) = delete;
+        row_cache& operator=(const row_cache&) = delete;
+
+        // open a binary CPD file and read its header.
+        // @return false if the file cannot be read.
+        bool
+        open(const std::string& filename);
+
+        // read the row offsets of the file, once its header is checked.
+        // @return false if the file is truncated or corrupt.
+        bool
+        read_offsets();
+
+        // read @param size bytes at @param pos of the file into @param data
+        // @return false on a short read
+        bool
+        read(uint64_t pos, void* data, size_t size) const;
+
+        inline const warthog::cpd::cpd_header&
+        get_header() const { return header_; }
+
+        inline uint64_t
+        get_file_size() const { return file_size_; }
+
+        inline uint32_t
+        get_num_rows() const { return header_.num_rows_; }
+
+        // the row @param row_id, read from the file unless it is cached.
+        // Empty if the file cannot be read. Valid until this thread looks up
+        // two other rows.
+        warthog::cpd::rle_row
+        get(uint32_t row_id);
+
+        // the row @param row_id, as ::get, owned by the caller
+        std::shared_ptr<const std::vector<warthog::cpd::rle_run32>>
+        get_shared(uint32_t row_id);
+
+        // lookups since the cache was opened, and those which read the file
+        uint64_t
+        get_hits() const;
+
+        uint64_t
+        get_misses() const;
+
+        // the bytes of the cached rows
+        size_t
+        get_cached_bytes() const;
+
+        size_t
+        mem() const;
+
+    private:
+        typedef std::shared_ptr<const std::vector<warthog::cpd::rle_run32>>
+            row_ptr;
+
+        struct slot
+        {
+            uint32_t row_id_;
+            bool referenced_;
+            row_ptr row_;
+        };
+
+        struct shard
+        {
+            mutable std::mutex mutex_;
+            std::vector<slot> slots_;
+            size_t bytes_ = 0;
+            uint32_t hand_ = 0;
+            uint64_t hits_ = 0;
+            uint64_t misses_ = 0;
+        };
+
+        // lookups served by the rows of the threads, spread over cache lines
+        struct alignas(64) stripe
+        {
+            std::atomic<uint64_t> hits_{0};
+        };
+
+        uint64_t id_;                   // tells caches apart in the threads
+        int fd_;
+        uint64_t file_size_;
+        warthog::cpd::cpd_header header_;
+        std::vector<uint64_t> offsets_;
+        size_t capacity_;
+        shard shards_[CPD_CACHE_SHARDS];
+        stripe stripes_[CPD_CACHE_STRIPES];
+
+        // the slot of each row in its shard, or UINT32_MAX; each entry is
+        // guarded by the lock of the row's shard
+        std::vector<uint32_t> slot_of_;
+
+        // the bytes a cached row counts for
+        static inline size_t
+        row_bytes(const row_ptr& row)
+        {
+            return sizeof(slot) + sizeof(*row) +
+                sizeof(warthog::cpd::rle_run32) * row->size();
+        }
+
+        // read row @param row_id from the file
+        row_ptr
+        read_row(uint32_t row_id) const;
+
+        // the row @param row_id, among those of this thread; it stays there
+        // until the thread looks up two other rows
+        const row_ptr&
+        lookup(uint32_t row_id);
+
+        // the row @param row_id, from the shards or the file
+        row_ptr
+        fetch(uint32_t row_id);
+
+        // cache @param row as row @param row_id of @param s, evicting rows
+        // until it fits; must hold the lock of @param s
+        void
+        insert(shard& s, uint32_t row_id, const row_ptr& row);
+};
+
+}
+
+}
+
+#endif
@@ -0,0 +1,134 @@
+#ifndef WARTHOG_CPD_RUN_LOOKUP_H
+#define WARTHOG_CPD_RUN_LOOKUP_H
+
+// cpd/run_lookup.h
+//
+// Find the run of a CPD row which covers a given column index. This is the
+// innermost loop of every CPD query so we avoid indirect calls and bounds
+// checks and specialise on the length of the row:
+//
+//  - rows are searched with a branchless binary search, where the next probe
+//    is selected with a conditional move instead of a jump;
+//  - with AVX2, short rows are instead scanned linearly 8 run heads at a
+//    time, without an early exit.
+//
+// The thresholds come from `bin/cpd_bench`: without AVX2 the binary search
+// beats a scalar (or SSE2) scan on rows of every length, since the scan
+// mispredicts on the varying row lengths of real CPDs.
+//
+// Runs are sorted by column index and the first run of a row always starts
+// at index 0. Since the move lives in the 4 low bits of a run, comparing
+// the raw run data against (index << 4 | 0xF) is the same as comparing the
+// run's index against @param index.
+//
+// @created: 2026-10-15
+//
+
+#include "cpd.h"
+
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace warthog
+{
+
+namespace cpd
+{
+
+// rows with at most this many runs are scanned linearly
+#if defined(__AVX2__)
+static const uint32_t RUN_LOOKUP_LINEAR_MAX = 16;
+#else
+static const uint32_t RUN_LOOKUP_LINEAR_MAX = 0;
+#endif
+
+inline uint32_t
+run_lookup_key(uint32_t index)
+{ return (index << 4) | 0xF; }
+
+// @return the position of the last run in @param runs whose index is not
+// greater than @param index. Counts the run heads not greater than the key
+// over the whole row, so the only branches are the (predictable) loop exits.
+inline uint32_t
+find_run_linear(const warthog::cpd::rle_run32* runs, uint32_t size,
+                uint32_t index)
+{
+    uint32_t key = run_lookup_key(index);
+    uint32_t count = 0;
+    uint32_t i = 0;
+
+#if defined(__AVX2__)
+    // SIMD compares are signed; flip the sign bits to compare unsigned.
+    const __m256i flip = _mm256_set1_epi32(INT32_MIN);
+    const __m256i vkey = _mm256_xor_si256(_mm256_set1_epi32(key), flip);
+    for( ; i + 8 <= size; i += 8)
+    {
+        __m256i v = _mm256_xor_si256(
+            _mm256_loadu_si256((const __m256i*)(runs + i)), flip);
+        uint32_t gt = _mm256_movemask_ps(
+            _mm256_castsi256_ps(_mm256_cmpgt_epi32(v, vkey)));
+        count += 8 - __builtin_popcount(gt);
+    }
+    if(i < size)
+    {
+        // masked load of the last (size - i) runs; masked lanes don't fault
+        const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        __m256i valid = _mm256_cmpgt_epi32(
+            _mm256_set1_epi32(size - i), lanes);
+        __m256i v = _mm256_xor_si256(
+            _mm256_maskload_epi32((const int*)(runs + i), valid), flip);
+        uint32_t le = _mm256_movemask_ps(_mm256_castsi256_ps(
+            _mm256_andnot_si256(_mm256_cmpgt_epi32(v, vkey), valid)));
+        count += __builtin_popcount(le);
+        i = size;
+    }
+#endif
+
+    for( ; i < size; i++)
+    {
+        count += runs[i].data_ <= key;
+    }
+    return count - 1;
+}
+
+// @return the position of the last run in @param runs whose index is not
+// greater than @param index, using a branchless binary search.
+inline uint32_t
+find_run_binary(const warthog::cpd::rle_run32* runs, uint32_t size,
+                uint32_t index)
+{
+    uint32_t key = run_lookup_key(index);
+    const warthog::cpd::rle_run32* base = runs;
+    uint32_t n = size;
+
+    while(n > 1)
+    {
+        uint32_t half = n >> 1;
+        base = (base[half].data_ <= key) ? base + half : base;
+        n -= half;
+    }
+    return (uint32_t)(base - runs);
+}
+
+// @return the position of the run of @param row which covers column
+// @param index. The row must not be empty.
+inline uint32_t
+find_run(warthog::cpd::rle_row row, uint32_t index)
+{
+    assert(row.size() > 0);
+
+    if(row.size() <= RUN_LOOKUP_LINEAR_MAX)
+    {
+        return find_run_linear(row.begin(), row.size(), index);
+    }
+    return find_run_binary(row.begin(), row.size(), index);
+}
+
+}
+
+}
+
+#endif
@@ -1,6 +1,8 @@
 #include "domains/xy_graph.h"
 #include "util/timer.h"
 
+#include <algorithm>
+
 void
 warthog::graph::gridmap_to_xy_graph(
     warthog::gridmap* gm, warthog::graph::xy_graph* g,
@@ -182,6 +184,32 @@ warthog::graph::dimacs_to_xy_graph(
         << g.edge_mem_frag() << std::endl;
 }
 
+void
+warthog::graph::merge_parallel_edges(
+    std::vector<std::pair<uint32_t, warthog::graph::edge>>& edges)
+{
+    // index in the merged list of each edge, by (u << 32 | v)
+    std::unordered_map<uint64_t, size_t> first;
+    size_t num_merged = 0;
+    for(size_t i = 0; i < edges.size(); i++)
+    {
+        uint64_t key =
+            ((uint64_t)edges.at(i).first << 32) | edges.at(i).second.node_id_;
+        auto it = first.find(key);
+        if(it == first.end())
+        {
+            first[key] = num_merged;
+            edges.at(num_merged++) = edges.at(i);
+        }
+        else
+        {
+            warthog::graph::edge& e = edges.at(it->second).second;
+            e.wt_ = std::min(e.wt_, edges.at(i).second.wt_);
+        }
+    }
+    edges.resize(num_merged);
+}
+
 void
 warthog::graph::parse_xy(
     std::istream &in,
@@ -46,6 +46,13 @@ parse_xy(
     std::vector<warthog::graph::ECAP_T>& in_degree,
     std::vector<warthog::graph::ECAP_T>& out_degree);
 
+// Merge the edges (u, v) listed more than once in @param edges into the first
+// of them, with the smallest of their costs: a graph keeps one edge (u, v),
+// the cheapest, when it loads them (cf. node::add_edge).
+void
+merge_parallel_edges(
+    std::vector<std::pair<uint32_t, warthog::graph::edge>>& edges);
+
 template<class T_NODE, class T_EDGE>
 class xy_graph_base
 {
@@ -449,13 +456,18 @@ class xy_graph_base
 
         /**
          * Edit the weights of the edges to contain the new costs and save the
-         * original cost in the labels.
+         * original cost in the labels. An edge listed more than once gets the
+         * cheapest of its costs (cf. merge_parallel_edges).
          */
         void
         perturb(std::vector<std::pair<uint32_t, warthog::graph::edge>>& edges)
         {
+            std::vector<std::pair<uint32_t, warthog::graph::edge>> merged =
+                edges;
+            warthog::graph::merge_parallel_edges(merged);
+
             uint32_t num_modif = 0;
-            for(auto e : edges)
+            for(auto e : merged)
             {
                 uint32_t from_id = e.first;
                 node* from = get_node(from_id);
@@ -474,6 +486,15 @@ class xy_graph_base
                     {
                         num_modif++;
                         eit->wt_ = e.second.wt_;
+
+                        // and its copy among the incoming edges, if any
+                        node* to = get_node(e.second.node_id_);
+                        edge_iter iit = to->find_edge(from_id,
+                                to->incoming_begin(), to->incoming_end());
+                        if(iit != to->incoming_end())
+                        {
+                            iit->wt_ = e.second.wt_;
+                        }
                     }
                 }
                 // TODO else add warning (from log.h?)
@@ -485,6 +506,51 @@ class xy_graph_base
             std::cerr << "Perturbed " << num_modif << " edges." << std::endl;
         }
 
+        // Renumber the nodes of the graph: node @param order[i] becomes node
+        // i. Edges keep their position in adjacency lists, so edge indices
+        // (e.g. first moves) are the same before and after.
+        //
+        // @param order: a permutation of the node ids
+        void
+        permute(const std::vector<uint32_t>& order)
+        {
+            assert(order.size() == get_num_nodes());
+
+            // new id of each node
+            std::vector<uint32_t> rank(order.size());
+            for(uint32_t i = 0; i < order.size(); i++)
+            {
+                rank.at(order.at(i)) = i;
+            }
+
+            std::vector<T_NODE> nodes;
+            std::vector<int32_t> xy(xy_.size());
+            nodes.reserve(nodes_.size());
+            for(uint32_t i = 0; i < order.size(); i++)
+            {
+                uint32_t old_id = order.at(i);
+                nodes.push_back(std::move(nodes_.at(old_id)));
+                xy.at(i*2) = xy_.at(old_id*2);
+                xy.at(i*2+1) = xy_.at(old_id*2+1);
+
+                T_NODE& n = nodes.back();
+                for(T_EDGE* it = n.outgoing_begin();
+                    it != n.outgoing_end(); it++)
+                {
+                    it->node_id_ = rank.at(it->node_id_);
+                }
+                for(T_EDGE* it = n.incoming_begin();
+                    it != n.incoming_end(); it++)
+                {
+                    it->node_id_ = rank.at(it->node_id_);
+                }
+            }
+
+            nodes_.swap(nodes);
+            xy_.swap(xy);
+            graph_id_ = graph_counter_++;
+        }
+
         //inline void
         //shrink_to_fit()
         //{
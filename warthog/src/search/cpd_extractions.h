@@ -7,6 +7,7 @@
 
 #include "forward.h"
 #include "graph_oracle.h"
+#include "hub_labels.h"
 #include "log.h"
 #include "problem_instance.h"
 #include "solution.h"
@@ -23,11 +24,12 @@ class cpd_extractions_base : public warthog::search
     public:
         cpd_extractions_base(warthog::graph::xy_graph *g,
                              warthog::cpd::graph_oracle_base<T> *oracle)
-            : g_(g), oracle_(oracle)
+            : g_(g), oracle_(oracle), distances_(nullptr)
         {
             assert(oracle->get_graph() == g);
             max_k_moves_ = UINT_MAX;
             time_cutoff_ = DBL_MAX;
+            batch_size_ = warthog::cpd::CPD_PREFETCH_GROUP;
         }
 
         virtual ~cpd_extractions_base() { }
@@ -86,6 +88,15 @@ class cpd_extractions_base : public warthog::search
 
             sol.sum_of_edge_costs_ = 0;
 
+            if(distances_ != nullptr)
+            {
+                sol.sum_of_edge_costs_ =
+                    distances_->get_cost(source_id, target_id);
+                mytimer.stop();
+                sol.time_elapsed_nano_ = mytimer.elapsed_time_nano();
+                return;
+            }
+
             while(source_id != target_id && sol.nodes_touched_ < max_k_moves_)
             {
                 uint32_t move = oracle_->get_move(source_id, target_id);
@@ -108,6 +119,52 @@ class cpd_extractions_base : public warthog::search
             sol.time_elapsed_nano_ = mytimer.elapsed_time_nano();
         }
 
+        // Extract the paths of many queries at once. Up to ::batch_size_
+        // queries advance in lock-step, one move per round, and the loads of
+        // a round are prefetched for all of them before any is resolved.
+        //
+        // Each solution gets the average time of the batch.
+        void
+        get_paths(std::vector<warthog::problem_instance>& pis,
+                  std::vector<warthog::solution>& sols)
+        { extract_batch(pis, sols, true); }
+
+        // Same as ::get_paths, without storing the paths.
+        void
+        get_pathcosts(std::vector<warthog::problem_instance>& pis,
+                      std::vector<warthog::solution>& sols)
+        {
+            if(distances_ == nullptr)
+            {
+                extract_batch(pis, sols, false);
+                return;
+            }
+
+            sols.resize(pis.size());
+            for(size_t i = 0; i < pis.size(); i++)
+            {
+                get_pathcost(pis.at(i), sols.at(i));
+            }
+        }
+
+        // Answer ::get_pathcost and ::get_pathcosts with @param distances,
+        // which must hold the costs of the graph, instead of walking the
+        // paths (nullptr to walk them again). Paths, and so first moves,
+        // still come from the CPD. The labels do not follow the graph: once
+        // its costs change (cf. xy_graph::perturb), set them to nullptr, as
+        // fifo does when a job applies a diff.
+        void
+        set_distances(const warthog::cpd::hub_labels* distances)
+        { distances_ = distances; }
+
+        void
+        set_batch_size(uint32_t batch_size)
+        { batch_size_ = std::max<uint32_t>(batch_size, 1); }
+
+        uint32_t
+        get_batch_size()
+        { return batch_size_; }
+
         void
         set_max_k_moves(uint32_t k_moves)
         { max_k_moves_ = k_moves; }
@@ -127,6 +184,111 @@ class cpd_extractions_base : public warthog::search
         warthog::cpd::graph_oracle_base<T>* oracle_;
         double time_cutoff_;            // Time limit in nanoseconds
         uint32_t max_k_moves_;          // Max "distance" from target
+        uint32_t batch_size_;           // Queries in flight in batches
+        const warthog::cpd::hub_labels* distances_;
+
+        // a query being extracted in a batch
+        struct batch_slot
+        {
+            size_t query_;
+            warthog::sn_id_t node_;
+            warthog::sn_id_t target_;
+        };
+
+        void
+        extract_batch(std::vector<warthog::problem_instance>& pis,
+                      std::vector<warthog::solution>& sols, bool store_path)
+        {
+            warthog::timer mytimer;
+            mytimer.start();
+
+            sols.resize(pis.size());
+            std::vector<batch_slot> slots;
+            slots.reserve(batch_size_);
+            size_t next = 0;
+
+            while(next < pis.size() || slots.size() > 0)
+            {
+                // replace the finished queries
+                while(slots.size() < batch_size_ && next < pis.size())
+                {
+                    warthog::solution& sol = sols.at(next);
+                    sol.reset();
+                    sol.sum_of_edge_costs_ = 0;
+
+                    batch_slot slot =
+                        {next, pis.at(next).start_id_, pis.at(next).target_id_};
+                    next++;
+
+                    if(slot.node_ == slot.target_ || max_k_moves_ == 0)
+                    {
+                        if(store_path) { sol.path_.push_back(slot.node_); }
+                        continue;
+                    }
+                    slots.push_back(slot);
+                }
+
+                for(batch_slot& slot : slots)
+                {
+                    oracle_->prefetch_move(slot.node_, slot.target_);
+                    __builtin_prefetch(g_->get_node(slot.node_));
+                }
+
+                for(batch_slot& slot : slots)
+                {
+                    oracle_->prefetch_runs(slot.node_, slot.target_);
+                    __builtin_prefetch(
+                        g_->get_node(slot.node_)->outgoing_begin());
+                }
+
+                for(size_t i = 0; i < slots.size(); )
+                {
+                    batch_slot& slot = slots.at(i);
+                    warthog::solution& sol = sols.at(slot.query_);
+                    bool done = false;
+
+                    if(store_path) { sol.path_.push_back(slot.node_); }
+
+                    uint32_t move = oracle_->get_move(slot.node_, slot.target_);
+                    if (move == warthog::cpd::CPD_FM_NONE)
+                    {
+                        error("Could not find path", pis.at(slot.query_));
+                        done = true;
+                    }
+                    else
+                    {
+                        warthog::graph::node* n = g_->get_node(slot.node_);
+                        assert(n->out_degree() > move);
+
+                        warthog::graph::edge* e = (n->outgoing_begin() + move);
+                        slot.node_ = e->node_id_;
+                        sol.sum_of_edge_costs_ += e->wt_;
+                        sol.nodes_touched_++;
+
+                        done = slot.node_ == slot.target_ ||
+                            sol.nodes_touched_ >= max_k_moves_;
+                    }
+
+                    if(done)
+                    {
+                        if(store_path) { sol.path_.push_back(slot.node_); }
+                        slot = slots.back();
+                        slots.pop_back();
+                    }
+                    else
+                    {
+                        i++;
+                    }
+                }
+            }
+
+            mytimer.stop();
+            for(warthog::solution& sol : sols)
+            {
+                sol.time_elapsed_nano_ =
+                    mytimer.elapsed_time_nano() / pis.size();
+            }
+        }
 };
 
 typedef cpd_extractions_base<warthog::cpd::FORWARD> cpd_extractions;
@@ -0,0 +1,196 @@
+#ifndef WARTHOG_CPD_MATRIX_H
+#define WARTHOG_CPD_MATRIX_H
+
+// cpd_matrix.h
+//
+// Many-to-many cost matrices from a CPD, e.g. for dispatch or vehicle
+// routing: the cost of every (source, target) pair of two sets of nodes.
+//
+// Paths to the same target share their suffixes, so the matrix is computed
+// one target at a time: each path is followed only until it reaches a node
+// whose cost to the target is known, and the costs of the nodes it passed
+// are then kept for the next sources, as cpd_heuristic does. Grouping the
+// lookups by target also keeps the row of the target hot in reverse CPDs.
+// Targets are shared between threads, each with its own memo.
+//
+// @created: 2026-10-16
+//
+
+#include "constants.h"
+#include "graph_oracle.h"
+#include "hub_labels.h"
+#include "xy_graph.h"
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace warthog
+{
+
+template<warthog::cpd::symbol T>
+class cpd_matrix_base
+{
+    public:
+        cpd_matrix_base(warthog::graph::xy_graph *g,
+                        warthog::cpd::graph_oracle_base<T> *oracle)
+            : g_(g), oracle_(oracle), distances_(nullptr)
+        {
+            assert(oracle->get_graph() == g);
+        }
+
+        // the costs from each of @param sources to each of @param targets,
+        // by source: the cost from sources[i] to targets[j] is
+        // costs[i * targets.size() + j], or warthog::COST_MAX if there is no
+        // path. The targets are shared between @param num_threads threads.
+        void
+        get_costs(const std::vector<warthog::sn_id_t>& sources,
+                  const std::vector<warthog::sn_id_t>& targets,
+                  std::vector<warthog::cost_t>& costs,
+                  uint32_t num_threads = 1)
+        {
+            costs.assign(sources.size() * targets.size(), warthog::COST_MAX);
+            num_threads = std::max<uint32_t>(
+                1, std::min<uint32_t>(num_threads, targets.size()));
+            workers_.resize(num_threads);
+
+            std::atomic<size_t> next(0);
+            auto work = [&](worker& w)
+            {
+                w.init(g_->get_num_nodes());
+                for(size_t j = next++; j < targets.size(); j = next++)
+                {
+                    w.next_target(targets.at(j));
+                    for(size_t i = 0; i < sources.size(); i++)
+                    {
+                        costs.at(i * targets.size() + j) = distances_
+                            ? distances_->get_cost(sources.at(i), targets.at(j))
+                            : get_cost(w, sources.at(i), targets.at(j));
+                    }
+                }
+            };
+
+            std::vector<std::thread> threads;
+            for(uint32_t t = 1; t < num_threads; t++)
+            {
+                threads.emplace_back(work, std::ref(workers_.at(t)));
+            }
+            work(workers_.at(0));
+            for(std::thread& t : threads) { t.join(); }
+        }
+
+        // take costs from @param distances rather than from the CPD, until
+        // the costs of the graph change (cf.
+        // cpd_extractions_base::set_distances)
+        void
+        set_distances(const warthog::cpd::hub_labels* distances)
+        { distances_ = distances; }
+
+        size_t
+        mem()
+        {
+            size_t retval = sizeof(*this);
+            for(worker& w : workers_)
+            {
+                retval += sizeof(warthog::cost_t) * w.cost_.capacity() +
+                    sizeof(uint32_t) * w.stamp_.capacity() +
+                    sizeof(std::pair<warthog::sn_id_t, warthog::cost_t>) *
+                        w.stack_.capacity();
+            }
+            return retval;
+        }
+
+    private:
+        // the costs to the current target of the nodes seen so far, which
+        // are those with the current stamp
+        struct worker
+        {
+            std::vector<warthog::cost_t> cost_;
+            std::vector<uint32_t> stamp_;
+            uint32_t current_ = 0;
+            std::vector<std::pair<warthog::sn_id_t, warthog::cost_t>> stack_;
+
+            void
+            init(uint32_t num_nodes)
+            {
+                cost_.resize(num_nodes);
+                stamp_.resize(num_nodes, 0);
+            }
+
+            void
+            next_target(warthog::sn_id_t target_id)
+            {
+                if(++current_ == 0)
+                {
+                    std::fill(stamp_.begin(), stamp_.end(), 0);
+                    current_ = 1;
+                }
+                set(target_id, 0);
+            }
+
+            inline bool
+            is_set(warthog::sn_id_t node_id) const
+            { return stamp_.at(node_id) == current_; }
+
+            inline void
+            set(warthog::sn_id_t node_id, warthog::cost_t cost)
+            {
+                cost_.at(node_id) = cost;
+                stamp_.at(node_id) = current_;
+            }
+        };
+
+        warthog::graph::xy_graph* g_;
+        warthog::cpd::graph_oracle_base<T>* oracle_;
+        std::vector<worker> workers_;
+        const warthog::cpd::hub_labels* distances_;
+
+        // follow the first moves from @param source_id until a node whose
+        // cost is known, then set the costs of the nodes on the way
+        warthog::cost_t
+        get_cost(worker& w, warthog::sn_id_t source_id,
+                 warthog::sn_id_t target_id)
+        {
+            w.stack_.clear();
+            warthog::sn_id_t node_id = source_id;
+            warthog::cost_t cost = warthog::COST_MAX;
+
+            while(!w.is_set(node_id))
+            {
+                uint32_t move = oracle_->get_move(node_id, target_id);
+                warthog::graph::node* n = g_->get_node(node_id);
+
+                // CPDs do not tell unreachable targets apart: there is no
+                // path if the move is not an edge or the path has a cycle
+                if(move >= n->out_degree() ||
+                   w.stack_.size() >= g_->get_num_nodes())
+                {
+                    break;
+                }
+
+                warthog::graph::edge* e = (n->outgoing_begin() + move);
+                w.stack_.push_back({node_id, e->wt_});
+                node_id = e->node_id_;
+            }
+            if(w.is_set(node_id)) { cost = w.cost_.at(node_id); }
+
+            while(w.stack_.size())
+            {
+                if(cost != warthog::COST_MAX)
+                {
+                    cost += w.stack_.back().second;
+                }
+                w.set(w.stack_.back().first, cost);
+                w.stack_.pop_back();
+            }
+            return cost;
+        }
+};
+
+typedef cpd_matrix_base<warthog::cpd::FORWARD> cpd_matrix;
+
+}
+
+#endif
@@ -0,0 +1,59 @@
+#include "mapped_file.h"
+
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool
+warthog::util::mapped_file::open(const std::string& filename)
+{
+    close();
+
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if(fd < 0)
+    {
+        std::cerr << "err; cannot open " << filename << ": "
+                  << strerror(errno) << "\n";
+        return false;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        std::cerr << "err; cannot map empty or invalid file " << filename
+                  << "\n";
+        ::close(fd);
+        return false;
+    }
+
+    void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    // the mapping keeps its own reference to the file
+    ::close(fd);
+
+    if(addr == MAP_FAILED)
+    {
+        std::cerr << "err; cannot map " << filename << ": "
+                  << strerror(errno) << "\n";
+        return false;
+    }
+
+    data_ = (const char*)addr;
+    size_ = st.st_size;
+    filename_ = filename;
+    return true;
+}
+
+void
+warthog::util::mapped_file::close()
+{
+    if(data_ != nullptr)
+    {
+        munmap((void*)data_, size_);
+        data_ = nullptr;
+        size_ = 0;
+        filename_.clear();
+    }
+}
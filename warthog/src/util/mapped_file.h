@@ -0,0 +1,64 @@
+#ifndef WARTHOG_MAPPED_FILE_H
+#define WARTHOG_MAPPED_FILE_H
+
+// util/mapped_file.h
+//
+// A read-only memory mapping of a file. The mapping is shared with the page
+// cache, so several processes mapping the same file use a single copy of its
+// contents.
+//
+// @created: 2026-10-15
+//
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace warthog
+{
+
+namespace util
+{
+
+class mapped_file
+{
+    public:
+        mapped_file() : data_(nullptr), size_(0) { }
+
+        ~mapped_file() { close(); }
+
+        mapped_file(const mapped_file&) = delete;
+        mapped_file& operator=(const mapped_file&) = delete;
+
+        // map the whole of @param filename into memory.
+        // @return false if the file cannot be opened or mapped; the reason
+        // is printed to std::cerr.
+        bool
+        open(const std::string& filename);
+
+        void
+        close();
+
+        inline bool
+        is_open() const { return data_ != nullptr; }
+
+        inline const char*
+        data() const { return data_; }
+
+        inline size_t
+        size() const { return size_; }
+
+        inline const std::string&
+        filename() const { return filename_; }
+
+    private:
+        const char* data_;
+        size_t size_;
+        std::string filename_;
+};
+
+}
+
+}
+
+#endif
@@ -0,0 +1,124 @@
+#include "numa_topology.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+std::vector<uint32_t>
+warthog::util::parse_cpu_list(const char* list)
+{
+    std::vector<uint32_t> cpus;
+    const char* p = list;
+    while(*p != '\0')
+    {
+        char* end;
+        uint32_t first = std::strtoul(p, &end, 10);
+        if(end == p) { break; }
+
+        uint32_t last = first;
+        p = end;
+        if(*p == '-')
+        {
+            last = std::strtoul(p + 1, &end, 10);
+            p = end;
+        }
+        for(uint32_t cpu = first; cpu <= last; cpu++) { cpus.push_back(cpu); }
+
+        if(*p == ',') { p++; }
+    }
+    return cpus;
+}
+
+std::vector<warthog::util::numa_node>
+warthog::util::get_numa_nodes()
+{
+    std::vector<warthog::util::numa_node> nodes;
+    std::string sys = "/sys/devices/system/node";
+    DIR* dir = opendir(sys.c_str());
+
+    while(dir != nullptr)
+    {
+        struct dirent* entry = readdir(dir);
+        if(entry == nullptr) { break; }
+
+        const char* name = entry->d_name;
+        if(std::strncmp(name, "node", 4) != 0 ||
+           std::strspn(name + 4, "0123456789") != std::strlen(name + 4) ||
+           name[4] == '\0')
+        {
+            continue;
+        }
+
+        std::ifstream ifs(sys + "/" + name + "/cpulist");
+        std::string list;
+        std::getline(ifs, list);
+
+        warthog::util::numa_node node;
+        node.id_ = std::atoi(name + 4);
+        node.cpus_ = parse_cpu_list(list.c_str());
+        // memory-only nodes have no CPUs to pin
+        if(!node.cpus_.empty()) { nodes.push_back(node); }
+    }
+    if(dir != nullptr) { closedir(dir); }
+
+    std::sort(nodes.begin(), nodes.end(),
+              [](const warthog::util::numa_node& a,
+                 const warthog::util::numa_node& b)
+              { return a.id_ < b.id_; });
+
+    if(nodes.empty())
+    {
+        warthog::util::numa_node node;
+        node.id_ = 0;
+        for(uint32_t cpu = 0;
+            cpu < std::max(1u, std::thread::hardware_concurrency()); cpu++)
+        {
+            node.cpus_.push_back(cpu);
+        }
+        nodes.push_back(node);
+    }
+    return nodes;
+}
+
+bool
+warthog::util::pin_thread(const std::vector<uint32_t>& cpus)
+{
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for(uint32_t cpu : cpus)
+    {
+        if(cpu < CPU_SETSIZE) { CPU_SET(cpu, &set); }
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+}
+
+std::vector<uint32_t>
+warthog::util::get_thread_cpus()
+{
+    std::vector<uint32_t> cpus;
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if(pthread_getaffinity_np(pthread_self(), sizeof(set), &set) == 0)
+    {
+        for(uint32_t cpu = 0; cpu < CPU_SETSIZE; cpu++)
+        {
+            if(CPU_ISSET(cpu, &set)) { cpus.push_back(cpu); }
+        }
+    }
+#endif
+    return cpus;
+}
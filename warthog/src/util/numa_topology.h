@@ -0,0 +1,54 @@
+#ifndef WARTHOG_NUMA_TOPOLOGY_H
+#define WARTHOG_NUMA_TOPOLOGY_H
+
+// util/numa_topology.h
+//
+// The NUMA nodes of the machine and their CPUs, read from sysfs, and the
+// pinning of threads to CPUs. Memory is placed on the node of the thread which
+// first writes it, so a thread pinned on a node gets local memory by copying
+// data itself (cf. graph_oracle_base::localise); no NUMA library is needed.
+//
+// Where the topology is not available (e.g., on macOS), the machine is a
+// single node and threads are not pinned.
+//
+// @created: 2026-10-16
+//
+
+#include <cstdint>
+#include <vector>
+
+namespace warthog
+{
+
+namespace util
+{
+
+struct numa_node
+{
+    uint32_t id_;
+    std::vector<uint32_t> cpus_;
+};
+
+// the NUMA nodes which have CPUs, by id
+std::vector<warthog::util::numa_node>
+get_numa_nodes();
+
+// the CPUs of a list such as "0-3,8,10-11" (cf. cpulist in sysfs)
+std::vector<uint32_t>
+parse_cpu_list(const char* list);
+
+// restrict the calling thread to the CPUs @param cpus
+// @return false if threads cannot be pinned here
+bool
+pin_thread(const std::vector<uint32_t>& cpus);
+
+// the CPUs the calling thread may run on, to restore them with ::pin_thread
+// once it was pinned for a while; empty if threads cannot be pinned here
+std::vector<uint32_t>
+get_thread_cpus();
+
+}
+
+}
+
+#endif
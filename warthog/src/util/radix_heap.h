@@ -0,0 +1,114 @@
+#ifndef WARTHOG_RADIX_HEAP_H
+#define WARTHOG_RADIX_HEAP_H
+
+// radix_heap.h
+//
+// A monotone min priority queue over 64-bit keys: the key of every element
+// pushed must be no smaller than the last key popped, which is the case for
+// Dijkstra's algorithm with non-negative edge costs. Elements are kept in 65
+// buckets by the highest bit in which their key differs from the last key
+// popped; each element moves down at most 64 times, so operations take
+// amortised O(log C) time without comparisons between elements.
+//
+// There is no decrease-key: push the element again and skip stale entries
+// when they are popped.
+//
+// @created: 2026-10-16
+//
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+namespace warthog
+{
+
+class radix_heap
+{
+    public:
+        radix_heap() : last_(0), size_(0) { }
+
+        inline void
+        clear()
+        {
+            for(std::vector<entry>& b : buckets_) { b.clear(); }
+            last_ = 0;
+            size_ = 0;
+        }
+
+        inline bool
+        empty() const { return size_ == 0; }
+
+        inline size_t
+        size() const { return size_; }
+
+        inline void
+        push(uint64_t key, uint32_t value)
+        {
+            assert(key >= last_);
+            buckets_[bucket(key)].push_back({key, value});
+            size_++;
+        }
+
+        // remove an element with the smallest key
+        inline void
+        pop(uint64_t& key, uint32_t& value)
+        {
+            assert(size_ > 0);
+            if(buckets_[0].empty())
+            {
+                uint32_t i = 1;
+                while(buckets_[i].empty()) { i++; }
+
+                // the smallest key of the first non-empty bucket becomes the
+                // last key, which moves every other key to a lower bucket
+                last_ = buckets_[i].front().key_;
+                for(const entry& e : buckets_[i])
+                {
+                    if(e.key_ < last_) { last_ = e.key_; }
+                }
+                for(const entry& e : buckets_[i])
+                {
+                    buckets_[bucket(e.key_)].push_back(e);
+                }
+                buckets_[i].clear();
+            }
+
+            key = buckets_[0].back().key_;
+            value = buckets_[0].back().value_;
+            buckets_[0].pop_back();
+            size_--;
+        }
+
+        inline size_t
+        mem()
+        {
+            size_t bytes = sizeof(*this);
+            for(std::vector<entry>& b : buckets_)
+            {
+                bytes += b.capacity() * sizeof(entry);
+            }
+            return bytes;
+        }
+
+    private:
+        struct entry
+        {
+            uint64_t key_;
+            uint32_t value_;
+        };
+
+        inline uint32_t
+        bucket(uint64_t key) const
+        {
+            return key == last_ ? 0 : 64 - __builtin_clzll(key ^ last_);
+        }
+
+        std::vector<entry> buckets_[65];
+        uint64_t last_;
+        size_t size_;
+};
+
+}
+
+#endif
@@ -0,0 +1,2546 @@
+#define CATCH_CONFIG_RUNNER
+
+#include "catch.hpp"
+#include "bearing_table.h"
+#include "bidirectional_graph_expansion_policy.h"
+#include "bounded_rows.h"
+#include "cpd_extractions.h"
+#include "cpd_matrix.h"
+#include "cpd_repair.h"
+#include "cpd_shards.h"
+#include "cpd_writer.h"
+#include "graph_oracle.h"
+#include "grid_first_move_dijkstra.h"
+#include "hub_labels.h"
+#include "numa_topology.h"
+#include "oracle_listener.h"
+#include "published_cpd.h"
+#include "run_lookup.h"
+#include "xy_graph.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <sys/stat.h>
+#include <thread>
+
+using namespace std;
+
+int
+main(int argv, char* args[])
+{
+    Catch::Session session;
+    int res = session.run(argv, args);
+    return res;
+}
+
+// An 8-connected lattice of @param width by @param height nodes with a few
+// holes, so that rows have more than one run.
+void
+make_lattice(warthog::graph::xy_graph& g, uint32_t width, uint32_t height)
+{
+    std::vector<uint32_t> ids(width * height, UINT32_MAX);
+
+    for(uint32_t y = 0; y < height; y++)
+    {
+        for(uint32_t x = 0; x < width; x++)
+        {
+            // obstacles
+            if(x == width / 2 && y > 0 && y < height - 1) { continue; }
+            if(y == height / 3 && x > 1 && x < width - 2) { continue; }
+
+            ids.at(y * width + x) = g.add_node(x * 1000, y * 1000);
+        }
+    }
+
+    for(int32_t y = 0; y < (int32_t)height; y++)
+    {
+        for(int32_t x = 0; x < (int32_t)width; x++)
+        {
+            uint32_t from = ids.at(y * width + x);
+            if(from == UINT32_MAX) { continue; }
+
+            for(int32_t dy = -1; dy <= 1; dy++)
+            {
+                for(int32_t dx = -1; dx <= 1; dx++)
+                {
+                    int32_t nx = x + dx;
+                    int32_t ny = y + dy;
+                    if((dx == 0 && dy == 0) || nx < 0 || ny < 0 ||
+                       nx >= (int32_t)width || ny >= (int32_t)height)
+                    { continue; }
+
+                    uint32_t to = ids.at(ny * width + nx);
+                    if(to == UINT32_MAX) { continue; }
+
+                    double wt = (dx != 0 && dy != 0) ? 1414 : 1000;
+                    g.get_node(from)->add_outgoing(
+                        warthog::graph::edge(to, wt));
+                    g.get_node(to)->add_incoming(
+                        warthog::graph::edge(from, wt));
+                }
+            }
+        }
+    }
+}
+
+// Same steps as `make_cpd`, single-threaded.
+template<warthog::cpd::symbol S>
+void
+build_oracle(warthog::graph::xy_graph& g,
+             warthog::cpd::graph_oracle_base<S>& cpd,
+             warthog::cpd::oracle_listener* listener, bool reverse,
+             warthog::cpd::order_strategy strategy = warthog::cpd::DFS_ORDER)
+{
+    warthog::sn_id_t source_id;
+    std::vector<warthog::cpd::fm_coll> s_row(g.get_num_nodes());
+    warthog::bidirectional_graph_expansion_policy expander(&g, reverse);
+    warthog::zero_heuristic h;
+    warthog::pqueue_min queue;
+    warthog::flexible_astar<
+        warthog::zero_heuristic,
+        warthog::bidirectional_graph_expansion_policy,
+        warthog::pqueue_min,
+        warthog::cpd::oracle_listener>
+        dijk(&h, &expander, &queue);
+
+    listener->set_run(&source_id, &s_row);
+    dijk.set_listener(listener);
+
+    cpd.compute_column_order(strategy);
+    for(source_id = 0; source_id < g.get_num_nodes(); source_id++)
+    {
+        cpd.compute_row(source_id, &dijk, s_row);
+    }
+    cpd.value_index_swap_array();
+}
+
+// Same as `build_oracle`, with the specialised search.
+template<warthog::cpd::symbol S>
+void
+build_oracle_fm(warthog::graph::xy_graph& g,
+                warthog::cpd::graph_oracle_base<S>& cpd, bool reverse)
+{
+    std::vector<warthog::cpd::fm_coll> s_row(g.get_num_nodes());
+    warthog::cpd::first_move_graph fm_graph(&g, reverse);
+    warthog::cpd::first_move_dijkstra dijk(&fm_graph);
+
+    cpd.compute_dfs_preorder(0);
+    for(uint32_t source_id = 0; source_id < g.get_num_nodes(); source_id++)
+    {
+        cpd.compute_row(source_id, &dijk, s_row);
+    }
+    cpd.value_index_swap_array();
+}
+
+template<warthog::cpd::symbol S, warthog::cpd::symbol R>
+bool
+same_moves(warthog::graph::xy_graph& g,
+           warthog::cpd::graph_oracle_base<S>& a,
+           warthog::cpd::graph_oracle_base<R>& b)
+{
+    for(uint32_t s = 0; s < g.get_num_nodes(); s++)
+    {
+        for(uint32_t t = 0; t < g.get_num_nodes(); t++)
+        {
+            if(a.get_move(s, t) != b.get_move(s, t)) { return false; }
+        }
+    }
+    return true;
+}
+
+SCENARIO("Binary CPD files", "[cpd][oracle][binary]")
+{
+    warthog::graph::xy_graph g;
+    make_lattice(g, 12, 9);
+
+    warthog::cpd::graph_oracle oracle(&g);
+    warthog::cpd::graph_oracle_listener<warthog::cpd::FORWARD> listener(
+        &oracle);
+    build_oracle(g, oracle, &listener, false);
+
+    std::string filename = "cpd_oracle_test.cpd";
+    std::ofstream ofs(filename, std::ios_base::binary);
+    oracle.write_binary(ofs);
+    ofs.close();
+
+    GIVEN("A binary CPD file")
+    {
+        THEN("It can be read from a stream")
+        {
+            warthog::cpd::graph_oracle other(&g);
+            std::ifstream ifs(filename, std::ios_base::binary);
+            ifs >> other;
+
+            REQUIRE(!other.is_mapped());
+            REQUIRE(oracle == other);
+            REQUIRE(same_moves(g, oracle, other));
+        }
+
+        THEN("It can be memory-mapped")
+        {
+            warthog::cpd::graph_oracle other(&g);
+
+            REQUIRE(other.load(filename));
+            REQUIRE(other.is_mapped());
+            REQUIRE(oracle == other);
+            REQUIRE(same_moves(g, oracle, other));
+        }
+
+        THEN("A mapped oracle writes the stream format back")
+        {
+            warthog::cpd::graph_oracle mapped(&g);
+            REQUIRE(mapped.load(filename));
+
+            std::stringstream s1;
+            std::stringstream s2;
+            s1 << oracle;
+            s2 << mapped;
+
+            REQUIRE(s1.str() == s2.str());
+        }
+
+        THEN("It records its version and symbol")
+        {
+            uint32_t version;
+            uint32_t symbol;
+            REQUIRE(warthog::cpd::get_file_version(filename, version, symbol));
+            REQUIRE(version == warthog::cpd::CPD_FILE_VERSION);
+            REQUIRE(symbol == warthog::cpd::FORWARD);
+        }
+
+        THEN("It cannot be loaded with another symbol")
+        {
+            warthog::cpd::graph_oracle_base<warthog::cpd::REVERSE> other(&g);
+            REQUIRE(!other.load(filename));
+        }
+    }
+
+    GIVEN("A stream CPD file")
+    {
+        std::string stream_name = "cpd_oracle_test_stream.cpd";
+        std::ofstream sfs(stream_name, std::ios_base::binary);
+        sfs << oracle;
+        sfs.close();
+
+        THEN("It is still readable")
+        {
+            warthog::cpd::graph_oracle other(&g);
+
+            REQUIRE(other.load(stream_name));
+            REQUIRE(!other.is_mapped());
+            REQUIRE(oracle == other);
+        }
+
+        THEN("It records its version and symbol")
+        {
+            uint32_t version;
+            uint32_t symbol;
+            REQUIRE(warthog::cpd::get_file_version(stream_name, version,
+                                                   symbol));
+            REQUIRE(version == warthog::cpd::CPD_FILE_VERSION);
+            REQUIRE(symbol == warthog::cpd::FORWARD);
+        }
+
+        THEN("It cannot be loaded with another symbol")
+        {
+            warthog::cpd::graph_oracle_base<warthog::cpd::REVERSE> other(&g);
+            REQUIRE(!other.load(stream_name));
+        }
+
+        std::remove(stream_name.c_str());
+    }
+
+    GIVEN("A corrupt file")
+    {
+        std::string bad_name = "cpd_oracle_test_bad.cpd";
+        std::ofstream bfs(bad_name, std::ios_base::binary);
+        warthog::cpd::cpd_header header = {};
+        header.magic_ = warthog::cpd::CPD_FILE_MAGIC;
+        header.version_ = warthog::cpd::CPD_FILE_VERSION;
+        header.num_nodes_ = g.get_num_nodes();
+        header.num_rows_ = g.get_num_nodes();
+        bfs.write((char*)&header, sizeof(header));
+        bfs.close();
+
+        THEN("It is rejected")
+        {
+            warthog::cpd::graph_oracle other(&g);
+            REQUIRE(!other.load(bad_name));
+        }
+
+        std::remove(bad_name.c_str());
+    }
+
+    std::remove(filename.c_str());
+}
+
+SCENARIO("Compacted CPD rows", "[cpd][oracle][compact]")
+{
+    warthog::graph::xy_graph g;
+    make_lattice(g, 12, 9);
+
+    warthog::cpd::graph_oracle_base<warthog::cpd::REV_TABLE> oracle(&g);
+    warthog::cpd::reverse_oracle_listener<warthog::cpd::REV_TABLE> listener(
+        &oracle);
+    build_oracle(g, oracle, &listener, true);
+
+    GIVEN("A compacted copy of an oracle")
+    {
+        warthog::cpd::graph_oracle_base<warthog::cpd::REV_TABLE> flat(oracle);
+        flat.compact();
+
+        THEN("It has the same rows in less memory")
+        {
+            REQUIRE(flat.is_flat());
+            REQUIRE(!oracle.is_flat());
+            REQUIRE(oracle == flat);
+            REQUIRE(flat.mem() < oracle.mem());
+            REQUIRE(same_moves(g, oracle, flat));
+        }
+
+        THEN("Its copies own their rows")
+        {
+            warthog::cpd::graph_oracle_base<warthog::cpd::REV_TABLE> copy(
+                flat);
+            flat.clear();
+
+            REQUIRE(copy.is_flat());
+            REQUIRE(oracle == copy);
+        }
+
+        THEN("It serialises the same way")
+        {
+            std::stringstream s1;
+            std::stringstream s2;
+            s1 << oracle;
+            s2 << flat;
+
+            REQUIRE(s1.str() == s2.str());
+
+            warthog::cpd::graph_oracle_base<warthog::cpd::REV_TABLE> other(&g);
+            s2 >> other;
+
+            REQUIRE(other.is_flat());
+            REQUIRE(other == oracle);
+        }
+    }
+}
+
+SCENARIO("Run lookup kernels", "[cpd][run_lookup]")
+{
+    std::mt19937 rng(7);
+
+    GIVEN("Rows of every length up to 100 runs")
+    {
+        THEN("Each kernel finds the run covering every column")
+        {
+            for(uint32_t size = 1; size <= 100; size++)
+            {
+                std::vector<warthog::cpd::rle_run32> row;
+                uint32_t index = 0;
+                for(uint32_t i = 0; i < size; i++)
+                {
+                    row.push_back({(index << 4) | (uint32_t)(rng() % 8)});
+                    index += 1 + rng() % 5;
+                }
+
+                for(uint32_t col = 0; col < index + 3; col++)
+                {
+                    uint32_t expected = 0;
+                    while(expected + 1 < size &&
+                          row.at(expected + 1).get_index() <= col)
+                    { expected++; }
+
+                    REQUIRE(warthog::cpd::find_run_linear(
+                                row.data(), size, col) == expected);
+                    REQUIRE(warthog::cpd::find_run_binary(
+                                row.data(), size, col) == expected);
+                    REQUIRE(warthog::cpd::find_run(
+                                warthog::cpd::rle_row(row), col) == expected);
+                }
+            }
+        }
+    }
+}
+
+SCENARIO("Renumbered graphs", "[cpd][oracle][renumber]")
+{
+    warthog::graph::xy_graph g;
+    make_lattice(g, 12, 9);
+
+    warthog::cpd::graph_oracle oracle(&g);
+    warthog::cpd::graph_oracle_listener<warthog::cpd::FORWARD> listener(
+        &oracle);
+    build_oracle(g, oracle, &listener, false);
+
+    GIVEN("A graph renumbered into column order")
+    {
+        std::vector<uint32_t> order;
+        warthog::cpd::compute_dfs_preorder(&g, &order);
+
+        std::stringstream perm;
+        warthog::cpd::write_permutation(perm, order);
+
+        warthog::graph::xy_graph h;
+        std::vector<uint32_t> ids;
+        make_lattice(h, 12, 9);
+        REQUIRE(warthog::cpd::renumber_graph(perm, &h, ids));
+
+        warthog::cpd::graph_oracle renumbered(&h);
+        warthog::cpd::graph_oracle_listener<warthog::cpd::FORWARD> other(
+            &renumbered);
+        build_oracle(h, renumbered, &other, false);
+        renumbered.compact();
+
+        THEN("Its oracle has an identity order and the same moves")
+        {
+            REQUIRE(renumbered.has_identity_order());
+            REQUIRE(!oracle.has_identity_order());
+
+            for(uint32_t s = 0; s < g.get_num_nodes(); s++)
+            {
+                REQUIRE(oracle.get_row_at(s).size() ==
+                        renumbered.get_row_at(ids.at(s)).size());
+
+                for(uint32_t t = 0; t < g.get_num_nodes(); t++)
+                {
+                    REQUIRE(oracle.get_move(s, t) ==
+                            renumbered.get_move(ids.at(s), ids.at(t)));
+                }
+            }
+        }
+
+        THEN("The identity order is kept in binary files")
+        {
+            std::string filename = "cpd_oracle_test_renumbered.cpd";
+            std::ofstream ofs(filename, std::ios_base::binary);
+            renumbered.write_binary(ofs);
+            ofs.close();
+
+            warthog::cpd::graph_oracle mapped(&h);
+            REQUIRE(mapped.load(filename));
+            REQUIRE(mapped.has_identity_order());
+            REQUIRE(mapped == renumbered);
+
+            std::remove(filename.c_str());
+        }
+    }
+
+    GIVEN("A malformed permutation")
+    {
+        std::stringstream perm("3\n0\n2\n2\n");
+        std::vector<uint32_t> order;
+
+        THEN("It is rejected")
+        {
+            REQUIRE(!warthog::cpd::read_permutation(perm, order));
+        }
+    }
+}
+
+SCENARIO("Batched extractions", "[cpd][oracle][batch]")
+{
+    warthog::graph::xy_graph g;
+    make_lattice(g, 12, 9);
+
+    warthog::cpd::graph_oracle oracle(&g);
+    warthog::cpd::graph_oracle_listener<warthog::cpd::FORWARD> listener(
+        &oracle);
+    build_oracle(g, oracle, &listener, false);
+    oracle.compact();
+
+    std::vector<warthog::sn_id_t> sources;
+    std::vector<warthog::sn_id_t> targets;
+    std::vector<warthog::problem_instance> pis;
+    for(uint32_t s = 0; s < g.get_num_nodes(); s++)
+    {
+        for(uint32_t t = 0; t < g.get_num_nodes(); t += 7)
+        {
+            sources.push_back(s);
+            targets.push_back(t);
+            pis.push_back(warthog::problem_instance(s, t));
+        }
+    }
+
+    GIVEN("Many (source, target) pairs")
+    {
+        THEN("Batched moves are the same as single moves")
+        {
+            std::vector<uint32_t> moves(sources.size());
+            oracle.get_moves(sources.data(), targets.data(), moves.data(),
+                             moves.size());
+
+            for(size_t i = 0; i < moves.size(); i++)
+            {
+                REQUIRE(moves.at(i) ==
+                        oracle.get_move(sources.at(i), targets.at(i)));
+            }
+        }
+
+        THEN("Batched paths are the same as single paths")
+        {
+            warthog::cpd_extractions extract(&g, &oracle);
+            std::vector<warthog::solution> paths;
+            std::vector<warthog::solution> costs;
+
+            for(uint32_t batch : {1, 5, 16})
+            {
+                extract.set_batch_size(batch);
+                extract.get_paths(pis, paths);
+                extract.get_pathcosts(pis, costs);
+
+                for(size_t i = 0; i < pis.size(); i++)
+                {
+                    warthog::solution sol;
+                    extract.get_path(pis.at(i), sol);
+
+                    REQUIRE(paths.at(i).path_ == sol.path_);
+                    REQUIRE(paths.at(i).sum_of_edge_costs_ ==
+                            sol.sum_of_edge_costs_);
+                    REQUIRE(costs.at(i).sum_of_edge_costs_ ==
+                            sol.sum_of_edge_costs_);
+                    REQUIRE(costs.at(i).nodes_touched_ == sol.nodes_touched_);
+                }
+            }
+        }
+    }
+}
+
+SCENARIO("Cut column order", "[cpd][oracle][order]")
+{
+    warthog::graph::xy_graph g;
+    make_lattice(g, 12, 9);
+
+    GIVEN("A graph with an isolated node")
+    {
+        warthog::graph::xy_graph h;
+        make_lattice(h, 12, 9);
+        h.add_node(-5000, -5000);
+
+        std::vector<uint32_t> order;
+        warthog::cpd::compute_cut_order(&h, &order);
+
+        THEN("The order is a permutation of its nodes")
+        {
+            std::vector<uint32_t> sorted(order);
+            std::sort(sorted.begin(), sorted.end());
+            REQUIRE(sorted.size() == h.get_num_nodes());
+            for(uint32_t i = 0; i < sorted.size(); i++)
+            {
+                REQUIRE(sorted.at(i) == i);
+            }
+        }
+    }
+
+    GIVEN("Oracles built with a DFS and a cut order")
+    {
+        warthog::cpd::graph_oracle dfs(&g);
+        warthog::cpd::graph_oracle_listener<warthog::cpd::FORWARD> l_dfs(
+            &dfs);
+        build_oracle(g, dfs, &l_dfs, false, warthog::cpd::DFS_ORDER);
+        dfs.compact();
+
+        warthog::cpd::graph_oracle cut(&g);
+        warthog::cpd::graph_oracle_listener<warthog::cpd::FORWARD> l_cut(
+            &cut);
+        build_oracle(g, cut, &l_cut, false, warthog::cpd::CUT_ORDER);
+        cut.compact();
+
+        THEN("Their paths have the same costs")
+        {
+            // ties between optimal moves are broken to extend runs, so the
+            // moves themselves depend on the order
+            std::vector<warthog::problem_instance> pis;
+            for(uint32_t s = 0; s < g.get_num_nodes(); s++)
+            {
+                for(uint32_t t = 0; t < g.get_num_nodes(); t++)
+                {
+                    pis.push_back(warthog::problem_instance(s, t));
+                }
+            }
+
+            std::vector<warthog::solution> dfs_costs;
+            std::vector<warthog::solution> cut_costs;
+            warthog::cpd_extractions(&g, &dfs).get_pathcosts(pis, dfs_costs);
+            warthog::cpd_extractions(&g, &cut).get_pathcosts(pis, cut_costs);
+
+            for(size_t i = 0; i < pis.size(); i++)
+            {
+                REQUIRE(dfs_costs.at(i).sum_of_edge_costs_ ==
+                        cut_costs.at(i).sum_of_edge_costs_);
+            }
+        }
+
+        THEN("The cut order has fewer runs")
+        {
+            size_t dfs_runs = 0;
+            size_t cut_runs = 0;
+            for(uint32_t i = 0; i < g.get_num_nodes(); i++)
+            {
+                dfs_runs += dfs.get_row_at(i).size();
+                cut_runs += cut.get_row_at(i).size();
+            }
+            REQUIRE(cut_runs < dfs_runs);
+        }
+    }
+}
+
+SCENARIO("First-move Dijkstra", "[cpd][oracle][dijkstra]")
+{
+    warthog::graph::xy_graph g;
+    make_lattice(g, 12, 9);
+
+    GIVEN("CPDs built with the generic and the specialised search")
+    {
+        THEN("Forward rows are identical")
+        {
+            warthog::cpd::graph_oracle a(&g);
+            warthog::cpd::graph_oracle b(&g);
+            warthog::cpd::graph_oracle_listener<warthog::cpd::FORWARD> l(&a);
+            build_oracle(g, a, &l, false);
+            build_oracle_fm(g, b, false);
+            REQUIRE(a == b);
+        }
+
+        THEN("Reverse rows are identical")
+        {
+            warthog::cpd::graph_oracle_base<warthog::cpd::REVERSE> a(&g);
+            warthog::cpd::graph_oracle_base<warthog::cpd::REVERSE> b(&g);
+            warthog::cpd::reverse_oracle_listener<warthog::cpd::REVERSE> l(
+                &a);
+            build_oracle(g, a, &l, true);
+            build_oracle_fm(g, b, true);
+            REQUIRE(a == b);
+        }
+
+        THEN("Table rows are identical")
+        {
+            warthog::cpd::graph_oracle_base<warthog::cpd::TABLE> a(&g);
+            warthog::cpd::graph_oracle_base<warthog::cpd::TABLE> b(&g);
+            warthog::cpd::graph_oracle_listener<warthog::cpd::TABLE> l(&a);
+            build_oracle(g, a, &l, false);
+            build_oracle_fm(g, b, false);
+            REQUIRE(a == b);
+        }
+
+        THEN("Reverse table rows are identical")
+        {
+            warthog::cpd::graph_oracle_base<warthog::cpd::REV_TABLE> a(&g);
+            warthog::cpd::graph_oracle_base<warthog::cpd::REV_TABLE> b(&g);
+            warthog::cpd::reverse_oracle_listener<warthog::cpd::REV_TABLE> l(
+                &a);
+            build_oracle(g, a, &l, true);
+            build_oracle_fm(g, b, true);
+            REQUIRE(a == b);
+        }
+    }
+}
+
+// Compare the rows of @param count sources from @param first, computed in
+// batches of @param lanes sources, with those of first_move_dijkstra.
+bool
+same_grid_rows(warthog::cpd::first_move_graph& fm_graph, uint32_t lanes,
+               uint32_t first, uint32_t count)
+{
+    uint32_t num_nodes = fm_graph.get_num_nodes();
+    warthog::cpd::first_move_dijkstra dijk(&fm_graph);
+    warthog::cpd::grid_first_move_dijkstra grid(&fm_graph, lanes);
+    std::vector<warthog::cpd::fm_coll> row(num_nodes);
+    std::vector<std::vector<warthog::cpd::fm_coll>> rows(
+        lanes, std::vector<warthog::cpd::fm_coll>(num_nodes));
+    std::vector<uint32_t> sources(lanes);
+
+    for(uint32_t i = first; i < first + count; i += lanes)
+    {
+        uint32_t batch = std::min(lanes, first + count - i);
+        std::iota(sources.begin(), sources.begin() + batch, i);
+        grid.compute_rows(sources.data(), batch, rows);
+
+        for(uint32_t l = 0; l < batch; l++)
+        {
+            dijk.compute_row(sources.at(l), row);
+            if(rows.at(l) != row) { return false; }
+        }
+    }
+    return true;
+}
+
+// Stream the rows of a forward CPD to @param filename as `make_cpd` does. The
+// build stops after @param stop rows, losing those after the last
+// checkpoint, and resumes from it.
+void
+stream_oracle(warthog::graph::xy_graph& g, const std::string& filename,
+              bool binary, uint32_t stop)
+{
+    warthog::cpd::graph_oracle cpd(&g);
+    std::vector<warthog::cpd::fm_coll> s_row(g.get_num_nodes());
+    std::vector<warthog::cpd::rle_run32> runs;
+    warthog::cpd::first_move_graph fm_graph(&g, false);
+    warthog::cpd::first_move_dijkstra dijk(&fm_graph);
+    uint32_t num_nodes = g.get_num_nodes();
+
+    cpd.compute_dfs_preorder(0);
+    auto append = [&](warthog::cpd::cpd_writer& writer, uint32_t source_id)
+    {
+        dijk.compute_row(source_id, s_row);
+        runs.clear();
+        cpd.compress_row(source_id, s_row, runs);
+        return writer.append(runs);
+    };
+
+    {
+        warthog::cpd::cpd_writer writer(
+            filename, binary, warthog::cpd::FORWARD, cpd.get_order(),
+            num_nodes, 42);
+        REQUIRE(writer.create());
+        for(uint32_t source_id = 0; source_id < stop; source_id++)
+        {
+            REQUIRE(append(writer, source_id));
+        }
+        REQUIRE(writer.checkpoint());
+        // not checkpointed
+        REQUIRE(append(writer, stop));
+    }
+
+    warthog::cpd::cpd_writer other(
+        filename, binary, warthog::cpd::FORWARD, cpd.get_order(),
+        num_nodes, 7);
+    REQUIRE(!other.resume());
+
+    warthog::cpd::cpd_writer writer(
+        filename, binary, warthog::cpd::FORWARD, cpd.get_order(),
+        num_nodes, 42);
+    REQUIRE(writer.resume());
+    REQUIRE(writer.get_rows_done() == stop);
+    for(uint32_t source_id = stop; source_id < num_nodes; source_id++)
+    {
+        REQUIRE(append(writer, source_id));
+    }
+    REQUIRE(writer.finish());
+}
+
+std::string
+read_file(const std::string& filename)
+{
+    std::ifstream ifs(filename, std::ios_base::binary);
+    std::stringstream ss;
+    ss << ifs.rdbuf();
+    return ss.str();
+}
+
+SCENARIO("Streamed CPD files", "[cpd][oracle][writer]")
+{
+    warthog::graph::xy_graph g;
+    make_lattice(g, 12, 9);
+
+    warthog::cpd::graph_oracle oracle(&g);
+    build_oracle_fm(g, oracle, false);
+    std::string filename = "cpd_oracle_test_writer.cpd";
+
+    GIVEN("A build which stops and resumes from its checkpoint")
+    {
+        THEN("The binary file is the same as the oracle writes")
+        {
+            std::stringstream ss;
+            oracle.write_binary(ss);
+            stream_oracle(g, filename, true, 40);
+
+            REQUIRE(read_file(filename) == ss.str());
+        }
+
+        THEN("The stream file is the same as the oracle writes")
+        {
+            std::stringstream ss;
+            ss << oracle;
+            stream_oracle(g, filename, false, 40);
+
+            REQUIRE(read_file(filename) == ss.str());
+        }
+
+        THEN("The checkpoint is removed")
+        {
+            stream_oracle(g, filename, true, 0);
+
+            std::ifstream ckpt(filename + ".ckpt");
+            REQUIRE(!ckpt.good());
+        }
+    }
+
+    std::remove(filename.c_str());
+}
+
+SCENARIO("Grid first-move Dijkstra", "[cpd][oracle][dijkstra][grid]")
+{
+    warthog::graph::xy_graph g;
+    make_lattice(g, 12, 9);
+
+    GIVEN("A graph with the costs of a grid map")
+    {
+        warthog::cpd::first_move_graph fwd(&g, false);
+        warthog::cpd::first_move_graph rev(&g, true);
+
+        REQUIRE(warthog::cpd::grid_first_move_dijkstra::supports(&fwd));
+        REQUIRE(warthog::cpd::grid_first_move_dijkstra::supports(&rev));
+
+        THEN("Batches of sources give the same rows as single sources")
+        {
+            uint32_t num_nodes = g.get_num_nodes();
+
+            REQUIRE(same_grid_rows(fwd, 1, 0, num_nodes));
+            REQUIRE(same_grid_rows(fwd, 7, 0, num_nodes));
+            REQUIRE(same_grid_rows(fwd, 64, 0, num_nodes));
+            REQUIRE(same_grid_rows(rev, 16, 0, num_nodes));
+            REQUIRE(same_grid_rows(rev, 64, 3, num_nodes - 3));
+        }
+    }
+
+    GIVEN("A graph with other costs")
+    {
+        warthog::graph::xy_graph other;
+        other.grow(3);
+        other.get_node(0)->add_outgoing(warthog::graph::edge(1, 1000));
+        other.get_node(1)->add_outgoing(warthog::graph::edge(2, 2500));
+        warthog::cpd::first_move_graph fm_graph(&other, false);
+
+        THEN("It is not searched by batches")
+        {
+            REQUIRE(!warthog::cpd::grid_first_move_dijkstra::supports(
+                &fm_graph));
+        }
+    }
+
+    GIVEN("Paths which cost too much for 32 bits")
+    {
+        warthog::graph::xy_graph line;
+        uint32_t num_nodes = 6000;
+        line.grow(num_nodes);
+        for(uint32_t i = 0; i + 1 < num_nodes; i++)
+        {
+            line.get_node(i)->add_outgoing(
+                warthog::graph::edge(i + 1, 200000));
+            line.get_node(i + 1)->add_outgoing(
+                warthog::graph::edge(i, 200000));
+        }
+        warthog::cpd::first_move_graph fm_graph(&line, false);
+
+        THEN("Rows are computed one source at a time")
+        {
+            REQUIRE(warthog::cpd::grid_first_move_dijkstra::supports(
+                &fm_graph));
+            REQUIRE(same_grid_rows(fm_graph, 8, 0, 3));
+
+            warthog::cpd::grid_first_move_dijkstra grid(&fm_graph, 8);
+            std::vector<std::vector<warthog::cpd::fm_coll>> rows(
+                1, std::vector<warthog::cpd::fm_coll>(num_nodes));
+            uint32_t source_id = 0;
+            grid.compute_rows(&source_id, 1, rows);
+            REQUIRE(grid.has_overflowed());
+        }
+    }
+}
+
+template<warthog::cpd::symbol S>
+uint64_t
+count_runs(warthog::cpd::graph_oracle_base<S>& cpd)
+{
+    uint64_t num_runs = 0;
+    for(size_t r = 0; r < cpd.get_num_rows(); r++)
+    {
+        num_runs += cpd.get_row_at(r).size();
+    }
+    return num_runs;
+}
+
+// true if the paths extracted from @param cpd cost as much as those of the
+// forward CPD @param ref, for all pairs of nodes
+template<warthog::cpd::symbol S>
+bool
+same_path_costs(warthog::graph::xy_graph& g, warthog::cpd::graph_oracle& ref,
+                warthog::cpd::graph_oracle_base<S>& cpd)
+{
+    warthog::cpd_extractions a(&g, &ref);
+    warthog::cpd_extractions_base<S> b(&g, &cpd);
+    b.set_max_k_moves(g.get_num_nodes());
+
+    for(uint32_t s = 0; s < g.get_num_nodes(); s++)
+    {
+        for(uint32_t t = 0; t < g.get_num_nodes(); t++)
+        {
+            warthog::problem_instance pi(s, t);
+            warthog::solution sol_a;
+            warthog::solution sol_b;
+            a.get_pathcost(pi, sol_a);
+            b.get_pathcost(pi, sol_b);
+            if(sol_a.sum_of_edge_costs_ != sol_b.sum_of_edge_costs_)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+SCENARIO("Bearing CPDs", "[cpd][oracle][bearing]")
+{
+    warthog::graph::xy_graph g;
+    make_lattice(g, 12, 9);
+
+    warthog::cpd::graph_oracle fwd(&g);
+    build_oracle_fm(g, fwd, false);
+
+    GIVEN("A node with edges in all four directions")
+    {
+        // south, east, west and north of node 0
+        warthog::graph::xy_graph star;
+        star.add_node(0, 0);
+        star.add_node(0, -10);
+        star.add_node(10, 0);
+        star.add_node(-10, 0);
+        star.add_node(0, 10);
+        star.add_node(20, 10);
+        for(uint32_t i = 1; i <= 4; i++)
+        {
+            star.get_node(0)->add_outgoing(warthog::graph::edge(i, 10));
+        }
+        warthog::cpd::bearing_table table(&star);
+        uint32_t cw, ccw;
+
+        THEN("Bearings grow counter-clockwise")
+        {
+            using warthog::cpd::bearing_table;
+            REQUIRE(bearing_table::bearing(1, 0) == 0);
+            REQUIRE(bearing_table::bearing(1, 1) <
+                    bearing_table::bearing(0, 1));
+            REQUIRE(bearing_table::bearing(0, 1) <
+                    bearing_table::bearing(-1, 0));
+            REQUIRE(bearing_table::bearing(-1, 0) <
+                    bearing_table::bearing(0, -1));
+            REQUIRE(bearing_table::bearing(0, -1) <
+                    bearing_table::bearing(1, -100));
+        }
+
+        THEN("The wildcards are the edges on either side of the target")
+        {
+            // north-east: east, then north
+            REQUIRE(table.sector(0, 5, cw, ccw));
+            REQUIRE(cw == 1);
+            REQUIRE(ccw == 3);
+
+            // south-east: south, then around to east
+            uint16_t b = warthog::cpd::bearing_table::bearing(1, -1);
+            REQUIRE(table.bearing_sector(0, b, cw, ccw));
+            REQUIRE(cw == 0);
+            REQUIRE(ccw == 1);
+
+            // in the direction of an edge
+            REQUIRE(table.sector(0, 4, cw, ccw));
+            REQUIRE(cw == 3);
+            REQUIRE(ccw == 2);
+
+            REQUIRE(!table.sector(0, 0, cw, ccw));
+            REQUIRE(!table.sector(1, 0, cw, ccw));
+        }
+    }
+
+    GIVEN("A forward bearing CPD")
+    {
+        warthog::cpd::graph_oracle_base<warthog::cpd::FWD_BEARING> a(&g);
+        warthog::cpd::graph_oracle_base<warthog::cpd::FWD_BEARING> b(&g);
+        warthog::cpd::bearing_oracle_listener l(&a);
+        build_oracle(g, a, &l, false);
+        build_oracle_fm(g, b, false);
+
+        THEN("The generic and the specialised search give the same rows")
+        {
+            REQUIRE(a == b);
+        }
+
+        THEN("Paths are optimal")
+        {
+            REQUIRE(same_path_costs(g, fwd, b));
+        }
+
+        THEN("There are fewer runs than in a forward CPD")
+        {
+            REQUIRE(count_runs(b) < count_runs(fwd));
+        }
+    }
+
+    GIVEN("A reverse bearing CPD")
+    {
+        warthog::cpd::graph_oracle_base<warthog::cpd::BEARING> cpd(&g);
+        warthog::cpd::reverse_bearing_oracle_listener l(&cpd);
+        build_oracle(g, cpd, &l, true);
+
+        THEN("Paths are optimal")
+        {
+            REQUIRE(same_path_costs(g, fwd, cpd));
+        }
+
+        THEN("Files of version 1, with other wildcards, are rejected")
+        {
+            std::string filename = "cpd_oracle_test_bearing.cpd";
+            std::ofstream ofs(filename, std::ios_base::binary);
+            cpd.write_binary(ofs);
+            ofs.close();
+
+            warthog::cpd::graph_oracle_base<warthog::cpd::BEARING> other(&g);
+            REQUIRE(other.load(filename));
+
+            std::fstream fs(filename, std::ios_base::binary |
+                            std::ios_base::in | std::ios_base::out);
+            uint32_t version = 1;
+            fs.seekp(offsetof(warthog::cpd::cpd_header, version_));
+            fs.write((char*)&version, sizeof(version));
+            fs.close();
+            REQUIRE(!other.load(filename));
+
+            // stream files of version 1 only start with the graph size
+            size_t prefix = 3 * sizeof(uint32_t);
+            std::stringstream ss;
+            ss << cpd;
+            std::string bytes = ss.str();
+            REQUIRE(bytes.size() > prefix);
+            std::ofstream sfs(filename, std::ios_base::binary);
+            sfs.write(bytes.data() + prefix, bytes.size() - prefix);
+            sfs.close();
+            REQUIRE(!other.load(filename));
+
+            uint32_t symbol;
+            REQUIRE(warthog::cpd::get_file_version(filename, version, symbol));
+            REQUIRE(version == 1);
+            REQUIRE(symbol == UINT32_MAX);
+
+            // which still holds for other symbols
+            std::stringstream fss;
+            fss << fwd;
+            bytes = fss.str();
+            sfs.open(filename, std::ios_base::binary);
+            sfs.write(bytes.data() + prefix, bytes.size() - prefix);
+            sfs.close();
+            warthog::cpd::graph_oracle old(&g);
+            REQUIRE(old.load(filename));
+            REQUIRE(old == fwd);
+
+            std::remove(filename.c_str());
+        }
+    }
+}
+
+// the number of rows of a hybrid CPD stored as tables
+template<warthog::cpd::symbol S>
+uint32_t
+count_tables(warthog::cpd::graph_oracle_base<S>& cpd)
+{
+    uint32_t num_tables = 0;
+    for(size_t r = 0; r < cpd.get_num_rows(); r++)
+    {
+        warthog::cpd::row_handle row = cpd.get_row_at(r);
+        num_tables += row.size() > 0 &&
+            row.at(0).data_ == warthog::cpd::CPD_TABLE_ROW;
+    }
+    return num_tables;
+}
+
+SCENARIO("Hybrid CPDs", "[cpd][oracle][hybrid]")
+{
+    warthog::graph::xy_graph g;
+    make_lattice(g, 12, 9);
+    // words of a table row, tag included
+    uint64_t table_words = 1 + (g.get_num_nodes() + 7) / 8;
+
+    GIVEN("A forward hybrid CPD")
+    {
+        warthog::cpd::graph_oracle fwd(&g);
+        warthog::cpd::graph_oracle_base<warthog::cpd::HYBRID> cpd(&g);
+        build_oracle_fm(g, fwd, false);
+        build_oracle_fm(g, cpd, false);
+
+        THEN("Rows have both encodings and are never larger than runs")
+        {
+            REQUIRE(count_tables(cpd) > 0);
+            REQUIRE(count_tables(cpd) < g.get_num_nodes());
+            REQUIRE(count_runs(cpd) < count_runs(fwd));
+            REQUIRE(count_runs(cpd) < table_words * g.get_num_nodes());
+        }
+
+        // a table keeps the first optimal move of each target, where runs
+        // keep one shared by the whole run
+        THEN("Paths are optimal")
+        {
+            REQUIRE(same_path_costs(g, fwd, cpd));
+        }
+
+        THEN("Moves are the same once compacted")
+        {
+            warthog::cpd::graph_oracle_base<warthog::cpd::HYBRID> flat = cpd;
+            flat.compact();
+            REQUIRE(same_moves(g, cpd, flat));
+        }
+    }
+
+    GIVEN("A table ratio")
+    {
+        warthog::cpd::graph_oracle fwd(&g);
+        warthog::cpd::graph_oracle_base<warthog::cpd::HYBRID> runs(&g);
+        warthog::cpd::graph_oracle_base<warthog::cpd::HYBRID> tables(&g);
+        runs.set_table_ratio(0);
+        tables.set_table_ratio(g.get_num_nodes());
+        build_oracle_fm(g, fwd, false);
+        build_oracle_fm(g, runs, false);
+        build_oracle_fm(g, tables, false);
+
+        THEN("0 keeps runs only")
+        {
+            REQUIRE(count_tables(runs) == 0);
+            REQUIRE(count_runs(runs) == count_runs(fwd));
+            REQUIRE(same_moves(g, fwd, runs));
+        }
+
+        THEN("A large ratio keeps tables only")
+        {
+            REQUIRE(count_tables(tables) == g.get_num_nodes());
+            REQUIRE(count_runs(tables) == table_words * g.get_num_nodes());
+            REQUIRE(same_path_costs(g, fwd, tables));
+        }
+    }
+
+    GIVEN("A reverse hybrid CPD")
+    {
+        warthog::cpd::graph_oracle fwd(&g);
+        warthog::cpd::graph_oracle_base<warthog::cpd::REV_HYBRID> cpd(&g);
+        build_oracle_fm(g, fwd, false);
+        build_oracle_fm(g, cpd, true);
+
+        THEN("Paths are optimal")
+        {
+            REQUIRE(count_tables(cpd) > 0);
+            REQUIRE(same_path_costs(g, fwd, cpd));
+        }
+    }
+}
+
+SCENARIO("Packed tables", "[cpd][oracle][table]")
+{
+    warthog::graph::xy_graph g;
+    make_lattice(g, 12, 9);
+    uint32_t num_nodes = g.get_num_nodes();
+
+    warthog::cpd::graph_oracle fwd(&g);
+    build_oracle_fm(g, fwd, false);
+
+    // 4-bit tables, as written before rows had a width of their own
+    warthog::cpd::graph_oracle_base<warthog::cpd::HYBRID> wide(&g);
+    wide.set_table_ratio(num_nodes);
+    build_oracle_fm(g, wide, false);
+
+    GIVEN("A table CPD of a graph with 8 out-edges per node at most")
+    {
+        warthog::cpd::graph_oracle_base<warthog::cpd::TABLE> cpd(&g);
+        build_oracle_fm(g, cpd, false);
+
+        THEN("Rows take 2 or 3 bits per move")
+        {
+            REQUIRE(warthog::cpd::table_widths_distinct(num_nodes));
+            for(size_t r = 0; r < cpd.get_num_rows(); r++)
+            {
+                uint32_t size = cpd.get_row_at(r).size();
+                REQUIRE(cpd.table_bits(size) < 4);
+                REQUIRE(size == warthog::cpd::table_words(
+                            num_nodes, cpd.table_bits(size)));
+            }
+        }
+
+        THEN("Moves are those of a 4-bit table")
+        {
+            REQUIRE(same_moves(g, wide, cpd));
+        }
+
+        THEN("Rows of 4 bits are still read")
+        {
+            warthog::cpd::graph_oracle_base<warthog::cpd::TABLE> old(&g);
+            old.compute_dfs_preorder(0);
+            for(size_t r = 0; r < wide.get_num_rows(); r++)
+            {
+                // without the tag of hybrid table rows
+                warthog::cpd::row_handle row = wide.get_row_at(r);
+                old.set_row(r, warthog::cpd::rle_row(
+                                row.begin() + 1, row.size() - 1));
+            }
+            old.value_index_swap_array();
+
+            REQUIRE(old.table_bits(wide.get_row_at(0).size() - 1) == 4);
+            REQUIRE(same_moves(g, cpd, old));
+        }
+
+        THEN("Words which equal a row tag are moves")
+        {
+            // rows whose first 16 moves make CPD_DELTA_ROW, CPD_BLOCK_ROW
+            warthog::cpd::graph_oracle_base<warthog::cpd::TABLE> tagged(&g);
+            tagged.copy_column_order(cpd);
+            std::vector<std::vector<warthog::cpd::rle_run32>> rows;
+            for(size_t r = 0; r < cpd.get_num_rows(); r++)
+            {
+                warthog::cpd::row_handle row = cpd.get_row_at(r);
+                rows.emplace_back(row.begin(), row.end());
+            }
+            REQUIRE(cpd.table_bits(rows.at(0).size()) == 2);
+            rows.at(0).at(0).data_ = warthog::cpd::CPD_DELTA_ROW;
+            rows.at(1).at(0).data_ = warthog::cpd::CPD_BLOCK_ROW;
+            for(size_t r = 0; r < rows.size(); r++)
+            {
+                tagged.set_row(r, warthog::cpd::rle_row(
+                                   rows.at(r).data(), rows.at(r).size()));
+            }
+            tagged.value_index_swap_array();
+            tagged.compact();
+
+            REQUIRE(!tagged.has_delta_rows());
+            REQUIRE(!tagged.has_block_rows());
+
+            std::vector<bool> affected(num_nodes, false);
+            affected.at(2) = true;
+            REQUIRE(tagged.mark_delta_rows(affected));
+            REQUIRE(std::count(affected.begin(), affected.end(), true) == 1);
+
+            std::stringstream ss;
+            tagged.write_binary(ss);
+            warthog::cpd::cpd_header header;
+            ss.seekg(0);
+            ss.read((char*)&header, sizeof(header));
+            REQUIRE((header.flags_ & (warthog::cpd::CPD_FLAG_DELTA_ROWS |
+                                      warthog::cpd::CPD_FLAG_BLOCK_ROWS)) ==
+                    0);
+
+            bool same = true;
+            for(uint32_t s = 2; s < num_nodes; s++)
+            {
+                for(uint32_t t = 0; t < num_nodes; t++)
+                {
+                    same = same && tagged.get_move(s, t) == cpd.get_move(s, t);
+                }
+            }
+            REQUIRE(same);
+        }
+
+        THEN("Batched lookups give the same moves")
+        {
+            warthog::cpd::graph_oracle_base<warthog::cpd::TABLE> flat = cpd;
+            flat.compact();
+
+            std::vector<warthog::sn_id_t> sources, targets;
+            for(uint32_t s = 0; s < num_nodes; s++)
+            {
+                for(uint32_t t = 0; t < num_nodes; t++)
+                {
+                    sources.push_back(s);
+                    targets.push_back(t);
+                }
+            }
+            std::vector<uint32_t> moves(sources.size());
+            flat.get_moves(sources.data(), targets.data(), moves.data(),
+                           moves.size());
+
+            bool same = true;
+            for(size_t i = 0; i < moves.size(); i++)
+            {
+                same = same &&
+                    moves.at(i) == cpd.get_move(sources.at(i), targets.at(i));
+            }
+            REQUIRE(same);
+        }
+    }
+
+    GIVEN("A reverse table CPD")
+    {
+        warthog::cpd::graph_oracle_base<warthog::cpd::REV_TABLE> cpd(&g);
+        build_oracle_fm(g, cpd, true);
+
+        THEN("Rows are smaller than 4-bit tables")
+        {
+            REQUIRE(count_runs(cpd) < count_runs(wide) - num_nodes);
+        }
+
+        THEN("Paths are optimal")
+        {
+            REQUIRE(same_path_costs(g, fwd, cpd));
+        }
+    }
+}
+
+SCENARIO("Delta rows", "[cpd][oracle][delta]")
+{
+    warthog::graph::xy_graph g;
+    make_lattice(g, 12, 9);
+
+    GIVEN("A reverse CPD with delta rows")
+    {
+        warthog::cpd::graph_oracle_base<warthog::cpd::REVERSE> rev(&g);
+        build_oracle_fm(g, rev, true);
+        warthog::cpd::graph_oracle_base<warthog::cpd::REVERSE> cpd = rev;
+        REQUIRE(cpd.encode_deltas());
+
+        THEN("Rows take fewer words and moves are the same")
+        {
+            REQUIRE(cpd.has_delta_rows());
+            REQUIRE(count_runs(cpd) < count_runs(rev));
+            REQUIRE(same_moves(g, rev, cpd));
+        }
+
+        THEN("Rows only refer to plain rows")
+        {
+            bool plain = true;
+            for(size_t r = 0; r < cpd.get_num_rows(); r++)
+            {
+                warthog::cpd::row_handle row = cpd.get_row_at(r);
+                if(row.at(0).data_ != warthog::cpd::CPD_DELTA_ROW)
+                { continue; }
+
+                warthog::cpd::row_handle ref = cpd.get_row_at(row.at(1).data_);
+                plain = plain &&
+                    ref.at(0).data_ != warthog::cpd::CPD_DELTA_ROW;
+            }
+            REQUIRE(plain);
+        }
+
+        THEN("Delta rows are kept in binary and stream files")
+        {
+            std::string filename = "cpd_oracle_test_delta.cpd";
+            std::ofstream ofs(filename, std::ios_base::binary);
+            cpd.write_binary(ofs);
+            ofs.close();
+
+            warthog::cpd::graph_oracle_base<warthog::cpd::REVERSE> mapped;
+            REQUIRE(mapped.load(filename));
+            REQUIRE(mapped.has_delta_rows());
+            REQUIRE(same_moves(g, rev, mapped));
+
+            std::stringstream ss;
+            ss << cpd;
+            warthog::cpd::graph_oracle_base<warthog::cpd::REVERSE> read;
+            ss >> read;
+            REQUIRE(read.has_delta_rows());
+            REQUIRE(same_moves(g, rev, read));
+            std::remove(filename.c_str());
+        }
+    }
+
+    GIVEN("A forward bearing CPD with delta rows")
+    {
+        warthog::cpd::graph_oracle_base<warthog::cpd::FWD_BEARING> fb(&g);
+        build_oracle_fm(g, fb, false);
+        warthog::cpd::graph_oracle_base<warthog::cpd::FWD_BEARING> cpd = fb;
+        REQUIRE(cpd.encode_deltas());
+
+        // a source has no bearing to itself, and no move either
+        THEN("Moves are the same")
+        {
+            bool same = true;
+            for(uint32_t s = 0; s < g.get_num_nodes(); s++)
+            {
+                for(uint32_t t = 0; t < g.get_num_nodes(); t++)
+                {
+                    same = same &&
+                        (s == t || fb.get_move(s, t) == cpd.get_move(s, t));
+                }
+            }
+            REQUIRE(count_runs(cpd) <= count_runs(fb));
+            REQUIRE(same);
+        }
+    }
+
+    GIVEN("Identical rows")
+    {
+        std::vector<warthog::cpd::rle_run32> runs = {
+            {0}, {(1 << 4) | 1}, {(2 << 4) | 0}, {(3 << 4) | 2}, // row 0
+            {(0 << 4) | 1}, {(2 << 4) | 0},                      // row 1
+            {0}, {(1 << 4) | 1}, {(2 << 4) | 0}, {(3 << 4) | 2}  // as row 0
+        };
+        std::vector<uint64_t> offsets = {0, 4, 6, 10};
+        std::vector<warthog::cpd::rle_run32> out_runs;
+        std::vector<uint64_t> out_offsets;
+
+        THEN("A row is a patch of its copy, without a graph")
+        {
+            REQUIRE(warthog::cpd::encode_delta_rows(
+                        nullptr, offsets.data(), runs.data(), 3, out_runs,
+                        out_offsets));
+            REQUIRE(out_offsets == std::vector<uint64_t>({0, 4, 6, 9}));
+            REQUIRE(out_runs.at(6).data_ == warthog::cpd::CPD_DELTA_ROW);
+            REQUIRE(out_runs.at(7).data_ == 0);
+            REQUIRE(warthog::cpd::is_delta_hole(out_runs.at(8)));
+        }
+    }
+}
+
+// the move of column @param index in a plain @param row
+uint32_t
+plain_move(const std::vector<warthog::cpd::rle_run32>& row, uint32_t index)
+{
+    warthog::cpd::rle_row r(row);
+    return r.at(warthog::cpd::find_run(r, index)).get_move();
+}
+
+SCENARIO("Block rows", "[cpd][oracle][blocks]")
+{
+    warthog::graph::xy_graph g;
+    make_lattice(g, 30, 20);
+
+    GIVEN("A reverse CPD with block rows")
+    {
+        warthog::cpd::graph_oracle_base<warthog::cpd::REVERSE> rev(&g);
+        build_oracle_fm(g, rev, true);
+        warthog::cpd::graph_oracle_base<warthog::cpd::REVERSE> cpd = rev;
+        REQUIRE(cpd.encode_blocks());
+
+        THEN("Rows take fewer words and moves are the same")
+        {
+            REQUIRE(cpd.has_block_rows());
+            REQUIRE(count_runs(cpd) < count_runs(rev));
+            REQUIRE(same_moves(g, rev, cpd));
+        }
+
+        THEN("Delta rows are encoded first")
+        {
+            warthog::cpd::graph_oracle_base<warthog::cpd::REVERSE> both = rev;
+            REQUIRE(both.encode_deltas());
+            REQUIRE(both.encode_blocks());
+            REQUIRE(both.has_delta_rows());
+            REQUIRE(both.has_block_rows());
+            REQUIRE(same_moves(g, rev, both));
+            REQUIRE(!cpd.encode_deltas());
+        }
+
+        THEN("Block rows are kept in binary and stream files")
+        {
+            std::string filename = "cpd_oracle_test_blocks.cpd";
+            std::ofstream ofs(filename, std::ios_base::binary);
+            cpd.write_binary(ofs);
+            ofs.close();
+
+            warthog::cpd::graph_oracle_base<warthog::cpd::REVERSE> mapped;
+            REQUIRE(mapped.load(filename));
+            REQUIRE(mapped.has_block_rows());
+            REQUIRE(same_moves(g, rev, mapped));
+
+            std::stringstream ss;
+            ss << cpd;
+            warthog::cpd::graph_oracle_base<warthog::cpd::REVERSE> read;
+            ss >> read;
+            REQUIRE(read.has_block_rows());
+            REQUIRE(same_moves(g, rev, read));
+            std::remove(filename.c_str());
+        }
+    }
+
+    GIVEN("Long rows with all moves and gaps of all lengths")
+    {
+        // skewed moves, whose Huffman codes would be longer than the limit
+        std::mt19937 rng(7);
+        std::vector<uint32_t> weights;
+        for(uint32_t m = 0, w = 1; m < warthog::cpd::CPD_FM_MAX; m++)
+        {
+            weights.push_back(w);
+            w = std::min<uint32_t>(2 * w, 1 << 20);
+        }
+        std::discrete_distribution<uint32_t> moves(
+            weights.begin(), weights.end());
+
+        std::vector<warthog::cpd::rle_run32> row;
+        uint32_t col = 0;
+        uint32_t last = UINT32_MAX;
+        while(row.size() < 2000)
+        {
+            uint32_t move = moves(rng);
+            if(move == last) { continue; }
+            row.push_back({(col << 4) | move});
+            last = move;
+
+            uint32_t bits = rng() % 16 == 0 ? 1 + rng() % 20 : 1 + rng() % 3;
+            col += 1 + rng() % (1 << bits);
+        }
+
+        std::vector<warthog::cpd::rle_run32> out(1, {0});
+        REQUIRE(warthog::cpd::encode_block_row(
+                    warthog::cpd::rle_row(row), out));
+        warthog::cpd::rle_row block(out.data() + 1, out.size() - 1);
+
+        THEN("Every column has the move of its run")
+        {
+            REQUIRE(block.at(0).data_ == warthog::cpd::CPD_BLOCK_ROW);
+            REQUIRE(block.size() < row.size());
+
+            bool same = true;
+            for(warthog::cpd::rle_run32 run : row)
+            {
+                uint32_t head = run.get_index();
+                for(uint32_t c = head > 0 ? head - 1 : 0; c <= head + 1; c++)
+                {
+                    same = same && warthog::cpd::get_block_move(block, c) ==
+                        plain_move(row, c);
+                }
+            }
+            REQUIRE(same);
+        }
+
+        THEN("Short rows are left as they are")
+        {
+            std::vector<warthog::cpd::rle_run32> shorter(
+                row.begin(), row.begin() + warthog::cpd::CPD_BLOCK_RUNS);
+            REQUIRE(!warthog::cpd::encode_block_row(
+                        warthog::cpd::rle_row(shorter), out));
+            REQUIRE(out.size() == block.size() + 1);
+        }
+    }
+}
+
+// Same steps as `make_cpd --repair`, single-threaded, once the rows which may
+// change are marked in @param affected and the graph has its new costs.
+template<warthog::cpd::symbol S>
+void
+repair_oracle(warthog::graph::xy_graph& g,
+              warthog::cpd::graph_oracle_base<S>& cpd,
+              const std::vector<bool>& affected, bool reverse)
+{
+    warthog::cpd::first_move_graph fm_graph(&g, reverse);
+    warthog::cpd::first_move_dijkstra dijk(&fm_graph);
+    warthog::cpd::graph_oracle_base<S> builder(&g);
+    builder.copy_column_order(cpd);
+
+    std::vector<warthog::cpd::fm_coll> s_row(g.get_num_nodes());
+    std::vector<uint32_t> row_ids;
+    std::vector<std::vector<warthog::cpd::rle_run32>> rows;
+    for(uint32_t r = 0; r < g.get_num_nodes(); r++)
+    {
+        if(!affected.at(r)) { continue; }
+        dijk.compute_row(r, s_row);
+        row_ids.push_back(r);
+        rows.emplace_back();
+        builder.compress_row(r, s_row, rows.back());
+    }
+    cpd.replace_rows(row_ids, rows);
+}
+
+SCENARIO("Repaired CPDs", "[cpd][oracle][repair]")
+{
+    warthog::graph::xy_graph g;
+    make_lattice(g, 20, 14);
+
+    warthog::cpd::graph_oracle fwd(&g);
+    warthog::cpd::graph_oracle_base<warthog::cpd::REVERSE> rev(&g);
+    build_oracle_fm(g, fwd, false);
+    build_oracle_fm(g, rev, true);
+    warthog::cpd::graph_oracle_base<warthog::cpd::REVERSE> delta = rev;
+    REQUIRE(delta.encode_deltas());
+    warthog::cpd::graph_oracle_base<warthog::cpd::REVERSE> blocks = rev;
+    REQUIRE(blocks.encode_blocks());
+
+    // a longer edge, a shorter one and one which stays the same
+    uint32_t mid = g.get_num_nodes() / 2;
+    std::vector<std::pair<uint32_t, warthog::graph::edge>> edges;
+    for(uint32_t n : {0u, mid, mid + 1})
+    {
+        edges.push_back({n, *g.get_node(n)->outgoing_begin()});
+    }
+    edges.at(0).second.wt_ *= 10;
+    edges.at(1).second.wt_ /= 4;
+
+    std::vector<warthog::cpd::edge_change> changes;
+    warthog::cpd::changed_edges(&g, edges, changes);
+
+    // with the old costs
+    auto affected_rows = [&](bool reverse)
+    {
+        warthog::cpd::first_move_graph fm_graph(&g, !reverse);
+        warthog::cpd::row_repair repair(&fm_graph);
+        std::vector<bool> affected(g.get_num_nodes(), false);
+        for(auto& change : changes) { repair.mark_rows(change, affected); }
+        return affected;
+    };
+    std::vector<bool> fwd_rows = affected_rows(false);
+    std::vector<bool> rev_rows = affected_rows(true);
+    std::vector<bool> delta_rows = rev_rows;
+    REQUIRE(delta.mark_delta_rows(delta_rows));
+
+    g.perturb(edges);
+    warthog::cpd::graph_oracle fresh_fwd(&g);
+    warthog::cpd::graph_oracle_base<warthog::cpd::REVERSE> fresh_rev(&g);
+    build_oracle_fm(g, fresh_fwd, false);
+    build_oracle_fm(g, fresh_rev, true);
+
+    GIVEN("Edges with new costs")
+    {
+        THEN("Only the changed edges are found")
+        {
+            REQUIRE(changes.size() == 2);
+            REQUIRE(changes.at(0).tail_ == 0);
+            REQUIRE(changes.at(0).new_wt_ == 10 * changes.at(0).old_wt_);
+            REQUIRE(changes.at(1).tail_ == mid);
+        }
+
+        THEN("Some rows are repaired, but not all")
+        {
+            for(auto* rows : {&fwd_rows, &rev_rows})
+            {
+                size_t count = std::count(rows->begin(), rows->end(), true);
+                REQUIRE(count > 0);
+                REQUIRE(count < g.get_num_nodes());
+            }
+        }
+
+        THEN("The reverse edges have the new costs")
+        {
+            warthog::graph::node* head = g.get_node(changes.at(1).head_);
+            warthog::graph::edge_iter eit = head->find_edge(
+                mid, head->incoming_begin(), head->incoming_end());
+            REQUIRE(eit != head->incoming_end());
+            REQUIRE(eit->wt_ == changes.at(1).new_wt_);
+        }
+    }
+
+    GIVEN("A diff which lists an edge twice")
+    {
+        warthog::graph::xy_graph pg(0, "", true);
+        std::stringstream xy;
+        xy << "nodes 3 edges 3\n"
+           << "v 0 0 0\nv 1 1 0\nv 2 2 0\n"
+           << "e 0 1 5\ne 0 1 7\ne 1 2 1\n";
+        xy >> pg;
+
+        std::vector<std::pair<uint32_t, warthog::graph::edge>> diff;
+        diff.push_back({0, warthog::graph::edge(1, 8)});
+        diff.push_back({0, warthog::graph::edge(1, 9)});
+
+        std::vector<warthog::cpd::edge_change> pchanges;
+        warthog::cpd::changed_edges(&pg, diff, pchanges);
+        pg.perturb(diff);
+
+        THEN("The edge gets the cheapest cost, as when loaded")
+        {
+            warthog::graph::node* tail = pg.get_node(0);
+            warthog::graph::node* head = pg.get_node(1);
+            REQUIRE(tail->out_degree() == 1);
+            REQUIRE(tail->outgoing_begin()->wt_ == 8);
+            REQUIRE(head->incoming_begin()->wt_ == 8);
+
+            REQUIRE(pchanges.size() == 1);
+            REQUIRE(pchanges.at(0).old_wt_ == 5);
+            REQUIRE(pchanges.at(0).new_wt_ == 8);
+        }
+    }
+
+    GIVEN("CPDs built with the old costs")
+    {
+        repair_oracle(g, fwd, fwd_rows, false);
+        repair_oracle(g, rev, rev_rows, true);
+        repair_oracle(g, delta, delta_rows, true);
+        repair_oracle(g, blocks, rev_rows, true);
+
+        THEN("Repaired CPDs are those built with the new costs")
+        {
+            REQUIRE(fwd == fresh_fwd);
+            REQUIRE(rev == fresh_rev);
+        }
+
+        THEN("Delta rows are repaired with the rows they refer to")
+        {
+            REQUIRE(delta.has_delta_rows());
+            REQUIRE(same_moves(g, fresh_rev, delta));
+        }
+
+        THEN("Repaired rows are coded as blocks in turn")
+        {
+            size_t runs = count_runs(blocks);
+            REQUIRE(blocks.encode_blocks());
+            REQUIRE(count_runs(blocks) < runs);
+            REQUIRE(same_moves(g, fresh_rev, blocks));
+        }
+    }
+}
+
+SCENARIO("Lazy CPDs", "[cpd][oracle][lazy]")
+{
+    warthog::graph::xy_graph g;
+    make_lattice(g, 16, 10);
+    uint32_t num_nodes = g.get_num_nodes();
+
+    GIVEN("A lazy reverse CPD without background threads")
+    {
+        warthog::cpd::graph_oracle_base<warthog::cpd::REVERSE> ref(&g);
+        build_oracle_fm(g, ref, true);
+        warthog::cpd::graph_oracle_base<warthog::cpd::REVERSE> cpd(&g);
+        REQUIRE(cpd.make_lazy(warthog::cpd::DFS_ORDER, 0));
+
+        THEN("Rows are computed as they are looked up")
+        {
+            REQUIRE(cpd.is_lazy());
+            REQUIRE(cpd.get_num_lazy_rows_done() == 0);
+            REQUIRE(cpd.get_move(3, 7) == ref.get_move(3, 7));
+            REQUIRE(cpd.get_num_lazy_rows_done() == 1);
+            REQUIRE(same_moves(g, ref, cpd));
+            REQUIRE(cpd.get_num_lazy_rows_done() == num_nodes);
+        }
+
+        THEN("A compacted lazy CPD is a complete one")
+        {
+            cpd.compact();
+            REQUIRE(!cpd.is_lazy());
+            REQUIRE(cpd == ref);
+        }
+    }
+
+    GIVEN("Lazy CPDs with background threads and concurrent readers")
+    {
+        warthog::cpd::graph_oracle_base<warthog::cpd::REV_TABLE> ref(&g);
+        build_oracle_fm(g, ref, true);
+        warthog::cpd::graph_oracle_base<warthog::cpd::REV_TABLE> cpd(&g);
+        REQUIRE(cpd.make_lazy(warthog::cpd::DFS_ORDER, 2));
+
+        // each reader looks up every move, from a different target
+        std::vector<std::vector<uint32_t>> moves(4);
+        std::vector<std::thread> readers;
+        for(uint32_t r = 0; r < moves.size(); r++)
+        {
+            readers.emplace_back([&, r]()
+            {
+                for(uint32_t i = 0; i < num_nodes; i++)
+                {
+                    uint32_t t = (i + r * num_nodes / 4) % num_nodes;
+                    for(uint32_t s = 0; s < num_nodes; s++)
+                    {
+                        moves.at(r).push_back(cpd.get_move(s, t));
+                    }
+                }
+            });
+        }
+        for(std::thread& t : readers) { t.join(); }
+
+        THEN("Every reader gets the moves of the complete CPD")
+        {
+            bool same = true;
+            for(uint32_t r = 0; r < moves.size(); r++)
+            {
+                size_t k = 0;
+                for(uint32_t i = 0; i < num_nodes; i++)
+                {
+                    uint32_t t = (i + r * num_nodes / 4) % num_nodes;
+                    for(uint32_t s = 0; s < num_nodes; s++)
+                    {
+                        same = same &&
+                            moves.at(r).at(k++) == ref.get_move(s, t);
+                    }
+                }
+            }
+            REQUIRE(same);
+            REQUIRE(cpd.get_num_lazy_rows_done() == num_nodes);
+        }
+    }
+}
+
+SCENARIO("Tiered CPDs", "[cpd][oracle][tiered]")
+{
+    warthog::graph::xy_graph g;
+    make_lattice(g, 16, 10);
+    uint32_t num_nodes = g.get_num_nodes();
+
+    warthog::cpd::graph_oracle_base<warthog::cpd::REVERSE> rev(&g);
+    build_oracle_fm(g, rev, true);
+    warthog::cpd::graph_oracle_base<warthog::cpd::REVERSE> delta = rev;
+    REQUIRE(delta.encode_deltas());
+
+    std::string filename = "cpd_oracle_test_tiered.cpd";
+    std::ofstream ofs(filename, std::ios_base::binary);
+    delta.write_binary(ofs);
+    ofs.close();
+
+    GIVEN("A cache which holds every row")
+    {
+        warthog::cpd::graph_oracle_base<warthog::cpd::REVERSE> cpd(&g);
+        REQUIRE(cpd.load_tiered(filename, 1 << 20));
+
+        THEN("Rows are read from disk once")
+        {
+            REQUIRE(cpd.is_tiered());
+            REQUIRE(cpd.has_delta_rows());
+            REQUIRE(same_moves(g, rev, cpd));
+
+            const warthog::cpd::row_cache* cache = cpd.get_row_cache();
+            REQUIRE(cache->get_misses() == num_nodes);
+            REQUIRE(cache->get_hits() > 0);
+        }
+
+        THEN("A compacted tiered CPD is read in memory")
+        {
+            cpd.compact();
+            REQUIRE(!cpd.is_tiered());
+            REQUIRE(cpd == delta);
+        }
+    }
+
+    GIVEN("A cache much smaller than the CPD")
+    {
+        // a few rows per shard
+        size_t capacity = 8192;
+        warthog::cpd::graph_oracle_base<warthog::cpd::REVERSE> cpd(&g);
+        REQUIRE(cpd.load_tiered(filename, capacity));
+
+        THEN("Rows are evicted and moves stay the same")
+        {
+            REQUIRE(same_moves(g, rev, cpd));
+
+            const warthog::cpd::row_cache* cache = cpd.get_row_cache();
+            REQUIRE(cache->get_misses() > num_nodes);
+            REQUIRE(cache->get_cached_bytes() <= capacity);
+        }
+
+        THEN("Rows stay valid while their handles are held")
+        {
+            warthog::cpd::row_handle first = cpd.get_row_at(0);
+            std::vector<warthog::cpd::rle_run32> runs(
+                first.begin(), first.end());
+            // evicts row 0, from the shards and this thread
+            for(uint32_t row_id = 1; row_id < num_nodes; row_id++)
+            {
+                cpd.get_row_at(row_id);
+            }
+            REQUIRE(std::equal(runs.begin(), runs.end(),
+                    first.begin(), first.end(),
+                    [](const warthog::cpd::rle_run32& a,
+                       const warthog::cpd::rle_run32& b)
+                    { return a.data_ == b.data_; }));
+        }
+
+        THEN("Concurrent readers get the same moves")
+        {
+            std::vector<char> same(4, true);
+            std::vector<std::thread> readers;
+            for(uint32_t r = 0; r < same.size(); r++)
+            {
+                readers.emplace_back([&, r]()
+                {
+                    for(uint32_t i = 0; i < num_nodes; i++)
+                    {
+                        uint32_t t = (i + r * num_nodes / 4) % num_nodes;
+                        for(uint32_t s = 0; s < num_nodes; s++)
+                        {
+                            same.at(r) = same.at(r) &&
+                                cpd.get_move(s, t) == rev.get_move(s, t);
+                        }
+                    }
+                });
+            }
+            for(std::thread& t : readers) { t.join(); }
+
+            REQUIRE(std::count(same.begin(), same.end(), true) == 4);
+        }
+    }
+
+    std::remove(filename.c_str());
+}
+
+SCENARIO("Cost matrices", "[cpd][oracle][matrix]")
+{
+    warthog::graph::xy_graph g;
+    make_lattice(g, 16, 10);
+    // no path to or from it
+    uint32_t isolated = g.add_node(-5000, -5000);
+
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<uint32_t> node(0, isolated - 1);
+    std::vector<warthog::sn_id_t> sources = {isolated, 0, 0};
+    std::vector<warthog::sn_id_t> targets = {0, isolated};
+    for(uint32_t i = 0; i < 30; i++) { sources.push_back(node(rng)); }
+    for(uint32_t i = 0; i < 20; i++) { targets.push_back(node(rng)); }
+
+    GIVEN("Forward and reverse CPDs")
+    {
+        warthog::cpd::graph_oracle fwd(&g);
+        build_oracle_fm(g, fwd, false);
+        warthog::cpd::graph_oracle_base<warthog::cpd::REVERSE> rev(&g);
+        build_oracle_fm(g, rev, true);
+
+        warthog::cpd_extractions ext(&g, &fwd);
+        std::vector<warthog::cost_t> ref;
+        for(warthog::sn_id_t s : sources)
+        {
+            for(warthog::sn_id_t t : targets)
+            {
+                if(s == isolated || t == isolated)
+                {
+                    ref.push_back(s == t ? 0 : warthog::COST_MAX);
+                    continue;
+                }
+                warthog::problem_instance pi(s, t);
+                warthog::solution sol;
+                ext.get_pathcost(pi, sol);
+                ref.push_back(sol.sum_of_edge_costs_);
+            }
+        }
+
+        THEN("Costs are those of single extractions")
+        {
+            warthog::cpd_matrix matrix(&g, &fwd);
+            std::vector<warthog::cost_t> costs;
+            matrix.get_costs(sources, targets, costs);
+            REQUIRE(costs == ref);
+        }
+
+        THEN("Threads give the same costs")
+        {
+            warthog::cpd_matrix_base<warthog::cpd::REVERSE> matrix(&g, &rev);
+            std::vector<warthog::cost_t> costs;
+            matrix.get_costs(sources, targets, costs, 3);
+            REQUIRE(costs == ref);
+
+        }
+
+        THEN("Memos are not kept between matrices")
+        {
+            warthog::cpd_matrix_base<warthog::cpd::REVERSE> matrix(&g, &rev);
+            std::vector<warthog::cost_t> costs;
+            matrix.get_costs(sources, targets, costs, 2);
+
+            // the lattice is undirected
+            matrix.get_costs(targets, sources, costs, 2);
+            bool same = costs.size() == ref.size();
+            for(size_t i = 0; same && i < sources.size(); i++)
+            {
+                for(size_t j = 0; j < targets.size(); j++)
+                {
+                    same = same && costs.at(j * sources.size() + i) ==
+                        ref.at(i * targets.size() + j);
+                }
+            }
+            REQUIRE(same);
+        }
+    }
+}
+
+SCENARIO("Distance labels", "[cpd][oracle][distances]")
+{
+    warthog::graph::xy_graph g;
+    make_lattice(g, 16, 10);
+    // a one-way shortcut, so that costs are not symmetric
+    uint32_t last = g.get_num_nodes() - 1;
+    g.get_node(0)->add_outgoing(warthog::graph::edge(last, 2000));
+    g.get_node(last)->add_incoming(warthog::graph::edge(0, 2000));
+    // no path to or from it
+    uint32_t isolated = g.add_node(-5000, -5000);
+
+    warthog::cpd::graph_oracle fwd(&g);
+    build_oracle_fm(g, fwd, false);
+    warthog::cpd_extractions ext(&g, &fwd);
+
+    warthog::cpd::hub_labels labels;
+    labels.build(&g);
+
+    GIVEN("Labels of the graph")
+    {
+        REQUIRE(labels.get_num_nodes() == g.get_num_nodes());
+
+        THEN("Costs are those of the CPD paths")
+        {
+            bool same = true;
+            for(uint32_t s = 0; s < isolated; s++)
+            {
+                for(uint32_t t = 0; t < isolated; t++)
+                {
+                    warthog::problem_instance pi(s, t);
+                    warthog::solution sol;
+                    ext.get_pathcost(pi, sol);
+                    same = same &&
+                        labels.get_cost(s, t) == sol.sum_of_edge_costs_;
+                }
+            }
+            REQUIRE(same);
+            REQUIRE(labels.get_cost(0, last) == 2000);
+            REQUIRE(labels.get_cost(last, 0) > 2000);
+        }
+
+        THEN("Unreachable pairs have no cost")
+        {
+            REQUIRE(labels.get_cost(isolated, isolated) == 0);
+            REQUIRE(labels.get_cost(0, isolated) == warthog::COST_MAX);
+            REQUIRE(labels.get_cost(isolated, 0) == warthog::COST_MAX);
+        }
+
+        THEN("Labels are smaller than the all-pairs table")
+        {
+            uint64_t num_nodes = g.get_num_nodes();
+            REQUIRE(labels.get_num_entries() < num_nodes * num_nodes / 4);
+        }
+    }
+
+    GIVEN("Labels written to a stream")
+    {
+        std::stringstream ss;
+        labels.write(ss);
+        std::string data = ss.str();
+
+        THEN("They read back the same")
+        {
+            warthog::cpd::hub_labels copy;
+            std::stringstream in(data);
+            REQUIRE(copy.read(in));
+            REQUIRE(copy.get_num_entries() == labels.get_num_entries());
+
+            bool same = true;
+            for(uint32_t s = 0; s < g.get_num_nodes(); s += 7)
+            {
+                for(uint32_t t = 0; t < g.get_num_nodes(); t++)
+                {
+                    same = same &&
+                        copy.get_cost(s, t) == labels.get_cost(s, t);
+                }
+            }
+            REQUIRE(same);
+        }
+
+        THEN("Truncated or corrupt streams are rejected")
+        {
+            warthog::cpd::hub_labels copy;
+            std::stringstream truncated(data.substr(0, data.size() / 2));
+            REQUIRE(!copy.read(truncated));
+
+            std::string bad = data;
+            bad.at(0) ^= 0xff;
+            std::stringstream corrupt(bad);
+            REQUIRE(!copy.read(corrupt));
+        }
+    }
+
+    GIVEN("Extractions and matrices which use the labels")
+    {
+        warthog::cpd_extractions with(&g, &fwd);
+        with.set_distances(&labels);
+
+        std::vector<warthog::problem_instance> pis;
+        for(uint32_t s = 0; s < isolated; s += 5)
+        {
+            pis.push_back(warthog::problem_instance(s, (s * 31) % isolated));
+        }
+
+        THEN("They give the same costs")
+        {
+            std::vector<warthog::solution> walked, looked_up;
+            ext.get_pathcosts(pis, walked);
+            with.get_pathcosts(pis, looked_up);
+            REQUIRE(walked.size() == looked_up.size());
+            bool same = true;
+            for(size_t i = 0; i < walked.size(); i++)
+            {
+                same = same && walked.at(i).sum_of_edge_costs_ ==
+                    looked_up.at(i).sum_of_edge_costs_;
+            }
+            REQUIRE(same);
+
+            std::vector<warthog::sn_id_t> nodes = {0, last, 17, 99};
+            std::vector<warthog::cost_t> ref, costs;
+            warthog::cpd_matrix matrix(&g, &fwd);
+            matrix.get_costs(nodes, nodes, ref);
+            matrix.set_distances(&labels);
+            matrix.get_costs(nodes, nodes, costs, 2);
+            REQUIRE(costs == ref);
+        }
+    }
+}
+
+SCENARIO("Bounded CPDs", "[cpd][oracle][bounded]")
+{
+    warthog::graph::xy_graph g(0, "", true);
+    make_lattice(g, 30, 20);
+    // no path to or from it
+    uint32_t isolated = g.add_node(-5000, -5000);
+    uint32_t num_nodes = g.get_num_nodes();
+
+    typedef warthog::cpd::graph_oracle_base<warthog::cpd::REVERSE> rev_oracle;
+    rev_oracle exact(&g);
+    build_oracle_fm(g, exact, true);
+
+    // a reverse CPD whose paths are within (1 + epsilon) of optimal
+    auto build_bounded = [&](rev_oracle& cpd, double epsilon)
+    {
+        std::vector<warthog::cpd::fm_coll> row(num_nodes);
+        std::vector<warthog::cpd::rle_run32> runs;
+        warthog::cpd::first_move_graph fm_graph(&g, true);
+        warthog::cpd::first_move_dijkstra dijk(&fm_graph);
+        warthog::cpd::bounded_rows bounded(&g, epsilon);
+
+        double bound = 0;
+        cpd.compute_dfs_preorder(0);
+        for(uint32_t target_id = 0; target_id < num_nodes; target_id++)
+        {
+            dijk.compute_row(target_id, row);
+            bounded.widen(target_id, dijk, row);
+            runs.clear();
+            cpd.compress_row(target_id, row, runs);
+            bound = std::max(bound, bounded.get_bound(
+                target_id, dijk, cpd.get_order(), runs));
+            cpd.set_row(target_id, warthog::cpd::rle_row(runs));
+        }
+        cpd.value_index_swap_array();
+        cpd.set_bound(bound);
+        return bound;
+    };
+
+    auto num_runs = [&](rev_oracle& cpd)
+    {
+        uint64_t retval = 0;
+        for(uint32_t row_id = 0; row_id < cpd.get_num_rows(); row_id++)
+        {
+            retval += cpd.get_row_at(row_id).size();
+        }
+        return retval;
+    };
+
+    GIVEN("An epsilon of 0")
+    {
+        rev_oracle cpd(&g);
+        REQUIRE(build_bounded(cpd, 0) == 0);
+
+        THEN("The CPD is exact")
+        {
+            REQUIRE(cpd == exact);
+        }
+    }
+
+    GIVEN("A positive epsilon")
+    {
+        // a move which is not optimal on the lattice is at least ~41% longer
+        // than the cost it saves
+        double epsilon = 0.5;
+        rev_oracle cpd(&g);
+        double bound = build_bounded(cpd, epsilon);
+
+        THEN("The CPD has fewer runs")
+        {
+            REQUIRE(bound > 0);
+            REQUIRE(bound <= epsilon);
+            REQUIRE(num_runs(cpd) < num_runs(exact));
+        }
+
+        THEN("Paths are within the achieved bound, which is tight")
+        {
+            warthog::cpd_extractions_base<warthog::cpd::REVERSE> lossy(
+                &g, &cpd);
+            warthog::cpd_extractions_base<warthog::cpd::REVERSE> optimal(
+                &g, &exact);
+            double worst = 0;
+            for(uint32_t s = 0; s < isolated; s++)
+            {
+                for(uint32_t t = 0; t < isolated; t++)
+                {
+                    warthog::problem_instance pi(s, t);
+                    warthog::solution a, b;
+                    lossy.get_pathcost(pi, a);
+                    optimal.get_pathcost(pi, b);
+                    if(s == t) { continue; }
+                    worst = std::max(
+                        worst, a.sum_of_edge_costs_ / b.sum_of_edge_costs_ - 1);
+                }
+            }
+            REQUIRE(worst <= bound + 1e-12);
+            REQUIRE(worst >= bound - 1e-12);
+        }
+
+        THEN("Binary files record the bound")
+        {
+            std::string filename = "cpd_oracle_test_bounded.cpd";
+            std::ofstream ofs(filename, std::ios_base::binary);
+            cpd.write_binary(ofs);
+            ofs.close();
+
+            rev_oracle mapped(&g);
+            REQUIRE(mapped.load(filename));
+            REQUIRE(mapped.get_bound() == bound);
+            REQUIRE(mapped == cpd);
+
+            rev_oracle tiered(&g);
+            REQUIRE(tiered.load_tiered(filename, 1 << 20));
+            REQUIRE(tiered.get_bound() == bound);
+
+            std::ofstream efs(filename, std::ios_base::binary);
+            exact.write_binary(efs);
+            efs.close();
+            REQUIRE(mapped.load(filename));
+            REQUIRE(mapped.get_bound() == 0);
+
+            // and so do streamed ones, in the same column order
+            rev_oracle columns(&g);
+            columns.compute_dfs_preorder(0);
+            warthog::cpd::cpd_writer writer(
+                filename, true, warthog::cpd::REVERSE, columns.get_order(),
+                num_nodes, 0);
+            REQUIRE(writer.create());
+            for(uint32_t row_id = 0; row_id < num_nodes; row_id++)
+            {
+                warthog::cpd::row_handle row = cpd.get_row_at(row_id);
+                REQUIRE(writer.append(std::vector<warthog::cpd::rle_run32>(
+                    row.begin(), row.end())));
+            }
+            writer.add_bound(bound);
+            REQUIRE(writer.finish());
+            REQUIRE(mapped.load(filename));
+            REQUIRE(mapped.get_bound() == bound);
+            REQUIRE(mapped == cpd);
+            std::remove(filename.c_str());
+        }
+    }
+}
+
+SCENARIO("Published CPDs", "[cpd][oracle][published]")
+{
+    warthog::graph::xy_graph g;
+    make_lattice(g, 12, 9);
+
+    warthog::cpd::graph_oracle first(&g);
+    build_oracle_fm(g, first, false);
+
+    // the same graph without diagonal moves, so that moves differ
+    warthog::graph::xy_graph straight;
+    make_lattice(straight, 12, 9);
+    for(uint32_t id = 0; id < straight.get_num_nodes(); id++)
+    {
+        warthog::graph::node* n = straight.get_node(id);
+        for(auto e = n->outgoing_begin(); e != n->outgoing_end(); e++)
+        {
+            if(e->wt_ > 1000) { e->wt_ = 3000; }
+        }
+    }
+    warthog::cpd::graph_oracle second(&straight);
+    build_oracle_fm(straight, second, false);
+    REQUIRE(!same_moves(g, first, second));
+
+    std::string filename = "cpd_oracle_test_published.cpd";
+    std::string new_name = "cpd_oracle_test_published.cpd.new";
+    auto write_build = [&](warthog::cpd::graph_oracle& cpd)
+    {
+        std::ofstream ofs(new_name, std::ios_base::binary);
+        cpd.write_binary(ofs);
+    };
+
+    warthog::cpd::published_cpd published(filename);
+    published.unlink();
+    REQUIRE(published.open());
+    REQUIRE(published.get_version() == 0);
+
+    // a process which serves the file before any build is published
+    warthog::cpd::published_cpd reader(filename);
+    REQUIRE(reader.open());
+    REQUIRE(reader.get_version() == 0);
+
+    GIVEN("A published build")
+    {
+        write_build(first);
+        REQUIRE(published.publish(new_name));
+
+        warthog::cpd::graph_oracle mapped(&g);
+        REQUIRE(mapped.load(filename));
+
+        THEN("It is served at the first version")
+        {
+            REQUIRE(published.get_version() == 1);
+            REQUIRE(same_moves(g, first, mapped));
+
+            // other processes see it through the shared memory
+            warthog::cpd::published_cpd other(filename);
+            REQUIRE(other.open());
+            REQUIRE(other.get_version() == 1);
+            REQUIRE(reader.get_version() == 1);
+        }
+
+        THEN("Only the publisher can write the version")
+        {
+            struct stat st;
+            std::string shm_file = "/dev/shm" + published.get_shm_name();
+            REQUIRE(stat(shm_file.c_str(), &st) == 0);
+            REQUIRE((st.st_mode & 0022) == 0);
+        }
+
+        THEN("A new build replaces it")
+        {
+            write_build(second);
+            REQUIRE(published.publish(new_name));
+            REQUIRE(published.get_version() == 2);
+
+            // a mapping of the old build stays valid
+            REQUIRE(same_moves(g, first, mapped));
+
+            warthog::cpd::graph_oracle fresh(&g);
+            REQUIRE(fresh.load(filename));
+            REQUIRE(same_moves(g, second, fresh));
+        }
+
+        THEN("Invalid builds are not published")
+        {
+            write_build(second);
+            std::ifstream ifs(new_name, std::ios_base::binary);
+            std::string bytes((std::istreambuf_iterator<char>(ifs)),
+                              std::istreambuf_iterator<char>());
+            ifs.close();
+            std::ofstream ofs(new_name, std::ios_base::binary);
+            ofs.write(bytes.data(), bytes.size() / 2);
+            ofs.close();
+
+            REQUIRE(!published.publish(new_name));
+            REQUIRE(!published.publish("cpd_oracle_test_missing.cpd"));
+
+            // nor is a build of another kind of CPD
+            write_build(second);
+            std::fstream fs(new_name, std::ios_base::binary |
+                            std::ios_base::in | std::ios_base::out);
+            uint32_t symbol = warthog::cpd::REVERSE;
+            fs.seekp(offsetof(warthog::cpd::cpd_header, symbol_));
+            fs.write((char*)&symbol, sizeof(symbol));
+            fs.close();
+            REQUIRE(!published.publish(new_name));
+            REQUIRE(published.get_version() == 1);
+
+            warthog::cpd::graph_oracle fresh(&g);
+            REQUIRE(fresh.load(filename));
+            REQUIRE(same_moves(g, first, fresh));
+            std::remove(new_name.c_str());
+        }
+    }
+
+    REQUIRE(published.unlink());
+    std::remove(filename.c_str());
+}
+
+// Write the rows of @param nodes of a reverse CPD to the binary partial CPD
+// @param filename, as `make_cpd --mod` or `--from` does, and return its
+// manifest line.
+std::string
+write_shard(warthog::graph::xy_graph& g, const std::string& filename,
+            const std::vector<uint32_t>& nodes)
+{
+    warthog::cpd::graph_oracle_base<warthog::cpd::REVERSE> cpd(&g);
+    std::vector<warthog::cpd::fm_coll> s_row(g.get_num_nodes());
+    std::vector<warthog::cpd::rle_run32> runs;
+    warthog::cpd::first_move_graph fm_graph(&g, true);
+    warthog::cpd::first_move_dijkstra dijk(&fm_graph);
+
+    cpd.compute_dfs_preorder(0);
+    warthog::cpd::cpd_writer writer(
+        filename, true, warthog::cpd::REVERSE, cpd.get_order(), nodes.size(),
+        42);
+    REQUIRE(writer.create());
+    for(uint32_t node : nodes)
+    {
+        dijk.compute_row(node, s_row);
+        runs.clear();
+        cpd.compress_row(node, s_row, runs);
+        REQUIRE(writer.append(runs));
+    }
+    REQUIRE(writer.finish());
+
+    warthog::cpd::cpd_shard shard;
+    shard.filename_ = filename;
+    shard.first_ = nodes.at(0);
+    shard.step_ = nodes.size() > 1 ? nodes.at(1) - nodes.at(0) : 1;
+    std::stringstream ss;
+    warthog::cpd::write_shard_line(ss, shard);
+    return ss.str();
+}
+
+SCENARIO("Sharded CPDs", "[cpd][oracle][shards]")
+{
+    warthog::graph::xy_graph g;
+    make_lattice(g, 12, 9);
+    uint32_t num_nodes = g.get_num_nodes();
+
+    warthog::cpd::graph_oracle_base<warthog::cpd::REVERSE> rev(&g);
+    build_oracle_fm(g, rev, true);
+
+    std::string manifest = "cpd_oracle_test_shards";
+    std::vector<std::string> filenames;
+    auto shard_name = [&]()
+    {
+        filenames.push_back(
+            "cpd_oracle_test_shard" + std::to_string(filenames.size()) +
+            ".cpd");
+        return filenames.back();
+    };
+    auto write_manifest = [&](const std::string& lines)
+    {
+        std::ofstream ofs(manifest);
+        ofs << "# shards of a lattice\n\n" << lines;
+    };
+
+    GIVEN("Modulo shards")
+    {
+        std::string lines;
+        for(uint32_t num = 0; num < 3; num++)
+        {
+            std::vector<uint32_t> nodes;
+            for(uint32_t n = num; n < num_nodes; n += 3) { nodes.push_back(n); }
+            lines += write_shard(g, shard_name(), nodes);
+        }
+        write_manifest(lines);
+
+        warthog::cpd::graph_oracle_base<warthog::cpd::REVERSE> cpd(&g);
+        REQUIRE(cpd.map_shards(manifest));
+
+        THEN("They are one oracle")
+        {
+            REQUIRE(cpd.is_sharded());
+            REQUIRE(cpd.get_num_rows() == num_nodes);
+            REQUIRE(same_moves(g, rev, cpd));
+            REQUIRE(cpd == rev);
+        }
+
+        THEN("Batched lookups are routed to the shards")
+        {
+            std::vector<warthog::sn_id_t> sources, targets;
+            for(uint32_t s = 0; s < num_nodes; s++)
+            {
+                sources.push_back(s);
+                targets.push_back((s * 7 + 3) % num_nodes);
+            }
+            std::vector<uint32_t> moves(num_nodes);
+            cpd.get_moves(sources.data(), targets.data(), moves.data(),
+                          num_nodes);
+            for(uint32_t i = 0; i < num_nodes; i++)
+            {
+                REQUIRE(moves.at(i) ==
+                        rev.get_move(sources.at(i), targets.at(i)));
+            }
+        }
+
+        THEN("A copy maps the same shards")
+        {
+            warthog::cpd::graph_oracle_base<warthog::cpd::REVERSE> copy = cpd;
+            cpd.clear();
+            REQUIRE(same_moves(g, rev, copy));
+        }
+    }
+
+    GIVEN("Range shards")
+    {
+        std::vector<uint32_t> low(50), high(num_nodes - 50);
+        std::iota(low.begin(), low.end(), 0);
+        std::iota(high.begin(), high.end(), 50);
+        std::string low_line = write_shard(g, shard_name(), low);
+        std::string high_line = write_shard(g, shard_name(), high);
+
+        THEN("They are joined into the whole CPD")
+        {
+            write_manifest(high_line + low_line);
+            warthog::cpd::graph_oracle_base<warthog::cpd::REVERSE> cpd(&g);
+            REQUIRE(cpd.map_shards(manifest));
+
+            std::stringstream joined, whole;
+            cpd.write_binary(joined);
+            rev.write_binary(whole);
+            REQUIRE(joined.str() == whole.str());
+        }
+
+        THEN("Rows of missing shards are empty")
+        {
+            write_manifest(low_line);
+            warthog::cpd::graph_oracle_base<warthog::cpd::REVERSE> cpd(&g);
+            REQUIRE(cpd.map_shards(manifest));
+
+            REQUIRE(cpd.get_move(60, 10) == rev.get_move(60, 10));
+            REQUIRE(cpd.get_move(10, 60) == warthog::cpd::CPD_FM_NONE);
+        }
+
+        THEN("Shards which overlap are rejected")
+        {
+            write_manifest(low_line + low_line + high_line);
+            warthog::cpd::graph_oracle_base<warthog::cpd::REVERSE> cpd(&g);
+            REQUIRE(!cpd.map_shards(manifest));
+
+            write_manifest("range 0 cpd_oracle_test_missing.cpd\n");
+            REQUIRE(!cpd.map_shards(manifest));
+
+            write_manifest("mod 3 5 " + filenames.at(0) + "\n");
+            REQUIRE(!cpd.map_shards(manifest));
+        }
+    }
+
+    for(const std::string& filename : filenames)
+    {
+        std::remove(filename.c_str());
+    }
+    std::remove(manifest.c_str());
+}
+
+SCENARIO("Local replicas", "[cpd][oracle][numa]")
+{
+    warthog::graph::xy_graph g;
+    make_lattice(g, 12, 9);
+
+    warthog::cpd::graph_oracle_base<warthog::cpd::REVERSE> rev(&g);
+    build_oracle_fm(g, rev, true);
+    warthog::cpd::graph_oracle_base<warthog::cpd::REVERSE> delta = rev;
+    REQUIRE(delta.encode_deltas());
+
+    std::string filename = "cpd_oracle_test_replica.cpd";
+    std::ofstream ofs(filename, std::ios_base::binary);
+    delta.write_binary(ofs);
+    ofs.close();
+
+    GIVEN("A replica of a mapped CPD")
+    {
+        warthog::cpd::graph_oracle_base<warthog::cpd::REVERSE> mapped(&g);
+        REQUIRE(mapped.load(filename));
+        warthog::cpd::graph_oracle_base<warthog::cpd::REVERSE> replica =
+            mapped;
+        replica.localise();
+
+        THEN("It has rows of its own and the same moves")
+        {
+            REQUIRE(mapped.is_mapped());
+            REQUIRE(!replica.is_mapped());
+            REQUIRE(replica.is_flat());
+            REQUIRE(replica.has_delta_rows());
+            REQUIRE(replica == delta);
+            REQUIRE(same_moves(g, rev, replica));
+        }
+    }
+
+    GIVEN("The CPU lists of NUMA nodes")
+    {
+        THEN("Ranges and single CPUs are read")
+        {
+            std::vector<uint32_t> cpus =
+                warthog::util::parse_cpu_list("0-3,8,10-11\n");
+            REQUIRE(cpus == std::vector<uint32_t>({0, 1, 2, 3, 8, 10, 11}));
+            REQUIRE(warthog::util::parse_cpu_list("").empty());
+
+            std::vector<warthog::util::numa_node> nodes =
+                warthog::util::get_numa_nodes();
+            REQUIRE(nodes.size() > 0);
+            REQUIRE(nodes.at(0).cpus_.size() > 0);
+        }
+
+        THEN("A pinned thread gets its CPUs back")
+        {
+            // empty where threads cannot be pinned
+            std::vector<uint32_t> cpus = warthog::util::get_thread_cpus();
+            std::vector<uint32_t> pinned, restored;
+            std::thread t([&] ()
+            {
+                if (cpus.empty()) { return; }
+                warthog::util::pin_thread({cpus.front()});
+                pinned = warthog::util::get_thread_cpus();
+                warthog::util::pin_thread(cpus);
+                restored = warthog::util::get_thread_cpus();
+            });
+            t.join();
+
+            if (!cpus.empty())
+            {
+                REQUIRE(pinned == std::vector<uint32_t>({cpus.front()}));
+                REQUIRE(restored == cpus);
+            }
+        }
+    }
+
+    std::remove(filename.c_str());
+}